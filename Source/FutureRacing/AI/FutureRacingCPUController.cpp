@@ -0,0 +1,128 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "FutureRacingCPUController.h"
+#include "FutureRacingPawn.h"
+#include "FutureRacingTrackSubsystem.h"
+#include "ChaosWheeledVehicleMovementComponent.h"
+#include "Components/SplineComponent.h"
+#include "EngineUtils.h"
+#include "Engine/World.h"
+#include "FutureRacing.h"
+
+DECLARE_CYCLE_STAT(TEXT("CPU Controller Tick"), STAT_FutureRacingCPUControllerTick, STATGROUP_FutureRacing);
+
+AFutureRacingCPUController::AFutureRacingCPUController()
+{
+	PrimaryActorTick.bCanEverTick = true;
+}
+
+void AFutureRacingCPUController::SetPath(USplineComponent* PathSpline)
+{
+	UFutureRacingTrackSubsystem* TrackSubsystem = GetWorld()->GetSubsystem<UFutureRacingTrackSubsystem>();
+
+	Track = TrackSubsystem ? TrackSubsystem->GetTable(PathSpline) : nullptr;
+
+	// start tracking from wherever the car is
+	PathDistance = -1.0f;
+}
+
+void AFutureRacingCPUController::OnPossess(APawn* InPawn)
+{
+	Super::OnPossess(InPawn);
+
+	// get a pointer to the controlled pawn
+	VehiclePawn = Cast<AFutureRacingPawn>(InPawn);
+
+	if (!Track.IsValid())
+	{
+		SetPath(FindPath());
+	}
+
+	if (!Track.IsValid() || !Track->IsValid())
+	{
+		UE_LOG(LogFutureRacing, Warning, TEXT("'%s' could not find a path spline to follow."), *GetNameSafe(this));
+	}
+}
+
+void AFutureRacingCPUController::OnUnPossess()
+{
+	VehiclePawn = nullptr;
+
+	Super::OnUnPossess();
+}
+
+USplineComponent* AFutureRacingCPUController::FindPath() const
+{
+	// look for a tagged path first
+	if (!PathTag.IsNone())
+	{
+		for (TActorIterator<AActor> It(GetWorld()); It; ++It)
+		{
+			if (It->ActorHasTag(PathTag))
+			{
+				return It->FindComponentByClass<USplineComponent>();
+			}
+		}
+	}
+
+	// fall back to the primary track
+	UFutureRacingTrackSubsystem* TrackSubsystem = GetWorld()->GetSubsystem<UFutureRacingTrackSubsystem>();
+
+	return TrackSubsystem ? TrackSubsystem->GetPrimarySpline() : nullptr;
+}
+
+void AFutureRacingCPUController::Tick(float Delta)
+{
+	FUTURERACING_SCOPE_CYCLE_COUNTER(STAT_FutureRacingCPUControllerTick);
+
+	Super::Tick(Delta);
+
+	if (!IsValid(VehiclePawn) || !Track.IsValid() || !Track->IsValid())
+	{
+		return;
+	}
+
+	// the simulation LOD moves kinematic cars along the track for us
+	if (VehiclePawn->IsKinematicSimulation())
+	{
+		PathDistance = -1.0f;
+		return;
+	}
+
+	const FTransform& VehicleTransform = VehiclePawn->GetActorTransform();
+	const float Speed = VehiclePawn->GetChaosVehicleMovement()->GetForwardSpeed();
+
+	// update our position along the path, using the last one to disambiguate crossovers
+	PathDistance = Track->FindClosestDistance(VehicleTransform.GetLocation(), PathDistance);
+
+	// aim at a point further along the path
+	const float AimDistance = PathDistance + LookAheadDistance + FMath::Max(Speed, 0.0f) * LookAheadTime;
+	const FVector AimLocation = Track->GetPositionAtDistance(AimDistance);
+
+	// steer towards the aim point
+	const FVector LocalAim = VehicleTransform.InverseTransformPosition(AimLocation);
+	const float HeadingError = FMath::Atan2(LocalAim.Y, LocalAim.X);
+
+	VehiclePawn->DoSteering(FMath::Clamp(HeadingError * SteeringGain, -1.0f, 1.0f));
+
+	// throttle or brake towards the target speed
+	const float SpeedError = GetTargetSpeed(PathDistance, Speed) - Speed;
+
+	if (SpeedError >= 0.0f)
+	{
+		VehiclePawn->DoThrottle(FMath::Clamp(SpeedError / SpeedErrorRange, 0.1f, 1.0f));
+
+	} else {
+
+		VehiclePawn->DoBrake(FMath::Clamp(-SpeedError / SpeedErrorRange, 0.0f, 1.0f));
+	}
+}
+
+float AFutureRacingCPUController::GetTargetSpeed(float Distance, float Speed) const
+{
+	// the baked speed profile already includes braking zones, so just read slightly ahead to allow for reaction time
+	const float SpeedDistance = Distance + FMath::Max(Speed, 0.0f) * SpeedLookAheadTime;
+
+	return FMath::Min(MaxSpeed, Track->GetSuggestedSpeedAtDistance(SpeedDistance));
+}
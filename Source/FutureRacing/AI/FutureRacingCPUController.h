@@ -0,0 +1,87 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AIController.h"
+#include "FutureRacingCPUController.generated.h"
+
+class AFutureRacingPawn;
+class USplineComponent;
+struct FFutureRacingTrackTable;
+
+/**
+ *  Native CPU racer controller.
+ *  Follows a path spline placed on the level and drives the vehicle
+ *  through the pawn's steering, throttle and brake API.
+ *  Track position, direction and target speed come from the spline's baked lookup table.
+ */
+UCLASS()
+class AFutureRacingCPUController : public AAIController
+{
+	GENERATED_BODY()
+
+protected:
+
+	/** If set, the path is taken from the first actor with this tag. Otherwise the primary track is used */
+	UPROPERTY(EditAnywhere, Category="CPU|Path")
+	FName PathTag;
+
+	/** Minimum distance ahead of the car to aim at */
+	UPROPERTY(EditAnywhere, Category="CPU|Steering", meta = (Units = "cm"))
+	float LookAheadDistance = 800.0f;
+
+	/** Additional look ahead time, scaled by the car's speed */
+	UPROPERTY(EditAnywhere, Category="CPU|Steering", meta = (Units = "s"))
+	float LookAheadTime = 0.4f;
+
+	/** Multiplier applied to the heading error to produce steering input */
+	UPROPERTY(EditAnywhere, Category="CPU|Steering")
+	float SteeringGain = 1.5f;
+
+	/** Top speed the CPU will target. The track's suggested speed is used when lower */
+	UPROPERTY(EditAnywhere, Category="CPU|Speed", meta = (Units = "cm/s"))
+	float MaxSpeed = 4000.0f;
+
+	/** How far ahead to read the track's suggested speed, scaled by the car's speed */
+	UPROPERTY(EditAnywhere, Category="CPU|Speed", meta = (Units = "s"))
+	float SpeedLookAheadTime = 0.3f;
+
+	/** Speed error at which throttle or brake is fully applied */
+	UPROPERTY(EditAnywhere, Category="CPU|Speed", meta = (Units = "cm/s"))
+	float SpeedErrorRange = 500.0f;
+
+	/** Baked lookup table for the path being followed */
+	TSharedPtr<const FFutureRacingTrackTable> Track;
+
+	/** Pointer to the controlled vehicle pawn */
+	TObjectPtr<AFutureRacingPawn> VehiclePawn;
+
+	/** Last known distance along the path */
+	float PathDistance = -1.0f;
+
+public:
+
+	/** Constructor */
+	AFutureRacingCPUController();
+
+	/** Overrides the path the CPU follows */
+	void SetPath(USplineComponent* PathSpline);
+
+	/** Drives the vehicle */
+	virtual void Tick(float Delta) override;
+
+protected:
+
+	/** Pawn setup */
+	virtual void OnPossess(APawn* InPawn) override;
+
+	/** Pawn cleanup */
+	virtual void OnUnPossess() override;
+
+	/** Finds the path spline on the level */
+	USplineComponent* FindPath() const;
+
+	/** Returns the speed the CPU should target at the given path distance */
+	float GetTargetSpeed(float Distance, float Speed) const;
+};
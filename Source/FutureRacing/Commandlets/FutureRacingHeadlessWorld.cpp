@@ -0,0 +1,203 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "FutureRacingHeadlessWorld.h"
+#include "FutureRacingPawn.h"
+#include "FutureRacingMarkerSubsystem.h"
+#include "FutureRacing.h"
+#include "Engine/Engine.h"
+#include "Engine/GameInstance.h"
+#include "Engine/World.h"
+#include "GameFramework/Controller.h"
+#include "GameFramework/PlayerStart.h"
+#include "Misc/App.h"
+#include "UObject/UObjectGlobals.h"
+
+FFutureRacingHeadlessWorld::~FFutureRacingHeadlessWorld()
+{
+	Shutdown();
+}
+
+bool FFutureRacingHeadlessWorld::LoadMap(const FString& MapName)
+{
+	check(GEngine);
+
+	// create a standalone game instance to own the world context
+	GameInstance = NewObject<UGameInstance>(GEngine);
+	GameInstance->AddToRoot();
+	GameInstance->InitializeStandalone();
+
+	FWorldContext* Context = GameInstance->GetWorldContext();
+
+	// load the map the same way a game client would, which spawns the game mode and begins play
+	FString Error;
+	if (!GEngine->LoadMap(*Context, FURL(*MapName), nullptr, Error))
+	{
+		UE_LOG(LogFutureRacing, Error, TEXT("Could not load map '%s': %s"), *MapName, *Error);
+		return false;
+	}
+
+	World = Context->World();
+
+	// cache the player starts so we can lay out a starting grid
+	if (UFutureRacingMarkerSubsystem* Markers = World->GetSubsystem<UFutureRacingMarkerSubsystem>())
+	{
+		for (int32 StartIndex = 0; StartIndex < Markers->GetNumPlayerStarts(); ++StartIndex)
+		{
+			if (APlayerStart* PlayerStart = Markers->GetPlayerStart(StartIndex))
+			{
+				StartTransforms.Add(PlayerStart->GetActorTransform());
+			}
+		}
+	}
+
+	if (StartTransforms.Num() == 0)
+	{
+		UE_LOG(LogFutureRacing, Warning, TEXT("Map '%s' has no player starts. Vehicles will spawn at the origin."), *MapName);
+		StartTransforms.Add(FTransform::Identity);
+	}
+
+	SimulatedTime = 0.0;
+
+	return true;
+}
+
+void FFutureRacingHeadlessWorld::Shutdown()
+{
+	Vehicles.Reset();
+	StartTransforms.Reset();
+
+	if (!GameInstance)
+	{
+		return;
+	}
+
+	if (World)
+	{
+		World->EndPlay(EEndPlayReason::Quit);
+	}
+
+	GameInstance->Shutdown();
+	GameInstance->RemoveFromRoot();
+	GameInstance = nullptr;
+
+	// LoadMap rooted the world, so it has to be released by hand. DestroyWorld cleans it up and unroots it
+	if (World)
+	{
+		GEngine->DestroyWorldContext(World);
+		World->DestroyWorld(false);
+		World = nullptr;
+	}
+
+	// collect it now, so the next pass doesn't load the same map into a world that's still around
+	CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+}
+
+AFutureRacingPawn* FFutureRacingHeadlessWorld::SpawnVehicle(UClass* VehicleClass, UClass* ControllerClass, int32 SlotIndex)
+{
+	if (!World)
+	{
+		return nullptr;
+	}
+
+	return SpawnVehicle(VehicleClass, ControllerClass, GetSlotTransform(SlotIndex));
+}
+
+AFutureRacingPawn* FFutureRacingHeadlessWorld::SpawnVehicle(UClass* VehicleClass, UClass* ControllerClass, const FTransform& SpawnTransform)
+{
+	if (!World || !VehicleClass)
+	{
+		return nullptr;
+	}
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
+
+	AFutureRacingPawn* Vehicle = World->SpawnActor<AFutureRacingPawn>(VehicleClass, SpawnTransform, SpawnParams);
+
+	if (!Vehicle)
+	{
+		UE_LOG(LogFutureRacing, Error, TEXT("Could not spawn vehicle of class '%s'."), *GetNameSafe(VehicleClass));
+		return nullptr;
+	}
+
+	// the Chaos movement component ignores inputs from pawns without a controller
+	if (ControllerClass)
+	{
+		if (AController* Controller = World->SpawnActor<AController>(ControllerClass, Vehicle->GetActorTransform(), SpawnParams))
+		{
+			Controller->Possess(Vehicle);
+		}
+	}
+
+	Vehicles.Add(Vehicle);
+
+	return Vehicle;
+}
+
+void FFutureRacingHeadlessWorld::Step(float DeltaSeconds)
+{
+	if (!World)
+	{
+		return;
+	}
+
+	// advance the application clock so timers and physics see a consistent fixed step
+	FApp::SetDeltaTime(DeltaSeconds);
+	FApp::SetCurrentTime(FApp::GetCurrentTime() + DeltaSeconds);
+
+	World->Tick(LEVELTICK_All, DeltaSeconds);
+
+	++GFrameCounter;
+	SimulatedTime += DeltaSeconds;
+}
+
+FTransform FFutureRacingHeadlessWorld::GetSlotTransform(int32 SlotIndex) const
+{
+	// distribute the slots round robin across the player starts
+	const FTransform& Start = StartTransforms[SlotIndex % StartTransforms.Num()];
+	const int32 GridIndex = SlotIndex / StartTransforms.Num();
+
+	// lay out a grid behind the start, offsetting the columns around the start's center line
+	const int32 Row = GridIndex / GridColumns;
+	const int32 Column = GridIndex % GridColumns;
+	const float ColumnOffset = (Column - (GridColumns - 1) * 0.5f) * GridColumnSpacing;
+
+	const FVector LocalOffset(-Row * GridRowSpacing, ColumnOffset, 0.0f);
+
+	return FTransform(Start.GetRotation(), Start.TransformPosition(LocalOffset));
+}
+
+FString FFutureRacingHeadlessWorld::ResolveMapName(const FString& MapName)
+{
+	// full package paths are used as is
+	if (MapName.StartsWith(TEXT("/")))
+	{
+		return MapName;
+	}
+
+	return FString::Printf(TEXT("/Game/Variant_TimeTrial/Maps/%s"), *MapName);
+}
+
+UClass* FFutureRacingHeadlessWorld::ResolveVehicleClass(const FString& VehicleName)
+{
+	FString ClassPath = VehicleName;
+
+	if (VehicleName.Equals(TEXT("Sports"), ESearchCase::IgnoreCase))
+	{
+		ClassPath = TEXT("/Game/VehicleTemplate/Blueprints/SportsCar/BP_SportsCar_Pawn.BP_SportsCar_Pawn_C");
+
+	} else if (VehicleName.Equals(TEXT("Offroad"), ESearchCase::IgnoreCase)) {
+
+		ClassPath = TEXT("/Game/VehicleTemplate/Blueprints/OffroadCar/BP_OffroadCar_Pawn.BP_OffroadCar_Pawn_C");
+	}
+
+	UClass* VehicleClass = LoadClass<AFutureRacingPawn>(nullptr, *ClassPath);
+
+	if (!VehicleClass)
+	{
+		UE_LOG(LogFutureRacing, Error, TEXT("Could not load vehicle class '%s'."), *ClassPath);
+	}
+
+	return VehicleClass;
+}
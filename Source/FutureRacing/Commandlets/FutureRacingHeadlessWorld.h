@@ -0,0 +1,81 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UWorld;
+class UGameInstance;
+class AFutureRacingPawn;
+class AController;
+
+/**
+ *  Standalone game world used by the headless commandlets.
+ *  Loads a map without a viewport, spawns vehicles and steps
+ *  the world at a fixed timestep as fast as the CPU allows.
+ */
+class FFutureRacingHeadlessWorld
+{
+public:
+
+	~FFutureRacingHeadlessWorld();
+
+	/** Loads the map and begins play. Returns false on failure */
+	bool LoadMap(const FString& MapName);
+
+	/** Tears down the game instance, destroys the world and collects garbage, so a map can be loaded again from scratch */
+	void Shutdown();
+
+	/** Spawns a vehicle of the given class at the given spawn slot and possesses it with a controller of the given class */
+	AFutureRacingPawn* SpawnVehicle(UClass* VehicleClass, UClass* ControllerClass, int32 SlotIndex);
+
+	/** Spawns a vehicle of the given class at the given transform and possesses it with a controller of the given class */
+	AFutureRacingPawn* SpawnVehicle(UClass* VehicleClass, UClass* ControllerClass, const FTransform& SpawnTransform);
+
+	/** Advances the world by a single fixed step */
+	void Step(float DeltaSeconds);
+
+	/** Returns the loaded world */
+	UWorld* GetWorld() const { return World; };
+
+	/** Returns the vehicles spawned so far */
+	const TArray<AFutureRacingPawn*>& GetVehicles() const { return Vehicles; };
+
+	/** Total simulated time since the map was loaded, in seconds */
+	double GetSimulatedTime() const { return SimulatedTime; };
+
+	/** Expands a short map name such as "Lvl_Timetrial" or "CPU_Playground" into a package path */
+	static FString ResolveMapName(const FString& MapName);
+
+	/** Loads a vehicle class from a short name such as "Sports" or "Offroad", or from a full class path */
+	static UClass* ResolveVehicleClass(const FString& VehicleName);
+
+protected:
+
+	/** Returns the transform for a spawn slot, laid out in a grid behind the level's player starts */
+	FTransform GetSlotTransform(int32 SlotIndex) const;
+
+	/** Game instance that owns the world context */
+	UGameInstance* GameInstance = nullptr;
+
+	/** Loaded world */
+	UWorld* World = nullptr;
+
+	/** Spawned vehicles */
+	TArray<AFutureRacingPawn*> Vehicles;
+
+	/** Start transforms found on the map */
+	TArray<FTransform> StartTransforms;
+
+	/** Accumulated simulated time */
+	double SimulatedTime = 0.0;
+
+	/** Distance between grid slots along the start's forward axis */
+	float GridRowSpacing = 800.0f;
+
+	/** Distance between grid slots along the start's right axis */
+	float GridColumnSpacing = 400.0f;
+
+	/** Number of cars per grid row */
+	int32 GridColumns = 4;
+};
@@ -0,0 +1,1433 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "FutureRacingSimCommandlet.h"
+#include "FutureRacingHeadlessWorld.h"
+#include "FutureRacingPawn.h"
+#include "FutureRacingCPUController.h"
+#include "FutureRacingVehicleMovementComponent.h"
+#include "TimeTrialTrackGate.h"
+#include "FutureRacingMarkerSubsystem.h"
+#include "FutureRacingTrackProgressSubsystem.h"
+#include "FutureRacingGateCrossingSubsystem.h"
+#include "FutureRacingReplaySubsystem.h"
+#include "FutureRacingTelemetrySubsystem.h"
+#include "FutureRacingReplayFile.h"
+#include "FutureRacingInputLog.h"
+#include "FutureRacingInputLogSubsystem.h"
+#include "FutureRacing.h"
+#include "AIController.h"
+#include "Components/ActorComponent.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformMemory.h"
+#include "Engine/World.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/App.h"
+#include "Misc/DateTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Physics/Experimental/PhysScene_Chaos.h"
+#include "PBDRigidsSolver.h"
+#include "Stats/ThreadIdleStats.h"
+#include <atomic>
+
+namespace FutureRacingSim
+{
+	/** Race state and scripted input for a single simulated car */
+	struct FSimDriver
+	{
+		/** Vehicle being driven */
+		AFutureRacingPawn* Vehicle = nullptr;
+
+		/** Next gate the vehicle should pass */
+		ATimeTrialTrackGate* TargetGate = nullptr;
+
+		/** Number of completed laps */
+		int32 CompletedLaps = 0;
+
+		/** Physics time when the current lap started */
+		double LapStartTime = 0.0;
+
+		/** Completed lap times, in seconds */
+		TArray<double> LapTimes;
+
+		/** Phase offset for the fallback weaving input, so cars don't all steer in lockstep */
+		float WeavePhase = 0.0f;
+
+		/** Updates the scripted input for this car */
+		void Drive(double SimTime)
+		{
+			if (TargetGate)
+			{
+				// steer towards the next gate
+				const FVector LocalTarget = Vehicle->GetActorTransform().InverseTransformPosition(TargetGate->GetActorLocation());
+				const float Heading = FMath::Atan2(LocalTarget.Y, LocalTarget.X);
+
+				Vehicle->DoSteering(FMath::Clamp(Heading * 2.0f / PI, -1.0f, 1.0f));
+
+				// ease off the throttle on tight corners
+				Vehicle->DoThrottle(FMath::Abs(Heading) > 0.6f ? 0.4f : 1.0f);
+
+			} else {
+
+				// no gates on this map: weave around at full throttle
+				Vehicle->DoSteering(FMath::Sin(SimTime * 0.5 + WeavePhase) * 0.5f);
+				Vehicle->DoThrottle(1.0f);
+			}
+		}
+	};
+
+	/** Options shared by the race and the benchmark */
+	struct FSimOptions
+	{
+		FString MapName = TEXT("Lvl_Timetrial");
+		TArray<UClass*> VehicleClasses;
+		UClass* ControllerClass = nullptr;
+		bool bScriptedInput = true;
+		float FixedStep = 1.0f / 60.0f;
+
+		/** Parses the common options. Returns false if they are unusable */
+		bool Parse(const FString& Params)
+		{
+			FParse::Value(*Params, TEXT("Map="), MapName);
+			FParse::Value(*Params, TEXT("Step="), FixedStep);
+
+			// resolve the vehicle classes. Cars cycle through the list in order
+			FString VehicleNames = TEXT("Sports");
+			FParse::Value(*Params, TEXT("Vehicle="), VehicleNames);
+
+			TArray<FString> VehicleNameList;
+			VehicleNames.ParseIntoArray(VehicleNameList, TEXT(","));
+
+			for (const FString& VehicleName : VehicleNameList)
+			{
+				if (UClass* VehicleClass = FFutureRacingHeadlessWorld::ResolveVehicleClass(VehicleName))
+				{
+					VehicleClasses.Add(VehicleClass);
+				}
+			}
+
+			// resolve the driver. Scripted input drives plain AI controllers from the commandlet
+			FString ControllerName = TEXT("Scripted");
+			FParse::Value(*Params, TEXT("Controller="), ControllerName);
+
+			bScriptedInput = ControllerName.Equals(TEXT("Scripted"), ESearchCase::IgnoreCase);
+
+			if (bScriptedInput)
+			{
+				ControllerClass = AAIController::StaticClass();
+
+			} else if (ControllerName.Equals(TEXT("CPU"), ESearchCase::IgnoreCase)) {
+
+				ControllerClass = AFutureRacingCPUController::StaticClass();
+
+			} else if (ControllerName.Equals(TEXT("BP"), ESearchCase::IgnoreCase)) {
+
+				ControllerClass = LoadClass<AController>(nullptr, TEXT("/Game/CPU/BP_CPU_AI.BP_CPU_AI_C"));
+
+			} else {
+
+				ControllerClass = LoadClass<AController>(nullptr, *ControllerName);
+			}
+
+			if (!ControllerClass)
+			{
+				UE_LOG(LogFutureRacing, Error, TEXT("Could not resolve controller '%s'."), *ControllerName);
+			}
+
+			return VehicleClasses.Num() > 0 && ControllerClass && FixedStep > 0.0f;
+		}
+	};
+
+	/** Logs the average component count, ticking components and memory of the spawned vehicles */
+	void LogVehicleFootprint(const TArray<FSimDriver>& Drivers)
+	{
+		int32 NumVehicles = 0;
+		int64 NumComponents = 0;
+		int64 NumTicking = 0;
+		SIZE_T NumBytes = 0;
+
+		for (const FSimDriver& Driver : Drivers)
+		{
+			if (!IsValid(Driver.Vehicle))
+			{
+				continue;
+			}
+
+			++NumVehicles;
+			NumBytes += Driver.Vehicle->GetClass()->GetStructureSize();
+
+			for (UActorComponent* Component : Driver.Vehicle->GetComponents())
+			{
+				++NumComponents;
+				NumTicking += Component->IsComponentTickEnabled() ? 1 : 0;
+				NumBytes += Component->GetClass()->GetStructureSize() + Component->GetResourceSizeBytes(EResourceSizeMode::Exclusive);
+			}
+		}
+
+		if (NumVehicles > 0)
+		{
+			// the variable lives with the pawn, so it may not be registered in a stripped down build
+			const IConsoleVariable* EagerRigVar = IConsoleManager::Get().FindConsoleVariable(TEXT("FutureRacing.Camera.EagerRig"));
+			const TCHAR* RigMode = EagerRigVar ? (EagerRigVar->GetInt() ? TEXT("eager") : TEXT("parked")) : TEXT("unknown");
+
+			UE_LOG(LogFutureRacing, Display, TEXT("Per car: %.1f components, %.1f ticking, %.1f KB (camera rig %s)."),
+				static_cast<double>(NumComponents) / NumVehicles,
+				static_cast<double>(NumTicking) / NumVehicles,
+				NumBytes / 1024.0 / NumVehicles,
+				RigMode);
+		}
+	}
+
+	/** Returns the finish line gate on the world, if any */
+	ATimeTrialTrackGate* FindFinishLine(UWorld* World)
+	{
+		UFutureRacingMarkerSubsystem* Markers = World->GetSubsystem<UFutureRacingMarkerSubsystem>();
+
+		return Markers ? Markers->GetFinishLine() : nullptr;
+	}
+
+	/** Follows each car along the gate chain and times its laps, starting every lap clock now */
+	void TrackLaps(UWorld* World, TArray<FSimDriver>& Drivers)
+	{
+		UFutureRacingMarkerSubsystem* Markers = World->GetSubsystem<UFutureRacingMarkerSubsystem>();
+
+		for (int32 GateIndex = 0; GateIndex < Markers->GetNumGates(); ++GateIndex)
+		{
+			Markers->GetGate(GateIndex)->OnActorPassed.AddLambda([&Drivers](ATimeTrialTrackGate* Gate, AActor* PassingActor, double CrossingTime)
+			{
+				for (FSimDriver& Driver : Drivers)
+				{
+					if (Driver.Vehicle == PassingActor && Driver.TargetGate == Gate)
+					{
+						Driver.TargetGate = Gate->GetNextMarker();
+
+						// time laps from the interpolated crossings, so they don't depend on the step size
+						if (Gate->IsFinishLine())
+						{
+							Driver.LapTimes.Add(CrossingTime - Driver.LapStartTime);
+							Driver.LapStartTime = CrossingTime;
+							++Driver.CompletedLaps;
+						}
+
+						break;
+					}
+				}
+			});
+		}
+
+		// start every lap clock on the physics time the crossings are measured in
+		if (UFutureRacingGateCrossingSubsystem* GateCrossing = World->GetSubsystem<UFutureRacingGateCrossingSubsystem>())
+		{
+			const double StartTime = GateCrossing->GetPhysicsResultsTime();
+
+			for (FSimDriver& Driver : Drivers)
+			{
+				Driver.LapStartTime = StartTime;
+			}
+		}
+	}
+
+	/** Recorded inputs of a single vehicle, read from a replay and played back by time */
+	struct FInputTrack
+	{
+		/** Recorded samples, in time order */
+		TArray<FutureRacingReplay::FSample> Samples;
+
+		/** Sample the last lookup landed on */
+		int32 SampleIndex = 0;
+
+		/** Handbrake state last sent to the vehicle */
+		bool bHandbrake = false;
+
+		/** Loads a vehicle's samples from a replay. Takes the first recorded vehicle if VehicleId is INDEX_NONE */
+		bool Load(const FString& Filename, int32 VehicleId)
+		{
+			const TSharedPtr<const FFutureRacingReplayFile, ESPMode::ThreadSafe> File = FFutureRacingReplayFile::Open(Filename);
+
+			if (!File)
+			{
+				UE_LOG(LogFutureRacing, Error, TEXT("Could not read input replay '%s'."), *Filename);
+				return false;
+			}
+
+			const FFutureRacingReplayFile::FVehicleEntry* Vehicle = nullptr;
+
+			if (VehicleId != INDEX_NONE)
+			{
+				Vehicle = File->FindVehicle(VehicleId);
+
+			} else if (File->GetVehicles().Num() > 0) {
+
+				Vehicle = &File->GetVehicles()[0];
+			}
+
+			if (Vehicle)
+			{
+				for (const FFutureRacingReplayFile::FBlockEntry& Block : Vehicle->Blocks)
+				{
+					File->DecodeSamples(Block, Samples);
+				}
+			}
+
+			if (Samples.Num() == 0)
+			{
+				UE_LOG(LogFutureRacing, Error, TEXT("Input replay '%s' has no samples for the requested vehicle."), *Filename);
+				return false;
+			}
+
+			return true;
+		}
+
+		/** Returns true once samples are loaded */
+		bool IsValid() const { return Samples.Num() > 0; }
+
+		/** Returns the length of the recording, in seconds */
+		double GetDuration() const { return Samples.Last().Time - Samples[0].Time; }
+
+		/** Returns where the recording started. The first sample is always a keyframe */
+		FTransform GetStartTransform() const
+		{
+			const FutureRacingReplay::FQuantizedState& State = Samples[0].State;
+
+			return FTransform(State.GetRotation(), State.GetLocation());
+		}
+
+		/** Applies the input recorded at a time since the start of the recording. Time must not go backwards */
+		void Drive(AFutureRacingPawn* Vehicle, double Time)
+		{
+			const double RecordedTime = Samples[0].Time + Time;
+
+			while (SampleIndex + 1 < Samples.Num() && Samples[SampleIndex + 1].Time <= RecordedTime)
+			{
+				++SampleIndex;
+			}
+
+			const FutureRacingReplay::FQuantizedInput& Input = Samples[SampleIndex].Input;
+
+			Vehicle->DoSteering(Input.GetSteering());
+			Vehicle->DoThrottle(Input.GetThrottle());
+			Vehicle->DoBrake(Input.GetBrake());
+
+			if (Input.bHandbrake != bHandbrake)
+			{
+				bHandbrake = Input.bHandbrake;
+
+				if (bHandbrake)
+				{
+					Vehicle->DoHandbrakeStart();
+
+				} else {
+
+					Vehicle->DoHandbrakeStop();
+				}
+			}
+		}
+	};
+
+	/** Measures the time the physics solver spends advancing, on whichever thread it runs */
+	struct FPhysicsTimer
+	{
+		Chaos::FPBDRigidsSolver* Solver = nullptr;
+
+		FDelegateHandle PreAdvanceHandle;
+		FDelegateHandle PostAdvanceHandle;
+
+		/** Written on the physics thread */
+		std::atomic<uint64> AdvanceStartCycles { 0 };
+		std::atomic<uint64> AdvanceCycles { 0 };
+		std::atomic<int32> NumAdvances { 0 };
+
+		~FPhysicsTimer()
+		{
+			Stop();
+		}
+
+		/** Starts timing the world's solver */
+		void Start(UWorld* World)
+		{
+			Solver = World->GetPhysicsScene() ? World->GetPhysicsScene()->GetSolver() : nullptr;
+
+			if (!Solver)
+			{
+				return;
+			}
+
+			PreAdvanceHandle = Solver->AddPreAdvanceCallback(Chaos::FSolverPreAdvance::FDelegate::CreateLambda([this](Chaos::FReal)
+			{
+				AdvanceStartCycles.store(FPlatformTime::Cycles64(), std::memory_order_relaxed);
+			}));
+
+			PostAdvanceHandle = Solver->AddPostAdvanceCallback(Chaos::FSolverPostAdvance::FDelegate::CreateLambda([this](Chaos::FReal)
+			{
+				AdvanceCycles.fetch_add(FPlatformTime::Cycles64() - AdvanceStartCycles.load(std::memory_order_relaxed), std::memory_order_relaxed);
+				NumAdvances.fetch_add(1, std::memory_order_relaxed);
+			}));
+		}
+
+		/** Stops timing. Callers must not read the timer from the physics thread after this */
+		void Stop()
+		{
+			if (Solver)
+			{
+				Solver->RemovePreAdvanceCallback(PreAdvanceHandle);
+				Solver->RemovePostAdvanceCallback(PostAdvanceHandle);
+				Solver = nullptr;
+			}
+		}
+
+		/** Returns the solver time since the last call in milliseconds, and how many advances it covered */
+		double Consume(int32& OutNumAdvances)
+		{
+			OutNumAdvances = NumAdvances.exchange(0, std::memory_order_relaxed);
+
+			return FPlatformTime::ToMilliseconds64(AdvanceCycles.exchange(0, std::memory_order_relaxed));
+		}
+	};
+
+	/**
+	 *  Times world steps: the whole frame, the game thread's share of it and the physics solver.
+	 *  Game thread time is the frame minus the time the game thread spent blocked, e.g. waiting on physics
+	 */
+	struct FStepTimings
+	{
+		TArray<double> FrameMs;
+		TArray<double> GameThreadMs;
+		TArray<double> PhysicsMs;
+
+		/** Number of solver advances in the recorded steps */
+		int64 NumPhysicsSteps = 0;
+
+		FPhysicsTimer PhysicsTimer;
+
+		uint64 StepStartCycles = 0;
+		uint32 StepStartWaits = 0;
+
+		/** Starts timing the world's solver */
+		void Start(UWorld* World, int32 ExpectedSteps)
+		{
+			FrameMs.Reserve(ExpectedSteps);
+			GameThreadMs.Reserve(ExpectedSteps);
+			PhysicsMs.Reserve(ExpectedSteps);
+
+			PhysicsTimer.Start(World);
+		}
+
+		/** Stops timing the solver. Call before the world goes away */
+		void Stop()
+		{
+			PhysicsTimer.Stop();
+		}
+
+		/** Call before setting the step's input */
+		void BeginStep()
+		{
+			StepStartCycles = FPlatformTime::Cycles64();
+			StepStartWaits = FThreadIdleStats::Get().Waits;
+		}
+
+		/** Call after stepping the world. Warmup steps pass false, so they're timed but not recorded */
+		void EndStep(bool bRecord)
+		{
+			const double StepMs = FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - StepStartCycles);
+			const double WaitMs = FPlatformTime::ToMilliseconds(FThreadIdleStats::Get().Waits - StepStartWaits);
+
+			int32 NumAdvances = 0;
+			const double StepPhysicsMs = PhysicsTimer.Consume(NumAdvances);
+
+			if (!bRecord)
+			{
+				return;
+			}
+
+			FrameMs.Add(StepMs);
+			GameThreadMs.Add(FMath::Max(StepMs - WaitMs, 0.0));
+			PhysicsMs.Add(StepPhysicsMs);
+			NumPhysicsSteps += NumAdvances;
+		}
+
+		/** Returns the average solver time per physics step, in milliseconds */
+		double GetAveragePhysicsStepMs() const
+		{
+			double Total = 0.0;
+
+			for (const double Ms : PhysicsMs)
+			{
+				Total += Ms;
+			}
+
+			return NumPhysicsSteps > 0 ? Total / NumPhysicsSteps : 0.0;
+		}
+	};
+
+	/** Percentiles and hitch count of a per frame timing, in milliseconds */
+	struct FTimingSummary
+	{
+		double Average = 0.0;
+		double P50 = 0.0;
+		double P90 = 0.0;
+		double P95 = 0.0;
+		double P99 = 0.0;
+		double Max = 0.0;
+
+		/** Number of frames over the hitch threshold */
+		int32 NumHitches = 0;
+
+		/** Summarizes a timing. Uses nearest rank percentiles */
+		static FTimingSummary Make(TArray<double> Samples, double HitchMs)
+		{
+			FTimingSummary Summary;
+
+			if (Samples.Num() == 0)
+			{
+				return Summary;
+			}
+
+			Samples.Sort();
+
+			double Total = 0.0;
+
+			for (const double Sample : Samples)
+			{
+				Total += Sample;
+				Summary.NumHitches += Sample > HitchMs ? 1 : 0;
+			}
+
+			auto Percentile = [&Samples](double Fraction)
+			{
+				return Samples[FMath::Clamp(FMath::CeilToInt(Fraction * Samples.Num()) - 1, 0, Samples.Num() - 1)];
+			};
+
+			Summary.Average = Total / Samples.Num();
+			Summary.P50 = Percentile(0.50);
+			Summary.P90 = Percentile(0.90);
+			Summary.P95 = Percentile(0.95);
+			Summary.P99 = Percentile(0.99);
+			Summary.Max = Samples.Last();
+
+			return Summary;
+		}
+
+		/** Returns the CSV columns for a timing with the given name */
+		static FString GetCsvHeader(const TCHAR* Name)
+		{
+			return FString::Printf(TEXT("%sAvgMs,%sP50Ms,%sP90Ms,%sP95Ms,%sP99Ms,%sMaxMs,%sHitches"), Name, Name, Name, Name, Name, Name, Name);
+		}
+
+		/** Returns the CSV values matching GetCsvHeader */
+		FString ToCsv() const
+		{
+			return FString::Printf(TEXT("%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%d"), Average, P50, P90, P95, P99, Max, NumHitches);
+		}
+	};
+
+	/** Appends rows to a CSV file, writing the header first if the file is new */
+	bool AppendCsvRows(const FString& CsvFile, const FString& Header, const TArray<FString>& Rows)
+	{
+		FString Csv;
+
+		if (!IFileManager::Get().FileExists(*CsvFile))
+		{
+			Csv += Header + LINE_TERMINATOR;
+		}
+
+		for (const FString& Row : Rows)
+		{
+			Csv += Row + LINE_TERMINATOR;
+		}
+
+		if (!FFileHelper::SaveStringToFile(Csv, *CsvFile, FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM, &IFileManager::Get(), FILEWRITE_Append))
+		{
+			UE_LOG(LogFutureRacing, Error, TEXT("Could not write benchmark results to '%s'."), *CsvFile);
+			return false;
+		}
+
+		UE_LOG(LogFutureRacing, Display, TEXT("Wrote benchmark results to '%s'."), *FPaths::ConvertRelativePathToFull(CsvFile));
+
+		return true;
+	}
+}
+
+UFutureRacingSimCommandlet::UFutureRacingSimCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+	ShowErrorCount = true;
+}
+
+int32 UFutureRacingSimCommandlet::Main(const FString& Params)
+{
+	FString InputLogFile;
+	if (FParse::Value(*Params, TEXT("InputLog="), InputLogFile))
+	{
+		return RunInputReplay(Params);
+	}
+
+	if (FParse::Param(*Params, TEXT("LapBenchmark")))
+	{
+		return RunLapBenchmark(Params);
+	}
+
+	if (FParse::Param(*Params, TEXT("ScalingBenchmark")))
+	{
+		return RunScalingBenchmark(Params);
+	}
+
+	FString CarCounts;
+	if (FParse::Value(*Params, TEXT("CarCounts="), CarCounts))
+	{
+		return RunControllerBenchmark(Params);
+	}
+
+	return RunRace(Params);
+}
+
+int32 UFutureRacingSimCommandlet::RunRace(const FString& Params)
+{
+	using namespace FutureRacingSim;
+
+	// parse the options
+	FSimOptions Options;
+
+	int32 NumCars = 8;
+	FParse::Value(*Params, TEXT("Cars="), NumCars);
+
+	float Duration = 600.0f;
+	FParse::Value(*Params, TEXT("Duration="), Duration);
+
+	int32 TargetLaps = 3;
+	FParse::Value(*Params, TEXT("Laps="), TargetLaps);
+
+	if (!Options.Parse(Params) || NumCars <= 0)
+	{
+		UE_LOG(LogFutureRacing, Error, TEXT("Invalid simulation parameters."));
+		return 1;
+	}
+
+	// lock the engine to a fixed timestep
+	FApp::SetUseFixedTimeStep(true);
+	FApp::SetFixedDeltaTime(Options.FixedStep);
+
+	FFutureRacingHeadlessWorld SimWorld;
+
+	if (!SimWorld.LoadMap(FFutureRacingHeadlessWorld::ResolveMapName(Options.MapName)))
+	{
+		return 1;
+	}
+
+	UWorld* World = SimWorld.GetWorld();
+	ATimeTrialTrackGate* FinishLine = FindFinishLine(World);
+
+	// spawn the grid
+	TArray<FSimDriver> Drivers;
+	Drivers.Reserve(NumCars);
+
+	for (int32 CarIndex = 0; CarIndex < NumCars; ++CarIndex)
+	{
+		if (AFutureRacingPawn* Vehicle = SimWorld.SpawnVehicle(Options.VehicleClasses[CarIndex % Options.VehicleClasses.Num()], Options.ControllerClass, CarIndex))
+		{
+			FSimDriver& Driver = Drivers.AddDefaulted_GetRef();
+			Driver.Vehicle = Vehicle;
+			Driver.TargetGate = FinishLine ? FinishLine->GetNextMarker() : nullptr;
+			Driver.WeavePhase = CarIndex * 0.7f;
+		}
+	}
+
+	UE_LOG(LogFutureRacing, Display, TEXT("Simulating %d cars on '%s' with %s at %.4fs per step for up to %.0fs (%s)."),
+		Drivers.Num(), *Options.MapName, *GetNameSafe(Options.ControllerClass), Options.FixedStep, Duration, FinishLine ? TEXT("timed laps") : TEXT("no finish line found"));
+
+	LogVehicleFootprint(Drivers);
+
+	// capture physics rate telemetry for the whole grid
+	UFutureRacingTelemetrySubsystem* Telemetry = World->GetSubsystem<UFutureRacingTelemetrySubsystem>();
+
+	if (Telemetry && FParse::Param(*Params, TEXT("Telemetry")))
+	{
+		Telemetry->StartCapture();
+	}
+
+	// follow the gate chain and time laps for each car
+	TrackLaps(World, Drivers);
+
+	// run the simulation as fast as possible
+	const double WallStart = FPlatformTime::Seconds();
+	int32 Steps = 0;
+
+	while (SimWorld.GetSimulatedTime() < Duration && !IsEngineExitRequested())
+	{
+		const double SimTime = SimWorld.GetSimulatedTime();
+
+		bool bAllFinished = FinishLine != nullptr;
+
+		for (FSimDriver& Driver : Drivers)
+		{
+			if (Options.bScriptedInput && IsValid(Driver.Vehicle))
+			{
+				Driver.Drive(SimTime);
+			}
+
+			bAllFinished &= Driver.CompletedLaps >= TargetLaps;
+		}
+
+		if (bAllFinished)
+		{
+			break;
+		}
+
+		SimWorld.Step(Options.FixedStep);
+		++Steps;
+	}
+
+	const double WallTime = FPlatformTime::Seconds() - WallStart;
+	const double SimTime = SimWorld.GetSimulatedTime();
+
+	// report the results
+	UE_LOG(LogFutureRacing, Display, TEXT("Simulated %.2fs in %.2fs wall time over %d steps: %.2f simulated seconds per wall second."),
+		SimTime, WallTime, Steps, WallTime > 0.0 ? SimTime / WallTime : 0.0);
+
+	// report the input to physics latency across all cars
+	FFutureRacingInputLatencyStats Latency;
+	double TotalLatencyMs = 0.0;
+
+	for (const FSimDriver& Driver : Drivers)
+	{
+		if (IsValid(Driver.Vehicle))
+		{
+			const FFutureRacingInputLatencyStats CarLatency = Driver.Vehicle->GetRacingVehicleMovement()->GetInputLatencyStats();
+			Latency.NumInputs += CarLatency.NumInputs;
+			Latency.NumSubsteps += CarLatency.NumSubsteps;
+			Latency.MaxMs = FMath::Max(Latency.MaxMs, CarLatency.MaxMs);
+			TotalLatencyMs += CarLatency.AverageMs * CarLatency.NumInputs;
+		}
+	}
+
+	UE_LOG(LogFutureRacing, Display, TEXT("Input to physics latency: %lld inputs, avg %.2fms, max %.2fms over %lld substeps."),
+		Latency.NumInputs, Latency.NumInputs > 0 ? TotalLatencyMs / Latency.NumInputs : 0.0, Latency.MaxMs, Latency.NumSubsteps);
+
+	// report the replay size and recording cost
+	if (UFutureRacingReplaySubsystem* Replay = World->GetSubsystem<UFutureRacingReplaySubsystem>())
+	{
+		if (Replay->IsRecording())
+		{
+			const FFutureRacingReplayStats ReplayStats = Replay->GetStats();
+
+			UE_LOG(LogFutureRacing, Display, TEXT("Replay: %lld samples, %.1f KB (%.2f bytes/sample), %d dropped blocks, record avg %.4fms, max %.4fms per frame."),
+				ReplayStats.NumSamples, ReplayStats.BytesRecorded / 1024.0, ReplayStats.GetBytesPerSample(),
+				ReplayStats.NumDroppedBlocks, ReplayStats.AverageRecordMs, ReplayStats.MaxRecordMs);
+		}
+	}
+
+	// report the telemetry capture cost, then close the file
+	if (Telemetry && Telemetry->IsCapturing())
+	{
+		const FFutureRacingTelemetryStats TelemetryStats = Telemetry->GetStats();
+
+		UE_LOG(LogFutureRacing, Display, TEXT("Telemetry: %d cars, %lld rows written so far, %lld dropped, capture avg %.3fus/sample, drain avg %.3fms, max %.3fms."),
+			TelemetryStats.NumVehicles, TelemetryStats.NumRows, TelemetryStats.NumDroppedSamples,
+			TelemetryStats.AverageCaptureMicroseconds, TelemetryStats.AverageDrainMs, TelemetryStats.MaxDrainMs);
+
+		Telemetry->StopCapture();
+	}
+
+	UFutureRacingTrackProgressSubsystem* TrackProgress = World->GetSubsystem<UFutureRacingTrackProgressSubsystem>();
+
+	for (int32 DriverIndex = 0; DriverIndex < Drivers.Num(); ++DriverIndex)
+	{
+		const FSimDriver& Driver = Drivers[DriverIndex];
+
+		// the first lap includes the standing start from the grid
+		double BestLap = -1.0;
+		FString LapList;
+
+		for (const double LapTime : Driver.LapTimes)
+		{
+			BestLap = BestLap < 0.0 ? LapTime : FMath::Min(BestLap, LapTime);
+			LapList += FString::Printf(TEXT(" %.3f"), LapTime);
+		}
+
+		UE_LOG(LogFutureRacing, Display, TEXT("Car %d (%s): P%d, %d laps, best %.3fs, laps:%s"),
+			DriverIndex, *GetNameSafe(Driver.Vehicle ? Driver.Vehicle->GetClass() : nullptr), TrackProgress ? TrackProgress->GetRacePosition(Driver.Vehicle) : 0, Driver.CompletedLaps, BestLap, *LapList);
+	}
+
+	SimWorld.Shutdown();
+
+	return 0;
+}
+
+int32 UFutureRacingSimCommandlet::RunControllerBenchmark(const FString& Params)
+{
+	using namespace FutureRacingSim;
+
+	// parse the options
+	FSimOptions Options;
+	Options.MapName = TEXT("CPU_Playground");
+
+	FString CarCountList = TEXT("8,32,128");
+	FParse::Value(*Params, TEXT("CarCounts="), CarCountList);
+
+	int32 WarmupSteps = 120;
+	FParse::Value(*Params, TEXT("WarmupSteps="), WarmupSteps);
+
+	int32 BenchSteps = 1800;
+	FParse::Value(*Params, TEXT("BenchSteps="), BenchSteps);
+
+	TArray<FString> CarCountStrings;
+	CarCountList.ParseIntoArray(CarCountStrings, TEXT(","));
+
+	if (!Options.Parse(Params) || CarCountStrings.Num() == 0 || BenchSteps <= 0)
+	{
+		UE_LOG(LogFutureRacing, Error, TEXT("Invalid benchmark parameters."));
+		return 1;
+	}
+
+	FApp::SetUseFixedTimeStep(true);
+	FApp::SetFixedDeltaTime(Options.FixedStep);
+
+	// runs one measurement pass and returns the average world step time in milliseconds
+	auto MeasureStepTime = [&Options, WarmupSteps, BenchSteps](int32 NumCars, UClass* ControllerClass, bool bScriptedInput) -> double
+	{
+		FFutureRacingHeadlessWorld SimWorld;
+
+		if (!SimWorld.LoadMap(FFutureRacingHeadlessWorld::ResolveMapName(Options.MapName)))
+		{
+			return -1.0;
+		}
+
+		ATimeTrialTrackGate* FinishLine = FindFinishLine(SimWorld.GetWorld());
+
+		TArray<FSimDriver> Drivers;
+		Drivers.Reserve(NumCars);
+
+		for (int32 CarIndex = 0; CarIndex < NumCars; ++CarIndex)
+		{
+			if (AFutureRacingPawn* Vehicle = SimWorld.SpawnVehicle(Options.VehicleClasses[CarIndex % Options.VehicleClasses.Num()], ControllerClass, CarIndex))
+			{
+				FSimDriver& Driver = Drivers.AddDefaulted_GetRef();
+				Driver.Vehicle = Vehicle;
+				Driver.TargetGate = FinishLine ? FinishLine->GetNextMarker() : nullptr;
+				Driver.WeavePhase = CarIndex * 0.7f;
+			}
+		}
+
+		uint64 MeasuredCycles = 0;
+
+		for (int32 StepIndex = 0; StepIndex < WarmupSteps + BenchSteps; ++StepIndex)
+		{
+			const uint64 StartCycles = FPlatformTime::Cycles64();
+
+			if (bScriptedInput)
+			{
+				for (FSimDriver& Driver : Drivers)
+				{
+					if (IsValid(Driver.Vehicle))
+					{
+						Driver.Drive(SimWorld.GetSimulatedTime());
+					}
+				}
+			}
+
+			SimWorld.Step(Options.FixedStep);
+
+			if (StepIndex >= WarmupSteps)
+			{
+				MeasuredCycles += FPlatformTime::Cycles64() - StartCycles;
+			}
+		}
+
+		SimWorld.Shutdown();
+
+		return FPlatformTime::ToMilliseconds64(MeasuredCycles) / BenchSteps;
+	};
+
+	UE_LOG(LogFutureRacing, Display, TEXT("Controller benchmark for %s on '%s'."), *GetNameSafe(Options.ControllerClass), *Options.MapName);
+	UE_LOG(LogFutureRacing, Display, TEXT("Cars, Baseline ms/step, Controller ms/step, Controller us/car"));
+
+	for (const FString& CarCountString : CarCountStrings)
+	{
+		const int32 NumCars = FCString::Atoi(*CarCountString);
+
+		if (NumCars <= 0)
+		{
+			continue;
+		}
+
+		// idle AI controllers give us the cost of the vehicles themselves.
+		// Driven cars also cost a little more physics than parked ones, so this slightly overstates the controller cost
+		const double BaselineMs = MeasureStepTime(NumCars, AAIController::StaticClass(), false);
+		const double ControllerMs = MeasureStepTime(NumCars, Options.ControllerClass, Options.bScriptedInput);
+
+		const double PerCarUs = (ControllerMs - BaselineMs) * 1000.0 / NumCars;
+
+		UE_LOG(LogFutureRacing, Display, TEXT("%d, %.3f, %.3f, %.2f"), NumCars, BaselineMs, ControllerMs, PerCarUs);
+	}
+
+	return 0;
+}
+
+int32 UFutureRacingSimCommandlet::RunLapBenchmark(const FString& Params)
+{
+	using namespace FutureRacingSim;
+
+	// parse the options
+	FSimOptions Options;
+
+	int32 TargetLaps = 3;
+	FParse::Value(*Params, TEXT("Laps="), TargetLaps);
+
+	float Duration = 600.0f;
+	FParse::Value(*Params, TEXT("Duration="), Duration);
+
+	int32 WarmupSteps = 60;
+	FParse::Value(*Params, TEXT("WarmupSteps="), WarmupSteps);
+
+	float HitchMs = 33.3f;
+	FParse::Value(*Params, TEXT("HitchMs="), HitchMs);
+
+	FString InputFile;
+	FParse::Value(*Params, TEXT("Input="), InputFile);
+
+	int32 InputVehicle = INDEX_NONE;
+	FParse::Value(*Params, TEXT("InputVehicle="), InputVehicle);
+
+	FString CsvFile = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("Benchmarks"), TEXT("LapBenchmark.csv"));
+	FParse::Value(*Params, TEXT("Csv="), CsvFile);
+
+	if (!Options.Parse(Params) || TargetLaps <= 0)
+	{
+		UE_LOG(LogFutureRacing, Error, TEXT("Invalid benchmark parameters."));
+		return 1;
+	}
+
+	// without a recording, fall back to the scripted driver. It's deterministic at a fixed step, but it isn't a human line
+	FInputTrack InputTrack;
+
+	if (!InputFile.IsEmpty() && !InputTrack.Load(InputFile, InputVehicle))
+	{
+		return 1;
+	}
+
+	FApp::SetUseFixedTimeStep(true);
+	FApp::SetFixedDeltaTime(Options.FixedStep);
+
+	FFutureRacingHeadlessWorld SimWorld;
+
+	if (!SimWorld.LoadMap(FFutureRacingHeadlessWorld::ResolveMapName(Options.MapName)))
+	{
+		return 1;
+	}
+
+	UWorld* World = SimWorld.GetWorld();
+	ATimeTrialTrackGate* FinishLine = FindFinishLine(World);
+
+	if (!FinishLine)
+	{
+		UE_LOG(LogFutureRacing, Error, TEXT("Map '%s' has no finish line to time laps on."), *Options.MapName);
+		return 1;
+	}
+
+	// the benchmark drives the car itself, so it's possessed by a plain AI controller.
+	// Recorded inputs only follow the recorded line if the car starts where the recording did
+	UClass* VehicleClass = Options.VehicleClasses[0];
+
+	AFutureRacingPawn* Vehicle = InputTrack.IsValid()
+		? SimWorld.SpawnVehicle(VehicleClass, AAIController::StaticClass(), InputTrack.GetStartTransform())
+		: SimWorld.SpawnVehicle(VehicleClass, AAIController::StaticClass(), 0);
+
+	if (!Vehicle)
+	{
+		return 1;
+	}
+
+	TArray<FSimDriver> Drivers;
+
+	FSimDriver& Driver = Drivers.AddDefaulted_GetRef();
+	Driver.Vehicle = Vehicle;
+	Driver.TargetGate = FinishLine->GetNextMarker();
+
+	TrackLaps(World, Drivers);
+
+	const FString InputName = InputTrack.IsValid() ? FPaths::GetCleanFilename(InputFile) : TEXT("Scripted");
+
+	UE_LOG(LogFutureRacing, Display, TEXT("Lap benchmark: %d laps of '%s' in %s driven by %s input, at %.4fs per step."),
+		TargetLaps, *Options.MapName, *GetNameSafe(VehicleClass), *InputName, Options.FixedStep);
+
+	FStepTimings Timings;
+	Timings.Start(World, FMath::CeilToInt(Duration / Options.FixedStep));
+
+	int32 StepIndex = 0;
+	bool bInputRanOut = false;
+
+	while (Driver.CompletedLaps < TargetLaps && SimWorld.GetSimulatedTime() < Duration && !IsEngineExitRequested())
+	{
+		const double SimTime = SimWorld.GetSimulatedTime();
+
+		if (InputTrack.IsValid() && SimTime > InputTrack.GetDuration())
+		{
+			bInputRanOut = true;
+			break;
+		}
+
+		Timings.BeginStep();
+
+		if (InputTrack.IsValid())
+		{
+			InputTrack.Drive(Vehicle, SimTime);
+
+		} else {
+
+			Driver.Drive(SimTime);
+		}
+
+		SimWorld.Step(Options.FixedStep);
+
+		// leave out the first frames, which pay for streaming and first use allocations
+		Timings.EndStep(StepIndex++ >= WarmupSteps);
+	}
+
+	Timings.Stop();
+
+	const bool bComplete = Driver.CompletedLaps >= TargetLaps;
+
+	if (!bComplete)
+	{
+		UE_LOG(LogFutureRacing, Warning, TEXT("Only %d of %d laps completed (%s). These numbers aren't comparable with a full run."),
+			Driver.CompletedLaps, TargetLaps, bInputRanOut ? TEXT("the input recording ran out") : TEXT("out of time"));
+	}
+
+	// summarize the timings
+	const FTimingSummary Frame = FTimingSummary::Make(Timings.FrameMs, HitchMs);
+	const FTimingSummary GameThread = FTimingSummary::Make(Timings.GameThreadMs, HitchMs);
+	const FTimingSummary Physics = FTimingSummary::Make(Timings.PhysicsMs, HitchMs);
+
+	double TotalTime = 0.0;
+	double BestLap = -1.0;
+	FString LapList;
+
+	for (const double LapTime : Driver.LapTimes)
+	{
+		TotalTime += LapTime;
+		BestLap = BestLap < 0.0 ? LapTime : FMath::Min(BestLap, LapTime);
+		LapList += FString::Printf(TEXT("%s%.3f"), LapList.IsEmpty() ? TEXT("") : TEXT(" "), LapTime);
+	}
+
+	UE_LOG(LogFutureRacing, Display, TEXT("%d laps in %.3fs, best %.3fs, laps: %s"), Driver.CompletedLaps, TotalTime, BestLap, *LapList);
+	UE_LOG(LogFutureRacing, Display, TEXT("%d frames, %lld physics steps, hitches over %.1fms."), Timings.FrameMs.Num(), Timings.NumPhysicsSteps, HitchMs);
+	UE_LOG(LogFutureRacing, Display, TEXT("Timing, Avg ms, P50 ms, P90 ms, P95 ms, P99 ms, Max ms, Hitches"));
+
+	const TPair<const TCHAR*, const FTimingSummary*> Summaries[] = { { TEXT("Frame"), &Frame }, { TEXT("GameThread"), &GameThread }, { TEXT("Physics"), &Physics } };
+
+	for (const TPair<const TCHAR*, const FTimingSummary*>& Summary : Summaries)
+	{
+		UE_LOG(LogFutureRacing, Display, TEXT("%s, %s"), Summary.Key, *Summary.Value->ToCsv().Replace(TEXT(","), TEXT(", ")));
+	}
+
+	// append a row to the CSV, so runs on the same machine build up a history
+	const FString Header = FString(TEXT("Timestamp,BuildVersion,Map,Vehicle,Input,Step,Laps,Complete,TotalTime,BestLap,LapTimes,Frames,PhysicsSteps,HitchMs,"))
+		+ FTimingSummary::GetCsvHeader(TEXT("Frame")) + TEXT(",")
+		+ FTimingSummary::GetCsvHeader(TEXT("GameThread")) + TEXT(",")
+		+ FTimingSummary::GetCsvHeader(TEXT("Physics"));
+
+	const FString Row = FString::Printf(TEXT("%s,%s,%s,%s,%s,%.6f,%d,%d,%.3f,%.3f,%s,%d,%lld,%.1f,"),
+		*FDateTime::UtcNow().ToIso8601(), FApp::GetBuildVersion(), *Options.MapName, *GetNameSafe(VehicleClass), *InputName,
+		Options.FixedStep, Driver.CompletedLaps, bComplete ? 1 : 0, TotalTime, BestLap, *LapList, Timings.FrameMs.Num(), Timings.NumPhysicsSteps, HitchMs)
+		+ Frame.ToCsv() + TEXT(",") + GameThread.ToCsv() + TEXT(",") + Physics.ToCsv();
+
+	AppendCsvRows(CsvFile, Header, { Row });
+
+	SimWorld.Shutdown();
+
+	// fail the run when the laps didn't finish, so a build box doesn't record a partial result as a pass
+	return bComplete ? 0 : 1;
+}
+
+int32 UFutureRacingSimCommandlet::RunScalingBenchmark(const FString& Params)
+{
+	using namespace FutureRacingSim;
+
+	// parse the options
+	FSimOptions Options;
+	Options.MapName = TEXT("CPU_Playground");
+
+	FString CarCountList = TEXT("1,8,32,128,256");
+	FParse::Value(*Params, TEXT("CarCounts="), CarCountList);
+
+	int32 WarmupSteps = 120;
+	FParse::Value(*Params, TEXT("WarmupSteps="), WarmupSteps);
+
+	int32 BenchSteps = 600;
+	FParse::Value(*Params, TEXT("BenchSteps="), BenchSteps);
+
+	FString CsvFile = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("Benchmarks"), TEXT("VehicleScaling.csv"));
+	FParse::Value(*Params, TEXT("Csv="), CsvFile);
+
+	TArray<FString> CarCountStrings;
+	CarCountList.ParseIntoArray(CarCountStrings, TEXT(","));
+
+	// the marginal cost is measured between neighbouring counts, so run them once each, smallest first
+	TArray<int32> CarCounts;
+
+	for (const FString& CarCountString : CarCountStrings)
+	{
+		const int32 NumCars = FCString::Atoi(*CarCountString);
+
+		if (NumCars > 0)
+		{
+			CarCounts.AddUnique(NumCars);
+		}
+	}
+
+	CarCounts.Sort();
+
+	if (!Options.Parse(Params) || CarCounts.Num() == 0 || BenchSteps <= 0)
+	{
+		UE_LOG(LogFutureRacing, Error, TEXT("Invalid benchmark parameters."));
+		return 1;
+	}
+
+	FApp::SetUseFixedTimeStep(true);
+	FApp::SetFixedDeltaTime(Options.FixedStep);
+
+	// frames slower than the fixed step can't keep up in real time
+	const double BudgetMs = Options.FixedStep * 1000.0;
+
+	UE_LOG(LogFutureRacing, Display, TEXT("Vehicle scaling benchmark on '%s', %d steps per count after %d warmup steps, %.2fms budget per step."),
+		*Options.MapName, BenchSteps, WarmupSteps, BudgetMs);
+	UE_LOG(LogFutureRacing, Display, TEXT("Cars, Frame avg ms, Frame P95 ms, Game thread avg ms, Physics avg ms, Physics step ms, Game thread us/car, Physics us/car, Marginal game thread us/car, Marginal physics us/car, KB/car, Over budget frames"));
+
+	const FString Timestamp = FDateTime::UtcNow().ToIso8601();
+
+	// cars cycle through every vehicle class, so the row names all of them
+	FString VehicleNames;
+
+	for (const UClass* VehicleClass : Options.VehicleClasses)
+	{
+		VehicleNames += (VehicleNames.IsEmpty() ? TEXT("") : TEXT("+")) + GetNameSafe(VehicleClass);
+	}
+
+	const FString Header = FString(TEXT("Timestamp,BuildVersion,Map,Vehicle,Step,Cars,Frames,PhysicsSteps,PhysicsStepMs,"))
+		+ FTimingSummary::GetCsvHeader(TEXT("Frame")) + TEXT(",")
+		+ FTimingSummary::GetCsvHeader(TEXT("GameThread")) + TEXT(",")
+		+ FTimingSummary::GetCsvHeader(TEXT("Physics")) + TEXT(",")
+		+ TEXT("GameThreadUsPerCar,PhysicsUsPerCar,MarginalGameThreadUsPerCar,MarginalPhysicsUsPerCar,MemoryKBPerCar");
+
+	TArray<FString> Rows;
+
+	int32 PreviousCars = 0;
+	double PreviousGameThreadMs = 0.0;
+	double PreviousPhysicsMs = 0.0;
+	int32 FirstOverBudget = 0;
+
+	for (const int32 NumCars : CarCounts)
+	{
+		// every count gets a fresh world, so nothing carries over from the previous pass
+		FFutureRacingHeadlessWorld SimWorld;
+
+		if (!SimWorld.LoadMap(FFutureRacingHeadlessWorld::ResolveMapName(Options.MapName)))
+		{
+			return 1;
+		}
+
+		ATimeTrialTrackGate* FinishLine = FindFinishLine(SimWorld.GetWorld());
+
+		const uint64 MemoryBefore = FPlatformMemory::GetStats().UsedPhysical;
+
+		TArray<FSimDriver> Drivers;
+		Drivers.Reserve(NumCars);
+
+		for (int32 CarIndex = 0; CarIndex < NumCars; ++CarIndex)
+		{
+			if (AFutureRacingPawn* Vehicle = SimWorld.SpawnVehicle(Options.VehicleClasses[CarIndex % Options.VehicleClasses.Num()], AAIController::StaticClass(), CarIndex))
+			{
+				FSimDriver& Driver = Drivers.AddDefaulted_GetRef();
+				Driver.Vehicle = Vehicle;
+				Driver.TargetGate = FinishLine ? FinishLine->GetNextMarker() : nullptr;
+				Driver.WeavePhase = CarIndex * 0.7f;
+			}
+		}
+
+		FStepTimings Timings;
+		Timings.Start(SimWorld.GetWorld(), BenchSteps);
+
+		for (int32 StepIndex = 0; StepIndex < WarmupSteps + BenchSteps && !IsEngineExitRequested(); ++StepIndex)
+		{
+			Timings.BeginStep();
+
+			for (FSimDriver& Driver : Drivers)
+			{
+				if (IsValid(Driver.Vehicle))
+				{
+					Driver.Drive(SimWorld.GetSimulatedTime());
+				}
+			}
+
+			SimWorld.Step(Options.FixedStep);
+
+			Timings.EndStep(StepIndex >= WarmupSteps);
+
+			// measure memory once the physics state and the first use allocations are in
+			if (StepIndex + 1 == WarmupSteps)
+			{
+				LogVehicleFootprint(Drivers);
+			}
+		}
+
+		Timings.Stop();
+
+		// process memory is noisy at low counts, but unlike the footprint above it includes the physics state
+		const int64 MemoryDelta = static_cast<int64>(FPlatformMemory::GetStats().UsedPhysical) - static_cast<int64>(MemoryBefore);
+		const double MemoryKBPerCar = FMath::Max<int64>(MemoryDelta, 0) / 1024.0 / FMath::Max(Drivers.Num(), 1);
+
+		SimWorld.Shutdown();
+
+		const FTimingSummary Frame = FTimingSummary::Make(Timings.FrameMs, BudgetMs);
+		const FTimingSummary GameThread = FTimingSummary::Make(Timings.GameThreadMs, BudgetMs);
+		const FTimingSummary Physics = FTimingSummary::Make(Timings.PhysicsMs, BudgetMs);
+
+		const double GameThreadUsPerCar = GameThread.Average * 1000.0 / NumCars;
+		const double PhysicsUsPerCar = Physics.Average * 1000.0 / NumCars;
+
+		// the cost of each car added since the previous count shows where the curve bends
+		const double MarginalGameThreadUsPerCar = (GameThread.Average - PreviousGameThreadMs) * 1000.0 / (NumCars - PreviousCars);
+		const double MarginalPhysicsUsPerCar = (Physics.Average - PreviousPhysicsMs) * 1000.0 / (NumCars - PreviousCars);
+
+		PreviousCars = NumCars;
+		PreviousGameThreadMs = GameThread.Average;
+		PreviousPhysicsMs = Physics.Average;
+
+		if (!FirstOverBudget && Frame.P95 > BudgetMs)
+		{
+			FirstOverBudget = NumCars;
+		}
+
+		UE_LOG(LogFutureRacing, Display, TEXT("%d, %.3f, %.3f, %.3f, %.3f, %.4f, %.2f, %.2f, %.2f, %.2f, %.1f, %d"),
+			NumCars, Frame.Average, Frame.P95, GameThread.Average, Physics.Average, Timings.GetAveragePhysicsStepMs(),
+			GameThreadUsPerCar, PhysicsUsPerCar, MarginalGameThreadUsPerCar, MarginalPhysicsUsPerCar, MemoryKBPerCar, Frame.NumHitches);
+
+		Rows.Add(FString::Printf(TEXT("%s,%s,%s,%s,%.6f,%d,%d,%lld,%.4f,"),
+			*Timestamp, FApp::GetBuildVersion(), *Options.MapName, *VehicleNames, Options.FixedStep,
+			NumCars, Timings.FrameMs.Num(), Timings.NumPhysicsSteps, Timings.GetAveragePhysicsStepMs())
+			+ Frame.ToCsv() + TEXT(",") + GameThread.ToCsv() + TEXT(",") + Physics.ToCsv() + TEXT(",")
+			+ FString::Printf(TEXT("%.3f,%.3f,%.3f,%.3f,%.2f"), GameThreadUsPerCar, PhysicsUsPerCar, MarginalGameThreadUsPerCar, MarginalPhysicsUsPerCar, MemoryKBPerCar));
+	}
+
+	if (FirstOverBudget)
+	{
+		UE_LOG(LogFutureRacing, Display, TEXT("P95 frame time first exceeds the %.2fms step at %d cars."), BudgetMs, FirstOverBudget);
+
+	} else {
+
+		UE_LOG(LogFutureRacing, Display, TEXT("P95 frame time stays within the %.2fms step at every count."), BudgetMs);
+	}
+
+	AppendCsvRows(CsvFile, Header, Rows);
+
+	return 0;
+}
+
+int32 UFutureRacingSimCommandlet::RunInputReplay(const FString& Params)
+{
+	using namespace FutureRacingSim;
+	using namespace FutureRacingInputLog;
+
+	// parse the options
+	FString InputLogFile;
+	FParse::Value(*Params, TEXT("InputLog="), InputLogFile);
+
+	FFutureRacingInputLog InputLog;
+
+	if (!InputLog.Load(InputLogFile))
+	{
+		return 1;
+	}
+
+	// the log knows where and how it was recorded. Overriding either is only useful to see how far off a run gets
+	FString MapName = InputLog.MapName;
+	FParse::Value(*Params, TEXT("Map="), MapName);
+
+	float FixedStep = InputLog.FixedStep;
+	FParse::Value(*Params, TEXT("Step="), FixedStep);
+
+	float Duration = 3600.0f;
+	FParse::Value(*Params, TEXT("Duration="), Duration);
+
+	const bool bRerecord = FParse::Param(*Params, TEXT("Rerecord"));
+
+	// a log that can't reproduce is no use as a baseline
+	if (InputLog.FixedStep <= 0.0f)
+	{
+		UE_LOG(LogFutureRacing, Error, TEXT("'%s' wasn't recorded at a fixed step, so its checksums can't reproduce."), *InputLogFile);
+		return 1;
+	}
+
+	UClass* VehicleClass = FFutureRacingHeadlessWorld::ResolveVehicleClass(InputLog.VehicleClassPath);
+
+	if (!VehicleClass || FixedStep <= 0.0f)
+	{
+		UE_LOG(LogFutureRacing, Error, TEXT("Invalid input replay parameters."));
+		return 1;
+	}
+
+	FApp::SetUseFixedTimeStep(true);
+	FApp::SetFixedDeltaTime(FixedStep);
+
+	FFutureRacingHeadlessWorld SimWorld;
+
+	if (!SimWorld.LoadMap(FFutureRacingHeadlessWorld::ResolveMapName(MapName)))
+	{
+		return 1;
+	}
+
+	// the commandlet makes the driving calls itself, so the car is possessed by a plain AI controller
+	AFutureRacingPawn* Vehicle = SimWorld.SpawnVehicle(VehicleClass, AAIController::StaticClass(), InputLog.StartTransform);
+
+	if (!Vehicle)
+	{
+		return 1;
+	}
+
+	// log the replay too, so a build that's meant to change the simulation can record a new baseline
+	UFutureRacingInputLogSubsystem* InputLogs = SimWorld.GetWorld()->GetSubsystem<UFutureRacingInputLogSubsystem>();
+
+	if (bRerecord && InputLogs)
+	{
+		InputLogs->StartRecording(Vehicle);
+	}
+
+	UFutureRacingVehicleMovementComponent* Movement = Vehicle->GetRacingVehicleMovement();
+	const int64 FirstStepIndex = Movement->GetNumStepsSeen();
+	const int64 LastLoggedStep = InputLog.Checksums.Num() > 0 ? InputLog.Checksums.Last().Step : 0;
+
+	UE_LOG(LogFutureRacing, Display, TEXT("Input replay: %d calls and %d step checksums from '%s' on '%s' in %s, at %.4fs per step."),
+		InputLog.Events.Num(), InputLog.Checksums.Num(), *FPaths::GetCleanFilename(InputLogFile), *MapName, *GetNameSafe(VehicleClass), FixedStep);
+
+	int32 NextEvent = 0;
+	int32 NextChecksum = 0;
+	int64 LastStepIndex = FirstStepIndex - 1;
+	int64 NumCompared = 0;
+	int64 NumMissing = 0;
+	int64 FirstDivergence = INDEX_NONE;
+	int64 NumStepsLastFrame = 1;
+
+	while (NextChecksum < InputLog.Checksums.Num() && FirstDivergence == INDEX_NONE && SimWorld.GetSimulatedTime() < Duration && !IsEngineExitRequested())
+	{
+		// make every call first simulated by the steps this frame should run, in the order it was made.
+		// The physics thread holds each call's input back until the step it was recorded on
+		const int64 StepsSeen = Movement->GetNumStepsSeen() - FirstStepIndex;
+		const int64 EndStep = StepsSeen + FMath::Max<int64>(NumStepsLastFrame, 1);
+
+		for (; NextEvent < InputLog.Events.Num() && InputLog.Events[NextEvent].Step < EndStep; ++NextEvent)
+		{
+			const FEvent& Event = InputLog.Events[NextEvent];
+
+			Movement->SetInputStep(FirstStepIndex + Event.Step);
+
+			switch (Event.Call)
+			{
+			case ECall::Steering:
+				Vehicle->DoSteering(Event.Value);
+				break;
+
+			case ECall::Throttle:
+				Vehicle->DoThrottle(Event.Value);
+				break;
+
+			case ECall::Brake:
+				Vehicle->DoBrake(Event.Value);
+				break;
+
+			case ECall::BrakeStart:
+				Vehicle->DoBrakeStart();
+				break;
+
+			case ECall::BrakeStop:
+				Vehicle->DoBrakeStop();
+				break;
+
+			case ECall::HandbrakeStart:
+				Vehicle->DoHandbrakeStart();
+				break;
+
+			case ECall::HandbrakeStop:
+				Vehicle->DoHandbrakeStop();
+				break;
+
+			case ECall::ResetVehicle:
+				Vehicle->DoResetVehicle();
+				break;
+
+			default:
+				break;
+			}
+		}
+
+		Movement->SetInputStep(INDEX_NONE);
+
+		SimWorld.Step(FixedStep);
+
+		NumStepsLastFrame = Movement->GetNumStepsSeen() - FirstStepIndex - StepsSeen;
+
+		// compare every step simulated this frame against the log
+		for (const FFutureRacingPhysicsStep& Step : Movement->GetRecentSteps())
+		{
+			if (Step.StepIndex <= LastStepIndex)
+			{
+				continue;
+			}
+
+			LastStepIndex = Step.StepIndex;
+
+			const int64 LogStep = Step.StepIndex - FirstStepIndex;
+
+			// steps the recording missed can't be checked, a hitch can skip past more than the movement component keeps
+			while (NextChecksum < InputLog.Checksums.Num() && InputLog.Checksums[NextChecksum].Step < LogStep)
+			{
+				++NumMissing;
+				++NextChecksum;
+			}
+
+			if (NextChecksum >= InputLog.Checksums.Num() || InputLog.Checksums[NextChecksum].Step != LogStep)
+			{
+				continue;
+			}
+
+			++NumCompared;
+
+			if (InputLog.Checksums[NextChecksum++].Hash != HashStep(Step))
+			{
+				FirstDivergence = LogStep;
+
+				UE_LOG(LogFutureRacing, Error, TEXT("Diverged at step %lld of %lld: location %s, velocity %s, input steering %.4f throttle %.4f brake %.4f."),
+					LogStep, LastLoggedStep, *Step.Location.ToString(), *Step.LinearVelocity.ToString(), Step.Input.Steering, Step.Input.Throttle, Step.Input.Brake);
+				break;
+			}
+		}
+	}
+
+	if (bRerecord && InputLogs)
+	{
+		InputLogs->StopRecording();
+	}
+
+	SimWorld.Shutdown();
+
+	if (FirstDivergence != INDEX_NONE)
+	{
+		return 1;
+	}
+
+	// running out of time before the last checksum means the replay never got there, which isn't a pass
+	const int64 NumUnchecked = InputLog.Checksums.Num() - NextChecksum;
+
+	if (NumUnchecked > 0)
+	{
+		UE_LOG(LogFutureRacing, Error, TEXT("Replay stopped with %lld of %d step checksums unchecked."), NumUnchecked, InputLog.Checksums.Num());
+		return 1;
+	}
+
+	UE_LOG(LogFutureRacing, Display, TEXT("All %lld compared steps match, %lld steps weren't in the log."), NumCompared, NumMissing);
+
+	return 0;
+}
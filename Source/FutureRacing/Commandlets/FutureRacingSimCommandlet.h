@@ -0,0 +1,78 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "FutureRacingSimCommandlet.generated.h"
+
+/**
+ *  Headless batch race simulator.
+ *  Loads a track, spawns a grid of vehicles driven by scripted input
+ *  and steps the world at a fixed timestep with no rendering, UI or audio.
+ *  Reports simulated seconds per wall second and lap results.
+ *  -Telemetry captures physics rate telemetry for every car to Saved/Telemetry.
+ *
+ *  Usage:
+ *  FutureRacing -run=FutureRacingSim -nullrhi -nosound -unattended
+ *      [-Map=Lvl_Timetrial] [-Vehicle=Sports,Offroad] [-Cars=8]
+ *      [-Step=0.0166667] [-Duration=600] [-Laps=3]
+ *      [-Controller=Scripted|CPU|BP|<class path>] [-Telemetry]
+ *
+ *  Passing -CarCounts=8,32,128 runs the controller benchmark instead,
+ *  comparing the game thread cost per car of the chosen controller
+ *  against idle AI controllers at each car count.
+ *      [-WarmupSteps=120] [-BenchSteps=1800]
+ *
+ *  Passing -LapBenchmark runs the timed lap benchmark instead. A single car replays the
+ *  inputs of a recorded replay, or follows the scripted line without one, until it finishes
+ *  its laps. Frame, game thread and physics timing percentiles and hitch counts are logged
+ *  and appended as a row to a CSV, Saved/Benchmarks/LapBenchmark.csv by default.
+ *  Returns an error if the laps weren't completed.
+ *      [-Input=<replay file>] [-InputVehicle=<recorded vehicle id>]
+ *      [-WarmupSteps=60] [-HitchMs=33.3] [-Csv=<file>]
+ *
+ *  Passing -ScalingBenchmark runs the vehicle count scaling benchmark instead. For each count,
+ *  smallest first, it drives that many scripted cars on CPU_Playground, then logs and appends to a CSV
+ *  the frame, game thread and physics times, the cost per car and the process memory per car,
+ *  Saved/Benchmarks/VehicleScaling.csv by default.
+ *      [-CarCounts=1,8,32,128,256] [-WarmupSteps=120] [-BenchSteps=600] [-Csv=<file>]
+ *
+ *  Passing -InputLog=<file> replays an input log recorded with FutureRacing.InputLog.Start instead.
+ *  The logged vehicle is spawned where logging started on the logged map, every logged driving call
+ *  is made again onto the physics step that first simulated it, and each step's state checksum is compared
+ *  against the log. Returns an error at the first step that diverges, if the replay ends early,
+ *  or if the log wasn't recorded at a fixed step.
+ *  -Rerecord logs the replay to Saved/InputLogs, to record a new baseline.
+ *      [-Map=<logged map>] [-Step=<logged step>] [-Duration=3600] [-Rerecord]
+ */
+UCLASS()
+class UFutureRacingSimCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+
+	/** Constructor */
+	UFutureRacingSimCommandlet();
+
+	/** Runs the simulation */
+	virtual int32 Main(const FString& Params) override;
+
+protected:
+
+	/** Runs a timed race and reports lap results */
+	int32 RunRace(const FString& Params);
+
+	/** Runs the controller cost benchmark */
+	int32 RunControllerBenchmark(const FString& Params);
+
+	/** Runs the timed lap performance benchmark */
+	int32 RunLapBenchmark(const FString& Params);
+
+	/** Runs the vehicle count scaling benchmark */
+	int32 RunScalingBenchmark(const FString& Params);
+
+	/** Replays an input log and checks its step checksums */
+	int32 RunInputReplay(const FString& Params);
+};
@@ -16,6 +16,7 @@ public class FutureRacing : ModuleRules
 			"EnhancedInput",
 			"ChaosVehicles",
 			"PhysicsCore",
+			"AIModule",
 			"UMG",
 			"Slate"
 		});
@@ -26,10 +27,16 @@ public class FutureRacing : ModuleRules
 			"FutureRacing/OffroadCar",
 			"FutureRacing/Variant_Offroad",
 			"FutureRacing/Variant_TimeTrial",
-			"FutureRacing/Variant_TimeTrial/UI"
+			"FutureRacing/Variant_TimeTrial/UI",
+			"FutureRacing/Commandlets",
+			"FutureRacing/AI",
+			"FutureRacing/Track",
+			"FutureRacing/Replay",
+			"FutureRacing/Telemetry",
+			"FutureRacing/Net"
 		});
 
-		PrivateDependencyModuleNames.AddRange(new string[] { });
+		PrivateDependencyModuleNames.AddRange(new string[] { "RenderCore" });
 
 		// Uncomment if you are using Slate UI
 		// PrivateDependencyModuleNames.AddRange(new string[] { "Slate", "SlateCore" });
@@ -5,4 +5,15 @@
 
 IMPLEMENT_PRIMARY_GAME_MODULE( FDefaultGameModuleImpl, FutureRacing, "FutureRacing" );
 
-DEFINE_LOG_CATEGORY(LogFutureRacing)
\ No newline at end of file
+DEFINE_LOG_CATEGORY(LogFutureRacing)
+
+DEFINE_STAT(STAT_FutureRacingActiveVehicles);
+DEFINE_STAT(STAT_FutureRacingRespawns);
+DEFINE_STAT(STAT_FutureRacingRespawnTime);
+DEFINE_STAT(STAT_FutureRacingGateCrossings);
+
+UE_TRACE_CHANNEL_DEFINE(FutureRacingChannel);
+
+LLM_DEFINE_TAG(FutureRacing_Vehicles);
+LLM_DEFINE_TAG(FutureRacing_Replay);
+LLM_DEFINE_TAG(FutureRacing_Telemetry);
@@ -3,6 +3,45 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "Stats/Stats.h"
+#include "HAL/LowLevelMemTracker.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "Trace/Trace.h"
 
 /** Main log category used across the project */
-DECLARE_LOG_CATEGORY_EXTERN(LogFutureRacing, Log, All);
\ No newline at end of file
+DECLARE_LOG_CATEGORY_EXTERN(LogFutureRacing, Log, All);
+
+/** Stat group for project specific stats */
+DECLARE_STATS_GROUP(TEXT("FutureRacing"), STATGROUP_FutureRacing, STATCAT_Advanced);
+
+/** Vehicles taking part in the world's vehicle systems, i.e. spawned and not parked in the pool */
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Active Vehicles"), STAT_FutureRacingActiveVehicles, STATGROUP_FutureRacing, FUTURERACING_API);
+
+/** Vehicles handed out to replace a destroyed one, pooled or freshly spawned */
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Respawns"), STAT_FutureRacingRespawns, STATGROUP_FutureRacing, FUTURERACING_API);
+
+/** Time spent respawning vehicles for their controllers, including possession */
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Vehicle Respawn"), STAT_FutureRacingRespawnTime, STATGROUP_FutureRacing, FUTURERACING_API);
+
+/** Track gates crossed by any vehicle */
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Gate Crossings"), STAT_FutureRacingGateCrossings, STATGROUP_FutureRacing, FUTURERACING_API);
+
+/** Trace channel for project specific CPU scopes. Enable with -trace=default,FutureRacing */
+UE_TRACE_CHANNEL_EXTERN(FutureRacingChannel, FUTURERACING_API);
+
+/** Memory tags, visible with -llm and in the LLM view of Unreal Insights */
+LLM_DECLARE_TAG_API(FutureRacing_Vehicles, FUTURERACING_API);
+LLM_DECLARE_TAG_API(FutureRacing_Replay, FUTURERACING_API);
+LLM_DECLARE_TAG_API(FutureRacing_Telemetry, FUTURERACING_API);
+
+/**
+ *  Times the rest of the enclosing scope under a cycle stat for `stat FutureRacing`, and as a CPU event in Insights.
+ *  Builds with stats emit the cycle stat, which Insights already shows as a CPU event. Builds without stats, like Test,
+ *  emit a trace event on the FutureRacing channel instead, so each scope shows up exactly once either way.
+ *  Declares a scoped variable, so only use it at the top of a braced scope, never as the body of an unbraced if or loop
+ */
+#if STATS
+	#define FUTURERACING_SCOPE_CYCLE_COUNTER(Stat) SCOPE_CYCLE_COUNTER(Stat)
+#else
+	#define FUTURERACING_SCOPE_CYCLE_COUNTER(Stat) TRACE_CPUPROFILER_EVENT_SCOPE_ON_CHANNEL(Stat, FutureRacingChannel)
+#endif
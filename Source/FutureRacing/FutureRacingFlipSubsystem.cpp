@@ -0,0 +1,152 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "FutureRacingFlipSubsystem.h"
+#include "FutureRacingPawn.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "HAL/IConsoleManager.h"
+#include "FutureRacing.h"
+
+DECLARE_CYCLE_STAT(TEXT("Flip Check"), STAT_FutureRacingFlipCheck, STATGROUP_FutureRacing);
+DECLARE_CYCLE_STAT(TEXT("Flip Reset"), STAT_FutureRacingFlipReset, STATGROUP_FutureRacing);
+
+static TAutoConsoleVariable<float> CVarFlipCheckInterval(
+	TEXT("FutureRacing.FlipCheck.Interval"),
+	3.0f,
+	TEXT("Time in seconds between flip checks. Vehicles flipped on two consecutive checks are reset."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarFlipCheckMaxResetsPerFrame(
+	TEXT("FutureRacing.FlipCheck.MaxResetsPerFrame"),
+	1,
+	TEXT("Maximum number of flipped vehicles reset in a single frame. The rest wait for the following frames."),
+	ECVF_Default);
+
+void UFutureRacingFlipSubsystem::RegisterVehicle(AFutureRacingPawn* Vehicle)
+{
+	if (!Vehicle || Vehicles.Contains(Vehicle))
+	{
+		return;
+	}
+
+	Vehicles.Add(Vehicle);
+	WasFlipped.Add(false);
+
+	UpdatePadding();
+
+	MinUpZ[Vehicles.Num() - 1] = Vehicle->GetFlipCheckMinDot();
+}
+
+void UFutureRacingFlipSubsystem::UnregisterVehicle(AFutureRacingPawn* Vehicle)
+{
+	const int32 Index = Vehicles.IndexOfByKey(Vehicle);
+
+	if (Index == INDEX_NONE)
+	{
+		return;
+	}
+
+	// move the last vehicle's threshold into the freed slot, like RemoveAtSwap does for the others
+	MinUpZ[Index] = MinUpZ[Vehicles.Num() - 1];
+
+	Vehicles.RemoveAtSwap(Index);
+	WasFlipped.RemoveAtSwap(Index);
+	ResetQueue.Remove(Vehicle);
+
+	UpdatePadding();
+}
+
+void UFutureRacingFlipSubsystem::Tick(float DeltaTime)
+{
+	CheckCountdown -= DeltaTime;
+
+	if (CheckCountdown <= 0.0f)
+	{
+		CheckCountdown = FMath::Max(CVarFlipCheckInterval.GetValueOnGameThread(), 0.1f);
+		CheckVehicles();
+	}
+
+	ProcessResetQueue();
+}
+
+TStatId UFutureRacingFlipSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UFutureRacingFlipSubsystem, STATGROUP_Tickables);
+}
+
+void UFutureRacingFlipSubsystem::CheckVehicles()
+{
+	FUTURERACING_SCOPE_CYCLE_COUNTER(STAT_FutureRacingFlipCheck);
+
+	const int32 NumVehicles = Vehicles.Num();
+
+	// gather the up vectors. Vehicles we shouldn't reset read as perfectly upright
+	for (int32 Index = 0; Index < NumVehicles; ++Index)
+	{
+		const AFutureRacingPawn* Vehicle = Vehicles[Index].Get();
+
+		UpZ[Index] = (Vehicle && !Vehicle->IsKinematicSimulation()) ? Vehicle->GetMesh()->GetComponentQuat().GetAxisZ().Z : 1.0f;
+	}
+
+	// compare four vehicles at a time
+	for (int32 Index = 0; Index < NumVehicles; Index += 4)
+	{
+		const VectorRegister4Float Up = VectorLoad(&UpZ[Index]);
+		const VectorRegister4Float MinUp = VectorLoad(&MinUpZ[Index]);
+		const int32 FlippedMask = VectorMaskBits(VectorCompareLT(Up, MinUp));
+
+		const int32 NumLanes = FMath::Min(4, NumVehicles - Index);
+
+		for (int32 Lane = 0; Lane < NumLanes; ++Lane)
+		{
+			const int32 VehicleIndex = Index + Lane;
+			const bool bFlipped = (FlippedMask & (1 << Lane)) != 0;
+
+			// still flipped since the last check, so queue a reset
+			if (bFlipped && WasFlipped[VehicleIndex])
+			{
+				ResetQueue.AddUnique(Vehicles[VehicleIndex]);
+				WasFlipped[VehicleIndex] = false;
+
+			} else {
+
+				WasFlipped[VehicleIndex] = bFlipped;
+			}
+		}
+	}
+}
+
+void UFutureRacingFlipSubsystem::ProcessResetQueue()
+{
+	FUTURERACING_SCOPE_CYCLE_COUNTER(STAT_FutureRacingFlipReset);
+
+	int32 ResetBudget = CVarFlipCheckMaxResetsPerFrame.GetValueOnGameThread();
+
+	while (ResetQueue.Num() > 0 && ResetBudget > 0)
+	{
+		// reset in the order the vehicles were found
+		TWeakObjectPtr<AFutureRacingPawn> Vehicle = ResetQueue[0];
+		ResetQueue.RemoveAt(0, EAllowShrinking::No);
+
+		if (Vehicle.IsValid() && !Vehicle->IsKinematicSimulation())
+		{
+			Vehicle->DoResetVehicle();
+			--ResetBudget;
+		}
+	}
+}
+
+void UFutureRacingFlipSubsystem::UpdatePadding()
+{
+	// pad with upright vehicles so the last vector compare never reads past the end
+	const int32 PaddedNum = Align(Vehicles.Num(), 4);
+
+	UpZ.SetNumUninitialized(PaddedNum, EAllowShrinking::No);
+	MinUpZ.SetNumUninitialized(PaddedNum, EAllowShrinking::No);
+
+	for (int32 Index = Vehicles.Num(); Index < PaddedNum; ++Index)
+	{
+		UpZ[Index] = 1.0f;
+		MinUpZ[Index] = -1.0f;
+	}
+}
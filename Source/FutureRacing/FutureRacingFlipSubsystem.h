@@ -0,0 +1,67 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "FutureRacingFlipSubsystem.generated.h"
+
+class AFutureRacingPawn;
+
+/**
+ *  Checks every vehicle for being flipped upside down in a single batched pass.
+ *  Up vectors and thresholds are kept in contiguous arrays and compared four at a time.
+ *  Vehicles found flipped on two consecutive checks are queued for a reset, and the
+ *  queue is drained a few vehicles per frame so a pile up doesn't reset everyone at once.
+ */
+UCLASS()
+class UFutureRacingFlipSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+protected:
+
+	/** Registered vehicles */
+	TArray<TWeakObjectPtr<AFutureRacingPawn>> Vehicles;
+
+	/** World Z of each vehicle's up vector, padded to a multiple of four */
+	TArray<float> UpZ;
+
+	/** Minimum up Z each vehicle is still considered upright at, padded to a multiple of four */
+	TArray<float> MinUpZ;
+
+	/** If true, the vehicle was flipped on the last check, parallel to Vehicles */
+	TArray<bool> WasFlipped;
+
+	/** Vehicles waiting to be reset */
+	TArray<TWeakObjectPtr<AFutureRacingPawn>> ResetQueue;
+
+	/** Time left until the next check */
+	float CheckCountdown = 0.0f;
+
+public:
+
+	/** Adds a vehicle to the flip checks */
+	void RegisterVehicle(AFutureRacingPawn* Vehicle);
+
+	/** Removes a vehicle from the flip checks */
+	void UnregisterVehicle(AFutureRacingPawn* Vehicle);
+
+	// Begin FTickableGameObject interface
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	// End FTickableGameObject interface
+
+protected:
+
+	/** Checks every vehicle and queues the ones that stayed flipped for a reset */
+	void CheckVehicles();
+
+	/** Resets up to the per frame budget of queued vehicles */
+	void ProcessResetQueue();
+
+	/** Resizes the padded arrays to fit the registered vehicles */
+	void UpdatePadding();
+};
@@ -0,0 +1,259 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "FutureRacingGateCrossingSubsystem.h"
+#include "FutureRacingMarkerSubsystem.h"
+#include "FutureRacingTrackSubsystem.h"
+#include "FutureRacingTrackTable.h"
+#include "FutureRacingPawn.h"
+#include "FutureRacingVehicleMovementComponent.h"
+#include "TimeTrialTrackGate.h"
+#include "Components/BoxComponent.h"
+#include "Physics/Experimental/PhysScene_Chaos.h"
+#include "PBDRigidsSolver.h"
+#include "Engine/World.h"
+#include "FutureRacing.h"
+
+DECLARE_CYCLE_STAT(TEXT("Gate Sweep"), STAT_FutureRacingGateSweep, STATGROUP_FutureRacing);
+
+void UFutureRacingGateCrossingSubsystem::RegisterVehicle(AFutureRacingPawn* Vehicle)
+{
+	if (!Vehicle || Vehicles.Contains(Vehicle))
+	{
+		return;
+	}
+
+	// skip any steps simulated before we started watching, e.g. while parked in a pool
+	const TArray<FFutureRacingPhysicsStep>& Steps = Vehicle->GetRacingVehicleMovement()->GetRecentSteps();
+
+	Vehicles.Add(Vehicle);
+	PreviousLocations.Add(Vehicle->GetActorLocation());
+	PreviousTimes.Add(GetPhysicsResultsTime());
+	LastStepIndices.Add(Steps.Num() > 0 ? Steps.Last().StepIndex : -1);
+	HasPrevious.Add(false);
+}
+
+void UFutureRacingGateCrossingSubsystem::UnregisterVehicle(AFutureRacingPawn* Vehicle)
+{
+	const int32 Index = Vehicles.IndexOfByKey(Vehicle);
+
+	if (Index != INDEX_NONE)
+	{
+		RemoveAtSwap(Index);
+	}
+}
+
+void UFutureRacingGateCrossingSubsystem::Tick(float DeltaTime)
+{
+	FUTURERACING_SCOPE_CYCLE_COUNTER(STAT_FutureRacingGateSweep);
+
+	// drop any vehicles destroyed without unregistering
+	for (int32 Index = Vehicles.Num() - 1; Index >= 0; --Index)
+	{
+		if (!Vehicles[Index].IsValid())
+		{
+			RemoveAtSwap(Index);
+		}
+	}
+
+	UpdateGateShapes();
+
+	if (Gates.Num() == 0)
+	{
+		return;
+	}
+
+	const double ResultsTime = GetPhysicsResultsTime();
+
+	// gate notifications can unregister vehicles, so walk a copy
+	const TArray<TWeakObjectPtr<AFutureRacingPawn>> VehiclesToSweep = Vehicles;
+
+	for (const TWeakObjectPtr<AFutureRacingPawn>& WeakVehicle : VehiclesToSweep)
+	{
+		AFutureRacingPawn* Vehicle = WeakVehicle.Get();
+		int32 Index = Vehicles.IndexOfByKey(WeakVehicle);
+
+		if (!Vehicle || Index == INDEX_NONE)
+		{
+			continue;
+		}
+
+		if (Vehicle->IsKinematicSimulation())
+		{
+			// kinematic vehicles don't publish physics steps, so sample where they are now
+			SweepTo(Index, Vehicle->GetActorLocation(), ResultsTime);
+			continue;
+		}
+
+		// sweep through every physics step we haven't seen yet
+		const TArray<FFutureRacingPhysicsStep>& Steps = Vehicle->GetRacingVehicleMovement()->GetRecentSteps();
+
+		for (const FFutureRacingPhysicsStep& Step : Steps)
+		{
+			if (Step.StepIndex <= LastStepIndices[Index])
+			{
+				continue;
+			}
+
+			LastStepIndices[Index] = Step.StepIndex;
+			SweepTo(Index, Step.Location, Step.Time);
+
+			// a gate may have unregistered the vehicle or shuffled the arrays
+			Index = Vehicles.IndexOfByKey(WeakVehicle);
+
+			if (Index == INDEX_NONE)
+			{
+				break;
+			}
+		}
+	}
+}
+
+TStatId UFutureRacingGateCrossingSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UFutureRacingGateCrossingSubsystem, STATGROUP_Tickables);
+}
+
+void UFutureRacingGateCrossingSubsystem::UpdateGateShapes()
+{
+	UWorld* World = GetWorld();
+
+	// gates register as they begin play, so rebuild the shapes whenever that changes
+	UFutureRacingMarkerSubsystem* Markers = World->GetSubsystem<UFutureRacingMarkerSubsystem>();
+	const int32 NumGates = Markers ? Markers->GetNumGates() : 0;
+
+	if (NumGates == NumCachedGates)
+	{
+		return;
+	}
+
+	NumCachedGates = NumGates;
+
+	// gates face along the track where we have one
+	TSharedPtr<const FFutureRacingTrackTable> Track;
+
+	if (UFutureRacingTrackSubsystem* TrackSubsystem = World->GetSubsystem<UFutureRacingTrackSubsystem>())
+	{
+		Track = TrackSubsystem->GetPrimaryTable();
+	}
+
+	Gates.Reset();
+
+	for (int32 GateIndex = 0; GateIndex < NumGates; ++GateIndex)
+	{
+		ATimeTrialTrackGate* Gate = Markers->GetGate(GateIndex);
+
+		if (!Gate || !Gate->GetCrossingBox())
+		{
+			continue;
+		}
+
+		const UBoxComponent* Box = Gate->GetCrossingBox();
+
+		FGateShape& Shape = Gates.AddDefaulted_GetRef();
+		Shape.Gate = Gate;
+		Shape.Transform = FTransform(Box->GetComponentQuat(), Box->GetComponentLocation());
+		Shape.Extent = Box->GetScaledBoxExtent();
+		Shape.BoundingRadius = Shape.Extent.Size();
+
+		if (Track.IsValid() && Track->IsValid())
+		{
+			Shape.Normal = Track->GetDirectionAtDistance(Track->FindClosestDistance(Shape.Transform.GetLocation()));
+
+		} else {
+
+			Shape.Normal = Gate->GetActorForwardVector();
+		}
+	}
+}
+
+void UFutureRacingGateCrossingSubsystem::SweepTo(int32 VehicleIndex, const FVector& Location, double Time)
+{
+	const FVector Start = PreviousLocations[VehicleIndex];
+	const double StartTime = PreviousTimes[VehicleIndex];
+	const bool bHasPrevious = HasPrevious[VehicleIndex];
+
+	PreviousLocations[VehicleIndex] = Location;
+	PreviousTimes[VehicleIndex] = Time;
+	HasPrevious[VehicleIndex] = true;
+
+	// nothing to sweep from yet, or the vehicle was teleported
+	if (!bHasPrevious || FVector::DistSquared(Start, Location) > FMath::Square(MaxSegmentLength))
+	{
+		return;
+	}
+
+	// a single step can pass through more than one gate, so notify them in the order they were crossed
+	TArray<TPair<float, int32>, TInlineAllocator<4>> Hits;
+
+	for (int32 GateIndex = 0; GateIndex < Gates.Num(); ++GateIndex)
+	{
+		const FGateShape& Shape = Gates[GateIndex];
+		const FVector Center = Shape.Transform.GetLocation();
+
+		// skip gates nowhere near the segment
+		if (FMath::PointDistToSegmentSquared(Center, Start, Location) > FMath::Square(Shape.BoundingRadius))
+		{
+			continue;
+		}
+
+		// the segment has to end up on the other side of the gate plane
+		const double StartSide = FVector::DotProduct(Start - Center, Shape.Normal);
+		const double EndSide = FVector::DotProduct(Location - Center, Shape.Normal);
+
+		if ((StartSide < 0.0) == (EndSide < 0.0))
+		{
+			continue;
+		}
+
+		// and pass through the plane inside the gate box
+		const float Alpha = static_cast<float>(StartSide / (StartSide - EndSide));
+		const FVector LocalHit = Shape.Transform.InverseTransformPositionNoScale(FMath::Lerp(Start, Location, Alpha));
+
+		if (FMath::Abs(LocalHit.X) <= Shape.Extent.X && FMath::Abs(LocalHit.Y) <= Shape.Extent.Y && FMath::Abs(LocalHit.Z) <= Shape.Extent.Z)
+		{
+			Hits.Emplace(Alpha, GateIndex);
+		}
+	}
+
+	if (Hits.Num() == 0)
+	{
+		return;
+	}
+
+	Hits.Sort([](const TPair<float, int32>& A, const TPair<float, int32>& B)
+	{
+		return A.Key < B.Key;
+	});
+
+	AFutureRacingPawn* Vehicle = Vehicles[VehicleIndex].Get();
+
+	for (const TPair<float, int32>& Hit : Hits)
+	{
+		if (ATimeTrialTrackGate* Gate = Gates[Hit.Value].Gate.Get())
+		{
+			Gate->NotifyCrossing(Vehicle, FMath::Lerp(StartTime, Time, static_cast<double>(Hit.Key)));
+		}
+	}
+}
+
+double UFutureRacingGateCrossingSubsystem::GetPhysicsResultsTime() const
+{
+	const FPhysScene* PhysScene = GetWorld()->GetPhysicsScene();
+
+	if (PhysScene && PhysScene->GetSolver())
+	{
+		return PhysScene->GetSolver()->GetPhysicsResultsTime_External();
+	}
+
+	return GetWorld()->GetTimeSeconds();
+}
+
+void UFutureRacingGateCrossingSubsystem::RemoveAtSwap(int32 Index)
+{
+	Vehicles.RemoveAtSwap(Index);
+	PreviousLocations.RemoveAtSwap(Index);
+	PreviousTimes.RemoveAtSwap(Index);
+	LastStepIndices.RemoveAtSwap(Index);
+	HasPrevious.RemoveAtSwap(Index);
+}
@@ -0,0 +1,90 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "FutureRacingGateCrossingSubsystem.generated.h"
+
+class AFutureRacingPawn;
+class ATimeTrialTrackGate;
+
+/**
+ *  Detects vehicles passing through track gates.
+ *  Each vehicle's path between consecutive physics steps is tested against every gate's
+ *  oriented crossing plane, so fast cars can't skip a gate between frames and the
+ *  crossing time is interpolated within the physics step instead of rounded to a frame.
+ */
+UCLASS(Config="Game")
+class UFutureRacingGateCrossingSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+protected:
+
+	/** Moves longer than this between two samples are treated as teleports and never cross gates */
+	UPROPERTY(Config)
+	float MaxSegmentLength = 5000.0f;
+
+	/** Cached gate geometry */
+	struct FGateShape
+	{
+		TWeakObjectPtr<ATimeTrialTrackGate> Gate;
+
+		/** Unscaled gate box transform */
+		FTransform Transform;
+
+		/** Scaled box half extents */
+		FVector Extent = FVector::ZeroVector;
+
+		/** Direction of travel through the gate */
+		FVector Normal = FVector::ForwardVector;
+
+		/** Radius of a sphere around the box, for early outs */
+		float BoundingRadius = 0.0f;
+	};
+
+	/** Gates to test against */
+	TArray<FGateShape> Gates;
+
+	/** Number of gates the shapes were built from */
+	int32 NumCachedGates = -1;
+
+	/** Registered vehicles */
+	TArray<TWeakObjectPtr<AFutureRacingPawn>> Vehicles;
+
+	/** Per vehicle sweep state, parallel to Vehicles */
+	TArray<FVector> PreviousLocations;
+	TArray<double> PreviousTimes;
+	TArray<int64> LastStepIndices;
+	TArray<bool> HasPrevious;
+
+public:
+
+	/** Starts detecting crossings for a vehicle */
+	void RegisterVehicle(AFutureRacingPawn* Vehicle);
+
+	/** Stops detecting crossings for a vehicle */
+	void UnregisterVehicle(AFutureRacingPawn* Vehicle);
+
+	/** Returns the physics time the game thread is currently seeing. Crossing times are measured on this clock */
+	double GetPhysicsResultsTime() const;
+
+	// Begin FTickableGameObject interface
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	// End FTickableGameObject interface
+
+protected:
+
+	/** Rebuilds the gate shapes whenever gates come or go */
+	void UpdateGateShapes();
+
+	/** Moves a vehicle's sweep on to a new sample, notifying any gates crossed on the way */
+	void SweepTo(int32 VehicleIndex, const FVector& Location, double Time);
+
+	/** Removes the vehicle at an index, keeping the arrays parallel */
+	void RemoveAtSwap(int32 Index);
+};
@@ -0,0 +1,223 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "FutureRacingMarkerSubsystem.h"
+#include "TimeTrialTrackGate.h"
+#include "GameFramework/PlayerStart.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+
+void UFutureRacingMarkerSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	// player starts are engine actors, so collect the placed ones once here
+	for (TActorIterator<APlayerStart> It(&InWorld); It; ++It)
+	{
+		RegisterPlayerStart(*It);
+	}
+
+	// and catch any spawned later
+	ActorSpawnedHandle = InWorld.AddOnActorSpawnedHandler(FOnActorSpawned::FDelegate::CreateUObject(this, &UFutureRacingMarkerSubsystem::OnActorSpawned));
+}
+
+void UFutureRacingMarkerSubsystem::Deinitialize()
+{
+	if (UWorld* World = GetWorld())
+	{
+		World->RemoveOnActorSpawnedHandler(ActorSpawnedHandle);
+	}
+
+	Super::Deinitialize();
+}
+
+void UFutureRacingMarkerSubsystem::RegisterPlayerStart(APlayerStart* PlayerStart)
+{
+	if (!PlayerStart || PlayerStarts.Contains(PlayerStart))
+	{
+		return;
+	}
+
+	PlayerStarts.Add(PlayerStart);
+	PlayerStartReservations.Add(-UE_BIG_NUMBER);
+
+	if (!PlayerStart->PlayerStartTag.IsNone() && !PlayerStartsByTag.Contains(PlayerStart->PlayerStartTag))
+	{
+		PlayerStartsByTag.Add(PlayerStart->PlayerStartTag, PlayerStart);
+	}
+}
+
+void UFutureRacingMarkerSubsystem::RegisterGate(ATimeTrialTrackGate* Gate)
+{
+	if (!Gate || Gates.Contains(Gate))
+	{
+		return;
+	}
+
+	Gates.Add(Gate);
+	bGateOrderDirty = true;
+
+	for (const FName& Tag : Gate->Tags)
+	{
+		if (!GatesByTag.Contains(Tag))
+		{
+			GatesByTag.Add(Tag, Gate);
+		}
+	}
+
+	if (Gate->IsFinishLine() && !FinishLine.IsValid())
+	{
+		FinishLine = Gate;
+	}
+}
+
+void UFutureRacingMarkerSubsystem::UnregisterGate(ATimeTrialTrackGate* Gate)
+{
+	if (Gates.Remove(Gate) == 0)
+	{
+		return;
+	}
+
+	bGateOrderDirty = true;
+
+	for (auto It = GatesByTag.CreateIterator(); It; ++It)
+	{
+		if (It->Value == Gate)
+		{
+			It.RemoveCurrent();
+		}
+	}
+
+	if (FinishLine == Gate)
+	{
+		FinishLine = nullptr;
+	}
+}
+
+APlayerStart* UFutureRacingMarkerSubsystem::GetPlayerStart(int32 Index) const
+{
+	return PlayerStarts.IsValidIndex(Index) ? PlayerStarts[Index].Get() : nullptr;
+}
+
+APlayerStart* UFutureRacingMarkerSubsystem::FindPlayerStart(FName Tag) const
+{
+	const TWeakObjectPtr<APlayerStart>* PlayerStart = PlayerStartsByTag.Find(Tag);
+
+	return PlayerStart ? PlayerStart->Get() : nullptr;
+}
+
+APlayerStart* UFutureRacingMarkerSubsystem::ReserveFreePlayerStart()
+{
+	const int32 NumStarts = PlayerStarts.Num();
+
+	if (NumStarts == 0)
+	{
+		return nullptr;
+	}
+
+	UWorld* World = GetWorld();
+	const double Now = World->GetTimeSeconds();
+
+	const FCollisionObjectQueryParams VehicleQuery(ECC_Vehicle);
+	const FCollisionShape Clearance = FCollisionShape::MakeSphere(SpawnClearanceRadius);
+
+	int32 ChosenIndex = INDEX_NONE;
+	int32 OldestIndex = INDEX_NONE;
+
+	// go round robin from where we left off, so consecutive respawns spread out
+	for (int32 Offset = 0; Offset < NumStarts; ++Offset)
+	{
+		const int32 Index = (NextSpawnIndex + Offset) % NumStarts;
+		const APlayerStart* PlayerStart = PlayerStarts[Index].Get();
+
+		if (!PlayerStart)
+		{
+			continue;
+		}
+
+		if (OldestIndex == INDEX_NONE || PlayerStartReservations[Index] < PlayerStartReservations[OldestIndex])
+		{
+			OldestIndex = Index;
+		}
+
+		// skip slots handed out recently, the car might not have moved off yet
+		if (Now - PlayerStartReservations[Index] < SpawnReservationTime)
+		{
+			continue;
+		}
+
+		// skip slots with a car sitting on them
+		if (World->OverlapAnyTestByObjectType(PlayerStart->GetActorLocation(), FQuat::Identity, VehicleQuery, Clearance))
+		{
+			continue;
+		}
+
+		ChosenIndex = Index;
+		break;
+	}
+
+	if (ChosenIndex == INDEX_NONE)
+	{
+		ChosenIndex = OldestIndex;
+	}
+
+	if (ChosenIndex == INDEX_NONE)
+	{
+		return nullptr;
+	}
+
+	PlayerStartReservations[ChosenIndex] = Now;
+	NextSpawnIndex = (ChosenIndex + 1) % NumStarts;
+
+	return PlayerStarts[ChosenIndex].Get();
+}
+
+ATimeTrialTrackGate* UFutureRacingMarkerSubsystem::GetGate(int32 Index)
+{
+	if (bGateOrderDirty)
+	{
+		SortGates();
+	}
+
+	return Gates.IsValidIndex(Index) ? Gates[Index].Get() : nullptr;
+}
+
+ATimeTrialTrackGate* UFutureRacingMarkerSubsystem::FindGate(FName Tag) const
+{
+	const TWeakObjectPtr<ATimeTrialTrackGate>* Gate = GatesByTag.Find(Tag);
+
+	return Gate ? Gate->Get() : nullptr;
+}
+
+void UFutureRacingMarkerSubsystem::OnActorSpawned(AActor* Actor)
+{
+	if (APlayerStart* PlayerStart = Cast<APlayerStart>(Actor))
+	{
+		RegisterPlayerStart(PlayerStart);
+	}
+}
+
+void UFutureRacingMarkerSubsystem::SortGates()
+{
+	bGateOrderDirty = false;
+
+	TArray<TWeakObjectPtr<ATimeTrialTrackGate>> Sorted;
+	Sorted.Reserve(Gates.Num());
+
+	// follow the chain from the finish line until it loops back or leaves the registry
+	for (ATimeTrialTrackGate* Gate = FinishLine.Get(); Gate && Gates.Contains(Gate) && !Sorted.Contains(Gate); Gate = Gate->GetNextMarker())
+	{
+		Sorted.Add(Gate);
+	}
+
+	// keep any gates off the chain at the end, in registration order
+	for (const TWeakObjectPtr<ATimeTrialTrackGate>& Gate : Gates)
+	{
+		if (Gate.IsValid() && !Sorted.Contains(Gate))
+		{
+			Sorted.Add(Gate);
+		}
+	}
+
+	Gates = MoveTemp(Sorted);
+}
@@ -0,0 +1,112 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "FutureRacingMarkerSubsystem.generated.h"
+
+class APlayerStart;
+class ATimeTrialTrackGate;
+
+/**
+ *  Registry of spawn points and track markers for a world.
+ *  Track gates register themselves as they begin play and player starts are
+ *  collected once when the world begins play, so lookups never scan the actor list.
+ *  Also hands out free spawn slots so respawning cars don't stack on top of each other.
+ */
+UCLASS(Config="Game")
+class UFutureRacingMarkerSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+protected:
+
+	/** Time a player start stays reserved after being handed out */
+	UPROPERTY(Config)
+	float SpawnReservationTime = 3.0f;
+
+	/** Radius around a player start that must be clear of vehicles for it to count as free */
+	UPROPERTY(Config)
+	float SpawnClearanceRadius = 400.0f;
+
+	/** Registered player starts */
+	TArray<TWeakObjectPtr<APlayerStart>> PlayerStarts;
+
+	/** World time each player start was last handed out at, parallel to PlayerStarts */
+	TArray<double> PlayerStartReservations;
+
+	/** Player starts by their player start tag */
+	TMap<FName, TWeakObjectPtr<APlayerStart>> PlayerStartsByTag;
+
+	/** Registered track gates, in track order once sorted */
+	TArray<TWeakObjectPtr<ATimeTrialTrackGate>> Gates;
+
+	/** Track gates by actor tag */
+	TMap<FName, TWeakObjectPtr<ATimeTrialTrackGate>> GatesByTag;
+
+	/** Finish line gate */
+	TWeakObjectPtr<ATimeTrialTrackGate> FinishLine;
+
+	/** If true, the gates need to be put back in track order */
+	bool bGateOrderDirty = false;
+
+	/** Index the next free spawn slot search starts from */
+	int32 NextSpawnIndex = 0;
+
+	/** Handle for the actor spawned delegate */
+	FDelegateHandle ActorSpawnedHandle;
+
+public:
+
+	// Begin UWorldSubsystem interface
+
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	virtual void Deinitialize() override;
+
+	// End UWorldSubsystem interface
+
+	/** Adds a player start to the registry */
+	void RegisterPlayerStart(APlayerStart* PlayerStart);
+
+	/** Adds a track gate to the registry */
+	void RegisterGate(ATimeTrialTrackGate* Gate);
+
+	/** Removes a track gate from the registry */
+	void UnregisterGate(ATimeTrialTrackGate* Gate);
+
+	/** Returns the number of registered player starts */
+	int32 GetNumPlayerStarts() const { return PlayerStarts.Num(); }
+
+	/** Returns a player start by index */
+	APlayerStart* GetPlayerStart(int32 Index) const;
+
+	/** Returns the player start with the given player start tag */
+	APlayerStart* FindPlayerStart(FName Tag) const;
+
+	/**
+	 *  Picks a player start that hasn't been used recently and has no vehicle on it, and reserves it.
+	 *  Falls back to the least recently used one if every slot is taken.
+	 */
+	APlayerStart* ReserveFreePlayerStart();
+
+	/** Returns the number of registered track gates */
+	int32 GetNumGates() const { return Gates.Num(); }
+
+	/** Returns a track gate by its index along the track, starting from the finish line */
+	ATimeTrialTrackGate* GetGate(int32 Index);
+
+	/** Returns the first track gate with the given actor tag */
+	ATimeTrialTrackGate* FindGate(FName Tag) const;
+
+	/** Returns the finish line gate */
+	ATimeTrialTrackGate* GetFinishLine() const { return FinishLine.Get(); }
+
+protected:
+
+	/** Catches player starts spawned after the world began play */
+	void OnActorSpawned(AActor* Actor);
+
+	/** Sorts the gates by following the chain from the finish line */
+	void SortGates();
+};
@@ -10,13 +10,41 @@
 #include "EnhancedInputSubsystems.h"
 #include "InputActionValue.h"
 #include "ChaosWheeledVehicleMovementComponent.h"
+#include "FutureRacingVehicleMovementComponent.h"
+#include "FutureRacingSimLODSubsystem.h"
+#include "FutureRacingFlipSubsystem.h"
+#include "FutureRacingTrackProgressSubsystem.h"
+#include "FutureRacingGateCrossingSubsystem.h"
+#include "FutureRacingReplaySubsystem.h"
+#include "FutureRacingTelemetrySubsystem.h"
+#include "FutureRacingInputLogSubsystem.h"
+#include "FutureRacingVehiclePoolSubsystem.h"
+#include "FutureRacingVehicleNetComponent.h"
+#include "FutureRacingNetSchedulerSubsystem.h"
+#include "Engine/ActorChannel.h"
+#include "Engine/NetConnection.h"
 #include "FutureRacing.h"
-#include "TimerManager.h"
+#include "HAL/IConsoleManager.h"
 
 #define LOCTEXT_NAMESPACE "VehiclePawn"
 
-AFutureRacingPawn::AFutureRacingPawn()
+DECLARE_CYCLE_STAT(TEXT("Vehicle Tick"), STAT_FutureRacingVehicleTick, STATGROUP_FutureRacing);
+DECLARE_CYCLE_STAT(TEXT("Vehicle Registration"), STAT_FutureRacingVehicleRegistration, STATGROUP_FutureRacing);
+
+static TAutoConsoleVariable<int32> CVarEagerCameraRig(
+	TEXT("FutureRacing.Camera.EagerRig"),
+	0,
+	TEXT("If 1, every vehicle wakes its camera rig at BeginPlay, even without a local viewer.\n")
+	TEXT("Only useful to compare the per vehicle cost against the parked rig."),
+	ECVF_Default);
+
+AFutureRacingPawn::AFutureRacingPawn(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer.SetDefaultSubobjectClass<UFutureRacingVehicleMovementComponent>(AWheeledVehiclePawn::VehicleMovementComponentName))
 {
+	LLM_SCOPE_BYTAG(FutureRacing_Vehicles);
+
+	// the camera rig starts parked, and only wakes up for a local player. See NotifyControllerChanged
+
 	// construct the front camera boom
 	FrontSpringArm = CreateDefaultSubobject<USpringArmComponent>(TEXT("Front Spring Arm"));
 	FrontSpringArm->SetupAttachment(GetMesh());
@@ -25,6 +53,7 @@ AFutureRacingPawn::AFutureRacingPawn()
 	FrontSpringArm->bEnableCameraRotationLag = true;
 	FrontSpringArm->CameraRotationLagSpeed = 15.0f;
 	FrontSpringArm->SetRelativeLocation(FVector(30.0f, 0.0f, 120.0f));
+	FrontSpringArm->PrimaryComponentTick.bStartWithTickEnabled = false;
 
 	FrontCamera = CreateDefaultSubobject<UCameraComponent>(TEXT("Front Camera"));
 	FrontCamera->SetupAttachment(FrontSpringArm);
@@ -41,9 +70,11 @@ AFutureRacingPawn::AFutureRacingPawn()
 	BackSpringArm->bEnableCameraRotationLag = true;
 	BackSpringArm->CameraRotationLagSpeed = 2.0f;
 	BackSpringArm->CameraLagMaxDistance = 50.0f;
+	BackSpringArm->PrimaryComponentTick.bStartWithTickEnabled = false;
 
 	BackCamera = CreateDefaultSubobject<UCameraComponent>(TEXT("Back Camera"));
 	BackCamera->SetupAttachment(BackSpringArm);
+	BackCamera->bAutoActivate = false;
 
 	// Configure the car mesh
 	GetMesh()->SetSimulatePhysics(true);
@@ -51,7 +82,12 @@ AFutureRacingPawn::AFutureRacingPawn()
 
 	// get the Chaos Wheeled movement component
 	ChaosVehicleMovement = CastChecked<UChaosWheeledVehicleMovementComponent>(GetVehicleMovement());
+	RacingVehicleMovement = CastChecked<UFutureRacingVehicleMovementComponent>(GetVehicleMovement());
 
+	// the net component sends quantized snapshots instead of the default movement replication
+	NetComponent = CreateDefaultSubobject<UFutureRacingVehicleNetComponent>(TEXT("NetComponent"));
+
+	SetReplicatingMovement(false);
 }
 
 void AFutureRacingPawn::SetupPlayerInputComponent(class UInputComponent* PlayerInputComponent)
@@ -96,47 +132,161 @@ void AFutureRacingPawn::BeginPlay()
 {
 	Super::BeginPlay();
 
-	// set up the flipped check timer
-	GetWorld()->GetTimerManager().SetTimer(FlipCheckTimer, this, &AFutureRacingPawn::FlippedCheck, FlipCheckTime, true);
+	// nobody watches the vehicles on a dedicated server, it only has to simulate them
+	if (IsNetMode(NM_DedicatedServer))
+	{
+		StripCosmetics();
+	}
+
+	// wake the camera rig up front when measuring its cost
+	if (CVarEagerCameraRig.GetValueOnGameThread())
+	{
+		WakeCameraRig();
+	}
+
+	// join the world's vehicle systems
+	SetWorldSystemsRegistered(true);
 }
 
 void AFutureRacingPawn::EndPlay(EEndPlayReason::Type EndPlayReason)
 {
-	// clear the flipped check timer
-	GetWorld()->GetTimerManager().ClearTimer(FlipCheckTimer);
+	// leave the world's vehicle systems
+	SetWorldSystemsRegistered(false);
 
 	Super::EndPlay(EndPlayReason);
 }
 
 void AFutureRacingPawn::Tick(float Delta)
 {
+	FUTURERACING_SCOPE_CYCLE_COUNTER(STAT_FutureRacingVehicleTick);
+
 	Super::Tick(Delta);
 
 	// add some angular damping if the vehicle is in midair
-	bool bMovingOnGround = ChaosVehicleMovement->IsMovingOnGround();
-	GetMesh()->SetAngularDamping(bMovingOnGround ? 0.0f : 3.0f);
+	if (!bKinematicSimulation)
+	{
+		bool bMovingOnGround = ChaosVehicleMovement->IsMovingOnGround();
+		GetMesh()->SetAngularDamping(bMovingOnGround ? 0.0f : 3.0f);
+	}
 
 	// realign the camera yaw to face front
-	float CameraYaw = BackSpringArm->GetRelativeRotation().Yaw;
-	CameraYaw = FMath::FInterpTo(CameraYaw, 0.0f, Delta, 1.0f);
+	if (BackSpringArm && BackSpringArm->IsComponentTickEnabled())
+	{
+		float CameraYaw = BackSpringArm->GetRelativeRotation().Yaw;
+		CameraYaw = FMath::FInterpTo(CameraYaw, 0.0f, Delta, 1.0f);
+
+		BackSpringArm->SetRelativeRotation(FRotator(0.0f, CameraYaw, 0.0f));
+	}
+}
+
+float AFutureRacingPawn::GetNetPriority(const FVector& ViewPos, const FVector& ViewDir, AActor* Viewer, AActor* ViewTarget, UActorChannel* InChannel, float Time, bool bLowBandwidth)
+{
+	const float Priority = Super::GetNetPriority(ViewPos, ViewDir, Viewer, ViewTarget, InChannel, Time, bLowBandwidth);
+
+	const UNetConnection* Connection = InChannel ? InChannel->Connection.Get() : (Viewer ? Viewer->GetNetConnection() : nullptr);
+
+	// near rivals go first when the connection runs out of bandwidth
+	return NetComponent && Connection ? Priority * NetComponent->GetPriorityScale(Connection) : Priority;
+}
+
+bool AFutureRacingPawn::IsNetRelevantFor(const AActor* RealViewer, const AActor* ViewTarget, const FVector& SrcLocation) const
+{
+	// the standings and sparse keyframes need every car on the grid, however far away
+	if (!bDormant)
+	{
+		return true;
+	}
+
+	return Super::IsNetRelevantFor(RealViewer, ViewTarget, SrcLocation);
+}
 
-	BackSpringArm->SetRelativeRotation(FRotator(0.0f, CameraYaw, 0.0f));
+void AFutureRacingPawn::NotifyControllerChanged()
+{
+	Super::NotifyControllerChanged();
+
+	// only a local player ever looks through our cameras
+	if (IsLocallyControlled() && IsPlayerControlled())
+	{
+		WakeCameraRig();
+
+		// log the driver's input from the start, if asked to
+		if (UFutureRacingInputLogSubsystem* InputLogs = GetWorld()->GetSubsystem<UFutureRacingInputLogSubsystem>())
+		{
+			InputLogs->NotifyLocalPlayerPossessed(this);
+		}
+
+	} else if (!CVarEagerCameraRig.GetValueOnGameThread()) {
+
+		ParkCameraRig();
+	}
+}
+
+void AFutureRacingPawn::FellOutOfWorld(const UDamageType& DamageType)
+{
+	// clients wait for the server to take us out of play
+	if (!HasAuthority())
+	{
+		Super::FellOutOfWorld(DamageType);
+		return;
+	}
+
+	Recycle();
+}
+
+void AFutureRacingPawn::WakeCameraRig()
+{
+	// a dedicated server never has anyone to look through the cameras
+	if (IsNetMode(NM_DedicatedServer))
+	{
+		return;
+	}
+
+	FrontSpringArm->SetComponentTickEnabled(true);
+	BackSpringArm->SetComponentTickEnabled(true);
+
+	FrontCamera->SetActive(bFrontCameraActive);
+	BackCamera->SetActive(!bFrontCameraActive);
+}
+
+void AFutureRacingPawn::ParkCameraRig()
+{
+	// keep the components for the next local player, but stop them from costing anything
+	FrontSpringArm->SetComponentTickEnabled(false);
+	BackSpringArm->SetComponentTickEnabled(false);
+
+	FrontCamera->SetActive(false);
+	BackCamera->SetActive(false);
+}
+
+void AFutureRacingPawn::StripCosmetics()
+{
+	// the wheel bones are only animated for show. The vehicle simulation works off the wheel setups
+	GetMesh()->VisibilityBasedAnimTickOption = EVisibilityBasedAnimTickOption::OnlyTickPoseWhenRendered;
 }
 
 void AFutureRacingPawn::Steering(const FInputActionValue& Value)
 {
+	// time the input from here
+	RacingVehicleMovement->StampInputEvent();
+
 	// route the input
 	DoSteering(Value.Get<float>());
 }
 
 void AFutureRacingPawn::Throttle(const FInputActionValue& Value)
 {
+	// time the input from here
+	RacingVehicleMovement->StampInputEvent();
+
 	// route the input
 	DoThrottle(Value.Get<float>());
 }
 
 void AFutureRacingPawn::Brake(const FInputActionValue& Value)
 {
+	// time the input from here
+	RacingVehicleMovement->StampInputEvent();
+
 	// route the input
 	DoBrake(Value.Get<float>());
 }
@@ -149,18 +299,27 @@ void AFutureRacingPawn::StartBrake(const FInputActionValue& Value)
 
 void AFutureRacingPawn::StopBrake(const FInputActionValue& Value)
 {
+	// time the input from here
+	RacingVehicleMovement->StampInputEvent();
+
 	// route the input
 	DoBrakeStop();
 }
 
 void AFutureRacingPawn::StartHandbrake(const FInputActionValue& Value)
 {
+	// time the input from here
+	RacingVehicleMovement->StampInputEvent();
+
 	// route the input
 	DoHandbrakeStart();
 }
 
 void AFutureRacingPawn::StopHandbrake(const FInputActionValue& Value)
 {
+	// time the input from here
+	RacingVehicleMovement->StampInputEvent();
+
 	// route the input
 	DoHandbrakeStop();
 }
@@ -185,47 +344,72 @@ void AFutureRacingPawn::ResetVehicle(const FInputActionValue& Value)
 
 void AFutureRacingPawn::DoSteering(float SteeringValue)
 {
+	LogInputCall(FutureRacingInputLog::ECall::Steering, SteeringValue);
+
 	// add the input
 	ChaosVehicleMovement->SetSteeringInput(SteeringValue);
+
+	// forward the input to the physics thread
+	RacingVehicleMovement->SubmitInput();
 }
 
 void AFutureRacingPawn::DoThrottle(float ThrottleValue)
 {
+	LogInputCall(FutureRacingInputLog::ECall::Throttle, ThrottleValue);
+
 	// add the input
 	ChaosVehicleMovement->SetThrottleInput(ThrottleValue);
 
 	// reset the brake input
 	ChaosVehicleMovement->SetBrakeInput(0.0f);
+
+	// forward the input to the physics thread
+	RacingVehicleMovement->SubmitInput();
 }
 
 void AFutureRacingPawn::DoBrake(float BrakeValue)
 {
+	LogInputCall(FutureRacingInputLog::ECall::Brake, BrakeValue);
+
 	// add the input
 	ChaosVehicleMovement->SetBrakeInput(BrakeValue);
 
 	// reset the throttle input
 	ChaosVehicleMovement->SetThrottleInput(0.0f);
+
+	// forward the input to the physics thread
+	RacingVehicleMovement->SubmitInput();
 }
 
 void AFutureRacingPawn::DoBrakeStart()
 {
+	LogInputCall(FutureRacingInputLog::ECall::BrakeStart);
+
 	// call the Blueprint hook for the brake lights
 	BrakeLights(true);
 }
 
 void AFutureRacingPawn::DoBrakeStop()
 {
+	LogInputCall(FutureRacingInputLog::ECall::BrakeStop);
+
 	// call the Blueprint hook for the brake lights
 	BrakeLights(false);
 
 	// reset brake input to zero
 	ChaosVehicleMovement->SetBrakeInput(0.0f);
+
+	// forward the input to the physics thread
+	RacingVehicleMovement->SubmitInput();
 }
 
 void AFutureRacingPawn::DoHandbrakeStart()
 {
+	LogInputCall(FutureRacingInputLog::ECall::HandbrakeStart);
+
 	// add the input
 	ChaosVehicleMovement->SetHandbrakeInput(true);
+	RacingVehicleMovement->SubmitInput();
 
 	// call the Blueprint hook for the break lights
 	BrakeLights(true);
@@ -233,8 +417,11 @@ void AFutureRacingPawn::DoHandbrakeStart()
 
 void AFutureRacingPawn::DoHandbrakeStop()
 {
+	LogInputCall(FutureRacingInputLog::ECall::HandbrakeStop);
+
 	// add the input
 	ChaosVehicleMovement->SetHandbrakeInput(false);
+	RacingVehicleMovement->SubmitInput();
 
 	// call the Blueprint hook for the break lights
 	BrakeLights(false);
@@ -243,7 +430,10 @@ void AFutureRacingPawn::DoHandbrakeStop()
 void AFutureRacingPawn::DoLookAround(float YawDelta)
 {
 	// rotate the spring arm
-	BackSpringArm->AddLocalRotation(FRotator(0.0f, YawDelta, 0.0f));
+	if (BackSpringArm)
+	{
+		BackSpringArm->AddLocalRotation(FRotator(0.0f, YawDelta, 0.0f));
+	}
 }
 
 void AFutureRacingPawn::DoToggleCamera()
@@ -251,12 +441,18 @@ void AFutureRacingPawn::DoToggleCamera()
 	// toggle the active camera flag
 	bFrontCameraActive = !bFrontCameraActive;
 
-	FrontCamera->SetActive(bFrontCameraActive);
-	BackCamera->SetActive(!bFrontCameraActive);
+	// the rig only exists while a local player is driving
+	if (FrontCamera && BackCamera)
+	{
+		FrontCamera->SetActive(bFrontCameraActive);
+		BackCamera->SetActive(!bFrontCameraActive);
+	}
 }
 
 void AFutureRacingPawn::DoResetVehicle()
 {
+	LogInputCall(FutureRacingInputLog::ECall::ResetVehicle);
+
 	// reset to a location slightly above our current one
 	FVector ResetLocation = GetActorLocation() + FVector(0.0f, 0.0f, 50.0f);
 
@@ -272,27 +468,257 @@ void AFutureRacingPawn::DoResetVehicle()
 	GetMesh()->SetPhysicsLinearVelocity(FVector::ZeroVector);
 }
 
-void AFutureRacingPawn::FlippedCheck()
+void AFutureRacingPawn::LogInputCall(FutureRacingInputLog::ECall Call, float Value)
+{
+	if (!InputLog)
+	{
+		return;
+	}
+
+	// the call goes out with the next input submitted. The input log subsystem tags it with the physics step
+	// that first simulates that input once it comes back, replays make the call onto the same step
+	FutureRacingInputLog::FEvent& Event = InputLog->Events.AddDefaulted_GetRef();
+	Event.Step = INDEX_NONE;
+	Event.InputSequence = RacingVehicleMovement->GetNumInputsSubmitted() + 1;
+	Event.Call = Call;
+	Event.Value = Value;
+
+	// calls that don't submit input themselves get a submission of their own, so they're tied to a step too
+	if (Call == FutureRacingInputLog::ECall::BrakeStart || Call == FutureRacingInputLog::ECall::ResetVehicle)
+	{
+		RacingVehicleMovement->SubmitInput();
+	}
+}
+
+void AFutureRacingPawn::SetKinematicSimulation(bool bKinematic, const FVector& LinearVelocity)
 {
-	// check the difference in angle between the mesh's up vector and world up
-	const float UpDot = FVector::DotProduct(FVector::UpVector, GetMesh()->GetUpVector());
+	if (bKinematic == bKinematicSimulation)
+	{
+		return;
+	}
+
+	bKinematicSimulation = bKinematic;
 
-	if (UpDot < FlipCheckMinDot)
+	if (bKinematic)
 	{
-		// is this the second time we've checked that the vehicle is still flipped?
-		if (bPreviousFlipCheck)
+		// tear down the vehicle simulation so it costs nothing on either thread
+		ChaosVehicleMovement->StopMovementImmediately();
+		ChaosVehicleMovement->Deactivate();
+		ChaosVehicleMovement->DestroyPhysicsState();
+
+		// keep the body around for collision queries, but let the owner drive it
+		GetMesh()->SetSimulatePhysics(false);
+
+	} else {
+
+		// bring the body back first so the vehicle simulation can be rebuilt on it
+		GetMesh()->SetSimulatePhysics(true);
+		GetMesh()->SetPhysicsLinearVelocity(LinearVelocity);
+		GetMesh()->SetPhysicsAngularVelocityInDegrees(FVector::ZeroVector);
+
+		ChaosVehicleMovement->RecreatePhysicsState();
+		ChaosVehicleMovement->Activate(true);
+	}
+}
+
+void AFutureRacingPawn::SetDormant(bool bNewDormant)
+{
+	if (bNewDormant == bDormant)
+	{
+		return;
+	}
+
+	bDormant = bNewDormant;
+
+	if (bDormant)
+	{
+		// take ourselves out of the vehicle systems first, so they don't wake us back up
+		SetWorldSystemsRegistered(false);
+
+		SetKinematicSimulation(true, FVector::ZeroVector);
+
+		SetActorHiddenInGame(true);
+		SetActorEnableCollision(false);
+		SetActorTickEnabled(false);
+
+		// component ticks don't follow the actor's, so park them separately
+		DormantTickingComponents.Reset();
+
+		for (UActorComponent* Component : GetComponents())
 		{
-			// reset the vehicle to upright
-			DoResetVehicle();
+			if (Component && Component->IsComponentTickEnabled())
+			{
+				Component->SetComponentTickEnabled(false);
+				DormantTickingComponents.Add(Component);
+			}
 		}
-		
-		// set the flipped check flag so the next check resets the car
-		bPreviousFlipCheck = true;
 
 	} else {
 
-		// we're upright. reset the flipped check flag
-		bPreviousFlipCheck = false;
+		SetActorHiddenInGame(false);
+		SetActorEnableCollision(true);
+		SetActorTickEnabled(true);
+
+		for (UActorComponent* Component : DormantTickingComponents)
+		{
+			if (IsValid(Component))
+			{
+				Component->SetComponentTickEnabled(true);
+			}
+		}
+
+		DormantTickingComponents.Reset();
+
+		// rebuild the vehicle simulation from rest with neutral controls
+		SetKinematicSimulation(false, FVector::ZeroVector);
+
+		ChaosVehicleMovement->SetSteeringInput(0.0f);
+		ChaosVehicleMovement->SetThrottleInput(0.0f);
+		ChaosVehicleMovement->SetBrakeInput(0.0f);
+		ChaosVehicleMovement->SetHandbrakeInput(false);
+		RacingVehicleMovement->SubmitInput();
+
+		SetWorldSystemsRegistered(true);
+	}
+}
+
+void AFutureRacingPawn::Recycle()
+{
+	UFutureRacingVehiclePoolSubsystem* VehiclePool = GetWorld()->GetSubsystem<UFutureRacingVehiclePoolSubsystem>();
+
+	if (VehiclePool && HasAuthority())
+	{
+		VehiclePool->Release(this);
+
+	} else {
+
+		Destroy();
+	}
+}
+
+void AFutureRacingPawn::SetWorldSystemsRegistered(bool bRegistered)
+{
+	// pooled vehicles leave the systems when parked, and again when they're destroyed
+	if (bRegistered == bWorldSystemsRegistered)
+	{
+		return;
+	}
+
+	FUTURERACING_SCOPE_CYCLE_COUNTER(STAT_FutureRacingVehicleRegistration);
+	LLM_SCOPE_BYTAG(FutureRacing_Vehicles);
+
+	bWorldSystemsRegistered = bRegistered;
+
+	if (bRegistered)
+	{
+		INC_DWORD_STAT(STAT_FutureRacingActiveVehicles);
+
+	} else {
+
+		DEC_DWORD_STAT(STAT_FutureRacingActiveVehicles);
+	}
+
+	UWorld* World = GetWorld();
+
+	// flip resets and simulation LOD only run where the vehicle is simulated for real.
+	// Clients follow the server's snapshots instead
+	const bool bHasAuthority = HasAuthority();
+
+	// batched flip checks
+	UFutureRacingFlipSubsystem* FlipCheck = bHasAuthority ? World->GetSubsystem<UFutureRacingFlipSubsystem>() : nullptr;
+
+	if (FlipCheck)
+	{
+		if (bRegistered)
+		{
+			FlipCheck->RegisterVehicle(this);
+
+		} else {
+
+			FlipCheck->UnregisterVehicle(this);
+		}
+	}
+
+	// simulation LOD
+	UFutureRacingSimLODSubsystem* SimLOD = bHasAuthority ? World->GetSubsystem<UFutureRacingSimLODSubsystem>() : nullptr;
+
+	if (SimLOD)
+	{
+		if (bRegistered)
+		{
+			SimLOD->RegisterVehicle(this);
+
+		} else {
+
+			SimLOD->UnregisterVehicle(this);
+		}
+	}
+
+	// race positions
+	if (UFutureRacingTrackProgressSubsystem* TrackProgress = World->GetSubsystem<UFutureRacingTrackProgressSubsystem>())
+	{
+		if (bRegistered)
+		{
+			TrackProgress->RegisterVehicle(this);
+
+		} else {
+
+			TrackProgress->UnregisterVehicle(this);
+		}
+	}
+
+	// gate crossings
+	if (UFutureRacingGateCrossingSubsystem* GateCrossing = World->GetSubsystem<UFutureRacingGateCrossingSubsystem>())
+	{
+		if (bRegistered)
+		{
+			GateCrossing->RegisterVehicle(this);
+
+		} else {
+
+			GateCrossing->UnregisterVehicle(this);
+		}
+	}
+
+	// replay recording
+	if (UFutureRacingReplaySubsystem* Replay = World->GetSubsystem<UFutureRacingReplaySubsystem>())
+	{
+		if (bRegistered)
+		{
+			Replay->RegisterVehicle(this);
+
+		} else {
+
+			Replay->UnregisterVehicle(this);
+		}
+	}
+
+	// telemetry capture
+	if (UFutureRacingTelemetrySubsystem* Telemetry = World->GetSubsystem<UFutureRacingTelemetrySubsystem>())
+	{
+		if (bRegistered)
+		{
+			Telemetry->RegisterVehicle(this);
+
+		} else {
+
+			Telemetry->UnregisterVehicle(this);
+		}
+	}
+
+	// snapshot scheduling, on servers
+	UFutureRacingNetSchedulerSubsystem* NetScheduler = bHasAuthority ? World->GetSubsystem<UFutureRacingNetSchedulerSubsystem>() : nullptr;
+
+	if (NetScheduler)
+	{
+		if (bRegistered)
+		{
+			NetScheduler->RegisterVehicle(this);
+
+		} else {
+
+			NetScheduler->UnregisterVehicle(this);
+		}
 	}
 }
 
@@ -4,12 +4,15 @@
 
 #include "CoreMinimal.h"
 #include "WheeledVehiclePawn.h"
+#include "FutureRacingInputLog.h"
 #include "FutureRacingPawn.generated.h"
 
 class UCameraComponent;
 class USpringArmComponent;
 class UInputAction;
 class UChaosWheeledVehicleMovementComponent;
+class UFutureRacingVehicleMovementComponent;
+class UFutureRacingVehicleNetComponent;
 struct FInputActionValue;
 
 /**
@@ -24,25 +27,32 @@ class AFutureRacingPawn : public AWheeledVehiclePawn
 {
 	GENERATED_BODY()
 
-	/** Spring Arm for the front camera */
+	/** Spring Arm for the front camera. Only ticks for locally player controlled vehicles */
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category ="Components", meta = (AllowPrivateAccess = "true"))
 	USpringArmComponent* FrontSpringArm;
 
-	/** Front Camera component */
+	/** Front Camera component. Only active for locally player controlled vehicles */
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category ="Components", meta = (AllowPrivateAccess = "true"))
 	UCameraComponent* FrontCamera;
 
-	/** Spring Arm for the back camera */
+	/** Spring Arm for the back camera. Only ticks for locally player controlled vehicles */
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category ="Components", meta = (AllowPrivateAccess = "true"))
 	USpringArmComponent* BackSpringArm;
 
-	/** Back Camera component */
+	/** Back Camera component. Only active for locally player controlled vehicles */
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category ="Components", meta = (AllowPrivateAccess = "true"))
 	UCameraComponent* BackCamera;
 
+	/** Replicates the vehicle state as snapshots, in place of the default movement replication */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category ="Components", meta = (AllowPrivateAccess = "true"))
+	UFutureRacingVehicleNetComponent* NetComponent;
+
 	/** Cast pointer to the Chaos Vehicle movement component */
 	TObjectPtr<UChaosWheeledVehicleMovementComponent> ChaosVehicleMovement;
 
+	/** Cast pointer to our movement component, which forwards inputs to the physics thread */
+	TObjectPtr<UFutureRacingVehicleMovementComponent> RacingVehicleMovement;
+
 protected:
 
 	/** Steering Action */
@@ -76,27 +86,39 @@ protected:
 	/** Keeps track of which camera is active */
 	bool bFrontCameraActive = false;
 
-	/** Keeps track of whether the car is flipped. If this is true for two flip checks, resets the vehicle automatically */
-	bool bPreviousFlipCheck = false;
-
-	/** Time between automatic flip checks */
-	UPROPERTY(EditAnywhere, Category="Flip Check", meta = (Units = "s"))
-	float FlipCheckTime = 3.0f;
-
 	/** Minimum dot product value for the vehicle's up direction that we still consider upright */
 	UPROPERTY(EditAnywhere, Category="Flip Check")
 	float FlipCheckMinDot = -0.2f;
 
-	/** Flip check timer */
-	FTimerHandle FlipCheckTimer;
+	/** If true, the Chaos simulation is suspended and the vehicle is moved kinematically by the simulation LOD */
+	bool bKinematicSimulation = false;
+
+	/** If true, the vehicle is parked in the vehicle pool */
+	bool bDormant = false;
+
+	/** Components that were ticking when the vehicle was parked, to wake back up with it */
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<UActorComponent>> DormantTickingComponents;
+
+	/** If true, the vehicle is registered with the world's vehicle subsystems */
+	bool bWorldSystemsRegistered = false;
+
+	/** Input log the driving calls are recorded to, if any */
+	TSharedPtr<FFutureRacingInputLog> InputLog;
 
 public:
-	AFutureRacingPawn();
+	AFutureRacingPawn(const FObjectInitializer& ObjectInitializer = FObjectInitializer::Get());
 
 	// Begin Pawn interface
 
 	virtual void SetupPlayerInputComponent(UInputComponent* InputComponent) override;
 
+	/** Sets up or parks the camera rig depending on who controls us */
+	virtual void NotifyControllerChanged() override;
+
+	/** Returns the vehicle to the pool instead of destroying it */
+	virtual void FellOutOfWorld(const UDamageType& DamageType) override;
+
 	// End Pawn interface
 
 	// Begin Actor interface
@@ -110,6 +132,12 @@ public:
 	/** Update */
 	virtual void Tick(float Delta) override;
 
+	/** Scales the net priority by how much the connection cares about us */
+	virtual float GetNetPriority(const FVector& ViewPos, const FVector& ViewDir, AActor* Viewer, AActor* ViewTarget, UActorChannel* InChannel, float Time, bool bLowBandwidth) override;
+
+	/** Racing vehicles stay relevant to everyone. Distance only lowers how often they're sent */
+	virtual bool IsNetRelevantFor(const AActor* RealViewer, const AActor* ViewTarget, const FVector& SrcLocation) const override;
+
 	// End Actor interface
 
 protected:
@@ -182,16 +210,57 @@ public:
 	UFUNCTION(BlueprintCallable, Category="Input")
 	void DoResetVehicle();
 
+	/**
+	 *  Suspends or resumes the Chaos vehicle simulation.
+	 *  While kinematic, the caller is responsible for moving the vehicle.
+	 *  @param bKinematic If true, physics and the vehicle simulation are turned off
+	 *  @param LinearVelocity Velocity to resume the simulation with
+	 */
+	void SetKinematicSimulation(bool bKinematic, const FVector& LinearVelocity);
+
+	/** Returns true if the vehicle is currently moved kinematically instead of simulated */
+	bool IsKinematicSimulation() const { return bKinematicSimulation; }
+
+	/**
+	 *  Puts the vehicle to sleep in the vehicle pool, or wakes it up with fresh state.
+	 *  Dormant vehicles are hidden, don't collide, don't tick and don't simulate.
+	 */
+	void SetDormant(bool bNewDormant);
+
+	/** Returns true if the vehicle is parked in the vehicle pool */
+	bool IsDormant() const { return bDormant; }
+
+	/** Takes the vehicle out of play. It goes back to the vehicle pool if the world has one, otherwise it's destroyed */
+	UFUNCTION(BlueprintCallable, Category="Vehicle")
+	void Recycle();
+
+	/** Starts recording every driving call to an input log, or stops with null */
+	void SetInputLog(const TSharedPtr<FFutureRacingInputLog>& NewInputLog) { InputLog = NewInputLog; }
+
+	/** Returns the minimum up vector dot product the vehicle is still considered upright at */
+	float GetFlipCheckMinDot() const { return FlipCheckMinDot; }
+
 protected:
 
+	/** Starts the spring arms ticking and activates the current camera */
+	void WakeCameraRig();
+
+	/** Stops the camera rig from ticking while nobody is looking through it */
+	void ParkCameraRig();
+
+	/** Removes the components and work only a viewer needs. Called on dedicated servers at BeginPlay */
+	virtual void StripCosmetics();
+
+	/** Adds us to or removes us from the world's vehicle subsystems */
+	void SetWorldSystemsRegistered(bool bRegistered);
+
+	/** Records a driving call to the input log, if one is attached */
+	void LogInputCall(FutureRacingInputLog::ECall Call, float Value = 0.0f);
+
 	/** Called when the brake lights are turned on or off */
 	UFUNCTION(BlueprintImplementableEvent, Category="Vehicle")
 	void BrakeLights(bool bBraking);
 
-	/** Checks if the car is flipped upside down and automatically resets it */
-	UFUNCTION()
-	void FlippedCheck();
-
 public:
 	/** Returns the front spring arm subobject */
 	FORCEINLINE USpringArmComponent* GetFrontSpringArm() const { return FrontSpringArm; }
@@ -203,4 +272,8 @@ public:
 	FORCEINLINE UCameraComponent* GetBackCamera() const { return BackCamera; }
 	/** Returns the cast Chaos Vehicle Movement subobject */
 	FORCEINLINE const TObjectPtr<UChaosWheeledVehicleMovementComponent>& GetChaosVehicleMovement() const { return ChaosVehicleMovement; }
+	/** Returns the cast FutureRacing movement subobject */
+	FORCEINLINE const TObjectPtr<UFutureRacingVehicleMovementComponent>& GetRacingVehicleMovement() const { return RacingVehicleMovement; }
+	/** Returns the snapshot replication subobject */
+	FORCEINLINE UFutureRacingVehicleNetComponent* GetNetComponent() const { return NetComponent; }
 };
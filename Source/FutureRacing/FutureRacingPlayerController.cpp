@@ -3,23 +3,39 @@
 
 #include "FutureRacingPlayerController.h"
 #include "FutureRacingPawn.h"
+#include "FutureRacingVehiclePoolSubsystem.h"
+#include "FutureRacingMarkerSubsystem.h"
 #include "FutureRacingUI.h"
 #include "EnhancedInputSubsystems.h"
 #include "ChaosWheeledVehicleMovementComponent.h"
 #include "Blueprint/UserWidget.h"
 #include "FutureRacing.h"
-#include "Kismet/GameplayStatics.h"
 #include "GameFramework/PlayerStart.h"
 #include "Widgets/Input/SVirtualJoystick.h"
 
+DECLARE_CYCLE_STAT(TEXT("Player Controller Tick"), STAT_FutureRacingPlayerControllerTick, STATGROUP_FutureRacing);
+
 void AFutureRacingPlayerController::BeginPlay()
 {
 	Super::BeginPlay();
+
+	// get respawn vehicles ready while we're still loading
+	if (HasAuthority())
+	{
+		if (UFutureRacingVehiclePoolSubsystem* VehiclePool = GetWorld()->GetSubsystem<UFutureRacingVehiclePoolSubsystem>())
+		{
+			VehiclePool->Prewarm(VehiclePawnClass, RespawnPoolSize);
+
+			// vehicles taken out of play go back to the pool instead of being destroyed
+			VehiclePool->OnVehicleReleased.AddUObject(this, &AFutureRacingPlayerController::OnPawnReleased);
+		}
+	}
 	
 	// ensure we're attached to the vehicle pawn so that World Partition streaming works correctly
 	bAttachToPawn = true;
 
-	// only spawn UI on local player controllers
+	// only spawn UI on local player controllers. Server builds never have one
+#if !UE_SERVER
 	if (IsLocalPlayerController())
 	{
 		if (ShouldUseTouchControls())
@@ -53,6 +69,7 @@ void AFutureRacingPlayerController::BeginPlay()
 
 		}
 	}
+#endif
 }
 
 void AFutureRacingPlayerController::SetupInputComponent()
@@ -84,6 +101,8 @@ void AFutureRacingPlayerController::SetupInputComponent()
 
 void AFutureRacingPlayerController::Tick(float Delta)
 {
+	FUTURERACING_SCOPE_CYCLE_COUNTER(STAT_FutureRacingPlayerControllerTick);
+
 	Super::Tick(Delta);
 
 	if (IsValid(VehiclePawn) && IsValid(VehicleUI))
@@ -101,21 +120,49 @@ void AFutureRacingPlayerController::OnPossess(APawn* InPawn)
 	VehiclePawn = CastChecked<AFutureRacingPawn>(InPawn);
 
 	// subscribe to the pawn's OnDestroyed delegate
-	VehiclePawn->OnDestroyed.AddDynamic(this, &AFutureRacingPlayerController::OnPawnDestroyed);
+	VehiclePawn->OnDestroyed.AddUniqueDynamic(this, &AFutureRacingPlayerController::OnPawnDestroyed);
+}
+
+void AFutureRacingPlayerController::AcknowledgePossession(APawn* InPawn)
+{
+	Super::AcknowledgePossession(InPawn);
+
+	// respawning is up to the server, clients only need the pointer for the UI
+	VehiclePawn = Cast<AFutureRacingPawn>(InPawn);
 }
 
 void AFutureRacingPlayerController::OnPawnDestroyed(AActor* DestroyedPawn)
 {
-	// find the player start
-	TArray<AActor*> ActorList;
-	UGameplayStatics::GetAllActorsOfClass(GetWorld(), APlayerStart::StaticClass(), ActorList);
+	// pooled vehicles outlive us, so ignore vehicles we've since moved on from
+	if (DestroyedPawn == VehiclePawn)
+	{
+		RespawnVehicle();
+	}
+}
+
+void AFutureRacingPlayerController::OnPawnReleased(AFutureRacingPawn* ReleasedPawn, AController* FormerController)
+{
+	if (FormerController == this)
+	{
+		RespawnVehicle();
+	}
+}
+
+void AFutureRacingPlayerController::RespawnVehicle()
+{
+	FUTURERACING_SCOPE_CYCLE_COUNTER(STAT_FutureRacingRespawnTime);
+
+	// find a free player start
+	UFutureRacingMarkerSubsystem* Markers = GetWorld()->GetSubsystem<UFutureRacingMarkerSubsystem>();
 
-	if (ActorList.Num() > 0)
+	if (APlayerStart* PlayerStart = Markers->ReserveFreePlayerStart())
 	{
-		// spawn a vehicle at the player start
-		const FTransform SpawnTransform = ActorList[0]->GetActorTransform();
+		// take a vehicle from the pool and place it at the player start
+		const FTransform SpawnTransform = PlayerStart->GetActorTransform();
+
+		UFutureRacingVehiclePoolSubsystem* VehiclePool = GetWorld()->GetSubsystem<UFutureRacingVehiclePoolSubsystem>();
 
-		if (AFutureRacingPawn* RespawnedVehicle = GetWorld()->SpawnActor<AFutureRacingPawn>(VehiclePawnClass, SpawnTransform))
+		if (AFutureRacingPawn* RespawnedVehicle = VehiclePool->Acquire(VehiclePawnClass, SpawnTransform))
 		{
 			// possess the vehicle
 			Possess(RespawnedVehicle);
@@ -55,6 +55,10 @@ protected:
 	UPROPERTY(EditAnywhere, Category="Vehicle|Respawn")
 	TSubclassOf<AFutureRacingPawn> VehiclePawnClass;
 
+	/** Number of dormant vehicles to keep ready for respawning */
+	UPROPERTY(EditAnywhere, Category="Vehicle|Respawn", meta = (ClampMin = 0))
+	int32 RespawnPoolSize = 1;
+
 	/** Pointer to the controlled vehicle pawn */
 	TObjectPtr<AFutureRacingPawn> VehiclePawn;
 
@@ -84,10 +88,23 @@ protected:
 	/** Pawn setup */
 	virtual void OnPossess(APawn* InPawn) override;
 
+public:
+
+	/** Pawn setup on clients, which never run OnPossess */
+	virtual void AcknowledgePossession(APawn* InPawn) override;
+
+protected:
+
 	/** Handles pawn destruction and respawning */
 	UFUNCTION()
 	void OnPawnDestroyed(AActor* DestroyedPawn);
 
+	/** Respawns when our pawn is returned to the vehicle pool */
+	void OnPawnReleased(AFutureRacingPawn* ReleasedPawn, AController* FormerController);
+
+	/** Places a vehicle from the pool at a free player start and possesses it */
+	void RespawnVehicle();
+
 	/** Returns true if the player should use UMG touch controls */
 	bool ShouldUseTouchControls() const;
 };
@@ -0,0 +1,94 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "FutureRacingServerStatsSubsystem.h"
+#include "FutureRacingPawn.h"
+#include "Engine/NetDriver.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformMemory.h"
+#include "HAL/PlatformTime.h"
+#include "FutureRacing.h"
+
+static FAutoConsoleCommandWithWorld DumpServerStatsCommand(
+	TEXT("FutureRacing.Server.DumpStats"),
+	TEXT("Logs the dedicated server's clients, vehicles, frame times and memory since the last log."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (UFutureRacingServerStatsSubsystem* ServerStats = World ? World->GetSubsystem<UFutureRacingServerStatsSubsystem>() : nullptr)
+		{
+			ServerStats->LogStats();
+		}
+	}));
+
+void UFutureRacingServerStatsSubsystem::LogStats()
+{
+	const UNetDriver* NetDriver = GetWorld()->GetNetDriver();
+	const int32 NumClients = NetDriver ? NetDriver->ClientConnections.Num() : 0;
+
+	// pooled vehicles are parked and cost next to nothing, so count them apart
+	int32 NumVehicles = 0;
+	int32 NumDormant = 0;
+
+	for (TActorIterator<AFutureRacingPawn> It(GetWorld()); It; ++It)
+	{
+		NumVehicles += It->IsDormant() ? 0 : 1;
+		NumDormant += It->IsDormant() ? 1 : 0;
+	}
+
+	const FPlatformMemoryStats Memory = FPlatformMemory::GetStats();
+
+	UE_LOG(LogFutureRacing, Display, TEXT("Server: %d clients, %d vehicles (+%d dormant), frame avg %.2fms, max %.2fms, game thread avg %.2fms, max %.2fms, memory %.1f MB (peak %.1f MB)"),
+		NumClients, NumVehicles, NumDormant,
+		NumFrames > 0 ? TotalFrameMs / NumFrames : 0.0, MaxFrameMs,
+		NumFrames > 0 ? TotalGameThreadMs / NumFrames : 0.0, MaxGameThreadMs,
+		Memory.UsedPhysical / (1024.0 * 1024.0), Memory.PeakUsedPhysical / (1024.0 * 1024.0));
+
+	NumFrames = 0;
+	TotalFrameMs = 0.0;
+	MaxFrameMs = 0.0;
+	TotalGameThreadMs = 0.0;
+	MaxGameThreadMs = 0.0;
+}
+
+bool UFutureRacingServerStatsSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	return Super::ShouldCreateSubsystem(Outer) && IsRunningDedicatedServer();
+}
+
+bool UFutureRacingServerStatsSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game;
+}
+
+void UFutureRacingServerStatsSubsystem::Tick(float DeltaTime)
+{
+	// the engine measures the previous frame's game thread time, minus the time it spent waiting
+	const double FrameMs = DeltaTime * 1000.0;
+	const double GameThreadMs = FPlatformTime::ToMilliseconds(GGameThreadTime);
+
+	++NumFrames;
+	TotalFrameMs += FrameMs;
+	MaxFrameMs = FMath::Max(MaxFrameMs, FrameMs);
+	TotalGameThreadMs += GameThreadMs;
+	MaxGameThreadMs = FMath::Max(MaxGameThreadMs, GameThreadMs);
+
+	if (LogInterval <= 0.0f)
+	{
+		return;
+	}
+
+	LogCountdown -= DeltaTime;
+
+	if (LogCountdown <= 0.0f)
+	{
+		LogCountdown = LogInterval;
+		LogStats();
+	}
+}
+
+TStatId UFutureRacingServerStatsSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UFutureRacingServerStatsSubsystem, STATGROUP_Tickables);
+}
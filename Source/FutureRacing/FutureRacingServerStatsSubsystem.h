@@ -0,0 +1,57 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "FutureRacingServerStatsSubsystem.generated.h"
+
+/**
+ *  Logs what a dedicated server costs at a regular interval: connected clients, simulated vehicles,
+ *  frame and game thread times and process memory. Only created on dedicated servers.
+ *
+ *  To measure a full grid on one machine, start the server and connect headless clients to it:
+ *      FutureRacingServer Lvl_Timetrial -log
+ *      FutureRacing 127.0.0.1 -nullrhi -nosound -unattended    (once per client)
+ */
+UCLASS(Config="Game")
+class UFutureRacingServerStatsSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+protected:
+
+	/** Seconds between stats logs. Zero or less only logs on request */
+	UPROPERTY(Config)
+	float LogInterval = 10.0f;
+
+	/** Time left until the next log */
+	float LogCountdown = 0.0f;
+
+	/** Frame measurements since the last log */
+	int32 NumFrames = 0;
+	double TotalFrameMs = 0.0;
+	double MaxFrameMs = 0.0;
+	double TotalGameThreadMs = 0.0;
+	double MaxGameThreadMs = 0.0;
+
+public:
+
+	/** Logs the measurements since the last log, then starts over */
+	void LogStats();
+
+	// Begin UWorldSubsystem interface
+
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+	// End UWorldSubsystem interface
+
+	// Begin FTickableGameObject interface
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	// End FTickableGameObject interface
+};
@@ -0,0 +1,254 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "FutureRacingSimLODSubsystem.h"
+#include "FutureRacingPawn.h"
+#include "FutureRacingTrackSubsystem.h"
+#include "FutureRacingTrackTable.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/IConsoleManager.h"
+#include "Engine/World.h"
+
+static TAutoConsoleVariable<int32> CVarSimLODEnable(
+	TEXT("FutureRacing.SimLOD.Enable"),
+	1,
+	TEXT("If 1, distant and off screen AI vehicles switch to kinematic track playback.\n")
+	TEXT("If 0, every vehicle runs the full Chaos simulation."),
+	ECVF_Default);
+
+void UFutureRacingSimLODSubsystem::RegisterVehicle(AFutureRacingPawn* Vehicle)
+{
+	if (!Vehicle || Vehicles.Contains(Vehicle))
+	{
+		return;
+	}
+
+	Vehicles.Add(Vehicle);
+	Kinematic.Add(false);
+	TrackDistances.Add(-1.0f);
+	Speeds.Add(0.0f);
+	LateralOffsets.Add(0.0f);
+	HeightOffsets.Add(0.0f);
+}
+
+void UFutureRacingSimLODSubsystem::UnregisterVehicle(AFutureRacingPawn* Vehicle)
+{
+	const int32 Index = Vehicles.IndexOfByKey(Vehicle);
+
+	if (Index == INDEX_NONE)
+	{
+		return;
+	}
+
+	// hand the vehicle back in its full simulation state
+	if (Kinematic[Index])
+	{
+		Promote(Index);
+	}
+
+	RemoveAtSwap(Index);
+}
+
+int32 UFutureRacingSimLODSubsystem::GetNumKinematicVehicles() const
+{
+	int32 NumKinematic = 0;
+
+	for (bool bKinematic : Kinematic)
+	{
+		NumKinematic += bKinematic ? 1 : 0;
+	}
+
+	return NumKinematic;
+}
+
+bool UFutureRacingSimLODSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	// only needed where vehicles actually race
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UFutureRacingSimLODSubsystem::Tick(float DeltaTime)
+{
+	// drop any vehicles destroyed without unregistering
+	for (int32 Index = Vehicles.Num() - 1; Index >= 0; --Index)
+	{
+		if (!Vehicles[Index].IsValid())
+		{
+			RemoveAtSwap(Index);
+		}
+	}
+
+	SignificanceCountdown -= DeltaTime;
+
+	if (SignificanceCountdown <= 0.0f)
+	{
+		SignificanceCountdown = SignificanceInterval;
+		UpdateSignificance();
+	}
+
+	AdvanceKinematicVehicles(DeltaTime);
+}
+
+TStatId UFutureRacingSimLODSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UFutureRacingSimLODSubsystem, STATGROUP_Tickables);
+}
+
+void UFutureRacingSimLODSubsystem::UpdateSignificance()
+{
+	UWorld* World = GetWorld();
+
+	// grab the primary track once it's available
+	if (!Track.IsValid())
+	{
+		if (UFutureRacingTrackSubsystem* TrackSubsystem = World->GetSubsystem<UFutureRacingTrackSubsystem>())
+		{
+			Track = TrackSubsystem->GetPrimaryTable();
+		}
+	}
+
+	// gather the local viewpoints
+	TArray<FVector, TInlineAllocator<4>> ViewLocations;
+	TArray<FVector, TInlineAllocator<4>> ViewDirections;
+
+	for (FConstPlayerControllerIterator It = World->GetPlayerControllerIterator(); It; ++It)
+	{
+		APlayerController* PlayerController = It->Get();
+
+		if (PlayerController && PlayerController->IsLocalController())
+		{
+			FVector ViewLocation;
+			FRotator ViewRotation;
+			PlayerController->GetPlayerViewPoint(ViewLocation, ViewRotation);
+
+			ViewLocations.Add(ViewLocation);
+			ViewDirections.Add(ViewRotation.Vector());
+		}
+	}
+
+	// without a track or anybody watching (dedicated servers, headless runs) everything is fully simulated
+	const bool bLODAllowed = CVarSimLODEnable.GetValueOnGameThread() != 0 && Track.IsValid() && Track->IsValid() && ViewLocations.Num() > 0;
+
+	const float PromoteDistanceSquared = FMath::Square(DemoteDistance * PromoteHysteresis);
+	const float OffscreenPromoteDistanceSquared = FMath::Square(OffscreenDemoteDistance * PromoteHysteresis);
+
+	for (int32 Index = 0; Index < Vehicles.Num(); ++Index)
+	{
+		AFutureRacingPawn* Vehicle = Vehicles[Index].Get();
+
+		// never take the simulation away from player driven cars
+		if (!bLODAllowed || Vehicle->IsPlayerControlled())
+		{
+			if (Kinematic[Index])
+			{
+				Promote(Index);
+			}
+
+			continue;
+		}
+
+		// find the closest viewer, and whether any viewer is looking our way
+		const FVector VehicleLocation = Vehicle->GetActorLocation();
+
+		float ClosestDistanceSquared = TNumericLimits<float>::Max();
+		bool bOnScreen = false;
+
+		for (int32 ViewIndex = 0; ViewIndex < ViewLocations.Num(); ++ViewIndex)
+		{
+			const FVector ToVehicle = VehicleLocation - ViewLocations[ViewIndex];
+			const float DistanceSquared = ToVehicle.SizeSquared();
+
+			ClosestDistanceSquared = FMath::Min(ClosestDistanceSquared, DistanceSquared);
+			bOnScreen |= FVector::DotProduct(ToVehicle.GetSafeNormal(), ViewDirections[ViewIndex]) >= OnScreenMinDot;
+		}
+
+		if (Kinematic[Index])
+		{
+			// promote with some hysteresis so cars on the boundary don't flicker between modes
+			if (ClosestDistanceSquared < (bOnScreen ? PromoteDistanceSquared : OffscreenPromoteDistanceSquared))
+			{
+				Promote(Index);
+			}
+
+		} else {
+
+			const float DemoteDistanceSquared = FMath::Square(bOnScreen ? DemoteDistance : OffscreenDemoteDistance);
+
+			if (ClosestDistanceSquared > DemoteDistanceSquared)
+			{
+				Demote(Index);
+			}
+		}
+	}
+}
+
+void UFutureRacingSimLODSubsystem::Demote(int32 Index)
+{
+	AFutureRacingPawn* Vehicle = Vehicles[Index].Get();
+
+	// snap to the track and remember where on it we were
+	const FVector Location = Vehicle->GetActorLocation();
+	const float Distance = Track->FindClosestDistance(Location, TrackDistances[Index]);
+
+	const FVector TrackLocation = Track->GetPositionAtDistance(Distance);
+	const FVector TrackDirection = Track->GetDirectionAtDistance(Distance);
+	const FVector TrackRight = FVector::CrossProduct(FVector::UpVector, TrackDirection).GetSafeNormal();
+
+	TrackDistances[Index] = Distance;
+	LateralOffsets[Index] = FVector::DotProduct(Location - TrackLocation, TrackRight);
+	HeightOffsets[Index] = Location.Z - TrackLocation.Z;
+
+	// keep going at the speed we had, but never backwards
+	Speeds[Index] = FMath::Max(0.0f, static_cast<float>(FVector::DotProduct(Vehicle->GetVelocity(), TrackDirection)));
+
+	Vehicle->SetKinematicSimulation(true, FVector::ZeroVector);
+	Kinematic[Index] = true;
+}
+
+void UFutureRacingSimLODSubsystem::Promote(int32 Index)
+{
+	AFutureRacingPawn* Vehicle = Vehicles[Index].Get();
+
+	// resume the full simulation with the velocity we've been moving at
+	const FVector Velocity = Track.IsValid() ? Track->GetDirectionAtDistance(TrackDistances[Index]) * Speeds[Index] : FVector::ZeroVector;
+
+	Vehicle->SetKinematicSimulation(false, Velocity);
+	Kinematic[Index] = false;
+}
+
+void UFutureRacingSimLODSubsystem::AdvanceKinematicVehicles(float DeltaTime)
+{
+	if (!Track.IsValid() || !Track->IsValid())
+	{
+		return;
+	}
+
+	for (int32 Index = 0; Index < Vehicles.Num(); ++Index)
+	{
+		if (!Kinematic[Index])
+		{
+			continue;
+		}
+
+		// move along the track, keeping our lane and ride height
+		const float Distance = Track->WrapDistance(TrackDistances[Index] + Speeds[Index] * DeltaTime);
+		TrackDistances[Index] = Distance;
+
+		const FVector TrackDirection = Track->GetDirectionAtDistance(Distance);
+		const FVector TrackRight = FVector::CrossProduct(FVector::UpVector, TrackDirection).GetSafeNormal();
+
+		const FVector Location = Track->GetPositionAtDistance(Distance) + TrackRight * LateralOffsets[Index] + FVector::UpVector * HeightOffsets[Index];
+
+		Vehicles[Index]->SetActorLocationAndRotation(Location, TrackDirection.Rotation(), false, nullptr, ETeleportType::TeleportPhysics);
+	}
+}
+
+void UFutureRacingSimLODSubsystem::RemoveAtSwap(int32 Index)
+{
+	Vehicles.RemoveAtSwap(Index);
+	Kinematic.RemoveAtSwap(Index);
+	TrackDistances.RemoveAtSwap(Index);
+	Speeds.RemoveAtSwap(Index);
+	LateralOffsets.RemoveAtSwap(Index);
+	HeightOffsets.RemoveAtSwap(Index);
+}
@@ -0,0 +1,101 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "FutureRacingSimLODSubsystem.generated.h"
+
+class AFutureRacingPawn;
+struct FFutureRacingTrackTable;
+
+/**
+ *  Significance-driven simulation LOD for vehicles.
+ *  AI vehicles far from every local viewer, or far and off screen, stop running
+ *  the Chaos vehicle simulation and glide along the primary track at the speed
+ *  they had when demoted. They go back to full simulation as soon as they become relevant.
+ */
+UCLASS(Config="Game")
+class UFutureRacingSimLODSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+protected:
+
+	/** Vehicles beyond this distance from every viewer are demoted */
+	UPROPERTY(Config)
+	float DemoteDistance = 30000.0f;
+
+	/** Off screen vehicles beyond this distance from every viewer are demoted */
+	UPROPERTY(Config)
+	float OffscreenDemoteDistance = 12000.0f;
+
+	/** Demoted vehicles are promoted back once they get this much closer than the demote distance */
+	UPROPERTY(Config)
+	float PromoteHysteresis = 0.8f;
+
+	/** Cosine of the half angle a vehicle needs to be within to count as on screen */
+	UPROPERTY(Config)
+	float OnScreenMinDot = 0.5f;
+
+	/** Time between significance updates */
+	UPROPERTY(Config)
+	float SignificanceInterval = 0.25f;
+
+	/** Registered vehicles */
+	TArray<TWeakObjectPtr<AFutureRacingPawn>> Vehicles;
+
+	/** Per vehicle kinematic state, parallel to Vehicles */
+	TArray<bool> Kinematic;
+	TArray<float> TrackDistances;
+	TArray<float> Speeds;
+	TArray<float> LateralOffsets;
+	TArray<float> HeightOffsets;
+
+	/** Track the kinematic vehicles follow */
+	TSharedPtr<const FFutureRacingTrackTable> Track;
+
+	/** Time left until the next significance update */
+	float SignificanceCountdown = 0.0f;
+
+public:
+
+	/** Adds a vehicle to the LOD system */
+	void RegisterVehicle(AFutureRacingPawn* Vehicle);
+
+	/** Removes a vehicle from the LOD system, restoring full simulation if needed */
+	void UnregisterVehicle(AFutureRacingPawn* Vehicle);
+
+	/** Returns the number of vehicles currently in kinematic mode */
+	int32 GetNumKinematicVehicles() const;
+
+	// Begin UWorldSubsystem interface
+
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+	// End UWorldSubsystem interface
+
+	// Begin FTickableGameObject interface
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	// End FTickableGameObject interface
+
+protected:
+
+	/** Re-evaluates which vehicles should be simulated */
+	void UpdateSignificance();
+
+	/** Switches a vehicle to kinematic track playback */
+	void Demote(int32 Index);
+
+	/** Switches a vehicle back to full simulation */
+	void Promote(int32 Index);
+
+	/** Advances the kinematic vehicles along the track */
+	void AdvanceKinematicVehicles(float DeltaTime);
+
+	/** Removes the vehicle at an index, keeping the arrays parallel */
+	void RemoveAtSwap(int32 Index);
+};
@@ -2,18 +2,110 @@
 
 
 #include "FutureRacingUI.h"
+#include "Components/TextBlock.h"
+#include "HAL/IConsoleManager.h"
+#include "FutureRacing.h"
+
+#define LOCTEXT_NAMESPACE "VehicleUI"
+
+DECLARE_CYCLE_STAT(TEXT("HUD Update"), STAT_FutureRacingHUDUpdate, STATGROUP_FutureRacing);
+DECLARE_DWORD_COUNTER_STAT(TEXT("HUD Values Pushed"), STAT_FutureRacingHUDValuesPushed, STATGROUP_FutureRacing);
+DECLARE_DWORD_COUNTER_STAT(TEXT("HUD Values Skipped"), STAT_FutureRacingHUDValuesSkipped, STATGROUP_FutureRacing);
+
+static TAutoConsoleVariable<int32> CVarForceHUDUpdates(
+	TEXT("FutureRacing.UI.ForceHUDUpdates"),
+	0,
+	TEXT("If 1, the speed and gear are pushed to the HUD every frame, even when the displayed value hasn't changed.\n")
+	TEXT("Only useful to compare the game thread and Slate cost against change driven updates, with stat FutureRacing and stat Slate."),
+	ECVF_Default);
+
+void UFutureRacingUI::NativeConstruct()
+{
+	Super::NativeConstruct();
+
+	ResetDisplay();
+}
 
 void UFutureRacingUI::UpdateSpeed(float NewSpeed)
 {
+	FUTURERACING_SCOPE_CYCLE_COUNTER(STAT_FutureRacingHUDUpdate);
+
 	// format the speed to KPH or MPH
-	float FormattedSpeed = FMath::Abs(NewSpeed) * (bIsMPH ? 0.022f : 0.036f);
+	const float FormattedSpeed = FMath::Abs(NewSpeed) * (bIsMPH ? 0.022f : 0.036f);
+
+	// quantize to what the display can show, and skip the update if that didn't change
+	const float Resolution = FMath::Max(SpeedResolution, 0.1f);
+	const int32 SpeedSteps = FMath::RoundToInt(FormattedSpeed / Resolution);
+
+	if (SpeedSteps == DisplayedSpeedSteps && !CVarForceHUDUpdates.GetValueOnGameThread())
+	{
+		INC_DWORD_STAT(STAT_FutureRacingHUDValuesSkipped);
+		return;
+	}
+
+	INC_DWORD_STAT(STAT_FutureRacingHUDValuesPushed);
+
+	DisplayedSpeedSteps = SpeedSteps;
+
+	const float DisplayedSpeed = SpeedSteps * Resolution;
+
+	if (SpeedText)
+	{
+		// set natively, the text block only invalidates when the text differs
+		FNumberFormattingOptions Format;
+		Format.MaximumFractionalDigits = Resolution < 1.0f ? 1 : 0;
+
+		SpeedText->SetText(FText::AsNumber(DisplayedSpeed, &Format));
+
+	} else {
 
-	// call the Blueprint handler
-	OnSpeedUpdate(FormattedSpeed);
+		// call the Blueprint handler
+		OnSpeedUpdate(DisplayedSpeed);
+	}
 }
 
 void UFutureRacingUI::UpdateGear(int32 NewGear)
 {
-	// call the Blueprint handler
-	OnGearUpdate(NewGear);
-}
\ No newline at end of file
+	FUTURERACING_SCOPE_CYCLE_COUNTER(STAT_FutureRacingHUDUpdate);
+
+	if (bHasDisplayedGear && NewGear == DisplayedGear && !CVarForceHUDUpdates.GetValueOnGameThread())
+	{
+		INC_DWORD_STAT(STAT_FutureRacingHUDValuesSkipped);
+		return;
+	}
+
+	INC_DWORD_STAT(STAT_FutureRacingHUDValuesPushed);
+
+	DisplayedGear = NewGear;
+	bHasDisplayedGear = true;
+
+	if (GearText)
+	{
+		if (NewGear < 0)
+		{
+			GearText->SetText(LOCTEXT("ReverseGear", "R"));
+
+		} else if (NewGear == 0) {
+
+			GearText->SetText(LOCTEXT("NeutralGear", "N"));
+
+		} else {
+
+			GearText->SetText(FText::AsNumber(NewGear));
+		}
+
+	} else {
+
+		// call the Blueprint handler
+		OnGearUpdate(NewGear);
+	}
+}
+
+void UFutureRacingUI::ResetDisplay()
+{
+	DisplayedSpeedSteps = INDEX_NONE;
+	DisplayedGear = INDEX_NONE;
+	bHasDisplayedGear = false;
+}
+
+#undef LOCTEXT_NAMESPACE
@@ -6,10 +6,17 @@
 #include "Blueprint/UserWidget.h"
 #include "FutureRacingUI.generated.h"
 
+class UTextBlock;
+
 /**
  *  Simple Vehicle HUD class
  *  Displays the current speed and gear.
  *  Widget setup is handled in a Blueprint subclass.
+ *
+ *  Speed is quantized to the displayed resolution and only pushed when the displayed value changes.
+ *  Blueprints that name their text blocks SpeedText and GearText are updated natively, without
+ *  going through the Blueprint events. Put them under an Invalidation Box or Retainer Box and leave
+ *  them non-volatile, so Slate only repaints them on the frames the text actually changes.
  */
 UCLASS(abstract)
 class UFutureRacingUI : public UUserWidget
@@ -22,6 +29,27 @@ protected:
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category="Vehicle")
 	bool bIsMPH = false;
 
+	/** Smallest speed step shown, in Km/h or MPH */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category="Vehicle", meta=(ClampMin="0.1"))
+	float SpeedResolution = 1.0f;
+
+	/** Optional text block the speed is written to natively. OnSpeedUpdate is called instead if missing */
+	UPROPERTY(BlueprintReadOnly, Category="Vehicle", meta=(BindWidgetOptional))
+	TObjectPtr<UTextBlock> SpeedText;
+
+	/** Optional text block the gear is written to natively. OnGearUpdate is called instead if missing */
+	UPROPERTY(BlueprintReadOnly, Category="Vehicle", meta=(BindWidgetOptional))
+	TObjectPtr<UTextBlock> GearText;
+
+	/** Speed currently displayed, in steps of SpeedResolution. INDEX_NONE until the first update */
+	int32 DisplayedSpeedSteps = INDEX_NONE;
+
+	/** Gear currently displayed */
+	int32 DisplayedGear = INDEX_NONE;
+
+	/** If true, a gear was displayed yet */
+	bool bHasDisplayedGear = false;
+
 public:
 
 	/** Called to update the speed display */
@@ -30,8 +58,14 @@ public:
 	/** Called to update the gear display */
 	void UpdateGear(int32 NewGear);
 
+	/** Forgets the displayed values, so the next updates are pushed even if unchanged */
+	void ResetDisplay();
+
 protected:
 
+	/** Widget initialization */
+	virtual void NativeConstruct() override;
+
 	/** Implemented in Blueprint to display the new speed */
 	UFUNCTION(BlueprintImplementableEvent, Category="Vehicle")
 	void OnSpeedUpdate(float NewSpeed);
@@ -0,0 +1,412 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "FutureRacingVehicleMovementComponent.h"
+#include "FutureRacingReplayWriter.h"
+#include "FutureRacingTelemetryFormat.h"
+#include "FutureRacingInputLatencySubsystem.h"
+#include "GameFramework/Pawn.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTime.h"
+#include "UObject/UObjectIterator.h"
+#include "Physics/Experimental/PhysScene_Chaos.h"
+#include "PBDRigidsSolver.h"
+#include "Net/UnrealNetwork.h"
+#include "FutureRacing.h"
+
+DECLARE_CYCLE_STAT(TEXT("Vehicle Simulation"), STAT_FutureRacingVehicleSimulation, STATGROUP_FutureRacing);
+DECLARE_CYCLE_STAT(TEXT("Telemetry Capture"), STAT_FutureRacingTelemetryCapture, STATGROUP_FutureRacing);
+
+static TAutoConsoleVariable<int32> CVarAsyncVehicleInput(
+	TEXT("FutureRacing.Input.AsyncQueue"),
+	1,
+	TEXT("If 1, vehicle input is applied from a timestamped queue on every physics substep.\n")
+	TEXT("If 0, input reaches physics once per game frame through the default Chaos path. Useful for latency comparisons."),
+	ECVF_Default);
+
+static FAutoConsoleCommand DumpInputLatencyCommand(
+	TEXT("FutureRacing.Input.DumpLatency"),
+	TEXT("Logs the input to physics latency for every vehicle and resets the measurements."),
+	FConsoleCommandDelegate::CreateLambda([]()
+	{
+		for (TObjectIterator<UFutureRacingVehicleMovementComponent> It; It; ++It)
+		{
+			if (It->IsTemplate() || !It->GetWorld())
+			{
+				continue;
+			}
+
+			const FFutureRacingInputLatencyStats Stats = It->GetInputLatencyStats();
+
+			UE_LOG(LogFutureRacing, Display, TEXT("%s (%s): %lld inputs, avg %.2fms, max %.2fms, %lld substeps"),
+				*GetNameSafe(It->GetOwner()),
+				CVarAsyncVehicleInput.GetValueOnGameThread() ? TEXT("async queue") : TEXT("per frame"),
+				Stats.NumInputs, Stats.AverageMs, Stats.MaxMs, Stats.NumSubsteps);
+
+			It->ResetInputLatencyStats();
+		}
+	}));
+
+// steps go through the ring buffer as raw bytes
+static_assert(std::is_trivially_copyable_v<FFutureRacingPhysicsStep>, "Physics steps must be trivially copyable");
+
+FFutureRacingInputChannel::FFutureRacingInputChannel()
+	: StepRing(MakeUnique<FFutureRacingByteRingBuffer>(StepRingCapacity * static_cast<int32>(sizeof(FFutureRacingPhysicsStep))))
+{
+}
+
+FFutureRacingInputChannel::~FFutureRacingInputChannel() = default;
+
+void FFutureRacingInputChannel::RecordLatency(double IssueTime, double ApplyTime)
+{
+	const int64 LatencyMicroseconds = FMath::Max<int64>(0, static_cast<int64>((ApplyTime - IssueTime) * 1000000.0));
+
+	NumInputs.fetch_add(1, std::memory_order_relaxed);
+	TotalLatencyMicroseconds.fetch_add(LatencyMicroseconds, std::memory_order_relaxed);
+
+	int64 PreviousMax = MaxLatencyMicroseconds.load(std::memory_order_relaxed);
+	while (LatencyMicroseconds > PreviousMax && !MaxLatencyMicroseconds.compare_exchange_weak(PreviousMax, LatencyMicroseconds, std::memory_order_relaxed))
+	{
+	}
+}
+
+void FFutureRacingInputChannel::EnableTelemetry(int32 RingCapacity)
+{
+	LLM_SCOPE_BYTAG(FutureRacing_Telemetry);
+
+	if (!TelemetryRing)
+	{
+		TelemetryRing = MakeUnique<FFutureRacingByteRingBuffer>(FMath::Max(RingCapacity, static_cast<int32>(sizeof(FFutureRacingTelemetrySample))));
+	}
+
+	// publishes the ring buffer to the physics thread
+	bTelemetryEnabled.store(true, std::memory_order_release);
+}
+
+void FFutureRacingInputChannel::DisableTelemetry()
+{
+	bTelemetryEnabled.store(false, std::memory_order_release);
+}
+
+FFutureRacingVehicleSimulation::FFutureRacingVehicleSimulation(const TSharedRef<FFutureRacingInputChannel, ESPMode::ThreadSafe>& InInputChannel, const UChaosWheeledVehicleMovementComponent& Component)
+	: InputChannel(InInputChannel)
+	, SteeringInputRate(Component.SteeringInputRate)
+	, ThrottleInputRate(Component.ThrottleInputRate)
+	, BrakeInputRate(Component.BrakeInputRate)
+	, bReverseAsBrake(Component.bReverseAsBrake)
+{
+}
+
+void FFutureRacingVehicleSimulation::TickVehicle(UWorld* WorldIn, float DeltaTime, const FChaosVehicleAsyncInput& InputData, FChaosVehicleAsyncOutput& OutputData, Chaos::FRigidBodyHandle_Internal* Handle)
+{
+	FUTURERACING_SCOPE_CYCLE_COUNTER(STAT_FutureRacingVehicleSimulation);
+
+	InputChannel->NumSubsteps.fetch_add(1, std::memory_order_relaxed);
+
+	// drain everything that arrived since the last substep, keeping the latest target.
+	// Replayed inputs wait for the step they were recorded on
+	const int64 StepIndex = InputChannel->NumStepsPublished.load(std::memory_order_relaxed);
+
+	while (const FFutureRacingTimedInput* QueuedInput = InputChannel->Queue.Peek())
+	{
+		if (QueuedInput->ApplyAtStep > StepIndex)
+		{
+			break;
+		}
+
+		TargetInput = *QueuedInput;
+		bReceivedInput = true;
+
+		InputChannel->Queue.Pop();
+	}
+
+	// publish where the body is at the start of this step, so the game thread can sweep between steps
+	if (Handle)
+	{
+		FFutureRacingPhysicsStep Step;
+		Step.StepIndex = InputChannel->NumStepsPublished.fetch_add(1, std::memory_order_relaxed);
+		Step.Time = WorldIn->GetPhysicsScene()->GetSolver()->GetSolverTime();
+		Step.Location = Handle->X();
+		Step.Rotation = Handle->R();
+		Step.LinearVelocity = Handle->V();
+		Step.Input = TargetInput;
+		Step.PlatformTime = FPlatformTime::Seconds();
+		Step.bNewInput = bReceivedInput;
+
+		if (!InputChannel->StepRing->Write(reinterpret_cast<const uint8*>(&Step), sizeof(Step)))
+		{
+			InputChannel->NumStepsDropped.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	// on the legacy path, new input only arrives with each game frame's async input
+	if (!CVarAsyncVehicleInput.GetValueOnAnyThread() && &InputData != LastInputData)
+	{
+		LastInputData = &InputData;
+
+		// approximate: inputs issued after the game thread kicked physics are counted against this frame too
+		InputChannel->RecordLatency(InputChannel->LastIssueTime.load(std::memory_order_relaxed), FPlatformTime::Seconds());
+	}
+
+	UChaosWheeledVehicleSimulation::TickVehicle(WorldIn, DeltaTime, InputData, OutputData, Handle);
+
+	if (InputChannel->bTelemetryEnabled.load(std::memory_order_acquire))
+	{
+		CaptureTelemetry(WorldIn, OutputData, Handle);
+	}
+}
+
+void FFutureRacingVehicleSimulation::CaptureTelemetry(UWorld* WorldIn, const FChaosVehicleAsyncOutput& OutputData, const Chaos::FRigidBodyHandle_Internal* Handle)
+{
+	FUTURERACING_SCOPE_CYCLE_COUNTER(STAT_FutureRacingTelemetryCapture);
+
+	const uint64 StartCycles = FPlatformTime::Cycles64();
+
+	const FPhysicsVehicleOutput& VehicleOutput = OutputData.VehicleSimOutput;
+
+	FFutureRacingTelemetrySample Sample;
+	Sample.Time = WorldIn->GetPhysicsScene()->GetSolver()->GetSolverTime();
+	Sample.EngineRPM = VehicleOutput.EngineRPM;
+	Sample.Gear = VehicleOutput.CurrentGear;
+	Sample.Throttle = CurrentThrottle;
+	Sample.Brake = CurrentBrake;
+	Sample.Steering = CurrentSteering;
+	Sample.Handbrake = TargetInput.bHandbrake ? 1.0f : 0.0f;
+
+	if (Handle)
+	{
+		Sample.ForwardSpeed = FVector::DotProduct(Handle->V(), Handle->R().GetForwardVector());
+	}
+
+	const int32 NumWheels = FMath::Min(VehicleOutput.Wheels.Num(), FFutureRacingTelemetrySample::MaxWheels);
+
+	for (int32 WheelIndex = 0; WheelIndex < NumWheels; ++WheelIndex)
+	{
+		const FWheelsOutput& Wheel = VehicleOutput.Wheels[WheelIndex];
+
+		Sample.WheelSlipAngle[WheelIndex] = Wheel.SlipAngle;
+		Sample.WheelSlipMagnitude[WheelIndex] = Wheel.SlipMagnitude;
+		Sample.WheelSuspensionOffset[WheelIndex] = Wheel.SuspensionOffset;
+		Sample.WheelAngularVelocity[WheelIndex] = Wheel.AngularVelocity;
+	}
+
+	// a full ring buffer drops the sample rather than stalling physics
+	if (!InputChannel->TelemetryRing->Write(reinterpret_cast<const uint8*>(&Sample), sizeof(Sample)))
+	{
+		InputChannel->NumTelemetryDropped.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	InputChannel->NumTelemetrySamples.fetch_add(1, std::memory_order_relaxed);
+	InputChannel->TelemetryCaptureCycles.fetch_add(FPlatformTime::Cycles64() - StartCycles, std::memory_order_relaxed);
+}
+
+void FFutureRacingVehicleSimulation::ApplyInput(const FControlInputs& ControlInputs, float DeltaTime)
+{
+	// the queue was drained at the start of the substep, so only the latency is left to record
+	const bool bNewInput = bReceivedInput;
+	bReceivedInput = false;
+
+	if (!CVarAsyncVehicleInput.GetValueOnAnyThread())
+	{
+		// keep the rate limited values in sync so switching paths doesn't cause a jump
+		CurrentSteering = ControlInputs.SteeringInput;
+		CurrentThrottle = ControlInputs.ThrottleInput;
+		CurrentBrake = ControlInputs.BrakeInput;
+
+		UChaosWheeledVehicleSimulation::ApplyInput(ControlInputs, DeltaTime);
+		return;
+	}
+
+	if (bNewInput)
+	{
+		InputChannel->RecordLatency(TargetInput.IssueTime, FPlatformTime::Seconds());
+	}
+
+	// while in reverse gear the pedals swap roles, matching the game thread's reverse as brake logic.
+	// Gear selection itself still happens on the game thread
+	float TargetThrottle = TargetInput.Throttle;
+	float TargetBrake = TargetInput.Brake;
+
+	if (bReverseAsBrake && PVehicle && PVehicle->HasTransmission() && PVehicle->GetTransmission().GetCurrentGear() < 0)
+	{
+		Swap(TargetThrottle, TargetBrake);
+	}
+
+	// rate limit towards the targets at the physics rate
+	CurrentSteering = SteeringInputRate.InterpInputValue(DeltaTime, CurrentSteering, TargetInput.Steering);
+	CurrentThrottle = ThrottleInputRate.InterpInputValue(DeltaTime, CurrentThrottle, TargetThrottle);
+	CurrentBrake = BrakeInputRate.InterpInputValue(DeltaTime, CurrentBrake, TargetBrake);
+
+	FControlInputs SubstepInputs = ControlInputs;
+	SubstepInputs.SteeringInput = CurrentSteering;
+	SubstepInputs.ThrottleInput = CurrentThrottle;
+	SubstepInputs.BrakeInput = CurrentBrake;
+	SubstepInputs.HandbrakeInput = TargetInput.bHandbrake ? 1.0f : 0.0f;
+
+	UChaosWheeledVehicleSimulation::ApplyInput(SubstepInputs, DeltaTime);
+}
+
+void UFutureRacingVehicleMovementComponent::TickComponent(float DeltaTime, enum ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	// Blueprint drivers set the Chaos inputs without submitting them, and the queue is all physics reads
+	if (HasRawInputChanged())
+	{
+		SubmitInput();
+	}
+
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	// collect the steps simulated since last frame
+	FFutureRacingPhysicsStep Step;
+
+	// the local driver's input changes are timed all the way to the screen
+	UFutureRacingInputLatencySubsystem* InputLatency = PawnOwner && PawnOwner->IsLocallyControlled() ? GetWorld()->GetSubsystem<UFutureRacingInputLatencySubsystem>() : nullptr;
+
+	while (InputChannel->StepRing->Read(reinterpret_cast<uint8*>(&Step), sizeof(Step)))
+	{
+		RecentSteps.Add(Step);
+
+		if (InputLatency && Step.bNewInput && Step.Input.bChanged)
+		{
+			InputLatency->RecordInputApplied(Step);
+		}
+	}
+
+	// a long hitch can outrun the ring buffer, which leaves a gap in the step indices
+	if (const int64 NumDropped = InputChannel->NumStepsDropped.exchange(0, std::memory_order_relaxed))
+	{
+		UE_LOG(LogFutureRacing, Warning, TEXT("%s dropped %lld physics steps."), *GetNameSafe(GetOwner()), NumDropped);
+	}
+
+	// only keep the newest ones around
+	if (RecentSteps.Num() > MaxRecentSteps)
+	{
+		RecentSteps.RemoveAt(0, RecentSteps.Num() - MaxRecentSteps, EAllowShrinking::No);
+	}
+}
+
+void UFutureRacingVehicleMovementComponent::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DISABLE_REPLICATED_PRIVATE_PROPERTY(UChaosVehicleMovementComponent, ReplicatedState);
+}
+
+int32 UFutureRacingVehicleMovementComponent::GetFunctionCallspace(UFunction* Function, FFrame* Stack)
+{
+	// the stock path sends every frame's processed input reliably and overwrites the server's copy with it
+	static const FName ServerUpdateStateName(TEXT("ServerUpdateState"));
+
+	if (Function && Function->GetFName() == ServerUpdateStateName)
+	{
+		return FunctionCallspace::Absorbed;
+	}
+
+	return Super::GetFunctionCallspace(Function, Stack);
+}
+
+void UFutureRacingVehicleMovementComponent::OnRegister()
+{
+	Super::OnRegister();
+
+	bConfiguredRequiresControllerForInputs = bRequiresControllerForInputs;
+}
+
+void UFutureRacingVehicleMovementComponent::UpdateState(float DeltaTime)
+{
+	// the net component sets the raw inputs of remote pawns on the server, so process them like a local pawn's.
+	// Otherwise Chaos would copy them, and the target gear, out of a replicated state that's never filled in
+	const bool bRemotePawnOnServer = GetOwnerRole() == ROLE_Authority && PawnOwner && !PawnOwner->IsLocallyControlled();
+
+	bRequiresControllerForInputs = bRemotePawnOnServer ? false : bConfiguredRequiresControllerForInputs;
+
+	Super::UpdateState(DeltaTime);
+}
+
+void UFutureRacingVehicleMovementComponent::SubmitInput()
+{
+	// nothing drains the queue while the vehicle simulation is torn down
+	if (!VehicleSimulationPT)
+	{
+		return;
+	}
+
+	FFutureRacingTimedInput Input = GetRawInput();
+
+	// time from the input event if there was one, from now otherwise
+	Input.EventTime = PendingEventTime > 0.0 ? PendingEventTime : Input.IssueTime;
+	PendingEventTime = 0.0;
+
+	Input.bChanged = HasRawInputChanged();
+
+	Input.Sequence = ++NumInputsSubmitted;
+	Input.ApplyAtStep = InputStep;
+
+	LastSubmittedInput = Input;
+
+	InputChannel->LastIssueTime.store(Input.IssueTime, std::memory_order_relaxed);
+	InputChannel->Queue.Enqueue(Input);
+}
+
+void UFutureRacingVehicleMovementComponent::StampInputEvent()
+{
+	// keep the oldest stamp if several events lead to one submission
+	if (PendingEventTime <= 0.0)
+	{
+		PendingEventTime = FPlatformTime::Seconds();
+	}
+}
+
+FFutureRacingTimedInput UFutureRacingVehicleMovementComponent::GetRawInput() const
+{
+	FFutureRacingTimedInput Input;
+	Input.IssueTime = FPlatformTime::Seconds();
+	Input.Steering = RawSteeringInput;
+	Input.Throttle = RawThrottleInput;
+	Input.Brake = RawBrakeInput;
+	Input.bHandbrake = bRawHandbrakeInput;
+
+	return Input;
+}
+
+bool UFutureRacingVehicleMovementComponent::HasRawInputChanged() const
+{
+	return RawSteeringInput != LastSubmittedInput.Steering
+		|| RawThrottleInput != LastSubmittedInput.Throttle
+		|| RawBrakeInput != LastSubmittedInput.Brake
+		|| bRawHandbrakeInput != LastSubmittedInput.bHandbrake;
+}
+
+FFutureRacingInputLatencyStats UFutureRacingVehicleMovementComponent::GetInputLatencyStats() const
+{
+	FFutureRacingInputLatencyStats Stats;
+	Stats.NumInputs = InputChannel->NumInputs.load(std::memory_order_relaxed);
+	Stats.NumSubsteps = InputChannel->NumSubsteps.load(std::memory_order_relaxed);
+	Stats.MaxMs = InputChannel->MaxLatencyMicroseconds.load(std::memory_order_relaxed) / 1000.0;
+
+	if (Stats.NumInputs > 0)
+	{
+		Stats.AverageMs = InputChannel->TotalLatencyMicroseconds.load(std::memory_order_relaxed) / 1000.0 / Stats.NumInputs;
+	}
+
+	return Stats;
+}
+
+void UFutureRacingVehicleMovementComponent::ResetInputLatencyStats()
+{
+	InputChannel->NumInputs.store(0, std::memory_order_relaxed);
+	InputChannel->TotalLatencyMicroseconds.store(0, std::memory_order_relaxed);
+	InputChannel->MaxLatencyMicroseconds.store(0, std::memory_order_relaxed);
+	InputChannel->NumSubsteps.store(0, std::memory_order_relaxed);
+}
+
+TUniquePtr<Chaos::FSimpleWheeledVehicle> UFutureRacingVehicleMovementComponent::CreatePhysicsVehicle()
+{
+	LLM_SCOPE_BYTAG(FutureRacing_Vehicles);
+
+	// make our vehicle simulation, to be updated from the physics thread async callback
+	VehicleSimulationPT = MakeUnique<FFutureRacingVehicleSimulation>(InputChannel, *this);
+
+	// skip the wheeled component's version, which would replace our simulation with the default one
+	return UChaosVehicleMovementComponent::CreatePhysicsVehicle();
+}
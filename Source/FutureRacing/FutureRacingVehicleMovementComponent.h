@@ -0,0 +1,287 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ChaosWheeledVehicleMovementComponent.h"
+#include "Containers/Queue.h"
+#include <atomic>
+#include "FutureRacingVehicleMovementComponent.generated.h"
+
+class FFutureRacingByteRingBuffer;
+
+/**
+ *  Vehicle control input, stamped with the time it was issued on the game thread
+ */
+struct FFutureRacingTimedInput
+{
+	/** Platform time the input was issued at, in seconds */
+	double IssueTime = 0.0;
+
+	/** Platform time the Enhanced Input event behind the input was handled at. Same as IssueTime for other sources */
+	double EventTime = 0.0;
+
+	/** Number of inputs the vehicle had submitted up to and including this one */
+	int64 Sequence = 0;
+
+	/** Physics step the input is held back until. INDEX_NONE applies it on the next step */
+	int64 ApplyAtStep = INDEX_NONE;
+
+	/** If true, the input differs from the one submitted before it */
+	bool bChanged = false;
+
+	float Steering = 0.0f;
+	float Throttle = 0.0f;
+	float Brake = 0.0f;
+	bool bHandbrake = false;
+};
+
+/**
+ *  Input latency measurements, gathered on the physics thread
+ */
+struct FFutureRacingInputLatencyStats
+{
+	/** Number of inputs that reached the physics thread */
+	int64 NumInputs = 0;
+
+	/** Average time from issue to the first physics substep that applied the input */
+	double AverageMs = 0.0;
+
+	/** Worst time from issue to the first physics substep that applied the input */
+	double MaxMs = 0.0;
+
+	/** Number of physics substeps simulated */
+	int64 NumSubsteps = 0;
+};
+
+/**
+ *  Vehicle body state at the start of a physics step, captured on the physics thread
+ */
+struct FFutureRacingPhysicsStep
+{
+	/** Number of physics steps this vehicle had simulated before this one */
+	int64 StepIndex = 0;
+
+	/** Physics solver time at the start of the step, in seconds */
+	double Time = 0.0;
+
+	/** World space body location */
+	FVector Location = FVector::ZeroVector;
+
+	/** World space body rotation */
+	FQuat Rotation = FQuat::Identity;
+
+	/** World space linear velocity */
+	FVector LinearVelocity = FVector::ZeroVector;
+
+	/** Latest input target the step was simulated with */
+	FFutureRacingTimedInput Input;
+
+	/** Platform time the step started at, in seconds */
+	double PlatformTime = 0.0;
+
+	/** If true, this is the first step to simulate with Input */
+	bool bNewInput = false;
+};
+
+/**
+ *  Game thread to physics thread input channel.
+ *  Shared between the movement component and its physics thread simulation,
+ *  so either side can outlive the other.
+ */
+struct FFutureRacingInputChannel
+{
+	/** Inputs waiting to be applied. Produced on the game thread, consumed on the physics thread */
+	TQueue<FFutureRacingTimedInput, EQueueMode::Spsc> Queue;
+
+	/** Issue time of the latest input, for measuring the legacy path */
+	std::atomic<double> LastIssueTime { 0.0 };
+
+	/** Number of physics steps the step ring buffer holds. The game thread drains it every frame */
+	static constexpr int32 StepRingCapacity = 256;
+
+	/**
+	 *  Body state for every physics step, as raw FFutureRacingPhysicsStep structs.
+	 *  Produced on the physics thread, consumed on the game thread. Fixed size, so publishing a step never allocates
+	 */
+	TUniquePtr<FFutureRacingByteRingBuffer> StepRing;
+
+	/** Number of physics steps dropped because the game thread fell too far behind, since it last checked */
+	std::atomic<int64> NumStepsDropped { 0 };
+
+	/** Number of physics steps published so far. Never reset, so step indices stay unique */
+	std::atomic<int64> NumStepsPublished { 0 };
+
+	/** Latency accumulators, written on the physics thread */
+	std::atomic<int64> NumInputs { 0 };
+	std::atomic<int64> TotalLatencyMicroseconds { 0 };
+	std::atomic<int64> MaxLatencyMicroseconds { 0 };
+	std::atomic<int64> NumSubsteps { 0 };
+
+	/** Telemetry samples. Produced on the physics thread while telemetry is enabled, consumed by the telemetry writer */
+	TUniquePtr<FFutureRacingByteRingBuffer> TelemetryRing;
+
+	/** If true, the physics thread captures a telemetry sample every substep */
+	std::atomic<bool> bTelemetryEnabled { false };
+
+	/** Telemetry accumulators, written on the physics thread */
+	std::atomic<int64> NumTelemetrySamples { 0 };
+	std::atomic<int64> NumTelemetryDropped { 0 };
+	std::atomic<int64> TelemetryCaptureCycles { 0 };
+
+	FFutureRacingInputChannel();
+	~FFutureRacingInputChannel();
+
+	/** Records the latency of an input applied on the physics thread */
+	void RecordLatency(double IssueTime, double ApplyTime);
+
+	/**
+	 *  Starts capturing telemetry. Game thread only.
+	 *  The ring buffer is made on first use and kept until the channel goes away, since the physics thread may still be writing to it
+	 */
+	void EnableTelemetry(int32 RingCapacity);
+
+	/** Stops capturing telemetry. Samples already captured stay in the ring buffer */
+	void DisableTelemetry();
+};
+
+/**
+ *  Physics thread vehicle simulation.
+ *  Drains the timestamped input queue on every physics substep, so steering,
+ *  throttle and brake follow the physics rate instead of the game frame rate.
+ *  That needs async physics at a fixed step (bTickPhysicsAsync in DefaultEngine.ini), otherwise there's one substep per frame.
+ */
+class FFutureRacingVehicleSimulation : public UChaosWheeledVehicleSimulation
+{
+public:
+
+	FFutureRacingVehicleSimulation(const TSharedRef<FFutureRacingInputChannel, ESPMode::ThreadSafe>& InInputChannel, const UChaosWheeledVehicleMovementComponent& Component);
+
+	virtual void TickVehicle(UWorld* WorldIn, float DeltaTime, const FChaosVehicleAsyncInput& InputData, FChaosVehicleAsyncOutput& OutputData, Chaos::FRigidBodyHandle_Internal* Handle) override;
+
+	virtual void ApplyInput(const FControlInputs& ControlInputs, float DeltaTime) override;
+
+protected:
+
+	/** Writes a telemetry sample for the substep just simulated into the ring buffer */
+	void CaptureTelemetry(UWorld* WorldIn, const FChaosVehicleAsyncOutput& OutputData, const Chaos::FRigidBodyHandle_Internal* Handle);
+
+	/** Shared input channel */
+	TSharedRef<FFutureRacingInputChannel, ESPMode::ThreadSafe> InputChannel;
+
+	/** Input rate configs copied from the component */
+	FVehicleInputRateConfig SteeringInputRate;
+	FVehicleInputRateConfig ThrottleInputRate;
+	FVehicleInputRateConfig BrakeInputRate;
+
+	/** If true, the brake drives the car backwards while in reverse gear */
+	bool bReverseAsBrake = true;
+
+	/** Latest input target drained from the queue */
+	FFutureRacingTimedInput TargetInput;
+
+	/** If true, TargetInput was replaced this substep and its latency hasn't been recorded yet */
+	bool bReceivedInput = false;
+
+	/** Rate limited inputs applied on the last substep */
+	float CurrentSteering = 0.0f;
+	float CurrentThrottle = 0.0f;
+	float CurrentBrake = 0.0f;
+
+	/** Game thread input struct seen on the last substep, used to detect new frames on the legacy path */
+	const FChaosVehicleAsyncInput* LastInputData = nullptr;
+};
+
+/**
+ *  Chaos wheeled movement component that forwards control input
+ *  to the async physics thread through a timestamped queue.
+ */
+UCLASS()
+class UFutureRacingVehicleMovementComponent : public UChaosWheeledVehicleMovementComponent
+{
+	GENERATED_BODY()
+
+protected:
+
+	/** Input channel shared with the physics thread simulation */
+	TSharedRef<FFutureRacingInputChannel, ESPMode::ThreadSafe> InputChannel = MakeShared<FFutureRacingInputChannel, ESPMode::ThreadSafe>();
+
+	/** Most recent physics steps, oldest first */
+	TArray<FFutureRacingPhysicsStep> RecentSteps;
+
+	/** Maximum number of physics steps kept in RecentSteps */
+	static constexpr int32 MaxRecentSteps = 64;
+
+	/** Platform time of the first input event not submitted yet. Zero if there is none */
+	double PendingEventTime = 0.0;
+
+	/** Last input sent to the physics thread */
+	FFutureRacingTimedInput LastSubmittedInput;
+
+	/** Number of inputs sent to the physics thread so far */
+	int64 NumInputsSubmitted = 0;
+
+	/** Physics step the inputs submitted next are held back until. INDEX_NONE if they aren't */
+	int64 InputStep = INDEX_NONE;
+
+	/** bRequiresControllerForInputs as configured, since UpdateState overrides it for remote pawns on the server */
+	bool bConfiguredRequiresControllerForInputs = true;
+
+public:
+
+	/** Leaves the Chaos replicated state out, vehicles replicate through their net component instead */
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
+	/** Swallows the stock ServerUpdateState RPC, so the net component is the only path input takes to the server */
+	virtual int32 GetFunctionCallspace(UFunction* Function, FFrame* Stack) override;
+
+	/** Remembers how inputs were configured to be processed */
+	virtual void OnRegister() override;
+
+	/** Submits raw inputs set without SubmitInput, then collects the physics steps simulated since the last frame */
+	virtual void TickComponent(float DeltaTime, enum ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+	/**
+	 *  Returns the most recent physics steps, oldest first.
+	 *  Readers should remember the last StepIndex they processed, since steps stay in here for several frames.
+	 */
+	const TArray<FFutureRacingPhysicsStep>& GetRecentSteps() const { return RecentSteps; }
+
+	/** Returns the number of physics steps collected on the game thread so far */
+	int64 GetNumStepsSeen() const { return RecentSteps.Num() > 0 ? RecentSteps.Last().StepIndex + 1 : 0; }
+
+	/** Sends the current raw inputs to the physics thread. Call after setting any input, or they go out with the next tick */
+	void SubmitInput();
+
+	/** Returns the number of inputs sent to the physics thread so far. The next one submitted is numbered one higher */
+	int64 GetNumInputsSubmitted() const { return NumInputsSubmitted; }
+
+	/** Holds the inputs submitted from now on back until the physics step with this index, for replays. INDEX_NONE stops holding them */
+	void SetInputStep(int64 StepIndex) { InputStep = StepIndex; }
+
+	/** Stamps the input submitted next with the current time, as the time its input event was handled. Call from input event handlers */
+	void StampInputEvent();
+
+	/** Returns the current raw inputs, stamped with the current platform time */
+	FFutureRacingTimedInput GetRawInput() const;
+
+	/** Returns true if the raw inputs differ from the last ones sent to the physics thread */
+	bool HasRawInputChanged() const;
+
+	/** Returns the input latency measured so far */
+	FFutureRacingInputLatencyStats GetInputLatencyStats() const;
+
+	/** Clears the input latency measurements */
+	void ResetInputLatencyStats();
+
+	/** Returns the channel shared with the physics thread simulation */
+	const TSharedRef<FFutureRacingInputChannel, ESPMode::ThreadSafe>& GetInputChannel() const { return InputChannel; }
+
+protected:
+
+	/** Creates our physics thread simulation */
+	virtual TUniquePtr<Chaos::FSimpleWheeledVehicle> CreatePhysicsVehicle() override;
+
+	/** Processes the raw inputs of remote pawns on the server, instead of copying the replicated state nothing sends any more */
+	virtual void UpdateState(float DeltaTime) override;
+};
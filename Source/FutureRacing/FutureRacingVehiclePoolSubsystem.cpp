@@ -0,0 +1,224 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "FutureRacingVehiclePoolSubsystem.h"
+#include "FutureRacingPawn.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTime.h"
+#include "FutureRacing.h"
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Vehicle Pool Hits"), STAT_FutureRacingVehiclePoolHits, STATGROUP_FutureRacing);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Vehicle Pool Misses"), STAT_FutureRacingVehiclePoolMisses, STATGROUP_FutureRacing);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Dormant Vehicles"), STAT_FutureRacingDormantVehicles, STATGROUP_FutureRacing);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Last Respawn (ms)"), STAT_FutureRacingLastRespawnMs, STATGROUP_FutureRacing);
+
+static FAutoConsoleCommandWithWorld DumpVehiclePoolCommand(
+	TEXT("FutureRacing.Pool.Dump"),
+	TEXT("Logs the vehicle pool hit rate and respawn latency for the current world."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (UFutureRacingVehiclePoolSubsystem* Pool = World ? World->GetSubsystem<UFutureRacingVehiclePoolSubsystem>() : nullptr)
+		{
+			const FFutureRacingVehiclePoolStats& Stats = Pool->GetStats();
+
+			UE_LOG(LogFutureRacing, Display, TEXT("Vehicle pool: %d hits, %d misses (%.0f%% hit rate), respawn avg %.2fms, max %.2fms"),
+				Stats.Hits, Stats.Misses, Stats.GetHitRate() * 100.0f, Stats.AverageRespawnMs, Stats.MaxRespawnMs);
+		}
+	}));
+
+void UFutureRacingVehiclePoolSubsystem::Prewarm(TSubclassOf<AFutureRacingPawn> VehicleClass, int32 Count)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE_ON_CHANNEL(UFutureRacingVehiclePoolSubsystem::Prewarm, FutureRacingChannel);
+	LLM_SCOPE_BYTAG(FutureRacing_Vehicles);
+
+	if (!VehicleClass)
+	{
+		return;
+	}
+
+	FFutureRacingVehiclePool& Pool = Pools.FindOrAdd(VehicleClass);
+	Pool.TargetSize = FMath::Max(Pool.TargetSize, Count);
+
+	while (Pool.Dormant.Num() < Pool.TargetSize)
+	{
+		AFutureRacingPawn* Vehicle = SpawnDormant(VehicleClass);
+
+		if (!Vehicle)
+		{
+			break;
+		}
+
+		Pool.Dormant.Add(Vehicle);
+		INC_DWORD_STAT(STAT_FutureRacingDormantVehicles);
+	}
+}
+
+AFutureRacingPawn* UFutureRacingVehiclePoolSubsystem::Acquire(TSubclassOf<AFutureRacingPawn> VehicleClass, const FTransform& SpawnTransform)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE_ON_CHANNEL(UFutureRacingVehiclePoolSubsystem::Acquire, FutureRacingChannel);
+	LLM_SCOPE_BYTAG(FutureRacing_Vehicles);
+
+	if (!VehicleClass)
+	{
+		return nullptr;
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+
+	// take the most recently parked vehicle, skipping any destroyed behind our back
+	if (FFutureRacingVehiclePool* Pool = Pools.Find(VehicleClass))
+	{
+		while (Pool->Dormant.Num() > 0)
+		{
+			AFutureRacingPawn* Vehicle = Pool->Dormant.Pop(EAllowShrinking::No);
+			DEC_DWORD_STAT(STAT_FutureRacingDormantVehicles);
+
+			if (!IsValid(Vehicle))
+			{
+				continue;
+			}
+
+			// move to the spawn point before waking up, so physics starts there
+			Vehicle->SetActorTransform(SpawnTransform, false, nullptr, ETeleportType::ResetPhysics);
+			Vehicle->SetDormant(false);
+
+			RecordRespawn(StartTime, true);
+
+			return Vehicle;
+		}
+	}
+
+	// pool miss, spawn a new vehicle the slow way. The pool is only topped up at safe points
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
+
+	AFutureRacingPawn* Vehicle = GetWorld()->SpawnActor<AFutureRacingPawn>(VehicleClass, SpawnTransform, SpawnParams);
+
+	RecordRespawn(StartTime, false);
+
+	return Vehicle;
+}
+
+void UFutureRacingVehiclePoolSubsystem::Release(AFutureRacingPawn* Vehicle)
+{
+	if (!IsValid(Vehicle))
+	{
+		return;
+	}
+
+	if (Vehicle->IsDormant())
+	{
+		return;
+	}
+
+	// let go of the vehicle
+	AController* Controller = Vehicle->GetController();
+
+	if (Controller)
+	{
+		Controller->UnPossess();
+	}
+
+	Vehicle->SetDormant(true);
+	Vehicle->SetActorLocation(ParkingLocation, false, nullptr, ETeleportType::ResetPhysics);
+
+	Pools.FindOrAdd(Vehicle->GetClass()).Dormant.Add(Vehicle);
+	INC_DWORD_STAT(STAT_FutureRacingDormantVehicles);
+
+	// let the controller respawn now that the vehicle is back in the pool
+	OnVehicleReleased.Broadcast(Vehicle, Controller);
+}
+
+void UFutureRacingVehiclePoolSubsystem::Refill()
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE_ON_CHANNEL(UFutureRacingVehiclePoolSubsystem::Refill, FutureRacingChannel);
+	LLM_SCOPE_BYTAG(FutureRacing_Vehicles);
+
+	// replace vehicles that were destroyed outright or handed out on a pool miss
+	for (TPair<TObjectPtr<UClass>, FFutureRacingVehiclePool>& Pair : Pools)
+	{
+		FFutureRacingVehiclePool& Pool = Pair.Value;
+
+		// drop any destroyed behind our back first, so they're replaced too
+		const int32 NumRemoved = Pool.Dormant.RemoveAll([](const TObjectPtr<AFutureRacingPawn>& Vehicle) { return !IsValid(Vehicle); });
+		DEC_DWORD_STAT_BY(STAT_FutureRacingDormantVehicles, NumRemoved);
+
+		while (Pool.Dormant.Num() < Pool.TargetSize)
+		{
+			AFutureRacingPawn* Vehicle = SpawnDormant(Pair.Key);
+
+			if (!Vehicle)
+			{
+				break;
+			}
+
+			Pool.Dormant.Add(Vehicle);
+			INC_DWORD_STAT(STAT_FutureRacingDormantVehicles);
+		}
+	}
+}
+
+int32 UFutureRacingVehiclePoolSubsystem::GetNumDormant(TSubclassOf<AFutureRacingPawn> VehicleClass) const
+{
+	const FFutureRacingVehiclePool* Pool = Pools.Find(VehicleClass);
+
+	return Pool ? Pool->Dormant.Num() : 0;
+}
+
+void UFutureRacingVehiclePoolSubsystem::Deinitialize()
+{
+	for (const TPair<TObjectPtr<UClass>, FFutureRacingVehiclePool>& Pair : Pools)
+	{
+		DEC_DWORD_STAT_BY(STAT_FutureRacingDormantVehicles, Pair.Value.Dormant.Num());
+	}
+
+	Pools.Empty();
+
+	Super::Deinitialize();
+}
+
+AFutureRacingPawn* UFutureRacingVehiclePoolSubsystem::SpawnDormant(UClass* VehicleClass)
+{
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+	AFutureRacingPawn* Vehicle = GetWorld()->SpawnActor<AFutureRacingPawn>(VehicleClass, FTransform(ParkingLocation), SpawnParams);
+
+	if (Vehicle)
+	{
+		Vehicle->SetDormant(true);
+
+	} else {
+
+		UE_LOG(LogFutureRacing, Warning, TEXT("Vehicle pool could not spawn '%s'."), *GetNameSafe(VehicleClass));
+	}
+
+	return Vehicle;
+}
+
+void UFutureRacingVehiclePoolSubsystem::RecordRespawn(double StartTime, bool bHit)
+{
+	const double ElapsedMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+	if (bHit)
+	{
+		++Stats.Hits;
+		INC_DWORD_STAT(STAT_FutureRacingVehiclePoolHits);
+
+	} else {
+
+		++Stats.Misses;
+		INC_DWORD_STAT(STAT_FutureRacingVehiclePoolMisses);
+	}
+
+	INC_DWORD_STAT(STAT_FutureRacingRespawns);
+
+	TotalRespawnMs += ElapsedMs;
+	Stats.AverageRespawnMs = TotalRespawnMs / (Stats.Hits + Stats.Misses);
+	Stats.MaxRespawnMs = FMath::Max(Stats.MaxRespawnMs, ElapsedMs);
+
+	SET_FLOAT_STAT(STAT_FutureRacingLastRespawnMs, ElapsedMs);
+
+	UE_LOG(LogFutureRacing, Verbose, TEXT("Vehicle respawn %s in %.2fms"), bHit ? TEXT("from pool") : TEXT("spawned"), ElapsedMs);
+}
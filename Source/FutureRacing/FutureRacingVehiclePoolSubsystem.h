@@ -0,0 +1,115 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "FutureRacingVehiclePoolSubsystem.generated.h"
+
+class AFutureRacingPawn;
+class AController;
+
+DECLARE_MULTICAST_DELEGATE_TwoParams(FVehicleReleasedDelegate, AFutureRacingPawn* /*Vehicle*/, AController* /*FormerController*/);
+
+/**
+ *  Vehicle pool measurements
+ */
+struct FFutureRacingVehiclePoolStats
+{
+	/** Number of acquires served from the pool */
+	int32 Hits = 0;
+
+	/** Number of acquires that had to spawn a new vehicle */
+	int32 Misses = 0;
+
+	/** Average time taken to hand out a vehicle */
+	double AverageRespawnMs = 0.0;
+
+	/** Worst time taken to hand out a vehicle */
+	double MaxRespawnMs = 0.0;
+
+	/** Returns the fraction of acquires served from the pool */
+	float GetHitRate() const { return Hits + Misses > 0 ? static_cast<float>(Hits) / (Hits + Misses) : 0.0f; }
+};
+
+/**
+ *  Dormant vehicles of a single class
+ */
+USTRUCT()
+struct FFutureRacingVehiclePool
+{
+	GENERATED_BODY()
+
+	/** Vehicles waiting to be handed out */
+	UPROPERTY()
+	TArray<TObjectPtr<AFutureRacingPawn>> Dormant;
+
+	/** Number of dormant vehicles to keep around */
+	int32 TargetSize = 0;
+};
+
+/**
+ *  Per world pool of pre-warmed vehicle pawns.
+ *  Respawns take a dormant vehicle and wake it up instead of building a new
+ *  skeletal mesh, camera rig and physics body mid race. Vehicles taken out of play are
+ *  released back into the pool rather than destroyed, so the pool doesn't run dry.
+ *  The pool itself only spawns at safe points: Prewarm at load time and Refill at race start.
+ */
+UCLASS(Config="Game")
+class UFutureRacingVehiclePoolSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+protected:
+
+	/** Location dormant vehicles are parked at */
+	UPROPERTY(Config)
+	FVector ParkingLocation = FVector(0.0f, 0.0f, -50000.0f);
+
+	/** Dormant vehicles per class */
+	UPROPERTY()
+	TMap<TObjectPtr<UClass>, FFutureRacingVehiclePool> Pools;
+
+	/** Measurements */
+	FFutureRacingVehiclePoolStats Stats;
+
+	/** Total time spent handing out vehicles */
+	double TotalRespawnMs = 0.0;
+
+public:
+
+	/** Makes sure at least Count dormant vehicles of a class are ready. Call at load time */
+	void Prewarm(TSubclassOf<AFutureRacingPawn> VehicleClass, int32 Count);
+
+	/** Takes a vehicle out of the pool and places it, spawning a new one if the pool is empty */
+	AFutureRacingPawn* Acquire(TSubclassOf<AFutureRacingPawn> VehicleClass, const FTransform& SpawnTransform);
+
+	/** Puts a vehicle to sleep and returns it to the pool. Its controller is told through OnVehicleReleased */
+	void Release(AFutureRacingPawn* Vehicle);
+
+	/** Tops every pool back up to its target size. Spawns vehicles, so only call at safe points like race start */
+	void Refill();
+
+	/** Called after a vehicle is released, with the controller it had, so the controller can respawn */
+	FVehicleReleasedDelegate OnVehicleReleased;
+
+	/** Returns the pool measurements */
+	const FFutureRacingVehiclePoolStats& GetStats() const { return Stats; }
+
+	/** Returns the number of dormant vehicles of a class */
+	int32 GetNumDormant(TSubclassOf<AFutureRacingPawn> VehicleClass) const;
+
+	// Begin UWorldSubsystem interface
+
+	virtual void Deinitialize() override;
+
+	// End UWorldSubsystem interface
+
+protected:
+
+	/** Spawns a vehicle straight into the dormant state */
+	AFutureRacingPawn* SpawnDormant(UClass* VehicleClass);
+
+	/** Records the time taken to hand out a vehicle */
+	void RecordRespawn(double StartTime, bool bHit);
+};
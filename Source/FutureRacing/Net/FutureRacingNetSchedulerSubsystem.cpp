@@ -0,0 +1,213 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "FutureRacingNetSchedulerSubsystem.h"
+#include "FutureRacingPawn.h"
+#include "FutureRacingVehicleNetComponent.h"
+#include "FutureRacingTrackProgressSubsystem.h"
+#include "Engine/NetConnection.h"
+#include "Engine/NetDriver.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "FutureRacing.h"
+
+DECLARE_CYCLE_STAT(TEXT("Net Scheduling"), STAT_FutureRacingNetScheduling, STATGROUP_FutureRacing);
+
+void UFutureRacingNetSchedulerSubsystem::RegisterVehicle(AFutureRacingPawn* Vehicle)
+{
+	if (!Vehicle || !Vehicle->GetNetComponent() || Vehicles.Contains(Vehicle))
+	{
+		return;
+	}
+
+	Vehicles.Add(Vehicle);
+}
+
+void UFutureRacingNetSchedulerSubsystem::UnregisterVehicle(AFutureRacingPawn* Vehicle)
+{
+	Vehicles.RemoveSwap(Vehicle);
+}
+
+uint32 UFutureRacingNetSchedulerSubsystem::GetSendIntervalMs(EFutureRacingNetTier Tier) const
+{
+	switch (Tier)
+	{
+	case EFutureRacingNetTier::Reduced:
+		return ReducedRate > 0.0f ? FMath::RoundToInt(1000.0f / ReducedRate) : 0;
+
+	case EFutureRacingNetTier::Distant:
+		return DistantRate > 0.0f ? FMath::RoundToInt(1000.0f / DistantRate) : 0;
+
+	case EFutureRacingNetTier::Sparse:
+		return FMath::Max(FMath::RoundToInt(SparseInterval * 1000.0f), 0);
+
+	default:
+		return 0;
+	}
+}
+
+float UFutureRacingNetSchedulerSubsystem::GetPriorityScale(EFutureRacingNetTier Tier) const
+{
+	const int32 TierIndex = static_cast<int32>(Tier);
+
+	return TierPriorityScales.IsValidIndex(TierIndex) ? TierPriorityScales[TierIndex] : 1.0f;
+}
+
+void UFutureRacingNetSchedulerSubsystem::RecordSnapshotSent(const UNetConnection* Connection, int64 NumBits)
+{
+	FFutureRacingNetConnectionStats& Stats = ConnectionStats.FindOrAdd(Connection);
+	Stats.NumBitsSent += NumBits;
+	++Stats.NumSnapshots;
+}
+
+const FFutureRacingNetConnectionStats* UFutureRacingNetSchedulerSubsystem::GetConnectionStats(const UNetConnection* Connection) const
+{
+	return ConnectionStats.Find(Connection);
+}
+
+void UFutureRacingNetSchedulerSubsystem::ResetConnectionStats()
+{
+	for (TPair<TObjectKey<const UNetConnection>, FFutureRacingNetConnectionStats>& Pair : ConnectionStats)
+	{
+		Pair.Value.NumBitsSent = 0;
+		Pair.Value.NumSnapshots = 0;
+	}
+}
+
+bool UFutureRacingNetSchedulerSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	// only needed where vehicles actually race
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UFutureRacingNetSchedulerSubsystem::Tick(float DeltaTime)
+{
+	// only servers send snapshots
+	const ENetMode NetMode = GetWorld()->GetNetMode();
+
+	if (NetMode == NM_Standalone || NetMode == NM_Client)
+	{
+		return;
+	}
+
+	UpdateCountdown -= DeltaTime;
+
+	if (UpdateCountdown <= 0.0f)
+	{
+		UpdateCountdown = FMath::Max(UpdateInterval, 0.05f);
+		UpdateTiers();
+	}
+}
+
+TStatId UFutureRacingNetSchedulerSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UFutureRacingNetSchedulerSubsystem, STATGROUP_Tickables);
+}
+
+void UFutureRacingNetSchedulerSubsystem::UpdateTiers()
+{
+	FUTURERACING_SCOPE_CYCLE_COUNTER(STAT_FutureRacingNetScheduling);
+
+	const UNetDriver* NetDriver = GetWorld()->GetNetDriver();
+
+	if (!NetDriver)
+	{
+		return;
+	}
+
+	const UFutureRacingTrackProgressSubsystem* TrackProgress = GetWorld()->GetSubsystem<UFutureRacingTrackProgressSubsystem>();
+
+	// drop any vehicles destroyed without unregistering, and forget the last ranking
+	for (int32 Index = Vehicles.Num() - 1; Index >= 0; --Index)
+	{
+		if (AFutureRacingPawn* Vehicle = Vehicles[Index].Get())
+		{
+			Vehicle->GetNetComponent()->ResetConnectionTiers();
+
+		} else {
+
+			Vehicles.RemoveAtSwap(Index);
+		}
+	}
+
+	// forget connections that went away
+	TMap<TObjectKey<const UNetConnection>, FFutureRacingNetConnectionStats> PreviousStats = MoveTemp(ConnectionStats);
+	ConnectionStats.Reset();
+
+	for (UNetConnection* Connection : NetDriver->ClientConnections)
+	{
+		const APlayerController* PC = Connection ? Connection->PlayerController.Get() : nullptr;
+
+		if (!PC)
+		{
+			continue;
+		}
+
+		FFutureRacingNetConnectionStats& Stats = ConnectionStats.Add(Connection, PreviousStats.FindRef(Connection));
+		FMemory::Memzero(Stats.NumVehiclesPerTier);
+
+		// rank from the player's camera, relative to their own vehicle if they have one
+		FVector ViewLocation;
+		FRotator ViewRotation;
+		PC->GetPlayerViewPoint(ViewLocation, ViewRotation);
+
+		const AFutureRacingPawn* ViewerVehicle = Cast<AFutureRacingPawn>(PC->GetPawn());
+		const int32 ViewerPosition = TrackProgress && ViewerVehicle ? TrackProgress->GetRacePosition(ViewerVehicle) : 0;
+
+		for (const TWeakObjectPtr<AFutureRacingPawn>& WeakVehicle : Vehicles)
+		{
+			AFutureRacingPawn* Vehicle = WeakVehicle.Get();
+
+			if (Vehicle->IsDormant())
+			{
+				continue;
+			}
+
+			const EFutureRacingNetTier Tier = RankVehicle(Vehicle, ViewerVehicle, ViewLocation, ViewRotation.Vector(), ViewerPosition);
+
+			Vehicle->GetNetComponent()->SetConnectionTier(Connection, Tier, GetSendIntervalMs(Tier));
+			++Stats.NumVehiclesPerTier[static_cast<int32>(Tier)];
+		}
+	}
+}
+
+EFutureRacingNetTier UFutureRacingNetSchedulerSubsystem::RankVehicle(const AFutureRacingPawn* Vehicle, const AFutureRacingPawn* ViewerVehicle, const FVector& ViewLocation, const FVector& ViewDirection, int32 ViewerPosition) const
+{
+	// our own vehicle needs every snapshot to reconcile against
+	if (Vehicle == ViewerVehicle)
+	{
+		return EFutureRacingNetTier::Full;
+	}
+
+	const FVector ToVehicle = Vehicle->GetActorLocation() - ViewLocation;
+	const double Distance = ToVehicle.Size();
+
+	const bool bInView = Distance <= MaxVisibleDistance
+		&& (Distance < UE_KINDA_SMALL_NUMBER || FVector::DotProduct(ToVehicle / Distance, ViewDirection) >= FMath::Cos(FMath::DegreesToRadians(ViewConeHalfAngle)));
+
+	// spectators, and vehicles that aren't on the track, go by straight line distance
+	const UFutureRacingTrackProgressSubsystem* TrackProgress = GetWorld()->GetSubsystem<UFutureRacingTrackProgressSubsystem>();
+	const float TrackGap = TrackProgress && ViewerVehicle ? TrackProgress->GetTrackGap(ViewerVehicle, Vehicle) : -1.0f;
+	const double Gap = TrackGap >= 0.0f ? TrackGap : Distance;
+
+	// close rivals, on track or in the standings
+	const int32 Position = TrackProgress && ViewerPosition > 0 ? TrackProgress->GetRacePosition(Vehicle) : 0;
+	const bool bRival = Position > 0 && FMath::Abs(Position - ViewerPosition) <= RivalPositions;
+
+	if (Gap <= NearTrackDistance || bRival)
+	{
+		return EFutureRacingNetTier::Full;
+	}
+
+	if (bInView)
+	{
+		return EFutureRacingNetTier::Reduced;
+	}
+
+	if (Gap <= FarTrackDistance)
+	{
+		return EFutureRacingNetTier::Distant;
+	}
+
+	return EFutureRacingNetTier::Sparse;
+}
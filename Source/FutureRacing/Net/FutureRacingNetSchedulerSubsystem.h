@@ -0,0 +1,154 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "UObject/ObjectKey.h"
+#include "FutureRacingNetSchedulerSubsystem.generated.h"
+
+class AFutureRacingPawn;
+class UNetConnection;
+
+/**
+ *  How much a connection cares about a vehicle, from most to least
+ */
+enum class EFutureRacingNetTier : uint8
+{
+	/** Close rivals and the connection's own vehicle. Every snapshot */
+	Full,
+
+	/** In view but not close. A fraction of the snapshots */
+	Reduced,
+
+	/** Out of view, within reach on track. A small fraction of the snapshots */
+	Distant,
+
+	/** Everything else. Sparse keyframes the client extrapolates between */
+	Sparse,
+
+	Num
+};
+
+/**
+ *  Snapshot traffic to a single client connection
+ */
+struct FFutureRacingNetConnectionStats
+{
+	/** Snapshot payload sent since the last reset */
+	int64 NumBitsSent = 0;
+	int64 NumSnapshots = 0;
+
+	/** Number of vehicles in each tier at the last ranking */
+	int32 NumVehiclesPerTier[static_cast<int32>(EFutureRacingNetTier::Num)] = {};
+};
+
+/**
+ *  Ranks vehicles per client connection and schedules their snapshots accordingly.
+ *
+ *  A few times a second, every vehicle is ranked for every connection by how close it is
+ *  to the connection's vehicle along the track, whether it's in view and how close it is in
+ *  the standings. The tier picks how often the vehicle's snapshots go to that connection and
+ *  scales its net priority, so near rivals keep the full rate when bandwidth runs short.
+ *  Server only.
+ */
+UCLASS(Config="Game")
+class UFutureRacingNetSchedulerSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+protected:
+
+	/** Seconds between rankings */
+	UPROPERTY(Config)
+	float UpdateInterval = 0.25f;
+
+	/** Vehicles closer than this along the track get every snapshot */
+	UPROPERTY(Config)
+	float NearTrackDistance = 5000.0f;
+
+	/** Vehicles closer than this along the track are at least Distant */
+	UPROPERTY(Config)
+	float FarTrackDistance = 30000.0f;
+
+	/** Vehicles this many race positions or fewer away get every snapshot */
+	UPROPERTY(Config)
+	int32 RivalPositions = 1;
+
+	/** Vehicles further than this from the viewpoint don't count as in view */
+	UPROPERTY(Config)
+	float MaxVisibleDistance = 25000.0f;
+
+	/** Half angle of the view cone, in degrees */
+	UPROPERTY(Config)
+	float ViewConeHalfAngle = 50.0f;
+
+	/** Snapshots per second for Reduced vehicles */
+	UPROPERTY(Config)
+	float ReducedRate = 15.0f;
+
+	/** Snapshots per second for Distant vehicles */
+	UPROPERTY(Config)
+	float DistantRate = 5.0f;
+
+	/** Seconds between keyframes for Sparse vehicles */
+	UPROPERTY(Config)
+	float SparseInterval = 1.0f;
+
+	/** Net priority multiplier for each tier, from Full to Sparse */
+	UPROPERTY(Config)
+	TArray<float> TierPriorityScales = { 4.0f, 2.0f, 1.0f, 0.5f };
+
+	/** Time left until the next ranking */
+	float UpdateCountdown = 0.0f;
+
+	/** Vehicles replicating through a net component */
+	TArray<TWeakObjectPtr<AFutureRacingPawn>> Vehicles;
+
+	/** Snapshot traffic per client connection */
+	TMap<TObjectKey<const UNetConnection>, FFutureRacingNetConnectionStats> ConnectionStats;
+
+public:
+
+	/** Adds a vehicle to the ranking */
+	void RegisterVehicle(AFutureRacingPawn* Vehicle);
+
+	/** Removes a vehicle from the ranking */
+	void UnregisterVehicle(AFutureRacingPawn* Vehicle);
+
+	/** Returns the time between snapshots for a tier, in ms. Zero sends every snapshot */
+	uint32 GetSendIntervalMs(EFutureRacingNetTier Tier) const;
+
+	/** Returns the net priority multiplier for a tier */
+	float GetPriorityScale(EFutureRacingNetTier Tier) const;
+
+	/** Counts a snapshot sent to a connection */
+	void RecordSnapshotSent(const UNetConnection* Connection, int64 NumBits);
+
+	/** Returns the snapshot traffic to a connection, or null if nothing was ranked for it yet */
+	const FFutureRacingNetConnectionStats* GetConnectionStats(const UNetConnection* Connection) const;
+
+	/** Clears the snapshot traffic counters of every connection */
+	void ResetConnectionStats();
+
+	// Begin UWorldSubsystem interface
+
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+	// End UWorldSubsystem interface
+
+	// Begin FTickableGameObject interface
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	// End FTickableGameObject interface
+
+protected:
+
+	/** Ranks every vehicle for every client connection */
+	void UpdateTiers();
+
+	/** Ranks a vehicle for a viewer */
+	EFutureRacingNetTier RankVehicle(const AFutureRacingPawn* Vehicle, const AFutureRacingPawn* ViewerVehicle, const FVector& ViewLocation, const FVector& ViewDirection, int32 ViewerPosition) const;
+};
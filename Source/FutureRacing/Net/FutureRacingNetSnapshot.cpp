@@ -0,0 +1,363 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "FutureRacingNetSnapshot.h"
+#include "FutureRacingVehicleNetComponent.h"
+#include "Engine/PackageMapClient.h"
+#include "Serialization/BitWriter.h"
+#include "Serialization/BitReader.h"
+
+namespace FutureRacingNet
+{
+	/** Change mask bits, one per field that can be left out of a delta */
+	enum ESnapshotFields : uint8
+	{
+		Field_Location = 1 << 0,
+		Field_Velocity = 1 << 1,
+		Field_Rotation = 1 << 2,
+		Field_AngularVelocity = 1 << 3,
+		Field_Input = 1 << 4,
+		Field_Gear = 1 << 5,
+		Field_EngineRPM = 1 << 6,
+		Field_LastInput = 1 << 7,
+
+		Field_All = 0xFF
+	};
+
+	namespace
+	{
+		/** Zig zag encodes, so small negative values stay small once packed */
+		uint32 ZigZag(int32 Value)
+		{
+			return (static_cast<uint32>(Value) << 1) ^ static_cast<uint32>(Value >> 31);
+		}
+
+		int32 UnZigZag(uint32 Value)
+		{
+			return static_cast<int32>(Value >> 1) ^ -static_cast<int32>(Value & 1);
+		}
+
+		/** Writes or reads a value as a packed difference from a base value */
+		void SerializeDelta(FArchive& Ar, int32& Value, int32 Base)
+		{
+			uint32 Packed = Ar.IsSaving() ? ZigZag(Value - Base) : 0;
+			Ar.SerializeIntPacked(Packed);
+
+			if (Ar.IsLoading())
+			{
+				Value = Base + UnZigZag(Packed);
+			}
+		}
+
+		void SerializeDelta(FArchive& Ar, FIntVector& Value, const FIntVector& Base)
+		{
+			SerializeDelta(Ar, Value.X, Base.X);
+			SerializeDelta(Ar, Value.Y, Base.Y);
+			SerializeDelta(Ar, Value.Z, Base.Z);
+		}
+
+		/** Moves the baseline location along the baseline velocity up to the given time. Integer math, so both ends agree exactly */
+		FIntVector PredictLocation(const FSnapshot& Baseline, uint32 ServerTimeMs)
+		{
+			const int64 DeltaMs = static_cast<int64>(ServerTimeMs) - static_cast<int64>(Baseline.ServerTimeMs);
+
+			return FIntVector(
+				Baseline.State.Location.X + static_cast<int32>(Baseline.State.Velocity.X * DeltaMs / 1000),
+				Baseline.State.Location.Y + static_cast<int32>(Baseline.State.Velocity.Y * DeltaMs / 1000),
+				Baseline.State.Location.Z + static_cast<int32>(Baseline.State.Velocity.Z * DeltaMs / 1000));
+		}
+
+		bool IsSameInput(const FutureRacingReplay::FQuantizedInput& A, const FutureRacingReplay::FQuantizedInput& B)
+		{
+			return A.Steering == B.Steering && A.Throttle == B.Throttle && A.Brake == B.Brake && A.bHandbrake == B.bHandbrake;
+		}
+
+		/** Returns the fields that differ from what the receiver can work out from the baseline */
+		uint8 GetChangedFields(const FSnapshot& Snapshot, const FSnapshot& Baseline)
+		{
+			uint8 Fields = 0;
+
+			Fields |= Snapshot.State.Location != PredictLocation(Baseline, Snapshot.ServerTimeMs) ? Field_Location : 0;
+			Fields |= Snapshot.State.Velocity != Baseline.State.Velocity ? Field_Velocity : 0;
+			Fields |= Snapshot.State.Rotation != Baseline.State.Rotation ? Field_Rotation : 0;
+			Fields |= Snapshot.AngularVelocity != Baseline.AngularVelocity ? Field_AngularVelocity : 0;
+			Fields |= !IsSameInput(Snapshot.Input, Baseline.Input) ? Field_Input : 0;
+			Fields |= Snapshot.Gear != Baseline.Gear ? Field_Gear : 0;
+			Fields |= Snapshot.EngineRPM != Baseline.EngineRPM ? Field_EngineRPM : 0;
+			Fields |= Snapshot.LastInputSequence != Baseline.LastInputSequence || Snapshot.InputAgeMs != Baseline.InputAgeMs ? Field_LastInput : 0;
+
+			return Fields;
+		}
+
+		/** Writes or reads everything after the sequence numbers */
+		void SerializeBody(FArchive& Ar, FSnapshot& Snapshot, const FSnapshot& Baseline, bool bDelta)
+		{
+			// time only moves forward, so the difference always packs small
+			uint32 TimeDelta = Ar.IsSaving() ? Snapshot.ServerTimeMs - Baseline.ServerTimeMs : 0;
+			Ar.SerializeIntPacked(TimeDelta);
+
+			if (Ar.IsLoading())
+			{
+				Snapshot.ServerTimeMs = Baseline.ServerTimeMs + TimeDelta;
+			}
+
+			uint8 Fields = Ar.IsSaving() ? (bDelta ? GetChangedFields(Snapshot, Baseline) : Field_All) : 0;
+			Ar << Fields;
+
+			// unchanged fields come from the baseline
+			if (Ar.IsLoading())
+			{
+				Snapshot.State = Baseline.State;
+				Snapshot.AngularVelocity = Baseline.AngularVelocity;
+				Snapshot.Input = Baseline.Input;
+				Snapshot.Gear = Baseline.Gear;
+				Snapshot.EngineRPM = Baseline.EngineRPM;
+				Snapshot.LastInputSequence = Baseline.LastInputSequence;
+				Snapshot.InputAgeMs = Baseline.InputAgeMs;
+			}
+
+			const FIntVector PredictedLocation = bDelta ? PredictLocation(Baseline, Snapshot.ServerTimeMs) : FIntVector::ZeroValue;
+
+			if (Fields & Field_Location)
+			{
+				SerializeDelta(Ar, Snapshot.State.Location, PredictedLocation);
+
+			} else if (Ar.IsLoading()) {
+
+				Snapshot.State.Location = PredictedLocation;
+			}
+
+			if (Fields & Field_Velocity)
+			{
+				SerializeDelta(Ar, Snapshot.State.Velocity, Baseline.State.Velocity);
+			}
+
+			// packed rotations don't delta well, so they go whole
+			if (Fields & Field_Rotation)
+			{
+				Ar << Snapshot.State.Rotation;
+			}
+
+			if (Fields & Field_AngularVelocity)
+			{
+				SerializeDelta(Ar, Snapshot.AngularVelocity, Baseline.AngularVelocity);
+			}
+
+			if (Fields & Field_Input)
+			{
+				Ar << Snapshot.Input.Steering;
+				Ar << Snapshot.Input.Throttle;
+				Ar << Snapshot.Input.Brake;
+
+				uint8 bHandbrake = Snapshot.Input.bHandbrake ? 1 : 0;
+				Ar.SerializeBits(&bHandbrake, 1);
+				Snapshot.Input.bHandbrake = bHandbrake != 0;
+			}
+
+			if (Fields & Field_Gear)
+			{
+				SerializeDelta(Ar, Snapshot.Gear, Baseline.Gear);
+			}
+
+			if (Fields & Field_EngineRPM)
+			{
+				SerializeDelta(Ar, Snapshot.EngineRPM, Baseline.EngineRPM);
+			}
+
+			if (Fields & Field_LastInput)
+			{
+				uint32 SequenceDelta = Ar.IsSaving() ? Snapshot.LastInputSequence - Baseline.LastInputSequence : 0;
+				Ar.SerializeIntPacked(SequenceDelta);
+				Ar.SerializeIntPacked(Snapshot.InputAgeMs);
+
+				if (Ar.IsLoading())
+				{
+					Snapshot.LastInputSequence = Baseline.LastInputSequence + SequenceDelta;
+				}
+			}
+		}
+	}
+
+	bool FSnapshot::operator==(const FSnapshot& Other) const
+	{
+		return Sequence == Other.Sequence
+			&& ServerTimeMs == Other.ServerTimeMs
+			&& State.Location == Other.State.Location
+			&& State.Velocity == Other.State.Velocity
+			&& State.Rotation == Other.State.Rotation
+			&& AngularVelocity == Other.AngularVelocity
+			&& IsSameInput(Input, Other.Input)
+			&& Gear == Other.Gear
+			&& EngineRPM == Other.EngineRPM
+			&& LastInputSequence == Other.LastInputSequence
+			&& InputAgeMs == Other.InputAgeMs;
+	}
+
+	void WriteSnapshot(FArchive& Ar, const FSnapshot& Snapshot, const FSnapshot* Baseline)
+	{
+		uint8 bDelta = Baseline ? 1 : 0;
+		Ar.SerializeBits(&bDelta, 1);
+
+		uint32 Sequence = Snapshot.Sequence;
+		Ar.SerializeIntPacked(Sequence);
+
+		// the receiver finds the baseline by how far back it is
+		if (Baseline)
+		{
+			uint32 Gap = Snapshot.Sequence - Baseline->Sequence;
+			Ar.SerializeIntPacked(Gap);
+		}
+
+		FSnapshot Body = Snapshot;
+		SerializeBody(Ar, Body, Baseline ? *Baseline : FSnapshot(), Baseline != nullptr);
+	}
+
+	bool ReadSnapshot(FArchive& Ar, FSnapshot& OutSnapshot, TFunctionRef<const FSnapshot*(uint32 Sequence)> FindBaseline)
+	{
+		uint8 bDelta = 0;
+		Ar.SerializeBits(&bDelta, 1);
+
+		uint32 Sequence = 0;
+		Ar.SerializeIntPacked(Sequence);
+
+		const FSnapshot* Baseline = nullptr;
+
+		if (bDelta)
+		{
+			uint32 Gap = 0;
+			Ar.SerializeIntPacked(Gap);
+
+			Baseline = FindBaseline(Sequence - Gap);
+		}
+
+		// a missing baseline still has to be read past, the field sizes don't depend on its values
+		const FSnapshot EmptyBaseline;
+
+		OutSnapshot = FSnapshot();
+		OutSnapshot.Sequence = Sequence;
+		SerializeBody(Ar, OutSnapshot, Baseline ? *Baseline : EmptyBaseline, bDelta != 0);
+
+		return !Ar.IsError() && (!bDelta || Baseline);
+	}
+}
+
+/**
+ *  Snapshot a connection was last sent, kept per connection by the replication system
+ */
+class FFutureRacingSnapshotBaseState : public INetDeltaBaseState
+{
+public:
+
+	FutureRacingNet::FSnapshot Snapshot;
+
+	virtual bool IsStateEqual(INetDeltaBaseState* OtherState) override
+	{
+		return Snapshot == static_cast<FFutureRacingSnapshotBaseState*>(OtherState)->Snapshot;
+	}
+};
+
+const FutureRacingNet::FSnapshot* FFutureRacingReplicatedSnapshot::FindReceived(uint32 Sequence) const
+{
+	if (Sequence == 0 || History.Num() != FutureRacingNet::HistorySize)
+	{
+		return nullptr;
+	}
+
+	const FutureRacingNet::FSnapshot& Received = History[Sequence % FutureRacingNet::HistorySize];
+
+	return Received.Sequence == Sequence ? &Received : nullptr;
+}
+
+bool FFutureRacingReplicatedSnapshot::NetDeltaSerialize(FNetDeltaSerializeInfo& DeltaParms)
+{
+	if (DeltaParms.Writer)
+	{
+		const FFutureRacingSnapshotBaseState* OldState = static_cast<const FFutureRacingSnapshotBaseState*>(DeltaParms.OldState);
+
+		TSharedPtr<FFutureRacingSnapshotBaseState> NewState = MakeShared<FFutureRacingSnapshotBaseState>();
+		NewState->Snapshot = Snapshot;
+		*DeltaParms.NewState = NewState;
+
+		// nothing captured since this connection's last send
+		if (Snapshot.Sequence == 0 || (OldState && OldState->Snapshot.Sequence == Snapshot.Sequence))
+		{
+			return false;
+		}
+
+		// vehicles this connection cares less about go out less often. The connection keeps its old baseline meanwhile
+		UPackageMapClient* PackageMap = Cast<UPackageMapClient>(DeltaParms.Map);
+		const UNetConnection* Connection = PackageMap ? PackageMap->GetConnection() : nullptr;
+		UFutureRacingVehicleNetComponent* Component = Owner.Get();
+
+		const uint32 SendIntervalMs = Component ? Component->GetSendIntervalMs(Connection) : 0;
+
+		if (OldState && SendIntervalMs > 0 && Snapshot.ServerTimeMs - OldState->Snapshot.ServerTimeMs < SendIntervalMs)
+		{
+			NewState->Snapshot = OldState->Snapshot;
+			return false;
+		}
+
+		// only delta against snapshots the client still keeps around, and send a full snapshot
+		// once per history length so a client that missed its baseline doesn't stay stuck
+		const bool bHasBaseline = OldState && OldState->Snapshot.Sequence != 0
+			&& OldState->Snapshot.Sequence / FutureRacingNet::HistorySize == Snapshot.Sequence / FutureRacingNet::HistorySize;
+
+		FBitWriter& Writer = *DeltaParms.Writer;
+		const int64 StartBits = Writer.GetNumBits();
+
+		FutureRacingNet::WriteSnapshot(Writer, Snapshot, bHasBaseline ? &OldState->Snapshot : nullptr);
+
+		const int64 NumBits = Writer.GetNumBits() - StartBits;
+
+		NumBitsSent += NumBits;
+		++NumSends;
+		NumDeltaSends += bHasBaseline ? 1 : 0;
+
+		if (Component)
+		{
+			Component->RecordSnapshotSent(Connection, NumBits);
+		}
+
+		return true;
+	}
+
+	if (DeltaParms.Reader)
+	{
+		FBitReader& Reader = *DeltaParms.Reader;
+
+		FutureRacingNet::FSnapshot Received;
+
+		const bool bDecoded = FutureRacingNet::ReadSnapshot(Reader, Received, [this](uint32 Sequence)
+		{
+			return FindReceived(Sequence);
+		});
+
+		if (Reader.IsError())
+		{
+			return false;
+		}
+
+		// the baseline fell out of the history. Skip ahead to the next full snapshot
+		if (!bDecoded)
+		{
+			return true;
+		}
+
+		if (History.Num() != FutureRacingNet::HistorySize)
+		{
+			History.SetNum(FutureRacingNet::HistorySize);
+		}
+
+		History[Received.Sequence % FutureRacingNet::HistorySize] = Received;
+
+		// packets can arrive out of order, keep the newest
+		if (Received.Sequence > Snapshot.Sequence)
+		{
+			Snapshot = Received;
+		}
+
+		return true;
+	}
+
+	return false;
+}
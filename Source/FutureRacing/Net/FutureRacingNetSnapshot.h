@@ -0,0 +1,108 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/NetSerialization.h"
+#include "FutureRacingReplayFormat.h"
+#include "FutureRacingNetSnapshot.generated.h"
+
+class UFutureRacingVehicleNetComponent;
+
+/**
+ *  Vehicle state snapshots sent from the server to clients.
+ *
+ *  Snapshots reuse the replay quantization: centimeters, cm/s and smallest three rotations.
+ *  Each snapshot is written as a change mask followed by whichever fields changed, encoded
+ *  against the last snapshot replicated to the receiving connection, with a full snapshot once
+ *  per history length. Locations are encoded against the baseline moved along its own velocity,
+ *  so a car holding its line sends almost nothing.
+ */
+namespace FutureRacingNet
+{
+	/** Number of received snapshots a client keeps as baselines. The server never deltas against anything older */
+	constexpr uint32 HistorySize = 32;
+
+	/** Vehicle state at network resolution */
+	struct FSnapshot
+	{
+		/** Increases by one for every snapshot the server captures */
+		uint32 Sequence = 0;
+
+		/** Server physics time, in ms */
+		uint32 ServerTimeMs = 0;
+
+		/** Body location, rotation and velocity */
+		FutureRacingReplay::FQuantizedState State;
+
+		/** Angular velocity, in degrees per second */
+		FIntVector AngularVelocity = FIntVector::ZeroValue;
+
+		/** Inputs the server is simulating with */
+		FutureRacingReplay::FQuantizedInput Input;
+
+		int32 Gear = 0;
+
+		/** Engine speed, in tens of RPM */
+		int32 EngineRPM = 0;
+
+		/** Last client input the server applied. Zero for vehicles without a remote driver */
+		uint32 LastInputSequence = 0;
+
+		/** Time between applying that input and capturing the snapshot, in ms */
+		uint32 InputAgeMs = 0;
+
+		bool operator==(const FSnapshot& Other) const;
+		bool operator!=(const FSnapshot& Other) const { return !(*this == Other); }
+	};
+
+	/**
+	 *  Writes a snapshot.
+	 *  @param Baseline Snapshot the receiver already has, or null to write the snapshot in full
+	 */
+	void WriteSnapshot(FArchive& Ar, const FSnapshot& Snapshot, const FSnapshot* Baseline);
+
+	/**
+	 *  Reads a snapshot written by WriteSnapshot.
+	 *  Always consumes the whole snapshot, but returns false if it was encoded against a baseline FindBaseline doesn't have.
+	 */
+	bool ReadSnapshot(FArchive& Ar, FSnapshot& OutSnapshot, TFunctionRef<const FSnapshot*(uint32 Sequence)> FindBaseline);
+}
+
+/**
+ *  Replicated vehicle snapshot.
+ *  Delta serialized per connection against the last snapshot replicated to that connection.
+ */
+USTRUCT()
+struct FFutureRacingReplicatedSnapshot
+{
+	GENERATED_BODY()
+
+	/** Latest snapshot. Captured by the server, replaced by the newest one received on clients */
+	FutureRacingNet::FSnapshot Snapshot;
+
+	/** Received snapshots, indexed by sequence modulo the history size. Clients only */
+	TArray<FutureRacingNet::FSnapshot> History;
+
+	/** Component replicating this snapshot, which schedules the sends per connection */
+	TWeakObjectPtr<UFutureRacingVehicleNetComponent> Owner;
+
+	/** Bandwidth accumulators, written on the server */
+	int64 NumBitsSent = 0;
+	int64 NumSends = 0;
+	int64 NumDeltaSends = 0;
+
+	/** Returns the received snapshot with the given sequence, or null if it's no longer in the history */
+	const FutureRacingNet::FSnapshot* FindReceived(uint32 Sequence) const;
+
+	bool NetDeltaSerialize(FNetDeltaSerializeInfo& DeltaParms);
+};
+
+template<>
+struct TStructOpsTypeTraits<FFutureRacingReplicatedSnapshot> : public TStructOpsTypeTraitsBase2<FFutureRacingReplicatedSnapshot>
+{
+	enum
+	{
+		WithNetDeltaSerializer = true
+	};
+};
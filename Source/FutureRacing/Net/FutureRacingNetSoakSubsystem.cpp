@@ -0,0 +1,339 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "FutureRacingNetSoakSubsystem.h"
+#include "FutureRacingNetSchedulerSubsystem.h"
+#include "FutureRacingPawn.h"
+#include "FutureRacingCPUController.h"
+#include "FutureRacingTrackSubsystem.h"
+#include "FutureRacingTrackTable.h"
+#include "FutureRacingHeadlessWorld.h"
+#include "Engine/NetConnection.h"
+#include "Engine/NetDriver.h"
+#include "Engine/World.h"
+#include "GameFramework/GameModeBase.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformProperties.h"
+#include "Misc/App.h"
+#include "Misc/CommandLine.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "FutureRacing.h"
+
+bool UFutureRacingNetSoakSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	float Seconds = 0.0f;
+
+	return Super::ShouldCreateSubsystem(Outer)
+		&& (FParse::Param(FCommandLine::Get(), TEXT("NetSoak")) || FParse::Value(FCommandLine::Get(), TEXT("NetSoak="), Seconds));
+}
+
+bool UFutureRacingNetSoakSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game;
+}
+
+void UFutureRacingNetSoakSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	// clients only report what they receive, the server measures every connection
+	if (InWorld.GetNetMode() != NM_DedicatedServer && InWorld.GetNetMode() != NM_ListenServer)
+	{
+		return;
+	}
+
+	const TCHAR* CommandLine = FCommandLine::Get();
+
+	NumBots = DefaultNumBots;
+	Interval = DefaultInterval;
+
+	FParse::Value(CommandLine, TEXT("NetSoak="), Duration);
+	FParse::Value(CommandLine, TEXT("NetSoakBots="), NumBots);
+	FParse::Value(CommandLine, TEXT("NetSoakInterval="), Interval);
+	FParse::Value(CommandLine, TEXT("NetSoakVehicle="), VehicleName);
+
+	int32 NumClients = 0;
+	FParse::Value(CommandLine, TEXT("NetSoakClients="), NumClients);
+
+	Interval = FMath::Max(Interval, 1.0f);
+
+	CsvFile = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("Benchmarks"), TEXT("NetSoak.csv"));
+	FParse::Value(CommandLine, TEXT("Csv="), CsvFile);
+
+	SpawnBots();
+
+	Elapsed = 0.0f;
+	MeasureCountdown = Interval;
+	bStarted = true;
+
+	// hold off measuring until the clients we launch have all connected
+	if (NumClients > 0)
+	{
+		LaunchClients(NumClients);
+
+		ConnectWaitTime = 0.0f;
+		bWaitingForClients = ClientProcesses.Num() > 0;
+	}
+
+	UE_LOG(LogFutureRacing, Display, TEXT("Net soak: %d bots and %d launched clients for %.0fs, measuring every %.0fs."), Bots.Num(), ClientProcesses.Num(), Duration, Interval);
+}
+
+void UFutureRacingNetSoakSubsystem::Deinitialize()
+{
+	CloseClients();
+
+	Super::Deinitialize();
+}
+
+void UFutureRacingNetSoakSubsystem::Tick(float DeltaTime)
+{
+	if (!bStarted)
+	{
+		return;
+	}
+
+	if (bWaitingForClients)
+	{
+		const UNetDriver* NetDriver = GetWorld()->GetNetDriver();
+		const int32 NumConnected = NetDriver ? NetDriver->ClientConnections.Num() : 0;
+
+		ConnectWaitTime += DeltaTime;
+
+		if (NumConnected < ClientProcesses.Num() && ConnectWaitTime < ClientConnectTimeout)
+		{
+			return;
+		}
+
+		if (NumConnected < ClientProcesses.Num())
+		{
+			UE_LOG(LogFutureRacing, Warning, TEXT("Net soak: only %d of %d launched clients connected after %.0fs, starting anyway."), NumConnected, ClientProcesses.Num(), ConnectWaitTime);
+		}
+
+		bWaitingForClients = false;
+	}
+
+	Elapsed += DeltaTime;
+	MeasureCountdown -= DeltaTime;
+
+	if (MeasureCountdown <= 0.0f)
+	{
+		Measure(Interval - MeasureCountdown);
+		MeasureCountdown += Interval;
+	}
+
+	if (Elapsed >= Duration)
+	{
+		Finish();
+	}
+}
+
+TStatId UFutureRacingNetSoakSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UFutureRacingNetSoakSubsystem, STATGROUP_Tickables);
+}
+
+void UFutureRacingNetSoakSubsystem::SpawnBots()
+{
+	UWorld* World = GetWorld();
+
+	// the game mode's vehicle unless told otherwise
+	UClass* VehicleClass = nullptr;
+
+	if (!VehicleName.IsEmpty())
+	{
+		VehicleClass = FFutureRacingHeadlessWorld::ResolveVehicleClass(VehicleName);
+
+	} else if (const AGameModeBase* GameMode = World->GetAuthGameMode()) {
+
+		VehicleClass = GameMode->DefaultPawnClass;
+	}
+
+	if (!VehicleClass || !VehicleClass->IsChildOf(AFutureRacingPawn::StaticClass()))
+	{
+		UE_LOG(LogFutureRacing, Error, TEXT("Net soak: no vehicle class to spawn bots with."));
+		return;
+	}
+
+	UFutureRacingTrackSubsystem* TrackSubsystem = World->GetSubsystem<UFutureRacingTrackSubsystem>();
+	const TSharedPtr<const FFutureRacingTrackTable> Track = TrackSubsystem ? TrackSubsystem->GetPrimaryTable() : nullptr;
+
+	if (!Track.IsValid() || !Track->IsValid())
+	{
+		UE_LOG(LogFutureRacing, Error, TEXT("Net soak: the map has no track to spread the bots along."));
+		return;
+	}
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
+
+	// spread evenly around the lap, alternating sides, so every tier gets some vehicles
+	for (int32 Index = 0; Index < NumBots; ++Index)
+	{
+		const float Distance = Track->TrackLength * Index / FMath::Max(NumBots, 1);
+		const FVector Direction = Track->GetDirectionAtDistance(Distance);
+		const FVector Right = FVector::CrossProduct(FVector::UpVector, Direction).GetSafeNormal();
+
+		const FVector Location = Track->GetPositionAtDistance(Distance) + Right * (Index % 2 == 0 ? 300.0f : -300.0f) + FVector::UpVector * 50.0f;
+
+		AFutureRacingPawn* Vehicle = World->SpawnActor<AFutureRacingPawn>(VehicleClass, FTransform(Direction.Rotation(), Location), SpawnParams);
+
+		if (!Vehicle)
+		{
+			continue;
+		}
+
+		if (AFutureRacingCPUController* Controller = World->SpawnActor<AFutureRacingCPUController>(Vehicle->GetActorLocation(), Vehicle->GetActorRotation(), SpawnParams))
+		{
+			Controller->Possess(Vehicle);
+		}
+
+		Bots.Add(Vehicle);
+	}
+}
+
+void UFutureRacingNetSoakSubsystem::LaunchClients(int32 NumClients)
+{
+	FString Executable;
+
+	if (!FParse::Value(FCommandLine::Get(), TEXT("NetSoakClientExe="), Executable))
+	{
+		Executable = FPlatformProcess::ExecutablePath();
+
+#if UE_SERVER
+		// a dedicated server can't run as a client, use the game built next to it
+		Executable = FPaths::Combine(FPaths::GetPath(Executable), FString(FApp::GetProjectName()) + FPaths::GetExtension(Executable, true));
+#endif
+	}
+
+	FString Params = FString::Printf(TEXT("127.0.0.1:%d -nullrhi -nosound -unattended -nosplash"), GetWorld()->URL.Port);
+
+	// editor binaries need to be told which project to run
+	if (!FPlatformProperties::RequiresCookedData())
+	{
+		Params = FString::Printf(TEXT("\"%s\" %s -game"), *FPaths::ConvertRelativePathToFull(FPaths::GetProjectFilePath()), *Params);
+	}
+
+	for (int32 Index = 0; Index < NumClients; ++Index)
+	{
+		const FString ClientParams = FString::Printf(TEXT("%s -log=NetSoakClient%d.log"), *Params, Index);
+
+		FProcHandle Process = FPlatformProcess::CreateProc(*Executable, *ClientParams, true, true, true, nullptr, 0, nullptr, nullptr);
+
+		if (Process.IsValid())
+		{
+			ClientProcesses.Add(Process);
+
+		} else {
+
+			UE_LOG(LogFutureRacing, Error, TEXT("Net soak: could not launch client '%s %s'."), *Executable, *ClientParams);
+		}
+	}
+}
+
+void UFutureRacingNetSoakSubsystem::CloseClients()
+{
+	for (FProcHandle& Process : ClientProcesses)
+	{
+		if (FPlatformProcess::IsProcRunning(Process))
+		{
+			FPlatformProcess::TerminateProc(Process, true);
+		}
+
+		FPlatformProcess::CloseProc(Process);
+	}
+
+	ClientProcesses.Reset();
+}
+
+void UFutureRacingNetSoakSubsystem::Measure(float MeasuredSeconds)
+{
+	const UNetDriver* NetDriver = GetWorld()->GetNetDriver();
+	UFutureRacingNetSchedulerSubsystem* Scheduler = GetWorld()->GetSubsystem<UFutureRacingNetSchedulerSubsystem>();
+
+	if (!NetDriver || MeasuredSeconds <= 0.0f)
+	{
+		return;
+	}
+
+	for (UNetConnection* Connection : NetDriver->ClientConnections)
+	{
+		if (!Connection)
+		{
+			continue;
+		}
+
+		const FFutureRacingNetConnectionStats* Stats = Scheduler ? Scheduler->GetConnectionStats(Connection) : nullptr;
+		const FFutureRacingNetConnectionStats Snapshots = Stats ? *Stats : FFutureRacingNetConnectionStats();
+
+		const double SnapshotBytesPerSecond = Snapshots.NumBitsSent / 8.0 / MeasuredSeconds;
+		const FString Address = Connection->LowLevelGetRemoteAddress(true);
+
+		UE_LOG(LogFutureRacing, Display, TEXT("Net soak %s: out %d B/s, in %d B/s, snapshots %.0f B/s (%lld), tiers %d/%d/%d/%d, ping %.0fms"),
+			*Address, Connection->OutBytesPerSecond, Connection->InBytesPerSecond, SnapshotBytesPerSecond, Snapshots.NumSnapshots,
+			Snapshots.NumVehiclesPerTier[0], Snapshots.NumVehiclesPerTier[1], Snapshots.NumVehiclesPerTier[2], Snapshots.NumVehiclesPerTier[3],
+			Connection->AvgLag * 1000.0);
+
+		PendingRows.Add(FString::Printf(TEXT("%s,%.1f,%s,%d,%d,%d,%.1f,%lld,%d,%d,%d,%d,%.1f"),
+			*FDateTime::Now().ToString(), Elapsed, *Address, Bots.Num(),
+			Connection->OutBytesPerSecond, Connection->InBytesPerSecond, SnapshotBytesPerSecond, Snapshots.NumSnapshots,
+			Snapshots.NumVehiclesPerTier[0], Snapshots.NumVehiclesPerTier[1], Snapshots.NumVehiclesPerTier[2], Snapshots.NumVehiclesPerTier[3],
+			Connection->AvgLag * 1000.0));
+
+		FConnectionTotals& Total = Totals.FindOrAdd(Connection);
+		Total.Address = Address;
+		Total.OutBytesPerSecond += Connection->OutBytesPerSecond;
+		Total.SnapshotBytesPerSecond += SnapshotBytesPerSecond;
+		Total.MaxOutBytesPerSecond = FMath::Max<double>(Total.MaxOutBytesPerSecond, Connection->OutBytesPerSecond);
+		++Total.NumMeasurements;
+	}
+
+	if (Scheduler)
+	{
+		Scheduler->ResetConnectionStats();
+	}
+}
+
+void UFutureRacingNetSoakSubsystem::Finish()
+{
+	bStarted = false;
+
+	for (const TPair<TObjectKey<const UNetConnection>, FConnectionTotals>& Pair : Totals)
+	{
+		const FConnectionTotals& Total = Pair.Value;
+		const int32 Count = FMath::Max(Total.NumMeasurements, 1);
+
+		UE_LOG(LogFutureRacing, Display, TEXT("Net soak summary %s: out avg %.0f B/s, max %.0f B/s, snapshots avg %.0f B/s over %d measurements"),
+			*Total.Address, Total.OutBytesPerSecond / Count, Total.MaxOutBytesPerSecond, Total.SnapshotBytesPerSecond / Count, Total.NumMeasurements);
+	}
+
+	if (PendingRows.Num() > 0)
+	{
+		FString Csv;
+
+		if (!IFileManager::Get().FileExists(*CsvFile))
+		{
+			Csv += TEXT("Date,Time,Connection,Bots,OutBytesPerSec,InBytesPerSec,SnapshotBytesPerSec,Snapshots,Full,Reduced,Distant,Sparse,PingMs") LINE_TERMINATOR;
+		}
+
+		for (const FString& Row : PendingRows)
+		{
+			Csv += Row + LINE_TERMINATOR;
+		}
+
+		if (FFileHelper::SaveStringToFile(Csv, *CsvFile, FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM, &IFileManager::Get(), FILEWRITE_Append))
+		{
+			UE_LOG(LogFutureRacing, Display, TEXT("Wrote net soak results to '%s'."), *FPaths::ConvertRelativePathToFull(CsvFile));
+
+		} else {
+
+			UE_LOG(LogFutureRacing, Error, TEXT("Could not write net soak results to '%s'."), *CsvFile);
+		}
+
+		PendingRows.Reset();
+	}
+
+	CloseClients();
+
+	FPlatformMisc::RequestExit(false, TEXT("FutureRacing.NetSoak"));
+}
@@ -0,0 +1,134 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "UObject/ObjectKey.h"
+#include "HAL/PlatformProcess.h"
+#include "FutureRacingNetSoakSubsystem.generated.h"
+
+class AFutureRacingPawn;
+class UNetConnection;
+
+/**
+ *  Fills the server with CPU driven vehicles and measures the bandwidth every client connection
+ *  uses, to check the snapshot scheduling holds up on a full grid. Only runs on servers started with -NetSoak.
+ *
+ *  Start the server with the number of headless clients to launch and connect to it:
+ *      FutureRacingServer Lvl_Timetrial -log -NetSoak=300 -NetSoakBots=31 -NetSoakClients=8
+ *      FutureRacing Lvl_Timetrial?listen -log -NetSoak=300 -NetSoakClients=8    (listen server)
+ *
+ *  Clients can also be started by hand with FutureRacing 127.0.0.1 -nullrhi -nosound -unattended.
+ *
+ *  Options:
+ *      -NetSoak=Seconds        How long to run for once the bots are spawned and the clients connected. 300 if left out
+ *      -NetSoakBots=N          Number of CPU vehicles to spawn
+ *      -NetSoakClients=N       Number of headless clients to launch. They're closed when the soak is over
+ *      -NetSoakClientExe=Path  Client executable. This one, or the game next to a dedicated server, if left out
+ *      -NetSoakInterval=S      Seconds between measurements
+ *      -NetSoakVehicle=Class   Sports, Offroad or a vehicle class path. The game mode's pawn if left out
+ *      -Csv=Path               Appends a row per connection and measurement. Saved/Benchmarks/NetSoak.csv by default
+ *
+ *  The server exits when the soak is over.
+ */
+UCLASS(Config="Game")
+class UFutureRacingNetSoakSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+protected:
+
+	/** Number of bots spawned when -NetSoakBots isn't given */
+	UPROPERTY(Config)
+	int32 DefaultNumBots = 31;
+
+	/** Seconds between measurements when -NetSoakInterval isn't given */
+	UPROPERTY(Config)
+	float DefaultInterval = 5.0f;
+
+	/** Longest time to wait for the launched clients to connect before starting anyway, in seconds */
+	UPROPERTY(Config)
+	float ClientConnectTimeout = 60.0f;
+
+	/** Spawned bots */
+	TArray<TWeakObjectPtr<AFutureRacingPawn>> Bots;
+
+	/** Soak length, measurement interval and time elapsed, in seconds */
+	float Duration = 300.0f;
+	float Interval = 5.0f;
+	float Elapsed = 0.0f;
+	float MeasureCountdown = 0.0f;
+
+	/** Vehicle class and number of bots to spawn */
+	FString VehicleName;
+	int32 NumBots = 0;
+
+	/** CSV the measurements are appended to */
+	FString CsvFile;
+
+	/** Rows measured since the last write */
+	TArray<FString> PendingRows;
+
+	/** Launched client processes */
+	TArray<FProcHandle> ClientProcesses;
+
+	/** Time spent waiting for the launched clients to connect, in seconds */
+	float ConnectWaitTime = 0.0f;
+
+	/** If true, the soak is waiting for the launched clients to connect */
+	bool bWaitingForClients = false;
+
+	/** If true, the bots have been spawned and the soak is running */
+	bool bStarted = false;
+
+	/** Totals per connection over the whole soak */
+	struct FConnectionTotals
+	{
+		FString Address;
+		double OutBytesPerSecond = 0.0;
+		double SnapshotBytesPerSecond = 0.0;
+		double MaxOutBytesPerSecond = 0.0;
+		int32 NumMeasurements = 0;
+	};
+
+	TMap<TObjectKey<const UNetConnection>, FConnectionTotals> Totals;
+
+public:
+
+	// Begin UWorldSubsystem interface
+
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+
+	virtual void Deinitialize() override;
+
+	// End UWorldSubsystem interface
+
+	// Begin FTickableGameObject interface
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	// End FTickableGameObject interface
+
+protected:
+
+	/** Spreads the bots along the primary track */
+	void SpawnBots();
+
+	/** Launches headless clients connecting to this server */
+	void LaunchClients(int32 NumClients);
+
+	/** Closes the launched clients */
+	void CloseClients();
+
+	/** Logs and queues a CSV row for every client connection, then starts over */
+	void Measure(float MeasuredSeconds);
+
+	/** Logs the totals, writes the CSV and asks the engine to exit */
+	void Finish();
+};
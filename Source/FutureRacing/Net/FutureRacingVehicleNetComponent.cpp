@@ -0,0 +1,603 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "FutureRacingVehicleNetComponent.h"
+#include "FutureRacingPawn.h"
+#include "FutureRacingVehicleMovementComponent.h"
+#include "FutureRacingGateCrossingSubsystem.h"
+#include "ChaosWheeledVehicleMovementComponent.h"
+#include "Algo/BinarySearch.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "Engine/NetDriver.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "HAL/IConsoleManager.h"
+#include "Net/UnrealNetwork.h"
+#include "FutureRacing.h"
+
+DECLARE_CYCLE_STAT(TEXT("Vehicle Net"), STAT_FutureRacingVehicleNet, STATGROUP_FutureRacing);
+
+static TAutoConsoleVariable<float> CVarSnapshotRate(
+	TEXT("FutureRacing.Net.SnapshotRate"),
+	30.0f,
+	TEXT("Vehicle snapshots captured and replicated per second. Read when a vehicle starts play."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarInterpolationDelay(
+	TEXT("FutureRacing.Net.InterpolationDelay"),
+	0.1f,
+	TEXT("Seconds other players' vehicles are shown behind the newest snapshot, so there is always a snapshot to interpolate towards."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarMaxExtrapolation(
+	TEXT("FutureRacing.Net.MaxExtrapolation"),
+	0.25f,
+	TEXT("Seconds other players' vehicles keep moving along their last velocity when snapshots run out."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarMaxSparseExtrapolation(
+	TEXT("FutureRacing.Net.MaxSparseExtrapolation"),
+	1.5f,
+	TEXT("Seconds other players' vehicles keep moving along their last velocity when the server only sends them sparse keyframes."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarSmoothingRate(
+	TEXT("FutureRacing.Net.SmoothingRate"),
+	8.0f,
+	TEXT("How fast other players' vehicles blend out the jump when a snapshot disagrees with where they were extrapolated to. Higher is faster."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarCorrectionTolerance(
+	TEXT("FutureRacing.Net.CorrectionTolerance"),
+	10.0f,
+	TEXT("Prediction errors of the local vehicle below this many cm are left alone."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarSnapDistance(
+	TEXT("FutureRacing.Net.SnapDistance"),
+	500.0f,
+	TEXT("Prediction errors of the local vehicle beyond this many cm are corrected at once instead of blended out."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<float> CVarCorrectionRate(
+	TEXT("FutureRacing.Net.CorrectionRate"),
+	10.0f,
+	TEXT("How fast prediction errors of the local vehicle are blended out. Higher is faster."),
+	ECVF_Default);
+
+static FAutoConsoleCommandWithWorld DumpBandwidthCommand(
+	TEXT("FutureRacing.Net.DumpBandwidth"),
+	TEXT("Logs the snapshot bandwidth of every vehicle on the server and resets the measurements.\n")
+	TEXT("Counts snapshot payload only, use stat net for packet and bunch overhead."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (!World)
+		{
+			return;
+		}
+
+		int32 NumVehicles = 0;
+		double TotalBytesPerSecond = 0.0;
+
+		for (TActorIterator<AFutureRacingPawn> It(World); It; ++It)
+		{
+			UFutureRacingVehicleNetComponent* NetComponent = It->GetNetComponent();
+
+			if (!NetComponent || !It->HasAuthority() || It->IsDormant())
+			{
+				continue;
+			}
+
+			const FFutureRacingNetBandwidthStats Stats = NetComponent->GetBandwidthStats();
+
+			UE_LOG(LogFutureRacing, Display, TEXT("%s: %.0f B/s per connection, %.1f bytes per snapshot, %.0f%% deltas, %lld snapshots sent"),
+				*It->GetName(), Stats.BytesPerSecondPerConnection, Stats.AverageSnapshotBytes, Stats.DeltaFraction * 100.0, Stats.NumSends);
+
+			++NumVehicles;
+			TotalBytesPerSecond += Stats.BytesPerSecondPerConnection;
+
+			NetComponent->ResetBandwidthStats();
+		}
+
+		UE_LOG(LogFutureRacing, Display, TEXT("%d vehicles, avg %.0f B/s per vehicle per connection"),
+			NumVehicles, NumVehicles > 0 ? TotalBytesPerSecond / NumVehicles : 0.0);
+	}));
+
+UFutureRacingVehicleNetComponent::UFutureRacingVehicleNetComponent()
+{
+	// capture and apply after physics has moved the vehicle this frame
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.TickGroup = TG_PostPhysics;
+
+	SetIsReplicatedByDefault(true);
+}
+
+void UFutureRacingVehicleNetComponent::OnRegister()
+{
+	Super::OnRegister();
+
+	// snapshots can arrive before BeginPlay, so grab the vehicle as early as possible
+	Vehicle = Cast<AFutureRacingPawn>(GetOwner());
+
+	// the snapshot asks us how often each connection gets it
+	ReplicatedSnapshot.Owner = this;
+}
+
+void UFutureRacingVehicleNetComponent::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME(UFutureRacingVehicleNetComponent, ReplicatedSnapshot);
+}
+
+void UFutureRacingVehicleNetComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	// nothing to replicate in a standalone game
+	if (!Vehicle || GetNetMode() == NM_Standalone)
+	{
+		SetComponentTickEnabled(false);
+		return;
+	}
+
+	if (Vehicle->HasAuthority())
+	{
+		// the vehicle replicates as often as it captures snapshots
+		Vehicle->SetNetUpdateFrequency(FMath::Max(CVarSnapshotRate.GetValueOnGameThread(), 1.0f));
+
+		BandwidthStartTime = GetWorld()->GetTimeSeconds();
+
+		CaptureSnapshot();
+	}
+}
+
+void UFutureRacingVehicleNetComponent::TickComponent(float DeltaTime, enum ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	FUTURERACING_SCOPE_CYCLE_COUNTER(STAT_FutureRacingVehicleNet);
+
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	if (!Vehicle || Vehicle->IsDormant())
+	{
+		return;
+	}
+
+	const ENetRole Role = Vehicle->GetLocalRole();
+
+	if (Role == ROLE_Authority)
+	{
+		// capture on a fixed cadence, independent of the frame rate
+		SnapshotCountdown -= DeltaTime;
+
+		if (SnapshotCountdown <= 0.0f)
+		{
+			SnapshotCountdown = FMath::Max(SnapshotCountdown + 1.0f / FMath::Max(CVarSnapshotRate.GetValueOnGameThread(), 1.0f), 0.0f);
+
+			CaptureSnapshot();
+		}
+
+	} else if (Role == ROLE_AutonomousProxy) {
+
+		// our own vehicle is simulated locally. Possession can hand us a vehicle we were only watching
+		if (Vehicle->IsKinematicSimulation())
+		{
+			Vehicle->SetKinematicSimulation(false, ReplicatedSnapshot.Snapshot.State.GetVelocity());
+		}
+
+		SendInput(DeltaTime);
+
+		// remember what we predicted, to compare against the server later
+		const UPrimitiveComponent* Body = Vehicle->GetMesh();
+
+		FBodyState& Predicted = PredictedStates.AddDefaulted_GetRef();
+		Predicted.Time = GetPhysicsTime();
+		Predicted.Location = Body->GetComponentLocation();
+		Predicted.Rotation = Body->GetComponentQuat();
+		Predicted.Velocity = Body->GetPhysicsLinearVelocity();
+
+		const int32 NumExpired = Algo::LowerBoundBy(PredictedStates, Predicted.Time - PredictionHistoryLength, &FBodyState::Time);
+		PredictedStates.RemoveAt(0, NumExpired, EAllowShrinking::No);
+
+		ApplyCorrection(1.0f - FMath::Exp(-CVarCorrectionRate.GetValueOnGameThread() * DeltaTime));
+
+	} else if (Role == ROLE_SimulatedProxy) {
+
+		// everyone else's vehicles follow the snapshots instead of simulating
+		if (!Vehicle->IsKinematicSimulation())
+		{
+			Vehicle->SetKinematicSimulation(true, FVector::ZeroVector);
+		}
+
+		Interpolate(DeltaTime);
+	}
+}
+
+double UFutureRacingVehicleNetComponent::ServerToLocalTime(double ServerTime) const
+{
+	return bHasServerTimeOffset ? ServerTime + ServerTimeOffset : ServerTime;
+}
+
+FFutureRacingNetBandwidthStats UFutureRacingVehicleNetComponent::GetBandwidthStats() const
+{
+	const UNetDriver* NetDriver = GetWorld()->GetNetDriver();
+	const int32 NumConnections = NetDriver ? NetDriver->ClientConnections.Num() : 0;
+
+	const double Elapsed = GetWorld()->GetTimeSeconds() - BandwidthStartTime;
+	const double Bytes = ReplicatedSnapshot.NumBitsSent / 8.0;
+
+	FFutureRacingNetBandwidthStats Stats;
+	Stats.NumSends = ReplicatedSnapshot.NumSends;
+	Stats.BytesPerSecondPerConnection = NumConnections > 0 && Elapsed > 0.0 ? Bytes / Elapsed / NumConnections : 0.0;
+	Stats.AverageSnapshotBytes = Stats.NumSends > 0 ? Bytes / Stats.NumSends : 0.0;
+	Stats.DeltaFraction = Stats.NumSends > 0 ? static_cast<double>(ReplicatedSnapshot.NumDeltaSends) / Stats.NumSends : 0.0;
+
+	return Stats;
+}
+
+void UFutureRacingVehicleNetComponent::ResetBandwidthStats()
+{
+	ReplicatedSnapshot.NumBitsSent = 0;
+	ReplicatedSnapshot.NumSends = 0;
+	ReplicatedSnapshot.NumDeltaSends = 0;
+
+	BandwidthStartTime = GetWorld()->GetTimeSeconds();
+}
+
+void UFutureRacingVehicleNetComponent::ResetConnectionTiers()
+{
+	ConnectionTiers.Reset();
+}
+
+void UFutureRacingVehicleNetComponent::SetConnectionTier(const UNetConnection* Connection, EFutureRacingNetTier Tier, uint32 SendIntervalMs)
+{
+	FConnectionTier& ConnectionTier = ConnectionTiers.FindOrAdd(Connection);
+	ConnectionTier.Tier = Tier;
+	ConnectionTier.SendIntervalMs = SendIntervalMs;
+}
+
+EFutureRacingNetTier UFutureRacingVehicleNetComponent::GetConnectionTier(const UNetConnection* Connection) const
+{
+	const FConnectionTier* ConnectionTier = ConnectionTiers.Find(Connection);
+
+	return ConnectionTier ? ConnectionTier->Tier : EFutureRacingNetTier::Full;
+}
+
+uint32 UFutureRacingVehicleNetComponent::GetSendIntervalMs(const UNetConnection* Connection) const
+{
+	const FConnectionTier* ConnectionTier = ConnectionTiers.Find(Connection);
+
+	return ConnectionTier ? ConnectionTier->SendIntervalMs : 0;
+}
+
+float UFutureRacingVehicleNetComponent::GetPriorityScale(const UNetConnection* Connection) const
+{
+	const UFutureRacingNetSchedulerSubsystem* Scheduler = GetWorld()->GetSubsystem<UFutureRacingNetSchedulerSubsystem>();
+
+	return Scheduler ? Scheduler->GetPriorityScale(GetConnectionTier(Connection)) : 1.0f;
+}
+
+void UFutureRacingVehicleNetComponent::RecordSnapshotSent(const UNetConnection* Connection, int64 NumBits)
+{
+	if (UFutureRacingNetSchedulerSubsystem* Scheduler = GetWorld()->GetSubsystem<UFutureRacingNetSchedulerSubsystem>())
+	{
+		Scheduler->RecordSnapshotSent(Connection, NumBits);
+	}
+}
+
+void UFutureRacingVehicleNetComponent::ServerReceiveInput_Implementation(const FFutureRacingNetInput& Input)
+{
+	// inputs are unreliable, so an old one can turn up after a newer one
+	if (!Vehicle || Vehicle->IsDormant() || Input.Sequence <= LastInputSequence)
+	{
+		return;
+	}
+
+	LastInputSequence = Input.Sequence;
+	LastInputTime = GetPhysicsTime();
+
+	FutureRacingReplay::FQuantizedInput Quantized;
+	Quantized.Steering = Input.Steering;
+	Quantized.Throttle = Input.Throttle;
+	Quantized.Brake = Input.Brake;
+	Quantized.bHandbrake = Input.bHandbrake;
+
+	UChaosWheeledVehicleMovementComponent* Movement = Vehicle->GetChaosVehicleMovement();
+	Movement->SetSteeringInput(Quantized.GetSteering());
+	Movement->SetThrottleInput(Quantized.GetThrottle());
+	Movement->SetBrakeInput(Quantized.GetBrake());
+	Movement->SetHandbrakeInput(Quantized.bHandbrake);
+
+	Vehicle->GetRacingVehicleMovement()->SubmitInput();
+}
+
+void UFutureRacingVehicleNetComponent::OnRep_Snapshot()
+{
+	const FutureRacingNet::FSnapshot& Snapshot = ReplicatedSnapshot.Snapshot;
+
+	if (!Vehicle || Snapshot.Sequence <= LastReceivedSequence)
+	{
+		return;
+	}
+
+	LastReceivedSequence = Snapshot.Sequence;
+
+	// the smallest offset seen went through the least network delay. Creep upwards slowly so clock drift doesn't get stuck
+	const double ServerTime = Snapshot.ServerTimeMs / 1000.0;
+	const double Offset = GetPhysicsTime() - ServerTime;
+
+	if (!bHasServerTimeOffset || Offset < ServerTimeOffset)
+	{
+		ServerTimeOffset = Offset;
+
+	} else {
+
+		ServerTimeOffset += (Offset - ServerTimeOffset) * 0.01;
+	}
+
+	bHasServerTimeOffset = true;
+
+	if (Vehicle->GetLocalRole() == ROLE_AutonomousProxy)
+	{
+		Reconcile(Snapshot);
+
+	} else if (Vehicle->GetLocalRole() == ROLE_SimulatedProxy) {
+
+		// where the vehicle is shown before the new state can move it
+		const bool bWasShown = !BufferedStates.IsEmpty();
+		const FVector ShownLocation = Vehicle->GetActorLocation();
+		const FQuat ShownRotation = Vehicle->GetActorQuat();
+
+		FBodyState& Received = BufferedStates.AddDefaulted_GetRef();
+		Received.Time = ServerTime;
+		Received.Location = Snapshot.State.GetLocation();
+		Received.Rotation = Snapshot.State.GetRotation();
+		Received.Velocity = Snapshot.State.GetVelocity();
+
+		const int32 NumExpired = Algo::LowerBoundBy(BufferedStates, ServerTime - BufferLength, &FBodyState::Time);
+		BufferedStates.RemoveAt(0, NumExpired, EAllowShrinking::No);
+
+		// a sparse keyframe rarely lands where we extrapolated to, so blend out the difference instead of popping
+		if (bWasShown)
+		{
+			const FBodyState State = GetRenderState(GetRenderTime());
+
+			RenderLocationOffset = ShownLocation - State.Location;
+			RenderRotationOffset = ShownRotation * State.Rotation.Inverse();
+
+			if (RenderLocationOffset.Size() >= CVarSnapDistance.GetValueOnGameThread())
+			{
+				RenderLocationOffset = FVector::ZeroVector;
+				RenderRotationOffset = FQuat::Identity;
+			}
+		}
+	}
+}
+
+void UFutureRacingVehicleNetComponent::CaptureSnapshot()
+{
+	const UPrimitiveComponent* Body = Vehicle->GetMesh();
+	const UChaosWheeledVehicleMovementComponent* Movement = Vehicle->GetChaosVehicleMovement();
+
+	const double Now = GetPhysicsTime();
+	const FVector Location = Body->GetComponentLocation();
+
+	// kinematic vehicles have no physics velocity, so work it out from the last snapshot
+	FVector Velocity = Body->GetPhysicsLinearVelocity();
+
+	if (Vehicle->IsKinematicSimulation() && Now > LastCaptureTime)
+	{
+		Velocity = (Location - LastCaptureLocation) / (Now - LastCaptureTime);
+	}
+
+	LastCaptureLocation = Location;
+	LastCaptureTime = Now;
+
+	const FVector AngularVelocity = Body->GetPhysicsAngularVelocityInDegrees();
+	const FFutureRacingTimedInput Input = Vehicle->GetRacingVehicleMovement()->GetRawInput();
+
+	FutureRacingNet::FSnapshot& Snapshot = ReplicatedSnapshot.Snapshot;
+	++Snapshot.Sequence;
+	Snapshot.ServerTimeMs = static_cast<uint32>(FMath::Max<int64>(FMath::RoundToInt64(Now * 1000.0), 0));
+	Snapshot.State = FutureRacingReplay::FQuantizedState::Quantize(Location, Body->GetComponentQuat(), Velocity);
+	Snapshot.AngularVelocity = FIntVector(FMath::RoundToInt(AngularVelocity.X), FMath::RoundToInt(AngularVelocity.Y), FMath::RoundToInt(AngularVelocity.Z));
+	Snapshot.Input = FutureRacingReplay::FQuantizedInput::Quantize(Input.Steering, Input.Throttle, Input.Brake, Input.bHandbrake);
+	Snapshot.Gear = Movement->GetCurrentGear();
+	Snapshot.EngineRPM = FMath::RoundToInt(Movement->GetEngineRotationSpeed() / 10.0f);
+	Snapshot.LastInputSequence = LastInputSequence;
+	Snapshot.InputAgeMs = LastInputSequence > 0 ? static_cast<uint32>(FMath::Max(FMath::RoundToInt((Now - LastInputTime) * 1000.0), 0)) : 0;
+}
+
+void UFutureRacingVehicleNetComponent::SendInput(float DeltaTime)
+{
+	const FFutureRacingTimedInput Input = Vehicle->GetRacingVehicleMovement()->GetRawInput();
+	const FutureRacingReplay::FQuantizedInput Quantized = FutureRacingReplay::FQuantizedInput::Quantize(Input.Steering, Input.Throttle, Input.Brake, Input.bHandbrake);
+
+	const bool bChanged = Quantized.Steering != LastSentInput.Steering
+		|| Quantized.Throttle != LastSentInput.Throttle
+		|| Quantized.Brake != LastSentInput.Brake
+		|| Quantized.bHandbrake != LastSentInput.bHandbrake;
+
+	// resend unchanged input now and then, which covers lost packets and keeps the server's input age short
+	InputResendCountdown -= DeltaTime;
+
+	if (!bChanged && InputResendCountdown > 0.0f)
+	{
+		return;
+	}
+
+	InputResendCountdown = InputResendInterval;
+
+	++LastSentInput.Sequence;
+	LastSentInput.Steering = Quantized.Steering;
+	LastSentInput.Throttle = Quantized.Throttle;
+	LastSentInput.Brake = Quantized.Brake;
+	LastSentInput.bHandbrake = Quantized.bHandbrake;
+
+	ServerReceiveInput(LastSentInput);
+
+	FSentInput& Sent = SentInputs.AddDefaulted_GetRef();
+	Sent.Sequence = LastSentInput.Sequence;
+	Sent.Time = GetPhysicsTime();
+
+	const int32 NumExpired = Algo::LowerBoundBy(SentInputs, Sent.Time - PredictionHistoryLength, &FSentInput::Time);
+	SentInputs.RemoveAt(0, NumExpired, EAllowShrinking::No);
+}
+
+void UFutureRacingVehicleNetComponent::Reconcile(const FutureRacingNet::FSnapshot& Snapshot)
+{
+	// the server has been simulating our input for InputAgeMs, so compare against our state that long after we applied it
+	const FSentInput* Sent = SentInputs.FindByPredicate([&Snapshot](const FSentInput& Candidate)
+	{
+		return Candidate.Sequence == Snapshot.LastInputSequence;
+	});
+
+	if (!Sent)
+	{
+		return;
+	}
+
+	FBodyState Predicted;
+
+	if (!SampleStates(PredictedStates, Sent->Time + Snapshot.InputAgeMs / 1000.0, Predicted))
+	{
+		return;
+	}
+
+	const FVector LocationError = Snapshot.State.GetLocation() - Predicted.Location;
+	const double Error = LocationError.Size();
+
+	// quantization alone accounts for a few cm
+	if (Error < CVarCorrectionTolerance.GetValueOnGameThread())
+	{
+		PendingLocationCorrection = FVector::ZeroVector;
+		PendingRotationCorrection = FQuat::Identity;
+		PendingVelocityCorrection = FVector::ZeroVector;
+		return;
+	}
+
+	// earlier corrections have already moved the predicted states, so this replaces whatever is still pending
+	PendingLocationCorrection = LocationError;
+	PendingRotationCorrection = Snapshot.State.GetRotation() * Predicted.Rotation.Inverse();
+	PendingVelocityCorrection = Snapshot.State.GetVelocity() - Predicted.Velocity;
+
+	// too far off to blend without driving through things
+	if (Error >= CVarSnapDistance.GetValueOnGameThread())
+	{
+		ApplyCorrection(1.0f);
+	}
+}
+
+void UFutureRacingVehicleNetComponent::ApplyCorrection(float Fraction)
+{
+	if (PendingLocationCorrection.IsNearlyZero() && PendingVelocityCorrection.IsNearlyZero() && PendingRotationCorrection.Equals(FQuat::Identity))
+	{
+		return;
+	}
+
+	const FVector LocationStep = PendingLocationCorrection * Fraction;
+	const FQuat RotationStep = FQuat::Slerp(FQuat::Identity, PendingRotationCorrection, Fraction);
+	const FVector VelocityStep = PendingVelocityCorrection * Fraction;
+
+	PendingLocationCorrection -= LocationStep;
+	PendingRotationCorrection = RotationStep.Inverse() * PendingRotationCorrection;
+	PendingVelocityCorrection -= VelocityStep;
+
+	UPrimitiveComponent* Body = Vehicle->GetMesh();
+
+	Vehicle->SetActorLocationAndRotation(Body->GetComponentLocation() + LocationStep, RotationStep * Body->GetComponentQuat(), false, nullptr, ETeleportType::TeleportPhysics);
+	Body->SetPhysicsLinearVelocity(VelocityStep, true);
+
+	// the states we predicted before the correction were off by the same amount
+	for (FBodyState& State : PredictedStates)
+	{
+		State.Location += LocationStep;
+		State.Rotation = RotationStep * State.Rotation;
+		State.Velocity += VelocityStep;
+	}
+}
+
+void UFutureRacingVehicleNetComponent::Interpolate(float DeltaTime)
+{
+	if (BufferedStates.IsEmpty())
+	{
+		return;
+	}
+
+	const FBodyState State = GetRenderState(GetRenderTime());
+
+	// decay the smoothing offset left by the last snapshot
+	const float Fraction = FMath::Exp(-CVarSmoothingRate.GetValueOnGameThread() * DeltaTime);
+
+	RenderLocationOffset *= Fraction;
+	RenderRotationOffset = FQuat::Slerp(FQuat::Identity, RenderRotationOffset, Fraction);
+
+	// moved without teleporting, so the kinematic body still pushes what it drives into
+	Vehicle->SetActorLocationAndRotation(State.Location + RenderLocationOffset, RenderRotationOffset * State.Rotation);
+}
+
+double UFutureRacingVehicleNetComponent::GetRenderTime() const
+{
+	return GetPhysicsTime() - ServerTimeOffset - CVarInterpolationDelay.GetValueOnGameThread();
+}
+
+UFutureRacingVehicleNetComponent::FBodyState UFutureRacingVehicleNetComponent::GetRenderState(double RenderTime) const
+{
+	FBodyState State;
+
+	if (SampleStates(BufferedStates, RenderTime, State))
+	{
+		return State;
+	}
+
+	const FBodyState& Newest = BufferedStates.Last();
+
+	if (RenderTime <= Newest.Time)
+	{
+		return BufferedStates[0];
+	}
+
+	// snapshots ran out, keep going along the last velocity for a little while.
+	// Vehicles the server only sends sparse keyframes for run out every time, so they go on for longer
+	const float InterpolationDelay = CVarInterpolationDelay.GetValueOnGameThread();
+	const bool bSparse = BufferedStates.Num() >= 2 && Newest.Time - BufferedStates.Last(1).Time > InterpolationDelay;
+
+	const double MaxExtrapolation = bSparse ? CVarMaxSparseExtrapolation.GetValueOnGameThread() : CVarMaxExtrapolation.GetValueOnGameThread();
+
+	State = Newest;
+	State.Time = RenderTime;
+	State.Location += Newest.Velocity * FMath::Min(RenderTime - Newest.Time, MaxExtrapolation);
+
+	return State;
+}
+
+double UFutureRacingVehicleNetComponent::GetPhysicsTime() const
+{
+	const UFutureRacingGateCrossingSubsystem* GateCrossing = GetWorld()->GetSubsystem<UFutureRacingGateCrossingSubsystem>();
+
+	return GateCrossing ? GateCrossing->GetPhysicsResultsTime() : GetWorld()->GetTimeSeconds();
+}
+
+bool UFutureRacingVehicleNetComponent::SampleStates(const TArray<FBodyState>& States, double Time, FBodyState& OutState)
+{
+	if (States.Num() < 2 || Time < States[0].Time || Time > States.Last().Time)
+	{
+		return false;
+	}
+
+	const int32 Next = FMath::Max(Algo::LowerBoundBy(States, Time, &FBodyState::Time), 1);
+
+	const FBodyState& From = States[Next - 1];
+	const FBodyState& To = States[Next];
+
+	const double Span = To.Time - From.Time;
+	const double Alpha = Span > UE_SMALL_NUMBER ? (Time - From.Time) / Span : 1.0;
+
+	// cubic through both velocities, so the path stays smooth through each state
+	OutState.Time = Time;
+	OutState.Location = FMath::CubicInterp(From.Location, From.Velocity * Span, To.Location, To.Velocity * Span, Alpha);
+	OutState.Rotation = FQuat::Slerp(From.Rotation, To.Rotation, Alpha);
+	OutState.Velocity = FMath::Lerp(From.Velocity, To.Velocity, Alpha);
+
+	return true;
+}
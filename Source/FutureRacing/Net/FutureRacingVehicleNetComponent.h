@@ -0,0 +1,244 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "FutureRacingNetSnapshot.h"
+#include "FutureRacingNetSchedulerSubsystem.h"
+#include "UObject/ObjectKey.h"
+#include "FutureRacingVehicleNetComponent.generated.h"
+
+class AFutureRacingPawn;
+class UNetConnection;
+
+/**
+ *  Quantized control input sent from the owning client to the server
+ */
+USTRUCT()
+struct FFutureRacingNetInput
+{
+	GENERATED_BODY()
+
+	/** Increases by one for every input the client sends */
+	UPROPERTY()
+	uint32 Sequence = 0;
+
+	UPROPERTY()
+	int8 Steering = 0;
+
+	UPROPERTY()
+	uint8 Throttle = 0;
+
+	UPROPERTY()
+	uint8 Brake = 0;
+
+	UPROPERTY()
+	bool bHandbrake = false;
+};
+
+/**
+ *  Snapshot bandwidth measured on the server
+ */
+struct FFutureRacingNetBandwidthStats
+{
+	/** Snapshot bytes sent per second, averaged over client connections */
+	double BytesPerSecondPerConnection = 0.0;
+
+	/** Average size of a sent snapshot, in bytes */
+	double AverageSnapshotBytes = 0.0;
+
+	/** Share of sent snapshots that were deltas */
+	double DeltaFraction = 0.0;
+
+	/** Snapshots sent, over all connections */
+	int64 NumSends = 0;
+};
+
+/**
+ *  Replicates a vehicle's physics state as quantized, delta compressed snapshots.
+ *
+ *  The server captures a snapshot at the snapshot rate. The owning client predicts its own
+ *  vehicle from local input, sends that input to the server and blends out the difference
+ *  between the server's state and what it predicted at the same point of the input stream.
+ *  Other clients move their copies of the vehicle kinematically, interpolating between buffered snapshots.
+ */
+UCLASS()
+class UFutureRacingVehicleNetComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+protected:
+
+	/** Latest vehicle state */
+	UPROPERTY(ReplicatedUsing=OnRep_Snapshot)
+	FFutureRacingReplicatedSnapshot ReplicatedSnapshot;
+
+	/** Owning vehicle */
+	TObjectPtr<AFutureRacingPawn> Vehicle;
+
+	/** Server: time left until the next snapshot */
+	float SnapshotCountdown = 0.0f;
+
+	/** Server: body location and physics time of the last snapshot, for vehicles moved kinematically */
+	FVector LastCaptureLocation = FVector::ZeroVector;
+	double LastCaptureTime = 0.0;
+
+	/** Server: last input received from the owning client, and the physics time it was applied at */
+	uint32 LastInputSequence = 0;
+	double LastInputTime = 0.0;
+
+	/** Server: world time the bandwidth measurements started at */
+	double BandwidthStartTime = 0.0;
+
+	/** Server: how much a client connection cares about this vehicle */
+	struct FConnectionTier
+	{
+		EFutureRacingNetTier Tier = EFutureRacingNetTier::Full;
+		uint32 SendIntervalMs = 0;
+	};
+
+	/** Server: tier per client connection, from the last ranking */
+	TMap<TObjectKey<const UNetConnection>, FConnectionTier> ConnectionTiers;
+
+	/** Owning client: input sent to the server, and the local physics time it was applied at */
+	struct FSentInput
+	{
+		uint32 Sequence = 0;
+		double Time = 0.0;
+	};
+
+	/** Owning client: sent inputs, oldest first */
+	TArray<FSentInput> SentInputs;
+
+	/** Owning client: last input sent to the server */
+	FFutureRacingNetInput LastSentInput;
+
+	/** Owning client: time left until the input is sent again, even if it hasn't changed */
+	float InputResendCountdown = 0.0f;
+
+	/** Body state at a point in time */
+	struct FBodyState
+	{
+		double Time = 0.0;
+		FVector Location = FVector::ZeroVector;
+		FQuat Rotation = FQuat::Identity;
+		FVector Velocity = FVector::ZeroVector;
+	};
+
+	/** Owning client: predicted states, oldest first */
+	TArray<FBodyState> PredictedStates;
+
+	/** Owning client: server correction still waiting to be blended in */
+	FVector PendingLocationCorrection = FVector::ZeroVector;
+	FQuat PendingRotationCorrection = FQuat::Identity;
+	FVector PendingVelocityCorrection = FVector::ZeroVector;
+
+	/** Other clients: received states, on the server clock, oldest first */
+	TArray<FBodyState> BufferedStates;
+
+	/** Other clients: offset from the buffered state to where the vehicle is shown, blended out over time */
+	FVector RenderLocationOffset = FVector::ZeroVector;
+	FQuat RenderRotationOffset = FQuat::Identity;
+
+	/** Sequence of the last snapshot we acted on */
+	uint32 LastReceivedSequence = 0;
+
+	/** Local physics time minus server physics time, estimated from received snapshots */
+	double ServerTimeOffset = 0.0;
+
+	/** If true, ServerTimeOffset holds an estimate */
+	bool bHasServerTimeOffset = false;
+
+	/** Time an unchanged input is resent after, so the server's input age stays fresh */
+	static constexpr float InputResendInterval = 0.1f;
+
+	/** Seconds of predicted states and sent inputs kept for reconciliation */
+	static constexpr double PredictionHistoryLength = 2.0;
+
+	/** Seconds of received states kept for interpolation */
+	static constexpr double BufferLength = 1.0;
+
+public:
+
+	UFutureRacingVehicleNetComponent();
+
+	// Begin ActorComponent interface
+
+	virtual void OnRegister() override;
+
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
+	virtual void BeginPlay() override;
+
+	virtual void TickComponent(float DeltaTime, enum ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+	// End ActorComponent interface
+
+	/** Converts a server physics time to the local physics clock. Returns the time unchanged until a snapshot arrives */
+	double ServerToLocalTime(double ServerTime) const;
+
+	/** Returns the snapshot bandwidth measured on the server since the last reset */
+	FFutureRacingNetBandwidthStats GetBandwidthStats() const;
+
+	/** Clears the bandwidth measurements */
+	void ResetBandwidthStats();
+
+	/** Server: forgets the tiers of every connection, before a new ranking */
+	void ResetConnectionTiers();
+
+	/** Server: sets how much a connection cares about this vehicle, and how often it gets its snapshots */
+	void SetConnectionTier(const UNetConnection* Connection, EFutureRacingNetTier Tier, uint32 SendIntervalMs);
+
+	/** Server: returns the tier of a connection. Connections that weren't ranked yet get everything */
+	EFutureRacingNetTier GetConnectionTier(const UNetConnection* Connection) const;
+
+	/** Server: returns the time between snapshots sent to a connection, in ms. Zero sends every snapshot */
+	uint32 GetSendIntervalMs(const UNetConnection* Connection) const;
+
+	/** Server: returns the net priority multiplier for a connection */
+	float GetPriorityScale(const UNetConnection* Connection) const;
+
+	/** Server: counts a snapshot sent to a connection */
+	void RecordSnapshotSent(const UNetConnection* Connection, int64 NumBits);
+
+protected:
+
+	/** Applies an input sent by the owning client */
+	UFUNCTION(Server, Unreliable)
+	void ServerReceiveInput(const FFutureRacingNetInput& Input);
+
+	/** Handles a new snapshot on clients */
+	UFUNCTION()
+	void OnRep_Snapshot();
+
+	/** Server: quantizes the vehicle's current state into the replicated snapshot */
+	void CaptureSnapshot();
+
+	/** Owning client: sends the current input to the server if it changed or is due again */
+	void SendInput(float DeltaTime);
+
+	/** Owning client: compares a snapshot against the state we predicted for the same input and queues a correction */
+	void Reconcile(const FutureRacingNet::FSnapshot& Snapshot);
+
+	/**
+	 *  Owning client: moves part of the pending correction into the body
+	 *  @param Fraction Share of the pending correction to apply, from 0 to 1
+	 */
+	void ApplyCorrection(float Fraction);
+
+	/** Other clients: moves the vehicle to the buffered state at the interpolation delay */
+	void Interpolate(float DeltaTime);
+
+	/** Other clients: returns the time on the server clock the vehicle is shown at */
+	double GetRenderTime() const;
+
+	/** Other clients: returns the buffered state at the given time, extrapolated if the snapshots ran out */
+	FBodyState GetRenderState(double RenderTime) const;
+
+	/** Returns the physics time laps are timed on */
+	double GetPhysicsTime() const;
+
+	/** Returns the interpolated state at the given time, or false if the time isn't covered */
+	static bool SampleStates(const TArray<FBodyState>& States, double Time, FBodyState& OutState);
+};
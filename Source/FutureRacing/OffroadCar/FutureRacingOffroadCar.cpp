@@ -85,4 +85,23 @@ AFutureRacingOffroadCar::AFutureRacingOffroadCar()
 	// NOTE: Check the Blueprint asset for the Steering Curve
 	GetChaosVehicleMovement()->SteeringSetup.SteeringType = ESteeringType::AngleRatio;
 	GetChaosVehicleMovement()->SteeringSetup.AngleRatio = 0.7f;
-}
\ No newline at end of file
+}
+
+void AFutureRacingOffroadCar::StripCosmetics()
+{
+	Super::StripCosmetics();
+
+	// the tires don't collide, so nothing on the server depends on them
+	for (UStaticMeshComponent* Tire : { TireFrontLeft, TireFrontRight, TireRearLeft, TireRearRight })
+	{
+		if (Tire)
+		{
+			Tire->DestroyComponent();
+		}
+	}
+
+	TireFrontLeft = nullptr;
+	TireFrontRight = nullptr;
+	TireRearLeft = nullptr;
+	TireRearRight = nullptr;
+}
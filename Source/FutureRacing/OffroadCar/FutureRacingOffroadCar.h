@@ -37,4 +37,9 @@ class AFutureRacingOffroadCar : public AFutureRacingPawn
 public:
 
 	AFutureRacingOffroadCar();
+
+protected:
+
+	/** Also removes the tire meshes, which are only there to be seen */
+	virtual void StripCosmetics() override;
 };
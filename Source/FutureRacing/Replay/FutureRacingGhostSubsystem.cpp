@@ -0,0 +1,409 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "FutureRacingGhostSubsystem.h"
+#include "FutureRacingGhostVehicle.h"
+#include "FutureRacingReplaySubsystem.h"
+#include "FutureRacingGateCrossingSubsystem.h"
+#include "FutureRacingPawn.h"
+#include "Async/Async.h"
+#include "Engine/World.h"
+#include "HAL/FileManager.h"
+#include "Materials/MaterialInterface.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "FutureRacing.h"
+
+DECLARE_CYCLE_STAT(TEXT("Ghost Playback"), STAT_FutureRacingGhostPlayback, STATGROUP_FutureRacing);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Visible Ghosts"), STAT_FutureRacingVisibleGhosts, STATGROUP_FutureRacing);
+
+void UFutureRacingGhostSubsystem::LoadGhosts()
+{
+	if (!LoadedGhostMaterial && GhostMaterial.IsValid())
+	{
+		LoadedGhostMaterial = Cast<UMaterialInterface>(GhostMaterial.TryLoad());
+	}
+
+	const FString Folder = FPaths::Combine(FPaths::ProjectSavedDir(), GhostFolder);
+
+	TArray<FString> Filenames;
+	IFileManager::Get().FindFiles(Filenames, *FPaths::Combine(Folder, GetGhostMapName() + TEXT("_*") + FutureRacingReplay::FileExtension), true, false);
+
+	for (const FString& Filename : Filenames)
+	{
+		AddGhosts(FPaths::Combine(Folder, Filename));
+	}
+}
+
+void UFutureRacingGhostSubsystem::StartPlayback(double LapStartTime)
+{
+	PlaybackStartTime = LapStartTime;
+}
+
+void UFutureRacingGhostSubsystem::StopPlayback()
+{
+	PlaybackStartTime = -1.0;
+
+	for (const FGhost& Ghost : Ghosts)
+	{
+		if (AFutureRacingGhostVehicle* Actor = Ghost.Actor.Get())
+		{
+			Actor->SetActorHiddenInGame(true);
+		}
+	}
+}
+
+void UFutureRacingGhostSubsystem::SaveBestLap(AFutureRacingPawn* Vehicle, double LapStartTime, double LapEndTime)
+{
+	if (!Vehicle || LapEndTime <= LapStartTime)
+	{
+		return;
+	}
+
+	// the lap is only the best of this session, so check it against the one saved from earlier sessions
+	const double LapTime = LapEndTime - LapStartTime;
+
+	if (SavedBestLapTime > 0.0 && LapTime >= SavedBestLapTime)
+	{
+		UE_LOG(LogFutureRacing, Log, TEXT("Lap of %.3fs doesn't beat the saved best of %.3fs, ghost kept."), LapTime, SavedBestLapTime);
+		return;
+	}
+
+	if (PendingExport.IsSet() && LapTime >= PendingExport->LapEndTime - PendingExport->LapStartTime)
+	{
+		return;
+	}
+
+	// a faster lap replaces one that hasn't been exported yet
+	FPendingExport& Export = PendingExport.Emplace();
+	Export.Vehicle = Vehicle;
+	Export.LapStartTime = LapStartTime;
+	Export.LapEndTime = LapEndTime;
+	Export.RequestTime = GetPhysicsTime();
+}
+
+FString UFutureRacingGhostSubsystem::GetBestLapFilename() const
+{
+	return FPaths::Combine(FPaths::ProjectSavedDir(), GhostFolder, GetGhostMapName() + TEXT("_Best") + FutureRacingReplay::FileExtension);
+}
+
+bool UFutureRacingGhostSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	// ghosts are purely cosmetic, so a dedicated server has no use for them
+	return Super::ShouldCreateSubsystem(Outer) && !IsRunningDedicatedServer();
+}
+
+void UFutureRacingGhostSubsystem::Deinitialize()
+{
+	for (const FGhost& Ghost : Ghosts)
+	{
+		if (AFutureRacingGhostVehicle* Actor = Ghost.Actor.Get())
+		{
+			Actor->Destroy();
+		}
+	}
+
+	// unmaps the files. Exports still running hold on to their own source file
+	Ghosts.Empty();
+	PendingExport.Reset();
+
+	Super::Deinitialize();
+}
+
+void UFutureRacingGhostSubsystem::Tick(float DeltaTime)
+{
+	if (PendingExport.IsSet())
+	{
+		UpdatePendingExport();
+	}
+
+	if (PlaybackStartTime < 0.0 || Ghosts.Num() == 0)
+	{
+		return;
+	}
+
+	FUTURERACING_SCOPE_CYCLE_COUNTER(STAT_FutureRacingGhostPlayback);
+
+	const double LapTime = GetPhysicsTime() - PlaybackStartTime;
+
+	for (FGhost& Ghost : Ghosts)
+	{
+		AFutureRacingGhostVehicle* Actor = Ghost.Actor.Get();
+
+		if (!Actor)
+		{
+			continue;
+		}
+
+		// ghosts are only shown while their lap is running
+		FTransform Transform;
+		const bool bVisible = Ghost.Cursor.Sample(LapTime, Transform);
+
+		if (bVisible)
+		{
+			Actor->SetActorLocationAndRotation(Transform.GetLocation(), Transform.GetRotation(), false, nullptr, ETeleportType::TeleportPhysics);
+			INC_DWORD_STAT(STAT_FutureRacingVisibleGhosts);
+		}
+
+		if (Actor->IsHidden() == bVisible)
+		{
+			Actor->SetActorHiddenInGame(!bVisible);
+		}
+	}
+}
+
+TStatId UFutureRacingGhostSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UFutureRacingGhostSubsystem, STATGROUP_Tickables);
+}
+
+void UFutureRacingGhostSubsystem::AddGhosts(const FString& Filename)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE_ON_CHANNEL(UFutureRacingGhostSubsystem::AddGhosts, FutureRacingChannel);
+	LLM_SCOPE_BYTAG(FutureRacing_Replay);
+
+	TSharedPtr<const FFutureRacingReplayFile, ESPMode::ThreadSafe> File = FFutureRacingReplayFile::Open(Filename);
+
+	if (!File)
+	{
+		return;
+	}
+
+	// remember how fast the saved best lap is, so only a faster one replaces it
+	if (Filename == GetBestLapFilename() && File->GetHeader().LapTime > 0.0)
+	{
+		SavedBestLapTime = File->GetHeader().LapTime;
+	}
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	SpawnParams.ObjectFlags |= RF_Transient;
+
+	for (const FFutureRacingReplayFile::FVehicleEntry& Vehicle : File->GetVehicles())
+	{
+		if (Ghosts.Num() >= MaxGhosts)
+		{
+			UE_LOG(LogFutureRacing, Warning, TEXT("Ghost limit of %d reached, skipping the rest of '%s'."), MaxGhosts, *Filename);
+			break;
+		}
+
+		FFutureRacingReplayCursor Cursor(File, Vehicle.Vehicle.VehicleId);
+
+		if (!Cursor.IsValid())
+		{
+			continue;
+		}
+
+		AFutureRacingGhostVehicle* Actor = GetWorld()->SpawnActor<AFutureRacingGhostVehicle>(FVector::ZeroVector, FRotator::ZeroRotator, SpawnParams);
+
+		if (!Actor)
+		{
+			continue;
+		}
+
+		Actor->SetAppearance(LoadClass<AFutureRacingPawn>(nullptr, *Vehicle.Vehicle.ClassPath), LoadedGhostMaterial);
+		Actor->SetActorHiddenInGame(true);
+
+		FGhost& Ghost = Ghosts.AddDefaulted_GetRef();
+		Ghost.Actor = Actor;
+		Ghost.Cursor = MoveTemp(Cursor);
+		Ghost.Filename = Filename;
+	}
+
+	UE_LOG(LogFutureRacing, Log, TEXT("Loaded ghost '%s' (%s)."), *Filename, File->IsMapped() ? TEXT("mapped") : TEXT("loaded"));
+}
+
+void UFutureRacingGhostSubsystem::RemoveGhosts(const FString& Filename)
+{
+	for (int32 Index = Ghosts.Num() - 1; Index >= 0; --Index)
+	{
+		if (Ghosts[Index].Filename != Filename)
+		{
+			continue;
+		}
+
+		if (AFutureRacingGhostVehicle* Actor = Ghosts[Index].Actor.Get())
+		{
+			Actor->Destroy();
+		}
+
+		Ghosts.RemoveAt(Index);
+	}
+}
+
+void UFutureRacingGhostSubsystem::UpdatePendingExport()
+{
+	FPendingExport& Export = PendingExport.GetValue();
+
+	UFutureRacingReplaySubsystem* Replay = GetWorld()->GetSubsystem<UFutureRacingReplaySubsystem>();
+	AFutureRacingPawn* Vehicle = Export.Vehicle.Get();
+
+	if (!Replay || !Vehicle || Replay->GetVehicleId(Vehicle) == INDEX_NONE)
+	{
+		// the lap wasn't recorded
+		PendingExport.Reset();
+		return;
+	}
+
+	// give the recorder time to pick up the last steps of the lap
+	if (Export.FlushMarker < 0)
+	{
+		if (GetPhysicsTime() - Export.RequestTime < ExportDelay)
+		{
+			return;
+		}
+
+		Export.FlushMarker = Replay->FlushVehicle(Vehicle);
+
+		if (Export.FlushMarker < 0)
+		{
+			PendingExport.Reset();
+		}
+
+		return;
+	}
+
+	// the lap is read back from the replay file, so wait until the writer got it there
+	if (!Replay->IsOnDisk(Export.FlushMarker))
+	{
+		return;
+	}
+
+	const FString SourceFile = Replay->GetFilename();
+	const FString DestFile = GetBestLapFilename();
+	const uint32 VehicleId = Replay->GetVehicleId(Vehicle);
+	const double LapStartTime = Export.LapStartTime;
+	const double LapEndTime = Export.LapEndTime;
+
+	PendingExport.Reset();
+
+	// let go of the old best lap, so its file can be replaced
+	RemoveGhosts(DestFile);
+
+	TWeakObjectPtr<UFutureRacingGhostSubsystem> WeakThis(this);
+
+	Async(EAsyncExecution::ThreadPool, [WeakThis, SourceFile, DestFile, VehicleId, LapStartTime, LapEndTime]()
+	{
+		// the old best lap is only overwritten on success, so bring it back either way
+		ExportLap(SourceFile, VehicleId, LapStartTime, LapEndTime, DestFile);
+
+		AsyncTask(ENamedThreads::GameThread, [WeakThis, DestFile]()
+		{
+			UFutureRacingGhostSubsystem* GhostSubsystem = WeakThis.Get();
+
+			if (GhostSubsystem && IFileManager::Get().FileExists(*DestFile))
+			{
+				GhostSubsystem->AddGhosts(DestFile);
+			}
+		});
+	});
+}
+
+double UFutureRacingGhostSubsystem::GetPhysicsTime() const
+{
+	// ghosts run on the same clock laps are timed with
+	const UFutureRacingGateCrossingSubsystem* GateCrossing = GetWorld()->GetSubsystem<UFutureRacingGateCrossingSubsystem>();
+
+	return GateCrossing ? GateCrossing->GetPhysicsResultsTime() : GetWorld()->GetTimeSeconds();
+}
+
+FString UFutureRacingGhostSubsystem::GetGhostMapName() const
+{
+	return UWorld::RemovePIEPrefix(GetWorld()->GetMapName());
+}
+
+bool UFutureRacingGhostSubsystem::ExportLap(const FString& SourceFile, uint32 VehicleId, double LapStartTime, double LapEndTime, const FString& DestFile)
+{
+	using namespace FutureRacingReplay;
+
+	TRACE_CPUPROFILER_EVENT_SCOPE_ON_CHANNEL(UFutureRacingGhostSubsystem::ExportLap, FutureRacingChannel);
+	LLM_SCOPE_BYTAG(FutureRacing_Replay);
+
+	TSharedPtr<const FFutureRacingReplayFile, ESPMode::ThreadSafe> Source = FFutureRacingReplayFile::Open(SourceFile);
+	const FFutureRacingReplayFile::FVehicleEntry* Vehicle = Source ? Source->FindVehicle(VehicleId) : nullptr;
+
+	if (!Vehicle)
+	{
+		UE_LOG(LogFutureRacing, Warning, TEXT("Could not find vehicle %u in replay '%s' to export a ghost lap."), VehicleId, *SourceFile);
+		return false;
+	}
+
+	// collect the keyframes of the lap, starting from the block the lap started in
+	TArray<FSample> Keyframes;
+
+	for (int32 BlockIndex = FMath::Max(Source->FindBlock(*Vehicle, LapStartTime), 0); BlockIndex < Vehicle->Blocks.Num(); ++BlockIndex)
+	{
+		const FFutureRacingReplayFile::FBlockEntry& Block = Vehicle->Blocks[BlockIndex];
+
+		if (Block.Header.FirstTime > LapEndTime)
+		{
+			// keep one keyframe past the end so the ghost can interpolate up to the line
+			FSample FirstSample;
+
+			if (Source->DecodeFirstSample(Block, FirstSample))
+			{
+				Keyframes.Add(FirstSample);
+			}
+
+			break;
+		}
+
+		Source->DecodeKeyframes(Block, Keyframes);
+	}
+
+	// trim to the lap, keeping one keyframe either side of it
+	const int32 FirstIndex = FMath::Max(Keyframes.IndexOfByPredicate([LapStartTime](const FSample& Sample) { return Sample.Time >= LapStartTime; }) - 1, 0);
+	int32 LastIndex = Keyframes.IndexOfByPredicate([LapEndTime](const FSample& Sample) { return Sample.Time >= LapEndTime; });
+
+	if (LastIndex == INDEX_NONE)
+	{
+		LastIndex = Keyframes.Num() - 1;
+	}
+
+	// a lap with its start missing, e.g. recorded from mid lap or dropped, makes a poor ghost
+	if (Keyframes.Num() == 0 || Keyframes[FirstIndex].Time > LapStartTime + 0.5 || Keyframes[LastIndex].Time < LapEndTime - 0.5)
+	{
+		UE_LOG(LogFutureRacing, Warning, TEXT("Replay '%s' doesn't cover the lap from %.3f to %.3f, no ghost saved."), *SourceFile, LapStartTime, LapEndTime);
+		return false;
+	}
+
+	// ghost laps hold only keyframes, timed from the start of the lap
+	TArray<uint8> Bytes;
+
+	FFileHeader Header;
+	Header.MapName = Source->GetHeader().MapName;
+	Header.RecordedAt = Source->GetHeader().RecordedAt;
+	Header.LapTime = LapEndTime - LapStartTime;
+	WriteFileHeader(Bytes, Header);
+
+	FVehicleBlock VehicleBlock = Vehicle->Vehicle;
+	VehicleBlock.VehicleId = 0;
+	WriteVehicleBlock(Bytes, VehicleBlock);
+
+	FStepBlockEncoder Encoder(1);
+
+	for (int32 Index = FirstIndex; Index <= LastIndex; ++Index)
+	{
+		const FSample& Keyframe = Keyframes[Index];
+
+		Encoder.AddSample(Keyframe.Time - LapStartTime, Keyframe.Input, Keyframe.State);
+
+		if (Encoder.GetNumSamples() >= DefaultSamplesPerBlock)
+		{
+			Encoder.Flush(0, Bytes);
+		}
+	}
+
+	Encoder.Flush(0, Bytes);
+
+	if (!FFileHelper::SaveArrayToFile(Bytes, *DestFile))
+	{
+		UE_LOG(LogFutureRacing, Warning, TEXT("Could not save ghost lap '%s'."), *DestFile);
+		return false;
+	}
+
+	UE_LOG(LogFutureRacing, Log, TEXT("Saved %.3fs ghost lap to '%s' (%d keyframes, %.1f KB)."),
+		LapEndTime - LapStartTime, *DestFile, LastIndex - FirstIndex + 1, Bytes.Num() / 1024.0);
+
+	return true;
+}
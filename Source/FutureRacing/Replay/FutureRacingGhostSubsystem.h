@@ -0,0 +1,150 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "FutureRacingReplayFile.h"
+#include "FutureRacingGhostSubsystem.generated.h"
+
+class AFutureRacingPawn;
+class AFutureRacingGhostVehicle;
+class UMaterialInterface;
+
+/**
+ *  Plays back recorded laps as ghost cars.
+ *  Ghost laps are small replay files holding only keyframes, timed from the start of the lap.
+ *  They are memory mapped and sampled every frame onto ghost actors that have no physics at all,
+ *  so racing against dozens of ghosts adds no Chaos simulation work.
+ *  New best laps are cut out of the live replay recording in the background.
+ */
+UCLASS(Config="Game")
+class UFutureRacingGhostSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+protected:
+
+	/** Folder ghost laps are kept in, relative to the project's Saved folder */
+	UPROPERTY(Config)
+	FString GhostFolder = TEXT("Replays/Ghosts");
+
+	/** Maximum number of ghosts shown at once */
+	UPROPERTY(Config)
+	int32 MaxGhosts = 32;
+
+	/** Time to wait after a lap before cutting it out of the replay, so its last steps are recorded */
+	UPROPERTY(Config)
+	float ExportDelay = 1.0f;
+
+	/** Optional material applied to every ghost */
+	UPROPERTY(Config)
+	FSoftObjectPath GhostMaterial;
+
+	/** Loaded ghost material */
+	UPROPERTY()
+	TObjectPtr<UMaterialInterface> LoadedGhostMaterial;
+
+	/** A ghost being played back */
+	struct FGhost
+	{
+		TWeakObjectPtr<AFutureRacingGhostVehicle> Actor;
+
+		/** Samples the ghost's lap */
+		FFutureRacingReplayCursor Cursor;
+
+		/** File the lap was loaded from */
+		FString Filename;
+	};
+
+	/** Ghosts being played back */
+	TArray<FGhost> Ghosts;
+
+	/** Physics time the ghost laps started at. Negative while stopped */
+	double PlaybackStartTime = -1.0;
+
+	/** Best lap waiting to be cut out of the replay */
+	struct FPendingExport
+	{
+		TWeakObjectPtr<AFutureRacingPawn> Vehicle;
+
+		/** Physics times the lap started and ended at */
+		double LapStartTime = 0.0;
+		double LapEndTime = 0.0;
+
+		/** Physics time the export was requested at */
+		double RequestTime = 0.0;
+
+		/** Replay writer marker to wait for before reading the replay back */
+		int64 FlushMarker = -1;
+	};
+
+	/** Best lap waiting to be exported, if any */
+	TOptional<FPendingExport> PendingExport;
+
+	/** Duration of the best lap saved for this map, in seconds. Negative if there's none, or it isn't known */
+	double SavedBestLapTime = -1.0;
+
+public:
+
+	/** Loads every ghost lap saved for the current map */
+	void LoadGhosts();
+
+	/** Starts every ghost on a new lap */
+	void StartPlayback(double LapStartTime);
+
+	/** Hides every ghost until playback starts again */
+	void StopPlayback();
+
+	/**
+	 *  Saves a lap from the replay being recorded as the best lap ghost for this map, if it beats the saved one.
+	 *  The ghost is loaded once it has been written.
+	 */
+	void SaveBestLap(AFutureRacingPawn* Vehicle, double LapStartTime, double LapEndTime);
+
+	/** Returns the number of ghosts loaded */
+	int32 GetNumGhosts() const { return Ghosts.Num(); }
+
+	/** Returns the file the best lap ghost of the current map is saved to */
+	FString GetBestLapFilename() const;
+
+	/** Returns the duration of the best lap saved for this map, or a negative value if it isn't known */
+	double GetSavedBestLapTime() const { return SavedBestLapTime; }
+
+	// Begin UWorldSubsystem interface
+
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual void Deinitialize() override;
+
+	// End UWorldSubsystem interface
+
+	// Begin FTickableGameObject interface
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	// End FTickableGameObject interface
+
+protected:
+
+	/** Loads a ghost lap file and spawns a ghost for every vehicle in it */
+	void AddGhosts(const FString& Filename);
+
+	/** Destroys the ghosts loaded from a file and lets go of the file */
+	void RemoveGhosts(const FString& Filename);
+
+	/** Moves the pending export along once its delay is up and its data is on disk */
+	void UpdatePendingExport();
+
+	/** Returns the physics time laps are measured on */
+	double GetPhysicsTime() const;
+
+	/** Returns the map name ghost files are saved under */
+	FString GetGhostMapName() const;
+
+	/**
+	 *  Cuts a lap out of a replay and saves it as a ghost lap file. Safe to call from any thread
+	 *  @return false if the replay doesn't cover the whole lap
+	 */
+	static bool ExportLap(const FString& SourceFile, uint32 VehicleId, double LapStartTime, double LapEndTime, const FString& DestFile);
+};
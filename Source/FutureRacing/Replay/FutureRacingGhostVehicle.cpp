@@ -0,0 +1,53 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "FutureRacingGhostVehicle.h"
+#include "FutureRacingPawn.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "Engine/CollisionProfile.h"
+#include "Engine/SkeletalMesh.h"
+#include "Materials/MaterialInterface.h"
+
+AFutureRacingGhostVehicle::AFutureRacingGhostVehicle()
+{
+	// placed by the ghost subsystem, never ticks on its own
+	PrimaryActorTick.bCanEverTick = false;
+
+	Mesh = CreateDefaultSubobject<USkeletalMeshComponent>(TEXT("Mesh"));
+	RootComponent = Mesh;
+
+	// no collision also means no physics bodies get created for the mesh
+	Mesh->SetCollisionProfileName(UCollisionProfile::NoCollision_ProfileName);
+	Mesh->SetSimulatePhysics(false);
+	Mesh->SetGenerateOverlapEvents(false);
+	Mesh->SetCanEverAffectNavigation(false);
+
+	// the wheels stay in the reference pose, so there's nothing to animate
+	Mesh->PrimaryComponentTick.bCanEverTick = false;
+	Mesh->VisibilityBasedAnimTickOption = EVisibilityBasedAnimTickOption::OnlyTickPoseWhenRendered;
+
+	// keep ghosts light on the renderer too
+	Mesh->SetCastShadow(false);
+	Mesh->bReceivesDecals = false;
+
+	SetActorEnableCollision(false);
+}
+
+void AFutureRacingGhostVehicle::SetAppearance(TSubclassOf<AFutureRacingPawn> VehicleClass, UMaterialInterface* GhostMaterial)
+{
+	const AFutureRacingPawn* VehicleDefaults = VehicleClass ? VehicleClass->GetDefaultObject<AFutureRacingPawn>() : nullptr;
+
+	if (!VehicleDefaults)
+	{
+		return;
+	}
+
+	const USkeletalMeshComponent* SourceMesh = VehicleDefaults->GetMesh();
+
+	Mesh->SetSkeletalMeshAsset(SourceMesh->GetSkeletalMeshAsset());
+
+	for (int32 MaterialIndex = 0; MaterialIndex < Mesh->GetNumMaterials(); ++MaterialIndex)
+	{
+		Mesh->SetMaterial(MaterialIndex, GhostMaterial ? GhostMaterial : SourceMesh->GetMaterial(MaterialIndex));
+	}
+}
@@ -0,0 +1,40 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "FutureRacingGhostVehicle.generated.h"
+
+class USkeletalMeshComponent;
+class UMaterialInterface;
+class AFutureRacingPawn;
+
+/**
+ *  Visual stand in for a recorded vehicle.
+ *  Has no physics body, no collision and no vehicle simulation, and doesn't tick.
+ *  The ghost subsystem places it from replay samples every frame.
+ */
+UCLASS(NotPlaceable, Transient)
+class AFutureRacingGhostVehicle : public AActor
+{
+	GENERATED_BODY()
+
+	/** Car body, borrowed from the recorded vehicle class */
+	UPROPERTY(VisibleAnywhere, Category="Components", meta = (AllowPrivateAccess = "true"))
+	USkeletalMeshComponent* Mesh;
+
+public:
+
+	AFutureRacingGhostVehicle();
+
+	/**
+	 *  Copies the look of a vehicle class
+	 *  @param VehicleClass Vehicle to copy the mesh and materials from
+	 *  @param GhostMaterial If set, replaces every material on the mesh
+	 */
+	void SetAppearance(TSubclassOf<AFutureRacingPawn> VehicleClass, UMaterialInterface* GhostMaterial);
+
+	/** Returns the ghost mesh */
+	FORCEINLINE USkeletalMeshComponent* GetMesh() const { return Mesh; }
+};
@@ -0,0 +1,164 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "FutureRacingInputLog.h"
+#include "FutureRacingReplayFormat.h"
+#include "FutureRacingVehicleMovementComponent.h"
+#include "Misc/FileHelper.h"
+#include "FutureRacing.h"
+
+uint32 FutureRacingInputLog::HashStep(const FFutureRacingPhysicsStep& Step)
+{
+	// raw bits, so any difference in the last place shows up
+	const double State[] =
+	{
+		Step.Location.X, Step.Location.Y, Step.Location.Z,
+		Step.Rotation.X, Step.Rotation.Y, Step.Rotation.Z, Step.Rotation.W,
+		Step.LinearVelocity.X, Step.LinearVelocity.Y, Step.LinearVelocity.Z
+	};
+
+	const float Input[] = { Step.Input.Steering, Step.Input.Throttle, Step.Input.Brake, Step.Input.bHandbrake ? 1.0f : 0.0f };
+
+	return FCrc::MemCrc32(Input, sizeof(Input), FCrc::MemCrc32(State, sizeof(State)));
+}
+
+bool FFutureRacingInputLog::Save(const FString& Filename) const
+{
+	using namespace FutureRacingReplay;
+
+	TArray<uint8> Bytes;
+	Bytes.Reserve(64 + Events.Num() * 8 + Checksums.Num() * 6);
+
+	FByteWriter Writer(Bytes);
+	Writer.WriteUInt32(FutureRacingInputLog::FileMagic);
+	Writer.WriteUInt32(FutureRacingInputLog::FileVersion);
+	Writer.WriteString(MapName);
+	Writer.WriteString(VehicleClassPath);
+
+	const FVector Location = StartTransform.GetLocation();
+	const FQuat Rotation = StartTransform.GetRotation();
+
+	Writer.WriteDouble(Location.X);
+	Writer.WriteDouble(Location.Y);
+	Writer.WriteDouble(Location.Z);
+	Writer.WriteDouble(Rotation.X);
+	Writer.WriteDouble(Rotation.Y);
+	Writer.WriteDouble(Rotation.Z);
+	Writer.WriteDouble(Rotation.W);
+	Writer.WriteFloat(FixedStep);
+
+	// steps only ever go forwards, so store them as deltas
+	Writer.WriteVarUInt(Events.Num());
+
+	int64 PreviousStep = 0;
+
+	for (const FutureRacingInputLog::FEvent& Event : Events)
+	{
+		Writer.WriteVarInt(Event.Step - PreviousStep);
+		Writer.WriteUInt8(static_cast<uint8>(Event.Call));
+		Writer.WriteFloat(Event.Value);
+
+		PreviousStep = Event.Step;
+	}
+
+	Writer.WriteVarUInt(Checksums.Num());
+
+	PreviousStep = 0;
+
+	for (const FutureRacingInputLog::FChecksum& Checksum : Checksums)
+	{
+		Writer.WriteVarInt(Checksum.Step - PreviousStep);
+		Writer.WriteUInt32(Checksum.Hash);
+
+		PreviousStep = Checksum.Step;
+	}
+
+	if (!FFileHelper::SaveArrayToFile(Bytes, *Filename))
+	{
+		UE_LOG(LogFutureRacing, Error, TEXT("Could not write input log '%s'."), *Filename);
+		return false;
+	}
+
+	return true;
+}
+
+bool FFutureRacingInputLog::Load(const FString& Filename)
+{
+	using namespace FutureRacingReplay;
+
+	TArray<uint8> Bytes;
+
+	if (!FFileHelper::LoadFileToArray(Bytes, *Filename))
+	{
+		UE_LOG(LogFutureRacing, Error, TEXT("Could not read input log '%s'."), *Filename);
+		return false;
+	}
+
+	FByteReader Reader(Bytes.GetData(), Bytes.Num());
+
+	if (Reader.ReadUInt32() != FutureRacingInputLog::FileMagic || Reader.ReadUInt32() != FutureRacingInputLog::FileVersion)
+	{
+		UE_LOG(LogFutureRacing, Error, TEXT("'%s' isn't an input log this build can read."), *Filename);
+		return false;
+	}
+
+	MapName = Reader.ReadString();
+	VehicleClassPath = Reader.ReadString();
+
+	FVector Location;
+	Location.X = Reader.ReadDouble();
+	Location.Y = Reader.ReadDouble();
+	Location.Z = Reader.ReadDouble();
+
+	FQuat Rotation;
+	Rotation.X = Reader.ReadDouble();
+	Rotation.Y = Reader.ReadDouble();
+	Rotation.Z = Reader.ReadDouble();
+	Rotation.W = Reader.ReadDouble();
+
+	StartTransform = FTransform(Rotation, Location);
+	FixedStep = Reader.ReadFloat();
+	FirstStepIndex = 0;
+
+	// counts are capped by what's left in the file, so a corrupt count can't allocate the world
+	const int64 NumEvents = FMath::Min<int64>(Reader.ReadVarUInt(), Reader.GetRemaining());
+
+	Events.Reset(NumEvents);
+
+	int64 Step = 0;
+
+	for (int64 Index = 0; Index < NumEvents; ++Index)
+	{
+		FutureRacingInputLog::FEvent& Event = Events.AddDefaulted_GetRef();
+
+		Step += Reader.ReadVarInt();
+
+		Event.Step = Step;
+		Event.Call = static_cast<FutureRacingInputLog::ECall>(FMath::Min<uint8>(Reader.ReadUInt8(), static_cast<uint8>(FutureRacingInputLog::ECall::Num)));
+		Event.Value = Reader.ReadFloat();
+	}
+
+	const int64 NumChecksums = FMath::Min<int64>(Reader.ReadVarUInt(), Reader.GetRemaining());
+
+	Checksums.Reset(NumChecksums);
+
+	Step = 0;
+
+	for (int64 Index = 0; Index < NumChecksums; ++Index)
+	{
+		FutureRacingInputLog::FChecksum& Checksum = Checksums.AddDefaulted_GetRef();
+
+		Step += Reader.ReadVarInt();
+
+		Checksum.Step = Step;
+		Checksum.Hash = Reader.ReadUInt32();
+	}
+
+	if (Reader.bOverflow)
+	{
+		UE_LOG(LogFutureRacing, Error, TEXT("Input log '%s' is truncated."), *Filename);
+		return false;
+	}
+
+	return true;
+}
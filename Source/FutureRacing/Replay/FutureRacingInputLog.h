@@ -0,0 +1,104 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FFutureRacingPhysicsStep;
+
+/**
+ *  Exact input stream of a single vehicle, for deterministic regression replays.
+ *
+ *  Every driving call on the pawn is logged at full precision, tagged with the physics step
+ *  that first simulated the input it submitted, so the tag doesn't depend on thread timing.
+ *  Alongside, every physics step gets a checksum of the body state it started from and the
+ *  input it simulated. Logs are always recorded at a fixed frame step. Replaying the calls onto
+ *  the same steps on the same map and build reproduces the checksums, and the first step that
+ *  doesn't match is where two builds diverge.
+ */
+namespace FutureRacingInputLog
+{
+	/** "FRIL", little endian */
+	constexpr uint32 FileMagic = 0x4C495246;
+
+	/** Bump whenever the layout changes */
+	constexpr uint32 FileVersion = 2;
+
+	/** File extension for input logs */
+	static const TCHAR* const FileExtension = TEXT(".frinput");
+
+	/** Pawn call an event stands for */
+	enum class ECall : uint8
+	{
+		Steering,
+		Throttle,
+		Brake,
+		BrakeStart,
+		BrakeStop,
+		HandbrakeStart,
+		HandbrakeStop,
+		ResetVehicle,
+
+		Num
+	};
+
+	/** A single logged call */
+	struct FEvent
+	{
+		/** Physics steps since logging started, up to the one that first simulated the call's input */
+		int64 Step = 0;
+
+		/** Number of the input submission the call went out with. Not saved, only used to find Step while recording */
+		int64 InputSequence = 0;
+
+		ECall Call = ECall::Steering;
+
+		/** Argument of the call, if it takes one */
+		float Value = 0.0f;
+	};
+
+	/** State checksum of a physics step */
+	struct FChecksum
+	{
+		/** Physics steps since logging started */
+		int64 Step = 0;
+
+		uint32 Hash = 0;
+	};
+
+	/** Returns the checksum of a physics step's starting body state and input, bit exact */
+	uint32 HashStep(const FFutureRacingPhysicsStep& Step);
+}
+
+/**
+ *  A recorded input log
+ */
+struct FFutureRacingInputLog
+{
+	/** Map the log was recorded on */
+	FString MapName;
+
+	/** Path of the recorded vehicle's class */
+	FString VehicleClassPath;
+
+	/** Where the vehicle was when logging started */
+	FTransform StartTransform;
+
+	/** Game frame step the log was recorded at, in seconds */
+	float FixedStep = 0.0f;
+
+	/** Vehicle's physics step index when logging started. Not saved, steps in the log are relative to it */
+	int64 FirstStepIndex = 0;
+
+	/** Logged calls, in call order. While recording, the calls at the end can still be waiting for their step */
+	TArray<FutureRacingInputLog::FEvent> Events;
+
+	/** Step checksums, in step order */
+	TArray<FutureRacingInputLog::FChecksum> Checksums;
+
+	/** Writes the log to a file */
+	bool Save(const FString& Filename) const;
+
+	/** Reads a log written by Save. Returns false if the file isn't a log we can read */
+	bool Load(const FString& Filename);
+};
@@ -0,0 +1,191 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "FutureRacingInputLogSubsystem.h"
+#include "FutureRacingPawn.h"
+#include "FutureRacingVehicleMovementComponent.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/App.h"
+#include "Misc/DateTime.h"
+#include "Misc/Paths.h"
+#include "FutureRacing.h"
+
+static TAutoConsoleVariable<int32> CVarInputLogOnPossess(
+	TEXT("FutureRacing.InputLog.RecordOnPossess"),
+	0,
+	TEXT("If 1, the local player's driving input is logged from the moment they take control of a vehicle."),
+	ECVF_Default);
+
+static FAutoConsoleCommandWithWorld StartInputLogCommand(
+	TEXT("FutureRacing.InputLog.Start"),
+	TEXT("Starts logging the local player's driving input and per step state checksums."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		UFutureRacingInputLogSubsystem* InputLogs = World ? World->GetSubsystem<UFutureRacingInputLogSubsystem>() : nullptr;
+		APlayerController* PC = World ? World->GetFirstPlayerController() : nullptr;
+
+		if (InputLogs && PC)
+		{
+			InputLogs->StartRecording(Cast<AFutureRacingPawn>(PC->GetPawn()));
+		}
+	}));
+
+static FAutoConsoleCommandWithWorld StopInputLogCommand(
+	TEXT("FutureRacing.InputLog.Stop"),
+	TEXT("Stops logging driving input and saves the log to Saved/InputLogs."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (UFutureRacingInputLogSubsystem* InputLogs = World ? World->GetSubsystem<UFutureRacingInputLogSubsystem>() : nullptr)
+		{
+			InputLogs->StopRecording();
+		}
+	}));
+
+void UFutureRacingInputLogSubsystem::StartRecording(AFutureRacingPawn* NewVehicle)
+{
+	StopRecording();
+
+	if (!NewVehicle)
+	{
+		return;
+	}
+
+	const UFutureRacingVehicleMovementComponent* Movement = NewVehicle->GetRacingVehicleMovement();
+
+	// a log recorded at a variable frame step can't reproduce, so it's no use as a baseline
+	if (!FApp::UseFixedTimeStep())
+	{
+		FApp::SetUseFixedTimeStep(true);
+		FApp::SetFixedDeltaTime(RecordingFixedStep);
+		bForcedFixedStep = true;
+
+		UE_LOG(LogFutureRacing, Warning, TEXT("Input logging needs a fixed frame step, running at %.4fs per frame until logging stops."), RecordingFixedStep);
+	}
+
+	Log = MakeShared<FFutureRacingInputLog>();
+	Log->MapName = GetWorld()->GetMapName();
+	Log->MapName.RemoveFromStart(GetWorld()->StreamingLevelsPrefix);
+	Log->VehicleClassPath = NewVehicle->GetClass()->GetPathName();
+	Log->StartTransform = NewVehicle->GetActorTransform();
+	Log->FixedStep = static_cast<float>(FApp::GetFixedDeltaTime());
+	Log->FirstStepIndex = Movement->GetNumStepsSeen();
+
+	// start checksumming from the first step we log input for
+	LastStepIndex = Log->FirstStepIndex - 1;
+	NumResolvedEvents = 0;
+
+	Vehicle = NewVehicle;
+	NewVehicle->SetInputLog(Log);
+
+	UE_LOG(LogFutureRacing, Display, TEXT("Logging the input of '%s'."), *NewVehicle->GetName());
+}
+
+FString UFutureRacingInputLogSubsystem::StopRecording()
+{
+	if (!Log)
+	{
+		return FString();
+	}
+
+	CollectChecksums();
+
+	if (AFutureRacingPawn* LoggedVehicle = Vehicle.Get())
+	{
+		LoggedVehicle->SetInputLog(nullptr);
+	}
+
+	// calls whose input never reached a physics step didn't affect the run
+	Log->Events.SetNum(NumResolvedEvents);
+
+	if (bForcedFixedStep)
+	{
+		FApp::SetUseFixedTimeStep(false);
+		bForcedFixedStep = false;
+	}
+
+	const FString Filename = FPaths::Combine(FPaths::ProjectSavedDir(), LogFolder,
+		FString::Printf(TEXT("%s_%s%s"), *Log->MapName, *FDateTime::Now().ToString(), FutureRacingInputLog::FileExtension));
+
+	const bool bSaved = Log->Save(Filename);
+
+	if (bSaved)
+	{
+		UE_LOG(LogFutureRacing, Display, TEXT("Saved %d input events and %d step checksums to '%s'."),
+			Log->Events.Num(), Log->Checksums.Num(), *FPaths::ConvertRelativePathToFull(Filename));
+	}
+
+	Log.Reset();
+	Vehicle.Reset();
+
+	return bSaved ? Filename : FString();
+}
+
+void UFutureRacingInputLogSubsystem::NotifyLocalPlayerPossessed(AFutureRacingPawn* NewVehicle)
+{
+	if (CVarInputLogOnPossess.GetValueOnGameThread() && NewVehicle != Vehicle.Get())
+	{
+		StartRecording(NewVehicle);
+	}
+}
+
+bool UFutureRacingInputLogSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	// only needed where vehicles actually race
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UFutureRacingInputLogSubsystem::Deinitialize()
+{
+	StopRecording();
+
+	Super::Deinitialize();
+}
+
+void UFutureRacingInputLogSubsystem::Tick(float DeltaTime)
+{
+	if (Log)
+	{
+		CollectChecksums();
+	}
+}
+
+TStatId UFutureRacingInputLogSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UFutureRacingInputLogSubsystem, STATGROUP_Tickables);
+}
+
+void UFutureRacingInputLogSubsystem::CollectChecksums()
+{
+	const AFutureRacingPawn* LoggedVehicle = Vehicle.Get();
+
+	if (!LoggedVehicle || !Log)
+	{
+		return;
+	}
+
+	// the movement component keeps the last few dozen steps, more than a frame ever simulates
+	for (const FFutureRacingPhysicsStep& Step : LoggedVehicle->GetRacingVehicleMovement()->GetRecentSteps())
+	{
+		if (Step.StepIndex <= LastStepIndex)
+		{
+			continue;
+		}
+
+		FutureRacingInputLog::FChecksum& Checksum = Log->Checksums.AddDefaulted_GetRef();
+		Checksum.Step = Step.StepIndex - Log->FirstStepIndex;
+		Checksum.Hash = FutureRacingInputLog::HashStep(Step);
+
+		// every call that went out with this step's input, or before it, was first simulated here
+		if (Step.bNewInput)
+		{
+			for (; NumResolvedEvents < Log->Events.Num() && Log->Events[NumResolvedEvents].InputSequence <= Step.Input.Sequence; ++NumResolvedEvents)
+			{
+				Log->Events[NumResolvedEvents].Step = Checksum.Step;
+			}
+		}
+
+		LastStepIndex = Step.StepIndex;
+	}
+}
@@ -0,0 +1,86 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "FutureRacingInputLog.h"
+#include "FutureRacingInputLogSubsystem.generated.h"
+
+class AFutureRacingPawn;
+
+/**
+ *  Records the local driver's exact input stream and per step state checksums to an input log,
+ *  which the headless sim commandlet replays with -InputLog to check a build still reproduces the run.
+ *
+ *  Start and stop with FutureRacing.InputLog.Start and FutureRacing.InputLog.Stop, or set
+ *  FutureRacing.InputLog.RecordOnPossess to log from the moment a local player gets a vehicle,
+ *  which is what a replay needs to start from the same state. Logs are saved to Saved/InputLogs.
+ *
+ *  Checksums only reproduce at a fixed frame step, so if the game isn't running at one,
+ *  recording switches to RecordingFixedStep until it stops.
+ */
+UCLASS(Config="Game")
+class UFutureRacingInputLogSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+protected:
+
+	/** Folder input logs are saved to, relative to the project's Saved folder */
+	UPROPERTY(Config)
+	FString LogFolder = TEXT("InputLogs");
+
+	/** Frame step recording switches to when the game isn't running at a fixed one, in seconds */
+	UPROPERTY(Config)
+	float RecordingFixedStep = 1.0f / 60.0f;
+
+	/** Vehicle being logged */
+	TWeakObjectPtr<AFutureRacingPawn> Vehicle;
+
+	/** Log being recorded */
+	TSharedPtr<FFutureRacingInputLog> Log;
+
+	/** Last physics step checksummed */
+	int64 LastStepIndex = -1;
+
+	/** Number of logged calls tagged with the step that simulated them */
+	int32 NumResolvedEvents = 0;
+
+	/** If true, recording switched the game to a fixed frame step, which is switched off again when it stops */
+	bool bForcedFixedStep = false;
+
+public:
+
+	/** Starts logging a vehicle, from its current state. Stops any log already running */
+	void StartRecording(AFutureRacingPawn* NewVehicle);
+
+	/** Stops logging and saves the log. Returns the file written, or an empty string if nothing was recorded */
+	FString StopRecording();
+
+	/** Returns true while logging */
+	bool IsRecording() const { return Log.IsValid(); }
+
+	/** Starts logging a vehicle a local player just took control of, if logging on possess is enabled */
+	void NotifyLocalPlayerPossessed(AFutureRacingPawn* NewVehicle);
+
+	// Begin UWorldSubsystem interface
+
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+	virtual void Deinitialize() override;
+
+	// End UWorldSubsystem interface
+
+	// Begin FTickableGameObject interface
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	// End FTickableGameObject interface
+
+protected:
+
+	/** Checksums the physics steps the vehicle simulated since the last call, and tags the logged calls they first simulated */
+	void CollectChecksums();
+};
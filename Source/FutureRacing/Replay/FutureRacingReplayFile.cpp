@@ -0,0 +1,291 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "FutureRacingReplayFile.h"
+#include "Async/MappedFileHandle.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/FileHelper.h"
+#include "Algo/BinarySearch.h"
+#include "FutureRacing.h"
+
+FFutureRacingReplayFile::~FFutureRacingReplayFile()
+{
+	// the region has to go before the handle it maps
+	MappedRegion.Reset();
+	MappedHandle.Reset();
+}
+
+TSharedPtr<const FFutureRacingReplayFile, ESPMode::ThreadSafe> FFutureRacingReplayFile::Open(const FString& Filename)
+{
+	TSharedPtr<FFutureRacingReplayFile, ESPMode::ThreadSafe> File = MakeShareable(new FFutureRacingReplayFile());
+	File->Filename = Filename;
+
+	// map the file if we can. The recorder may still be appending to it
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	FOpenMappedResult MappedResult = PlatformFile.OpenMappedEx(*Filename, IPlatformFile::EOpenReadFlags::AllowWrite);
+
+	if (MappedResult.HasValue())
+	{
+		File->MappedHandle = MappedResult.StealValue();
+
+		if (File->MappedHandle->GetFileSize() > 0)
+		{
+			File->MappedRegion.Reset(File->MappedHandle->MapRegion(0, File->MappedHandle->GetFileSize()));
+		}
+	}
+
+	if (File->MappedRegion)
+	{
+		File->Data = File->MappedRegion->GetMappedPtr();
+		File->Size = File->MappedRegion->GetMappedSize();
+
+	} else {
+
+		// fall back to reading the whole file
+		File->MappedHandle.Reset();
+
+		if (!FFileHelper::LoadFileToArray(File->LoadedBytes, *Filename, FILEREAD_AllowWrite | FILEREAD_Silent))
+		{
+			UE_LOG(LogFutureRacing, Warning, TEXT("Could not open replay '%s'."), *Filename);
+			return nullptr;
+		}
+
+		File->Data = File->LoadedBytes.GetData();
+		File->Size = File->LoadedBytes.Num();
+	}
+
+	if (!File->BuildIndex())
+	{
+		UE_LOG(LogFutureRacing, Warning, TEXT("'%s' is not a readable replay."), *Filename);
+		return nullptr;
+	}
+
+	return File;
+}
+
+const FFutureRacingReplayFile::FVehicleEntry* FFutureRacingReplayFile::FindVehicle(uint32 VehicleId) const
+{
+	return Vehicles.FindByPredicate([VehicleId](const FVehicleEntry& Entry) { return Entry.Vehicle.VehicleId == VehicleId; });
+}
+
+int32 FFutureRacingReplayFile::FindBlock(const FVehicleEntry& Vehicle, double Time) const
+{
+	const int32 UpperBound = Algo::UpperBoundBy(Vehicle.Blocks, Time, [](const FBlockEntry& Block) { return Block.Header.FirstTime; });
+
+	return UpperBound > 0 ? UpperBound - 1 : INDEX_NONE;
+}
+
+void FFutureRacingReplayFile::DecodeKeyframes(const FBlockEntry& Block, TArray<FutureRacingReplay::FSample>& OutKeyframes) const
+{
+	FutureRacingReplay::FStepBlockDecoder Decoder(Block.Header, Data + Block.PayloadOffset);
+	FutureRacingReplay::FSample Sample;
+
+	while (Decoder.Next(Sample))
+	{
+		if (Sample.bKeyframe)
+		{
+			OutKeyframes.Add(Sample);
+		}
+	}
+}
+
+void FFutureRacingReplayFile::DecodeSamples(const FBlockEntry& Block, TArray<FutureRacingReplay::FSample>& OutSamples) const
+{
+	FutureRacingReplay::FStepBlockDecoder Decoder(Block.Header, Data + Block.PayloadOffset);
+	FutureRacingReplay::FSample Sample;
+
+	while (Decoder.Next(Sample))
+	{
+		OutSamples.Add(Sample);
+	}
+}
+
+bool FFutureRacingReplayFile::DecodeFirstSample(const FBlockEntry& Block, FutureRacingReplay::FSample& OutSample) const
+{
+	FutureRacingReplay::FStepBlockDecoder Decoder(Block.Header, Data + Block.PayloadOffset);
+
+	return Decoder.Next(OutSample);
+}
+
+bool FFutureRacingReplayFile::BuildIndex()
+{
+	using namespace FutureRacingReplay;
+
+	FByteReader Reader(Data, Size);
+
+	if (!ReadFileHeader(Reader, Header))
+	{
+		return false;
+	}
+
+	while (!Reader.IsAtEnd())
+	{
+		const EBlockType Type = static_cast<EBlockType>(Reader.ReadUInt8());
+
+		if (Type == EBlockType::Vehicle)
+		{
+			FVehicleBlock Block;
+
+			if (!ReadVehicleBlock(Reader, Block))
+			{
+				break;
+			}
+
+			FindOrAddVehicle(Block.VehicleId).Vehicle = Block;
+
+		} else if (Type == EBlockType::Steps) {
+
+			FBlockEntry Entry;
+
+			// a block cut off by the end of the file is still being written
+			if (!ReadStepBlockHeader(Reader, Entry.Header))
+			{
+				break;
+			}
+
+			Entry.PayloadOffset = Reader.Offset;
+			Reader.Skip(Entry.Header.PayloadSize);
+
+			FindOrAddVehicle(Entry.Header.VehicleId).Blocks.Add(Entry);
+
+		} else {
+
+			UE_LOG(LogFutureRacing, Warning, TEXT("Replay '%s' has an unknown block at offset %lld, ignoring the rest."), *Filename, Reader.Offset - 1);
+			break;
+		}
+	}
+
+	// work out the time range of each vehicle
+	for (FVehicleEntry& Vehicle : Vehicles)
+	{
+		if (Vehicle.Blocks.Num() == 0)
+		{
+			continue;
+		}
+
+		// blocks are written as they fill up, which is almost always in time order
+		Vehicle.Blocks.StableSort([](const FBlockEntry& A, const FBlockEntry& B)
+		{
+			return A.Header.FirstTime < B.Header.FirstTime;
+		});
+
+		Vehicle.StartTime = Vehicle.Blocks[0].Header.FirstTime;
+
+		// the end time needs the last block decoded
+		FStepBlockDecoder Decoder(Vehicle.Blocks.Last().Header, Data + Vehicle.Blocks.Last().PayloadOffset);
+		FSample Sample;
+		Vehicle.EndTime = Vehicle.StartTime;
+
+		while (Decoder.Next(Sample))
+		{
+			Vehicle.EndTime = Sample.Time;
+		}
+	}
+
+	return true;
+}
+
+FFutureRacingReplayFile::FVehicleEntry& FFutureRacingReplayFile::FindOrAddVehicle(uint32 VehicleId)
+{
+	if (FVehicleEntry* Existing = Vehicles.FindByPredicate([VehicleId](const FVehicleEntry& Entry) { return Entry.Vehicle.VehicleId == VehicleId; }))
+	{
+		return *Existing;
+	}
+
+	// steps can arrive without their vehicle block if it was dropped while recording
+	FVehicleEntry& Entry = Vehicles.AddDefaulted_GetRef();
+	Entry.Vehicle.VehicleId = VehicleId;
+
+	return Entry;
+}
+
+FFutureRacingReplayCursor::FFutureRacingReplayCursor(const TSharedPtr<const FFutureRacingReplayFile, ESPMode::ThreadSafe>& InFile, uint32 InVehicleId)
+	: File(InFile)
+{
+	if (File.IsValid())
+	{
+		Vehicle = File->FindVehicle(InVehicleId);
+
+		if (Vehicle && Vehicle->Blocks.Num() == 0)
+		{
+			Vehicle = nullptr;
+		}
+	}
+}
+
+bool FFutureRacingReplayCursor::Sample(double Time, FTransform& OutTransform)
+{
+	if (!Vehicle || Time < Vehicle->StartTime || Time > Vehicle->EndTime)
+	{
+		return false;
+	}
+
+	// move on to another block if the time left the decoded one
+	if (Keyframes.Num() == 0 || Time < Keyframes[0].Time || Time > Keyframes.Last().Time)
+	{
+		const int32 BlockIndex = File->FindBlock(*Vehicle, Time);
+
+		if (BlockIndex == INDEX_NONE)
+		{
+			return false;
+		}
+
+		if (BlockIndex != LoadedBlock)
+		{
+			LoadBlock(BlockIndex);
+		}
+
+		if (Keyframes.Num() == 0)
+		{
+			return false;
+		}
+	}
+
+	// playback mostly moves forwards, so search on from the last keyframe
+	if (!Keyframes.IsValidIndex(KeyIndex) || Keyframes[KeyIndex].Time > Time)
+	{
+		KeyIndex = 0;
+	}
+
+	while (KeyIndex + 1 < Keyframes.Num() && Keyframes[KeyIndex + 1].Time <= Time)
+	{
+		++KeyIndex;
+	}
+
+	const FutureRacingReplay::FSample& From = Keyframes[KeyIndex];
+
+	// hold the last keyframe at the end of the recording or across gaps
+	if (KeyIndex + 1 >= Keyframes.Num() || Keyframes[KeyIndex + 1].Time - From.Time > MaxInterpolationGap)
+	{
+		OutTransform = FTransform(From.State.GetRotation(), From.State.GetLocation());
+		return true;
+	}
+
+	const FutureRacingReplay::FSample& To = Keyframes[KeyIndex + 1];
+	const double Duration = To.Time - From.Time;
+	const float Alpha = static_cast<float>(FMath::Clamp((Time - From.Time) / Duration, 0.0, 1.0));
+
+	const FVector Location = FMath::CubicInterp(From.State.GetLocation(), From.State.GetVelocity() * Duration, To.State.GetLocation(), To.State.GetVelocity() * Duration, Alpha);
+	const FQuat Rotation = FQuat::Slerp(From.State.GetRotation(), To.State.GetRotation(), Alpha);
+
+	OutTransform = FTransform(Rotation, Location);
+
+	return true;
+}
+
+void FFutureRacingReplayCursor::LoadBlock(int32 BlockIndex)
+{
+	LoadedBlock = BlockIndex;
+	KeyIndex = 0;
+	Keyframes.Reset();
+
+	File->DecodeKeyframes(Vehicle->Blocks[BlockIndex], Keyframes);
+
+	// borrow the first keyframe of the next block so we can interpolate up to it. Every block starts on one
+	FutureRacingReplay::FSample NextKeyframe;
+
+	if (Vehicle->Blocks.IsValidIndex(BlockIndex + 1) && File->DecodeFirstSample(Vehicle->Blocks[BlockIndex + 1], NextKeyframe))
+	{
+		Keyframes.Add(NextKeyframe);
+	}
+}
@@ -0,0 +1,150 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FutureRacingReplayFormat.h"
+
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+/**
+ *  Read only view of a replay file.
+ *  The file is memory mapped where the platform allows it, and indexed on open by
+ *  walking the block headers, so samples are only decoded when something asks for them.
+ *  Safe to share between threads once opened.
+ */
+class FFutureRacingReplayFile
+{
+public:
+
+	/** A step block in the file */
+	struct FBlockEntry
+	{
+		FutureRacingReplay::FStepBlockHeader Header;
+
+		/** Offset of the block's payload from the start of the file */
+		int64 PayloadOffset = 0;
+	};
+
+	/** Index of a single recorded vehicle */
+	struct FVehicleEntry
+	{
+		FutureRacingReplay::FVehicleBlock Vehicle;
+
+		/** Step blocks, in time order */
+		TArray<FBlockEntry> Blocks;
+
+		/** Time of the first and last recorded samples */
+		double StartTime = 0.0;
+		double EndTime = 0.0;
+	};
+
+	~FFutureRacingReplayFile();
+
+	/** Maps and indexes a replay. Returns null if it can't be read. A partly written replay is read up to its last whole block */
+	static TSharedPtr<const FFutureRacingReplayFile, ESPMode::ThreadSafe> Open(const FString& Filename);
+
+	/** Returns the file name the replay was read from */
+	const FString& GetFilename() const { return Filename; }
+
+	/** Returns the file header */
+	const FutureRacingReplay::FFileHeader& GetHeader() const { return Header; }
+
+	/** Returns the recorded vehicles */
+	const TArray<FVehicleEntry>& GetVehicles() const { return Vehicles; }
+
+	/** Returns a recorded vehicle by id, or null if it isn't in the file */
+	const FVehicleEntry* FindVehicle(uint32 VehicleId) const;
+
+	/** Returns the index of the last block of a vehicle starting at or before a time, or INDEX_NONE */
+	int32 FindBlock(const FVehicleEntry& Vehicle, double Time) const;
+
+	/** Decodes a block's samples, appending only the keyframes */
+	void DecodeKeyframes(const FBlockEntry& Block, TArray<FutureRacingReplay::FSample>& OutKeyframes) const;
+
+	/** Decodes every sample of a block, appending them in time order */
+	void DecodeSamples(const FBlockEntry& Block, TArray<FutureRacingReplay::FSample>& OutSamples) const;
+
+	/** Decodes the first sample of a block, which is always a keyframe */
+	bool DecodeFirstSample(const FBlockEntry& Block, FutureRacingReplay::FSample& OutSample) const;
+
+	/** Returns true if the file is memory mapped rather than loaded */
+	bool IsMapped() const { return MappedRegion != nullptr; }
+
+protected:
+
+	FFutureRacingReplayFile() = default;
+
+	/** Walks the blocks and builds the vehicle index */
+	bool BuildIndex();
+
+	/** Returns the vehicle entry for an id, adding one if needed */
+	FVehicleEntry& FindOrAddVehicle(uint32 VehicleId);
+
+	FString Filename;
+
+	FutureRacingReplay::FFileHeader Header;
+
+	TArray<FVehicleEntry> Vehicles;
+
+	/** Mapping, if the platform supports it */
+	TUniquePtr<IMappedFileHandle> MappedHandle;
+	TUniquePtr<IMappedFileRegion> MappedRegion;
+
+	/** Loaded file, if it couldn't be mapped */
+	TArray<uint8> LoadedBytes;
+
+	/** Start and size of the file contents */
+	const uint8* Data = nullptr;
+	int64 Size = 0;
+};
+
+/**
+ *  Samples the transform of a single recorded vehicle at arbitrary times.
+ *  Keeps the keyframes of the block around the last sampled time decoded,
+ *  so playing forwards decodes each block once.
+ */
+class FFutureRacingReplayCursor
+{
+public:
+
+	FFutureRacingReplayCursor() = default;
+	FFutureRacingReplayCursor(const TSharedPtr<const FFutureRacingReplayFile, ESPMode::ThreadSafe>& InFile, uint32 InVehicleId);
+
+	/** Returns true if the cursor points at a recorded vehicle */
+	bool IsValid() const { return Vehicle != nullptr; }
+
+	/** Returns the time of the first recorded sample */
+	double GetStartTime() const { return Vehicle ? Vehicle->StartTime : 0.0; }
+
+	/** Returns the time of the last recorded sample */
+	double GetEndTime() const { return Vehicle ? Vehicle->EndTime : 0.0; }
+
+	/**
+	 *  Interpolates the recorded transform at a time.
+	 *  Locations follow a cubic through the recorded velocities, rotations are slerped.
+	 *  @return false if the time is outside the recording
+	 */
+	bool Sample(double Time, FTransform& OutTransform);
+
+protected:
+
+	/** Decodes the keyframes of a block, plus the first keyframe of the next one */
+	void LoadBlock(int32 BlockIndex);
+
+	TSharedPtr<const FFutureRacingReplayFile, ESPMode::ThreadSafe> File;
+	const FFutureRacingReplayFile::FVehicleEntry* Vehicle = nullptr;
+
+	/** Block the keyframes were decoded from */
+	int32 LoadedBlock = INDEX_NONE;
+
+	/** Decoded keyframes */
+	TArray<FutureRacingReplay::FSample> Keyframes;
+
+	/** Keyframe the last sample started from */
+	int32 KeyIndex = 0;
+
+	/** Keyframes further apart than this are not interpolated across, e.g. around a respawn */
+	double MaxInterpolationGap = 0.5;
+};
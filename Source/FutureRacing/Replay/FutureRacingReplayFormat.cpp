@@ -0,0 +1,522 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "FutureRacingReplayFormat.h"
+#include "Containers/StringConv.h"
+
+namespace FutureRacingReplay
+{
+	/** Largest magnitude of the three smallest components of a unit quaternion */
+	constexpr float RotationComponentRange = UE_INV_SQRT_2;
+
+	/** Highest value a packed rotation component can hold */
+	constexpr uint32 RotationComponentMax = (1 << 10) - 1;
+
+	/** Sample times further than this from the expected step are stored explicitly */
+	constexpr double TimeTolerance = 0.00001;
+
+	FQuantizedInput FQuantizedInput::Quantize(float Steering, float Throttle, float Brake, bool bHandbrake)
+	{
+		FQuantizedInput Input;
+		Input.Steering = static_cast<int8>(FMath::RoundToInt(FMath::Clamp(Steering, -1.0f, 1.0f) * 127.0f));
+		Input.Throttle = static_cast<uint8>(FMath::RoundToInt(FMath::Clamp(Throttle, 0.0f, 1.0f) * 255.0f));
+		Input.Brake = static_cast<uint8>(FMath::RoundToInt(FMath::Clamp(Brake, 0.0f, 1.0f) * 255.0f));
+		Input.bHandbrake = bHandbrake;
+
+		return Input;
+	}
+
+	FQuantizedState FQuantizedState::Quantize(const FVector& Location, const FQuat& Rotation, const FVector& Velocity)
+	{
+		FQuantizedState State;
+		State.Location = FIntVector(FMath::RoundToInt(Location.X), FMath::RoundToInt(Location.Y), FMath::RoundToInt(Location.Z));
+		State.Velocity = FIntVector(FMath::RoundToInt(Velocity.X), FMath::RoundToInt(Velocity.Y), FMath::RoundToInt(Velocity.Z));
+		State.Rotation = PackRotation(Rotation);
+
+		return State;
+	}
+
+	FQuat FQuantizedState::GetRotation() const
+	{
+		return UnpackRotation(Rotation);
+	}
+
+	uint32 PackRotation(const FQuat& Rotation)
+	{
+		const FQuat Normalized = Rotation.GetNormalized();
+		const double Components[4] = { Normalized.X, Normalized.Y, Normalized.Z, Normalized.W };
+
+		// drop the largest component, it can be rebuilt from the other three
+		int32 Largest = 0;
+
+		for (int32 Index = 1; Index < 4; ++Index)
+		{
+			if (FMath::Abs(Components[Index]) > FMath::Abs(Components[Largest]))
+			{
+				Largest = Index;
+			}
+		}
+
+		// q and -q are the same rotation, so flip the quaternion to keep the dropped component positive
+		const double Sign = Components[Largest] < 0.0 ? -1.0 : 1.0;
+
+		uint32 Packed = static_cast<uint32>(Largest);
+		int32 Shift = 2;
+
+		for (int32 Index = 0; Index < 4; ++Index)
+		{
+			if (Index == Largest)
+			{
+				continue;
+			}
+
+			const double Alpha = (Components[Index] * Sign / RotationComponentRange + 1.0) * 0.5;
+			const uint32 Quantized = static_cast<uint32>(FMath::Clamp<int64>(FMath::RoundToInt64(Alpha * RotationComponentMax), 0, RotationComponentMax));
+
+			Packed |= Quantized << Shift;
+			Shift += 10;
+		}
+
+		return Packed;
+	}
+
+	FQuat UnpackRotation(uint32 Packed)
+	{
+		const int32 Largest = Packed & 3;
+
+		double Components[4];
+		double SumSquares = 0.0;
+		int32 Shift = 2;
+
+		for (int32 Index = 0; Index < 4; ++Index)
+		{
+			if (Index == Largest)
+			{
+				continue;
+			}
+
+			const double Alpha = static_cast<double>((Packed >> Shift) & RotationComponentMax) / RotationComponentMax;
+			Components[Index] = (Alpha * 2.0 - 1.0) * RotationComponentRange;
+			SumSquares += FMath::Square(Components[Index]);
+			Shift += 10;
+		}
+
+		Components[Largest] = FMath::Sqrt(FMath::Max(0.0, 1.0 - SumSquares));
+
+		return FQuat(Components[0], Components[1], Components[2], Components[3]).GetNormalized();
+	}
+
+	void FByteWriter::WriteUInt32(uint32 Value)
+	{
+		for (int32 Byte = 0; Byte < 4; ++Byte)
+		{
+			Bytes.Add(static_cast<uint8>(Value >> (Byte * 8)));
+		}
+	}
+
+	void FByteWriter::WriteFloat(float Value)
+	{
+		uint32 Bits;
+		FMemory::Memcpy(&Bits, &Value, sizeof(Bits));
+
+		WriteUInt32(Bits);
+	}
+
+	void FByteWriter::WriteDouble(double Value)
+	{
+		uint64 Bits;
+		FMemory::Memcpy(&Bits, &Value, sizeof(Bits));
+
+		WriteUInt32(static_cast<uint32>(Bits));
+		WriteUInt32(static_cast<uint32>(Bits >> 32));
+	}
+
+	void FByteWriter::WriteVarUInt(uint64 Value)
+	{
+		while (Value >= 0x80)
+		{
+			Bytes.Add(static_cast<uint8>(Value) | 0x80);
+			Value >>= 7;
+		}
+
+		Bytes.Add(static_cast<uint8>(Value));
+	}
+
+	void FByteWriter::WriteVarInt(int64 Value)
+	{
+		WriteVarUInt((static_cast<uint64>(Value) << 1) ^ static_cast<uint64>(Value >> 63));
+	}
+
+	void FByteWriter::WriteString(const FString& Value)
+	{
+		const FTCHARToUTF8 Utf8(*Value);
+
+		WriteVarUInt(Utf8.Length());
+		Bytes.Append(reinterpret_cast<const uint8*>(Utf8.Get()), Utf8.Length());
+	}
+
+	uint8 FByteReader::ReadUInt8()
+	{
+		if (Offset >= Size)
+		{
+			bOverflow = true;
+			return 0;
+		}
+
+		return Data[Offset++];
+	}
+
+	uint32 FByteReader::ReadUInt32()
+	{
+		if (Offset + 4 > Size)
+		{
+			bOverflow = true;
+			Offset = Size;
+			return 0;
+		}
+
+		uint32 Value = 0;
+
+		for (int32 Byte = 0; Byte < 4; ++Byte)
+		{
+			Value |= static_cast<uint32>(Data[Offset++]) << (Byte * 8);
+		}
+
+		return Value;
+	}
+
+	float FByteReader::ReadFloat()
+	{
+		const uint32 Bits = ReadUInt32();
+
+		float Value;
+		FMemory::Memcpy(&Value, &Bits, sizeof(Value));
+
+		return Value;
+	}
+
+	double FByteReader::ReadDouble()
+	{
+		const uint64 Low = ReadUInt32();
+		const uint64 Bits = Low | (static_cast<uint64>(ReadUInt32()) << 32);
+
+		double Value;
+		FMemory::Memcpy(&Value, &Bits, sizeof(Value));
+
+		return Value;
+	}
+
+	uint64 FByteReader::ReadVarUInt()
+	{
+		uint64 Value = 0;
+
+		for (int32 Shift = 0; Shift < 64; Shift += 7)
+		{
+			const uint8 Byte = ReadUInt8();
+			Value |= static_cast<uint64>(Byte & 0x7F) << Shift;
+
+			if (!(Byte & 0x80))
+			{
+				return Value;
+			}
+		}
+
+		// more than ten bytes can't be a valid value
+		bOverflow = true;
+
+		return 0;
+	}
+
+	int64 FByteReader::ReadVarInt()
+	{
+		const uint64 Encoded = ReadVarUInt();
+
+		return static_cast<int64>(Encoded >> 1) ^ -static_cast<int64>(Encoded & 1);
+	}
+
+	FString FByteReader::ReadString()
+	{
+		const int64 Length = static_cast<int64>(ReadVarUInt());
+
+		if (Length < 0 || Length > GetRemaining())
+		{
+			bOverflow = true;
+			Offset = Size;
+			return FString();
+		}
+
+		const FUTF8ToTCHAR Converted(reinterpret_cast<const UTF8CHAR*>(Data + Offset), static_cast<int32>(Length));
+		Offset += Length;
+
+		return FString(Converted.Length(), Converted.Get());
+	}
+
+	void FByteReader::Skip(int64 Num)
+	{
+		if (Num < 0 || Num > GetRemaining())
+		{
+			bOverflow = true;
+			Offset = Size;
+			return;
+		}
+
+		Offset += Num;
+	}
+
+	void WriteFileHeader(TArray<uint8>& Out, const FFileHeader& Header)
+	{
+		FByteWriter Writer(Out);
+		Writer.WriteUInt32(FileMagic);
+		Writer.WriteUInt32(Header.Version);
+		Writer.WriteString(Header.MapName);
+		Writer.WriteVarInt(Header.RecordedAt.GetTicks());
+		Writer.WriteDouble(Header.LapTime);
+	}
+
+	bool ReadFileHeader(FByteReader& Reader, FFileHeader& OutHeader)
+	{
+		if (Reader.ReadUInt32() != FileMagic)
+		{
+			return false;
+		}
+
+		OutHeader.Version = Reader.ReadUInt32();
+
+		if (OutHeader.Version == 0 || OutHeader.Version > FileVersion)
+		{
+			return false;
+		}
+
+		OutHeader.MapName = Reader.ReadString();
+		OutHeader.RecordedAt = FDateTime(Reader.ReadVarInt());
+		OutHeader.LapTime = OutHeader.Version >= 2 ? Reader.ReadDouble() : 0.0;
+
+		return !Reader.bOverflow;
+	}
+
+	void WriteVehicleBlock(TArray<uint8>& Out, const FVehicleBlock& Block)
+	{
+		FByteWriter Writer(Out);
+		Writer.WriteUInt8(static_cast<uint8>(EBlockType::Vehicle));
+		Writer.WriteVarUInt(Block.VehicleId);
+		Writer.WriteString(Block.ClassPath);
+		Writer.WriteString(Block.Name);
+	}
+
+	bool ReadVehicleBlock(FByteReader& Reader, FVehicleBlock& OutBlock)
+	{
+		OutBlock.VehicleId = static_cast<uint32>(Reader.ReadVarUInt());
+		OutBlock.ClassPath = Reader.ReadString();
+		OutBlock.Name = Reader.ReadString();
+
+		return !Reader.bOverflow;
+	}
+
+	bool ReadStepBlockHeader(FByteReader& Reader, FStepBlockHeader& OutHeader)
+	{
+		OutHeader.VehicleId = static_cast<uint32>(Reader.ReadVarUInt());
+		OutHeader.NumSamples = static_cast<int32>(Reader.ReadVarUInt());
+		OutHeader.FirstTime = Reader.ReadDouble();
+		OutHeader.StepDelta = Reader.ReadFloat();
+		OutHeader.PayloadSize = static_cast<int32>(Reader.ReadVarUInt());
+
+		return !Reader.bOverflow && OutHeader.PayloadSize <= Reader.GetRemaining();
+	}
+
+	FStepBlockEncoder::FStepBlockEncoder(int32 InKeyframeInterval)
+		: KeyframeInterval(FMath::Max(InKeyframeInterval, 1))
+	{
+	}
+
+	void FStepBlockEncoder::AddSample(double Time, const FQuantizedInput& Input, const FQuantizedState& State)
+	{
+		const bool bFirst = NumSamples == 0;
+
+		uint8 Flags = 0;
+		float TimeDelta = 0.0f;
+
+		// times follow the step delta unless the vehicle skipped steps or was sampled per frame
+		if (bFirst)
+		{
+			FirstTime = Time;
+			LastTime = Time;
+
+		} else if (NumSamples == 1) {
+
+			StepDelta = static_cast<float>(Time - LastTime);
+			LastTime += StepDelta;
+
+		} else if (FMath::Abs(Time - (LastTime + StepDelta)) > TimeTolerance) {
+
+			Flags |= SampleFlag_Time;
+			TimeDelta = static_cast<float>(Time - LastTime);
+			LastTime += TimeDelta;
+
+		} else {
+
+			LastTime += StepDelta;
+		}
+
+		// blocks start with every input, after that only changes are stored
+		if (bFirst || Input.Steering != LastInput.Steering)
+		{
+			Flags |= SampleFlag_Steering;
+		}
+
+		if (bFirst || Input.Throttle != LastInput.Throttle)
+		{
+			Flags |= SampleFlag_Throttle;
+		}
+
+		if (bFirst || Input.Brake != LastInput.Brake)
+		{
+			Flags |= SampleFlag_Brake;
+		}
+
+		if (Input.bHandbrake)
+		{
+			Flags |= SampleFlag_Handbrake;
+		}
+
+		if (bFirst || ++SamplesSinceKeyframe >= KeyframeInterval)
+		{
+			Flags |= SampleFlag_Keyframe;
+			SamplesSinceKeyframe = 0;
+		}
+
+		FByteWriter Writer(Payload);
+		Writer.WriteUInt8(Flags);
+
+		if (Flags & SampleFlag_Time)
+		{
+			Writer.WriteFloat(TimeDelta);
+		}
+
+		if (Flags & SampleFlag_Steering)
+		{
+			Writer.WriteUInt8(static_cast<uint8>(Input.Steering));
+		}
+
+		if (Flags & SampleFlag_Throttle)
+		{
+			Writer.WriteUInt8(Input.Throttle);
+		}
+
+		if (Flags & SampleFlag_Brake)
+		{
+			Writer.WriteUInt8(Input.Brake);
+		}
+
+		if (Flags & SampleFlag_Keyframe)
+		{
+			// the first keyframe deltas against zero, which makes it absolute
+			if (bFirst)
+			{
+				LastKeyframe = FQuantizedState();
+			}
+
+			Writer.WriteVarInt(static_cast<int64>(State.Location.X) - LastKeyframe.Location.X);
+			Writer.WriteVarInt(static_cast<int64>(State.Location.Y) - LastKeyframe.Location.Y);
+			Writer.WriteVarInt(static_cast<int64>(State.Location.Z) - LastKeyframe.Location.Z);
+			Writer.WriteVarInt(static_cast<int64>(State.Velocity.X) - LastKeyframe.Velocity.X);
+			Writer.WriteVarInt(static_cast<int64>(State.Velocity.Y) - LastKeyframe.Velocity.Y);
+			Writer.WriteVarInt(static_cast<int64>(State.Velocity.Z) - LastKeyframe.Velocity.Z);
+			Writer.WriteUInt32(State.Rotation);
+
+			LastKeyframe = State;
+		}
+
+		LastInput = Input;
+		++NumSamples;
+	}
+
+	void FStepBlockEncoder::Flush(uint32 VehicleId, TArray<uint8>& Out)
+	{
+		if (NumSamples > 0)
+		{
+			FByteWriter Writer(Out);
+			Writer.WriteUInt8(static_cast<uint8>(EBlockType::Steps));
+			Writer.WriteVarUInt(VehicleId);
+			Writer.WriteVarUInt(NumSamples);
+			Writer.WriteDouble(FirstTime);
+			Writer.WriteFloat(StepDelta);
+			Writer.WriteVarUInt(Payload.Num());
+			Out.Append(Payload);
+		}
+
+		Payload.Reset();
+		NumSamples = 0;
+		SamplesSinceKeyframe = 0;
+		StepDelta = 0.0f;
+	}
+
+	FStepBlockDecoder::FStepBlockDecoder(const FStepBlockHeader& InHeader, const uint8* Payload)
+		: Header(InHeader)
+		, Reader(Payload, InHeader.PayloadSize)
+	{
+	}
+
+	bool FStepBlockDecoder::Next(FSample& OutSample)
+	{
+		if (NumDecoded >= Header.NumSamples || Reader.bOverflow)
+		{
+			return false;
+		}
+
+		const uint8 Flags = Reader.ReadUInt8();
+
+		// mirror the encoder's time reconstruction
+		if (NumDecoded == 0)
+		{
+			Current.Time = Header.FirstTime;
+
+		} else if (Flags & SampleFlag_Time) {
+
+			Current.Time += Reader.ReadFloat();
+
+		} else {
+
+			Current.Time += Header.StepDelta;
+		}
+
+		if (Flags & SampleFlag_Steering)
+		{
+			Current.Input.Steering = static_cast<int8>(Reader.ReadUInt8());
+		}
+
+		if (Flags & SampleFlag_Throttle)
+		{
+			Current.Input.Throttle = Reader.ReadUInt8();
+		}
+
+		if (Flags & SampleFlag_Brake)
+		{
+			Current.Input.Brake = Reader.ReadUInt8();
+		}
+
+		Current.Input.bHandbrake = (Flags & SampleFlag_Handbrake) != 0;
+		Current.bKeyframe = (Flags & SampleFlag_Keyframe) != 0;
+
+		if (Current.bKeyframe)
+		{
+			FQuantizedState& State = Current.State;
+			State.Location.X += static_cast<int32>(Reader.ReadVarInt());
+			State.Location.Y += static_cast<int32>(Reader.ReadVarInt());
+			State.Location.Z += static_cast<int32>(Reader.ReadVarInt());
+			State.Velocity.X += static_cast<int32>(Reader.ReadVarInt());
+			State.Velocity.Y += static_cast<int32>(Reader.ReadVarInt());
+			State.Velocity.Z += static_cast<int32>(Reader.ReadVarInt());
+			State.Rotation = Reader.ReadUInt32();
+		}
+
+		if (Reader.bOverflow)
+		{
+			return false;
+		}
+
+		++NumDecoded;
+		OutSample = Current;
+
+		return true;
+	}
+}
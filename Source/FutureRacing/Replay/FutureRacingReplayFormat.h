@@ -0,0 +1,276 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ *  Replay file format, shared by the recorder and anything reading replays back.
+ *
+ *  A replay is a file header followed by a stream of blocks. Vehicle blocks declare a vehicle,
+ *  step blocks hold a run of samples for a single vehicle. Every step block starts with absolute
+ *  inputs and an absolute keyframe, so each block decodes on its own and a dropped block only
+ *  loses its own samples.
+ *
+ *  A sample is one flag byte, followed by whichever inputs changed and, every few samples,
+ *  a keyframe delta encoded against the previous keyframe in the block. Locations are quantized
+ *  to centimeters, velocities to cm/s and rotations to three 10 bit components.
+ */
+namespace FutureRacingReplay
+{
+	/** "FRRP", little endian */
+	constexpr uint32 FileMagic = 0x50525246;
+
+	/** Bump whenever the layout changes. Version 2 added the lap time to the file header */
+	constexpr uint32 FileVersion = 2;
+
+	/** Number of samples per step block, unless the recorder is configured otherwise */
+	constexpr int32 DefaultSamplesPerBlock = 120;
+
+	/** File extension for replays */
+	static const TCHAR* const FileExtension = TEXT(".frreplay");
+
+	/** Type byte at the start of every block */
+	enum class EBlockType : uint8
+	{
+		Vehicle = 1,
+		Steps = 2
+	};
+
+	/** Flags at the start of every sample */
+	enum ESampleFlags : uint8
+	{
+		SampleFlag_Steering = 1 << 0,
+		SampleFlag_Throttle = 1 << 1,
+		SampleFlag_Brake = 1 << 2,
+		SampleFlag_Handbrake = 1 << 3,
+		SampleFlag_Keyframe = 1 << 4,
+		SampleFlag_Time = 1 << 5
+	};
+
+	/** Control inputs at replay resolution */
+	struct FQuantizedInput
+	{
+		int8 Steering = 0;
+		uint8 Throttle = 0;
+		uint8 Brake = 0;
+		bool bHandbrake = false;
+
+		static FQuantizedInput Quantize(float Steering, float Throttle, float Brake, bool bHandbrake);
+
+		float GetSteering() const { return Steering / 127.0f; }
+		float GetThrottle() const { return Throttle / 255.0f; }
+		float GetBrake() const { return Brake / 255.0f; }
+	};
+
+	/** Body state at replay resolution */
+	struct FQuantizedState
+	{
+		/** Location, in cm */
+		FIntVector Location = FIntVector::ZeroValue;
+
+		/** Linear velocity, in cm/s */
+		FIntVector Velocity = FIntVector::ZeroValue;
+
+		/** Smallest three packed rotation */
+		uint32 Rotation = 0;
+
+		static FQuantizedState Quantize(const FVector& Location, const FQuat& Rotation, const FVector& Velocity);
+
+		FVector GetLocation() const { return FVector(Location); }
+		FVector GetVelocity() const { return FVector(Velocity); }
+		FQuat GetRotation() const;
+	};
+
+	/** Packs a rotation into two index bits and three 10 bit components */
+	uint32 PackRotation(const FQuat& Rotation);
+
+	/** Unpacks a rotation made by PackRotation */
+	FQuat UnpackRotation(uint32 Packed);
+
+	/**
+	 *  Appends little endian and variable length values to a byte array
+	 */
+	struct FByteWriter
+	{
+		TArray<uint8>& Bytes;
+
+		explicit FByteWriter(TArray<uint8>& InBytes) : Bytes(InBytes) {}
+
+		void WriteUInt8(uint8 Value) { Bytes.Add(Value); }
+		void WriteUInt32(uint32 Value);
+		void WriteFloat(float Value);
+		void WriteDouble(double Value);
+
+		/** Seven bits per byte, high bit set while more bytes follow */
+		void WriteVarUInt(uint64 Value);
+
+		/** Zig zag encoded, so small negative values stay small */
+		void WriteVarInt(int64 Value);
+
+		/** Length prefixed UTF-8 */
+		void WriteString(const FString& Value);
+	};
+
+	/**
+	 *  Reads values written by FByteWriter. Reading past the end sets bOverflow and returns zeroes
+	 */
+	struct FByteReader
+	{
+		const uint8* Data = nullptr;
+		int64 Size = 0;
+		int64 Offset = 0;
+		bool bOverflow = false;
+
+		FByteReader(const uint8* InData, int64 InSize) : Data(InData), Size(InSize) {}
+
+		bool IsAtEnd() const { return Offset >= Size; }
+		int64 GetRemaining() const { return Size - Offset; }
+
+		uint8 ReadUInt8();
+		uint32 ReadUInt32();
+		float ReadFloat();
+		double ReadDouble();
+		uint64 ReadVarUInt();
+		int64 ReadVarInt();
+		FString ReadString();
+
+		/** Skips over bytes without reading them */
+		void Skip(int64 Num);
+	};
+
+	/** Contents of the file header */
+	struct FFileHeader
+	{
+		uint32 Version = FileVersion;
+
+		/** Map the replay was recorded on */
+		FString MapName;
+
+		/** Wall clock time recording started at */
+		FDateTime RecordedAt;
+
+		/** Duration of the lap a ghost lap file holds, in seconds. Zero for full replays and files older than version 2 */
+		double LapTime = 0.0;
+	};
+
+	void WriteFileHeader(TArray<uint8>& Out, const FFileHeader& Header);
+
+	/** Returns false if the data isn't a replay we can read */
+	bool ReadFileHeader(FByteReader& Reader, FFileHeader& OutHeader);
+
+	/** Contents of a vehicle block */
+	struct FVehicleBlock
+	{
+		uint32 VehicleId = 0;
+
+		/** Path of the recorded vehicle's class */
+		FString ClassPath;
+
+		/** Name of the recorded vehicle actor */
+		FString Name;
+	};
+
+	void WriteVehicleBlock(TArray<uint8>& Out, const FVehicleBlock& Block);
+
+	/** Reads a vehicle block, after its type byte */
+	bool ReadVehicleBlock(FByteReader& Reader, FVehicleBlock& OutBlock);
+
+	/** Header of a step block. The payload follows it */
+	struct FStepBlockHeader
+	{
+		uint32 VehicleId = 0;
+		int32 NumSamples = 0;
+
+		/** Physics time of the first sample */
+		double FirstTime = 0.0;
+
+		/** Time between samples, unless a sample says otherwise */
+		float StepDelta = 0.0f;
+
+		/** Size of the payload, in bytes */
+		int32 PayloadSize = 0;
+	};
+
+	/** Reads a step block header, after its type byte */
+	bool ReadStepBlockHeader(FByteReader& Reader, FStepBlockHeader& OutHeader);
+
+	/** A decoded sample */
+	struct FSample
+	{
+		/** Physics time of the sample */
+		double Time = 0.0;
+
+		/** Inputs held during the sample */
+		FQuantizedInput Input;
+
+		/** Most recent keyframe at or before the sample */
+		FQuantizedState State;
+
+		/** If true, State was keyed on this sample */
+		bool bKeyframe = false;
+	};
+
+	/**
+	 *  Builds step blocks for a single vehicle, one sample at a time
+	 */
+	class FStepBlockEncoder
+	{
+	public:
+
+		explicit FStepBlockEncoder(int32 InKeyframeInterval = 6);
+
+		/** Adds a sample. State is only encoded on keyframes */
+		void AddSample(double Time, const FQuantizedInput& Input, const FQuantizedState& State);
+
+		/** Returns the number of samples in the open block */
+		int32 GetNumSamples() const { return NumSamples; }
+
+		/** Appends the open block, if it has any samples, and starts a new one */
+		void Flush(uint32 VehicleId, TArray<uint8>& Out);
+
+	protected:
+
+		/** Keyframe every this many samples */
+		int32 KeyframeInterval = 6;
+
+		/** Encoded samples of the open block */
+		TArray<uint8> Payload;
+
+		int32 NumSamples = 0;
+		int32 SamplesSinceKeyframe = 0;
+
+		double FirstTime = 0.0;
+
+		/** Sample time as the decoder will reconstruct it */
+		double LastTime = 0.0;
+
+		float StepDelta = 0.0f;
+
+		FQuantizedInput LastInput;
+		FQuantizedState LastKeyframe;
+	};
+
+	/**
+	 *  Walks the samples of a step block
+	 */
+	class FStepBlockDecoder
+	{
+	public:
+
+		/** Payload must stay alive while decoding */
+		FStepBlockDecoder(const FStepBlockHeader& InHeader, const uint8* Payload);
+
+		/** Decodes the next sample. Returns false at the end of the block or on corrupt data */
+		bool Next(FSample& OutSample);
+
+	protected:
+
+		FStepBlockHeader Header;
+		FByteReader Reader;
+		int32 NumDecoded = 0;
+
+		/** Running state, carried from sample to sample */
+		FSample Current;
+	};
+}
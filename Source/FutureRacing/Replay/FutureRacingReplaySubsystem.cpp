@@ -0,0 +1,313 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "FutureRacingReplaySubsystem.h"
+#include "FutureRacingPawn.h"
+#include "FutureRacingVehicleMovementComponent.h"
+#include "FutureRacingGateCrossingSubsystem.h"
+#include "ChaosWheeledVehicleMovementComponent.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/Paths.h"
+#include "FutureRacing.h"
+
+DECLARE_CYCLE_STAT(TEXT("Replay Record"), STAT_FutureRacingReplayRecord, STATGROUP_FutureRacing);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Replay Dropped Blocks"), STAT_FutureRacingReplayDroppedBlocks, STATGROUP_FutureRacing);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Replay Recorded (KB)"), STAT_FutureRacingReplayRecordedKB, STATGROUP_FutureRacing);
+
+static TAutoConsoleVariable<int32> CVarReplayRecord(
+	TEXT("FutureRacing.Replay.Record"),
+	1,
+	TEXT("If 1, every vehicle in a game world is recorded to a replay file under Saved/Replays.\n")
+	TEXT("Takes effect for the next world."),
+	ECVF_Default);
+
+static FAutoConsoleCommandWithWorld DumpReplayCommand(
+	TEXT("FutureRacing.Replay.Dump"),
+	TEXT("Logs the replay recorder size and cost for the current world."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (UFutureRacingReplaySubsystem* Replay = World ? World->GetSubsystem<UFutureRacingReplaySubsystem>() : nullptr)
+		{
+			const FFutureRacingReplayStats Stats = Replay->GetStats();
+
+			UE_LOG(LogFutureRacing, Display, TEXT("Replay '%s': %lld samples, %.1f KB (%.2f bytes/sample), %d dropped blocks, peak buffer %.0f%%, record avg %.4fms, max %.4fms"),
+				*Replay->GetFilename(), Stats.NumSamples, Stats.BytesRecorded / 1024.0, Stats.GetBytesPerSample(),
+				Stats.NumDroppedBlocks, Stats.PeakBufferFill * 100.0f, Stats.AverageRecordMs, Stats.MaxRecordMs);
+		}
+	}));
+
+void UFutureRacingReplaySubsystem::RegisterVehicle(AFutureRacingPawn* Vehicle)
+{
+	if (!Vehicle || Recorded.ContainsByPredicate([Vehicle](const FRecordedVehicle& Entry) { return Entry.Vehicle.Get() == Vehicle; }))
+	{
+		return;
+	}
+
+	// the file is only opened once there's something to record
+	if (!Writer)
+	{
+		if (!CVarReplayRecord.GetValueOnGameThread() || !GetWorld()->IsGameWorld())
+		{
+			return;
+		}
+
+		StartRecording();
+	}
+
+	FRecordedVehicle& Entry = Recorded.Emplace_GetRef();
+	Entry.Vehicle = Vehicle;
+	Entry.Encoder = FutureRacingReplay::FStepBlockEncoder(KeyframeInterval);
+
+	// skip any steps simulated before we started watching, e.g. while parked in a pool
+	const TArray<FFutureRacingPhysicsStep>& Steps = Vehicle->GetRacingVehicleMovement()->GetRecentSteps();
+	Entry.LastStepIndex = Steps.Num() > 0 ? Steps.Last().StepIndex : -1;
+
+	// vehicles coming back from the pool keep their id
+	if (const uint32* Id = VehicleIds.Find(Vehicle))
+	{
+		Entry.Id = *Id;
+		return;
+	}
+
+	Entry.Id = VehicleIds.Num();
+	VehicleIds.Add(Vehicle, Entry.Id);
+
+	FutureRacingReplay::FVehicleBlock Block;
+	Block.VehicleId = Entry.Id;
+	Block.ClassPath = Vehicle->GetClass()->GetPathName();
+	Block.Name = Vehicle->GetName();
+
+	BlockScratch.Reset();
+	FutureRacingReplay::WriteVehicleBlock(BlockScratch, Block);
+	SubmitScratch();
+}
+
+void UFutureRacingReplaySubsystem::UnregisterVehicle(AFutureRacingPawn* Vehicle)
+{
+	const int32 Index = Recorded.IndexOfByPredicate([Vehicle](const FRecordedVehicle& Entry) { return Entry.Vehicle.Get() == Vehicle; });
+
+	if (Index != INDEX_NONE)
+	{
+		FlushBlock(Recorded[Index]);
+		Recorded.RemoveAtSwap(Index);
+	}
+}
+
+int64 UFutureRacingReplaySubsystem::FlushVehicle(AFutureRacingPawn* Vehicle)
+{
+	FRecordedVehicle* Entry = Recorded.FindByPredicate([Vehicle](const FRecordedVehicle& Candidate) { return Candidate.Vehicle.Get() == Vehicle; });
+
+	if (!Writer || !Entry)
+	{
+		return -1;
+	}
+
+	FlushBlock(*Entry);
+	Writer->Wake();
+
+	return Writer->GetBytesSubmitted();
+}
+
+bool UFutureRacingReplaySubsystem::IsOnDisk(int64 Marker) const
+{
+	return Writer && Marker >= 0 && Writer->GetBytesWritten() >= Marker;
+}
+
+int32 UFutureRacingReplaySubsystem::GetVehicleId(const AFutureRacingPawn* Vehicle) const
+{
+	const uint32* Id = VehicleIds.Find(Vehicle);
+
+	return Id ? static_cast<int32>(*Id) : INDEX_NONE;
+}
+
+FString UFutureRacingReplaySubsystem::GetFilename() const
+{
+	return Writer ? Writer->GetFilename() : FString();
+}
+
+FFutureRacingReplayStats UFutureRacingReplaySubsystem::GetStats() const
+{
+	FFutureRacingReplayStats Result = Stats;
+
+	if (Writer)
+	{
+		Result.BytesRecorded = Writer->GetBytesSubmitted();
+		Result.NumDroppedBlocks = Writer->GetNumDroppedBlocks();
+		Result.PeakBufferFill = Writer->GetPeakFill();
+	}
+
+	return Result;
+}
+
+void UFutureRacingReplaySubsystem::Deinitialize()
+{
+	StopRecording();
+
+	Super::Deinitialize();
+}
+
+void UFutureRacingReplaySubsystem::Tick(float DeltaTime)
+{
+	if (!Writer || Recorded.Num() == 0)
+	{
+		return;
+	}
+
+	FUTURERACING_SCOPE_CYCLE_COUNTER(STAT_FutureRacingReplayRecord);
+	LLM_SCOPE_BYTAG(FutureRacing_Replay);
+
+	const uint64 StartCycles = FPlatformTime::Cycles64();
+
+	// kinematic vehicles are sampled on the same clock the physics steps are stamped with
+	const UFutureRacingGateCrossingSubsystem* GateCrossing = GetWorld()->GetSubsystem<UFutureRacingGateCrossingSubsystem>();
+	const double ResultsTime = GateCrossing ? GateCrossing->GetPhysicsResultsTime() : GetWorld()->GetTimeSeconds();
+
+	for (int32 Index = Recorded.Num() - 1; Index >= 0; --Index)
+	{
+		FRecordedVehicle& Entry = Recorded[Index];
+
+		// close out vehicles destroyed without unregistering
+		if (!Entry.Vehicle.IsValid())
+		{
+			FlushBlock(Entry);
+			Recorded.RemoveAtSwap(Index);
+			continue;
+		}
+
+		RecordVehicle(Entry, ResultsTime);
+	}
+
+	const double ElapsedMs = FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - StartCycles);
+
+	++NumRecordedFrames;
+	TotalRecordMs += ElapsedMs;
+	Stats.AverageRecordMs = TotalRecordMs / NumRecordedFrames;
+	Stats.MaxRecordMs = FMath::Max(Stats.MaxRecordMs, ElapsedMs);
+}
+
+TStatId UFutureRacingReplaySubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UFutureRacingReplaySubsystem, STATGROUP_Tickables);
+}
+
+void UFutureRacingReplaySubsystem::StartRecording()
+{
+	LLM_SCOPE_BYTAG(FutureRacing_Replay);
+
+	const FString MapName = UWorld::RemovePIEPrefix(GetWorld()->GetMapName());
+	const FDateTime Now = FDateTime::Now();
+
+	const FString Filename = FPaths::Combine(FPaths::ProjectSavedDir(), ReplayFolder,
+		FString::Printf(TEXT("%s_%s%s"), *MapName, *Now.ToString(), FutureRacingReplay::FileExtension));
+
+	Writer = MakeUnique<FFutureRacingReplayWriter>(Filename, FMath::Max(BufferSizeKB, 64) * 1024);
+	Writer->Start();
+
+	// reserve enough scratch for a full block up front, so recording doesn't allocate
+	BlockScratch.Reserve(SamplesPerBlock * 64);
+
+	FutureRacingReplay::FFileHeader Header;
+	Header.MapName = MapName;
+	Header.RecordedAt = Now;
+
+	BlockScratch.Reset();
+	FutureRacingReplay::WriteFileHeader(BlockScratch, Header);
+	SubmitScratch();
+
+	UE_LOG(LogFutureRacing, Log, TEXT("Recording replay to '%s'."), *Filename);
+}
+
+void UFutureRacingReplaySubsystem::StopRecording()
+{
+	if (!Writer)
+	{
+		return;
+	}
+
+	for (FRecordedVehicle& Entry : Recorded)
+	{
+		FlushBlock(Entry);
+	}
+
+	Recorded.Empty();
+	VehicleIds.Empty();
+
+	Writer->Finish();
+
+	const FFutureRacingReplayStats FinalStats = GetStats();
+
+	UE_LOG(LogFutureRacing, Log, TEXT("Finished replay '%s': %lld samples, %.1f KB, %d dropped blocks."),
+		*Writer->GetFilename(), FinalStats.NumSamples, FinalStats.BytesRecorded / 1024.0, FinalStats.NumDroppedBlocks);
+
+	Writer.Reset();
+}
+
+void UFutureRacingReplaySubsystem::RecordVehicle(FRecordedVehicle& Entry, double ResultsTime)
+{
+	using namespace FutureRacingReplay;
+
+	AFutureRacingPawn* Vehicle = Entry.Vehicle.Get();
+
+	if (Vehicle->IsKinematicSimulation())
+	{
+		// kinematic vehicles don't publish physics steps, so sample where they are now
+		const UChaosWheeledVehicleMovementComponent* Movement = Vehicle->GetChaosVehicleMovement();
+
+		Entry.Encoder.AddSample(ResultsTime,
+			FQuantizedInput::Quantize(Movement->GetSteeringInput(), Movement->GetThrottleInput(), Movement->GetBrakeInput(), Movement->GetHandbrakeInput()),
+			FQuantizedState::Quantize(Vehicle->GetActorLocation(), Vehicle->GetActorQuat(), Vehicle->GetVelocity()));
+
+		++Stats.NumSamples;
+
+	} else {
+
+		// record every physics step we haven't seen yet
+		for (const FFutureRacingPhysicsStep& Step : Vehicle->GetRacingVehicleMovement()->GetRecentSteps())
+		{
+			if (Step.StepIndex <= Entry.LastStepIndex)
+			{
+				continue;
+			}
+
+			Entry.LastStepIndex = Step.StepIndex;
+
+			Entry.Encoder.AddSample(Step.Time,
+				FQuantizedInput::Quantize(Step.Input.Steering, Step.Input.Throttle, Step.Input.Brake, Step.Input.bHandbrake),
+				FQuantizedState::Quantize(Step.Location, Step.Rotation, Step.LinearVelocity));
+
+			++Stats.NumSamples;
+		}
+	}
+
+	if (Entry.Encoder.GetNumSamples() >= SamplesPerBlock)
+	{
+		FlushBlock(Entry);
+	}
+}
+
+void UFutureRacingReplaySubsystem::FlushBlock(FRecordedVehicle& Entry)
+{
+	if (!Writer || Entry.Encoder.GetNumSamples() == 0)
+	{
+		return;
+	}
+
+	BlockScratch.Reset();
+	Entry.Encoder.Flush(Entry.Id, BlockScratch);
+	SubmitScratch();
+}
+
+void UFutureRacingReplaySubsystem::SubmitScratch()
+{
+	if (Writer->Submit(BlockScratch))
+	{
+		INC_FLOAT_STAT_BY(STAT_FutureRacingReplayRecordedKB, BlockScratch.Num() / 1024.0f);
+
+	} else {
+
+		INC_DWORD_STAT(STAT_FutureRacingReplayDroppedBlocks);
+		UE_LOG(LogFutureRacing, Verbose, TEXT("Replay buffer full, dropped a %d byte block."), BlockScratch.Num());
+	}
+}
@@ -0,0 +1,161 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "FutureRacingReplayFormat.h"
+#include "FutureRacingReplayWriter.h"
+#include "FutureRacingReplaySubsystem.generated.h"
+
+class AFutureRacingPawn;
+
+/**
+ *  Replay recorder measurements
+ */
+struct FFutureRacingReplayStats
+{
+	/** Number of samples recorded across all vehicles */
+	int64 NumSamples = 0;
+
+	/** Number of bytes handed to the writer */
+	int64 BytesRecorded = 0;
+
+	/** Number of blocks lost to a full buffer */
+	int32 NumDroppedBlocks = 0;
+
+	/** Fullest the ring buffer has been, from 0 to 1 */
+	float PeakBufferFill = 0.0f;
+
+	/** Average game thread time spent recording per frame */
+	double AverageRecordMs = 0.0;
+
+	/** Worst game thread time spent recording in a frame */
+	double MaxRecordMs = 0.0;
+
+	/** Returns the average encoded size of a sample */
+	double GetBytesPerSample() const { return NumSamples > 0 ? static_cast<double>(BytesRecorded) / NumSamples : 0.0; }
+};
+
+/**
+ *  Records every vehicle in the world to a replay file.
+ *  Each physics step's inputs and body state are quantized and delta encoded into
+ *  per vehicle blocks, which are handed to a fixed size ring buffer and streamed to disk
+ *  from a background thread. A full buffer drops blocks rather than stalling the game thread.
+ */
+UCLASS(Config="Game")
+class UFutureRacingReplaySubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+protected:
+
+	/** Size of the ring buffer between the game thread and the writer thread */
+	UPROPERTY(Config)
+	int32 BufferSizeKB = 4096;
+
+	/** Number of samples per block. Larger blocks compress better, smaller ones lose less when dropped */
+	UPROPERTY(Config)
+	int32 SamplesPerBlock = FutureRacingReplay::DefaultSamplesPerBlock;
+
+	/** Number of samples between keyframes */
+	UPROPERTY(Config)
+	int32 KeyframeInterval = 6;
+
+	/** Folder replays are saved to, relative to the project's Saved folder */
+	UPROPERTY(Config)
+	FString ReplayFolder = TEXT("Replays");
+
+	/** Recording state of a single vehicle */
+	struct FRecordedVehicle
+	{
+		TWeakObjectPtr<AFutureRacingPawn> Vehicle;
+
+		/** Id the vehicle is recorded under */
+		uint32 Id = 0;
+
+		/** Last physics step recorded */
+		int64 LastStepIndex = -1;
+
+		/** Open block */
+		FutureRacingReplay::FStepBlockEncoder Encoder;
+	};
+
+	/** Vehicles being recorded */
+	TArray<FRecordedVehicle> Recorded;
+
+	/** Ids handed out so far, so vehicles coming back from the pool keep theirs */
+	TMap<TWeakObjectPtr<AFutureRacingPawn>, uint32> VehicleIds;
+
+	/** Streams the blocks to disk. Created with the first vehicle */
+	TUniquePtr<FFutureRacingReplayWriter> Writer;
+
+	/** Scratch space blocks are built in before submitting */
+	TArray<uint8> BlockScratch;
+
+	/** Measurements */
+	FFutureRacingReplayStats Stats;
+
+	/** Total game thread time spent recording, and the number of frames it was spread over */
+	double TotalRecordMs = 0.0;
+	int64 NumRecordedFrames = 0;
+
+public:
+
+	/** Starts recording a vehicle */
+	void RegisterVehicle(AFutureRacingPawn* Vehicle);
+
+	/** Stops recording a vehicle, closing its open block */
+	void UnregisterVehicle(AFutureRacingPawn* Vehicle);
+
+	/**
+	 *  Hands a vehicle's open block to the writer and wakes the writer up
+	 *  @return Marker to pass to IsOnDisk, or -1 if the vehicle isn't being recorded
+	 */
+	int64 FlushVehicle(AFutureRacingPawn* Vehicle);
+
+	/** Returns true once everything submitted before a FlushVehicle marker has been written to the file */
+	bool IsOnDisk(int64 Marker) const;
+
+	/** Returns the id a vehicle is recorded under, or INDEX_NONE if it was never recorded */
+	int32 GetVehicleId(const AFutureRacingPawn* Vehicle) const;
+
+	/** Returns true if a replay is being recorded */
+	bool IsRecording() const { return Writer.IsValid(); }
+
+	/** Returns the file being recorded to, or an empty string if not recording */
+	FString GetFilename() const;
+
+	/** Returns the recorder measurements */
+	FFutureRacingReplayStats GetStats() const;
+
+	// Begin UWorldSubsystem interface
+
+	virtual void Deinitialize() override;
+
+	// End UWorldSubsystem interface
+
+	// Begin FTickableGameObject interface
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	// End FTickableGameObject interface
+
+protected:
+
+	/** Opens the replay file and starts the writer thread */
+	void StartRecording();
+
+	/** Closes every open block and finishes the file */
+	void StopRecording();
+
+	/** Records the samples a vehicle produced since the last frame */
+	void RecordVehicle(FRecordedVehicle& Entry, double ResultsTime);
+
+	/** Hands a vehicle's open block to the writer */
+	void FlushBlock(FRecordedVehicle& Entry);
+
+	/** Hands the scratch block to the writer */
+	void SubmitScratch();
+};
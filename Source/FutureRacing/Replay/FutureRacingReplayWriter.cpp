@@ -0,0 +1,246 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "FutureRacingReplayWriter.h"
+#include "HAL/FileManager.h"
+#include "HAL/Event.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/RunnableThread.h"
+#include "Serialization/Archive.h"
+#include "FutureRacing.h"
+
+FFutureRacingByteRingBuffer::FFutureRacingByteRingBuffer(int32 InCapacity)
+{
+	Buffer.SetNumUninitialized(FMath::Max(InCapacity, 1));
+}
+
+bool FFutureRacingByteRingBuffer::Write(const uint8* Data, int32 Num)
+{
+	const uint64 Write = WritePosition.load(std::memory_order_relaxed);
+	const uint64 Read = ReadPosition.load(std::memory_order_acquire);
+	const int32 Capacity = Buffer.Num();
+
+	if (Num > Capacity - static_cast<int32>(Write - Read))
+	{
+		return false;
+	}
+
+	// copy in two parts if the data wraps around the end of the buffer
+	const int32 Start = static_cast<int32>(Write % Capacity);
+	const int32 FirstPart = FMath::Min(Num, Capacity - Start);
+
+	FMemory::Memcpy(Buffer.GetData() + Start, Data, FirstPart);
+	FMemory::Memcpy(Buffer.GetData(), Data + FirstPart, Num - FirstPart);
+
+	WritePosition.store(Write + Num, std::memory_order_release);
+
+	return true;
+}
+
+bool FFutureRacingByteRingBuffer::Read(uint8* Data, int32 Num)
+{
+	const uint64 Read = ReadPosition.load(std::memory_order_relaxed);
+	const uint64 Write = WritePosition.load(std::memory_order_acquire);
+	const int32 Capacity = Buffer.Num();
+
+	if (Num > static_cast<int32>(Write - Read))
+	{
+		return false;
+	}
+
+	// copy out in two parts if the data wraps around the end of the buffer
+	const int32 Start = static_cast<int32>(Read % Capacity);
+	const int32 FirstPart = FMath::Min(Num, Capacity - Start);
+
+	FMemory::Memcpy(Data, Buffer.GetData() + Start, FirstPart);
+	FMemory::Memcpy(Data + FirstPart, Buffer.GetData(), Num - FirstPart);
+
+	ReadPosition.store(Read + Num, std::memory_order_release);
+
+	return true;
+}
+
+int64 FFutureRacingByteRingBuffer::Drain(FArchive* Archive)
+{
+	const uint64 Read = ReadPosition.load(std::memory_order_relaxed);
+	const uint64 Write = WritePosition.load(std::memory_order_acquire);
+	const int32 Capacity = Buffer.Num();
+	const int32 Num = static_cast<int32>(Write - Read);
+
+	if (Num == 0)
+	{
+		return 0;
+	}
+
+	if (Archive)
+	{
+		const int32 Start = static_cast<int32>(Read % Capacity);
+		const int32 FirstPart = FMath::Min(Num, Capacity - Start);
+
+		Archive->Serialize(Buffer.GetData() + Start, FirstPart);
+
+		if (Num > FirstPart)
+		{
+			Archive->Serialize(Buffer.GetData(), Num - FirstPart);
+		}
+	}
+
+	ReadPosition.store(Write, std::memory_order_release);
+
+	return Num;
+}
+
+int32 FFutureRacingByteRingBuffer::GetNumUsed() const
+{
+	return static_cast<int32>(WritePosition.load(std::memory_order_acquire) - ReadPosition.load(std::memory_order_acquire));
+}
+
+FFutureRacingReplayWriter::FFutureRacingReplayWriter(const FString& InFilename, int32 BufferCapacity)
+	: Filename(InFilename)
+	, Ring(BufferCapacity)
+{
+}
+
+FFutureRacingReplayWriter::~FFutureRacingReplayWriter()
+{
+	Finish();
+}
+
+void FFutureRacingReplayWriter::Start()
+{
+	if (Thread || !FPlatformProcess::SupportsMultithreading())
+	{
+		return;
+	}
+
+	WakeEvent = FPlatformProcess::GetSynchEventFromPool(false);
+	Thread = FRunnableThread::Create(this, TEXT("FutureRacingReplayWriter"), 0, TPri_BelowNormal);
+}
+
+bool FFutureRacingReplayWriter::Submit(const TArray<uint8>& Block)
+{
+	if (!Ring.Write(Block.GetData(), Block.Num()))
+	{
+		++NumDroppedBlocks;
+		return false;
+	}
+
+	BytesSubmitted += Block.Num();
+
+	const float Fill = static_cast<float>(Ring.GetNumUsed()) / Ring.GetCapacity();
+	PeakFill = FMath::Max(PeakFill, Fill);
+
+	if (!Thread)
+	{
+		// no writer thread, so write on ours
+		OpenFile();
+		BytesWritten.fetch_add(Ring.Drain(Archive.Get()), std::memory_order_relaxed);
+
+		if (Archive)
+		{
+			Archive->Flush();
+		}
+
+	} else if (Fill > 0.25f) {
+
+		// filling up faster than the writer wakes up on its own
+		WakeEvent->Trigger();
+	}
+
+	return true;
+}
+
+void FFutureRacingReplayWriter::Wake()
+{
+	if (WakeEvent)
+	{
+		WakeEvent->Trigger();
+	}
+}
+
+void FFutureRacingReplayWriter::Finish()
+{
+	if (Thread)
+	{
+		Stop();
+		Thread->WaitForCompletion();
+
+		delete Thread;
+		Thread = nullptr;
+
+	} else if (bOpenAttempted || Ring.GetNumUsed() > 0) {
+
+		OpenFile();
+		BytesWritten.fetch_add(Ring.Drain(Archive.Get()), std::memory_order_relaxed);
+	}
+
+	if (WakeEvent)
+	{
+		FPlatformProcess::ReturnSynchEventToPool(WakeEvent);
+		WakeEvent = nullptr;
+	}
+
+	if (Archive)
+	{
+		Archive->Close();
+		Archive.Reset();
+	}
+}
+
+uint32 FFutureRacingReplayWriter::Run()
+{
+	OpenFile();
+
+	while (!bStopRequested.load(std::memory_order_acquire))
+	{
+		WakeEvent->Wait(DrainIntervalMs);
+
+		const int64 Drained = Ring.Drain(Archive.Get());
+
+		// push it through to the file so readers of the live replay see whole blocks
+		if (Drained > 0 && Archive)
+		{
+			Archive->Flush();
+		}
+
+		BytesWritten.fetch_add(Drained, std::memory_order_relaxed);
+	}
+
+	// pick up anything submitted before the stop request
+	BytesWritten.fetch_add(Ring.Drain(Archive.Get()), std::memory_order_relaxed);
+
+	if (Archive)
+	{
+		Archive->Flush();
+	}
+
+	return 0;
+}
+
+void FFutureRacingReplayWriter::Stop()
+{
+	bStopRequested.store(true, std::memory_order_release);
+
+	if (WakeEvent)
+	{
+		WakeEvent->Trigger();
+	}
+}
+
+void FFutureRacingReplayWriter::OpenFile()
+{
+	if (bOpenAttempted)
+	{
+		return;
+	}
+
+	bOpenAttempted = true;
+
+	// the file manager creates the directory tree for us. Others may read the replay while it's recorded
+	Archive.Reset(IFileManager::Get().CreateFileWriter(*Filename, FILEWRITE_AllowRead));
+
+	if (!Archive)
+	{
+		UE_LOG(LogFutureRacing, Error, TEXT("Could not open replay file '%s'. Recorded data will be discarded."), *Filename);
+	}
+}
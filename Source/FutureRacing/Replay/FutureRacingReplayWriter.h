@@ -0,0 +1,128 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+#include <atomic>
+
+class FArchive;
+class FEvent;
+class FRunnableThread;
+
+/**
+ *  Fixed size single producer, single consumer byte ring buffer.
+ *  Writes are all or nothing, so a full buffer drops whole blocks instead of stalling the producer.
+ */
+class FFutureRacingByteRingBuffer
+{
+public:
+
+	explicit FFutureRacingByteRingBuffer(int32 InCapacity);
+
+	/** Copies all of the data in. Producer only. Returns false, writing nothing, if it doesn't fit */
+	bool Write(const uint8* Data, int32 Num);
+
+	/** Copies the oldest Num bytes out. Consumer only. Returns false, reading nothing, if fewer are buffered */
+	bool Read(uint8* Data, int32 Num);
+
+	/** Moves everything buffered so far into the archive, or discards it if there's no archive. Consumer only */
+	int64 Drain(FArchive* Archive);
+
+	/** Returns the number of bytes waiting to be drained */
+	int32 GetNumUsed() const;
+
+	/** Returns the size of the buffer */
+	int32 GetCapacity() const { return Buffer.Num(); }
+
+protected:
+
+	TArray<uint8> Buffer;
+
+	/** Total bytes ever written and read. Positions wrap through the buffer modulo its size */
+	std::atomic<uint64> WritePosition { 0 };
+	std::atomic<uint64> ReadPosition { 0 };
+};
+
+/**
+ *  Streams bytes to a file from a background thread.
+ *  The game thread submits blocks into a ring buffer and never touches the file.
+ */
+class FFutureRacingReplayWriter : public FRunnable
+{
+public:
+
+	FFutureRacingReplayWriter(const FString& InFilename, int32 BufferCapacity);
+	virtual ~FFutureRacingReplayWriter();
+
+	/** Starts the writer thread. Falls back to writing on the calling thread if threads aren't available */
+	void Start();
+
+	/** Queues a block for writing. Returns false if the buffer was full and the block was dropped */
+	bool Submit(const TArray<uint8>& Block);
+
+	/** Asks the writer thread to drain the buffer now instead of on its next interval */
+	void Wake();
+
+	/** Writes out everything submitted so far, closes the file and joins the thread */
+	void Finish();
+
+	/** Returns the file being written */
+	const FString& GetFilename() const { return Filename; }
+
+	/** Returns the number of bytes submitted */
+	int64 GetBytesSubmitted() const { return BytesSubmitted; }
+
+	/** Returns the number of bytes the writer thread has handed to the file so far */
+	int64 GetBytesWritten() const { return BytesWritten.load(std::memory_order_relaxed); }
+
+	/** Returns the number of blocks dropped because the buffer was full */
+	int32 GetNumDroppedBlocks() const { return NumDroppedBlocks; }
+
+	/** Returns the fullest the buffer has been, from 0 to 1 */
+	float GetPeakFill() const { return PeakFill; }
+
+	// Begin FRunnable interface
+
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+
+	// End FRunnable interface
+
+protected:
+
+	/** Opens the file if it isn't open yet */
+	void OpenFile();
+
+	/** Output file */
+	FString Filename;
+
+	/** Bytes waiting for the writer thread */
+	FFutureRacingByteRingBuffer Ring;
+
+	/** Output archive. Only touched by the writer thread, or the game thread when there's no writer thread */
+	TUniquePtr<FArchive> Archive;
+
+	/** If true, opening the file was already attempted */
+	bool bOpenAttempted = false;
+
+	/** Writer thread, null if writing happens on the calling thread */
+	FRunnableThread* Thread = nullptr;
+
+	/** Wakes the writer thread up early */
+	FEvent* WakeEvent = nullptr;
+
+	/** Set when the writer thread should drain and exit */
+	std::atomic<bool> bStopRequested { false };
+
+	/** How long the writer thread sleeps between drains */
+	uint32 DrainIntervalMs = 100;
+
+	/** Game thread measurements */
+	int64 BytesSubmitted = 0;
+	int32 NumDroppedBlocks = 0;
+	float PeakFill = 0.0f;
+
+	/** Writer thread measurements */
+	std::atomic<int64> BytesWritten { 0 };
+};
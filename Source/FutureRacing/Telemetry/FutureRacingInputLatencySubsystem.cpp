@@ -0,0 +1,282 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "FutureRacingInputLatencySubsystem.h"
+#include "FutureRacingVehicleMovementComponent.h"
+#include "Engine/World.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/CoreDelegates.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "RenderingThread.h"
+#include "FutureRacing.h"
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Input Latency Samples"), STAT_FutureRacingInputLatencySamples, STATGROUP_FutureRacing);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Input To Physics P50 (ms)"), STAT_FutureRacingInputToPhysicsP50, STATGROUP_FutureRacing);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Input To Physics P95 (ms)"), STAT_FutureRacingInputToPhysicsP95, STATGROUP_FutureRacing);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Input To Frame P50 (ms)"), STAT_FutureRacingInputToFrameP50, STATGROUP_FutureRacing);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Input To Frame P95 (ms)"), STAT_FutureRacingInputToFrameP95, STATGROUP_FutureRacing);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Input To Present P50 (ms)"), STAT_FutureRacingInputToPresentP50, STATGROUP_FutureRacing);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Input To Present P95 (ms)"), STAT_FutureRacingInputToPresentP95, STATGROUP_FutureRacing);
+
+static FAutoConsoleCommandWithWorld DumpLatencyHistogramsCommand(
+	TEXT("FutureRacing.Input.DumpLatencyHistograms"),
+	TEXT("Logs the input to physics, frame and present latency of the local driver, writes the histograms\n")
+	TEXT("to Saved/Benchmarks/InputLatency.csv and the samples to InputLatencySamples.csv, and resets the measurements."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (UFutureRacingInputLatencySubsystem* InputLatency = World ? World->GetSubsystem<UFutureRacingInputLatencySubsystem>() : nullptr)
+		{
+			InputLatency->DumpHistograms();
+		}
+	}));
+
+namespace
+{
+	/** Stage names, for logs and CSV */
+	const TCHAR* const StageNames[] = { TEXT("Physics"), TEXT("Frame"), TEXT("Present") };
+
+	static_assert(UE_ARRAY_COUNT(StageNames) == static_cast<int32>(EFutureRacingLatencyStage::Num), "One name per latency stage");
+}
+
+void FFutureRacingLatencyHistogram::Add(double Ms)
+{
+	Ms = FMath::Max(Ms, 0.0);
+
+	++Counts[FMath::Min(FMath::FloorToInt(Ms), NumBuckets - 1)];
+
+	++NumSamples;
+	TotalMs += Ms;
+	MaxMs = FMath::Max(MaxMs, Ms);
+}
+
+double FFutureRacingLatencyHistogram::GetPercentile(double Fraction) const
+{
+	if (NumSamples == 0)
+	{
+		return 0.0;
+	}
+
+	const int64 Target = FMath::Max<int64>(FMath::CeilToInt64(NumSamples * Fraction), 1);
+	int64 Count = 0;
+
+	// report the top of the bucket, so the percentile is never flattering
+	for (int32 Bucket = 0; Bucket < NumBuckets; ++Bucket)
+	{
+		Count += Counts[Bucket];
+
+		if (Count >= Target)
+		{
+			return FMath::Min<double>(Bucket + 1, MaxMs);
+		}
+	}
+
+	return MaxMs;
+}
+
+void UFutureRacingInputLatencySubsystem::RecordInputApplied(const FFutureRacingPhysicsStep& Step)
+{
+	const double Now = FPlatformTime::Seconds();
+	const double EventTime = Step.Input.EventTime;
+
+	const int64 SampleId = NextSampleId++;
+
+	FFutureRacingLatencySample& Sample = Samples[SampleId % Samples.Num()];
+	Sample = FFutureRacingLatencySample();
+	Sample.EventTime = EventTime;
+	Sample.PhysicsStep = Step.StepIndex;
+	Sample.Frame = GFrameCounter;
+	Sample.StageMs[static_cast<int32>(EFutureRacingLatencyStage::Physics)] = (Step.PlatformTime - EventTime) * 1000.0;
+	Sample.StageMs[static_cast<int32>(EFutureRacingLatencyStage::Frame)] = (Now - EventTime) * 1000.0;
+
+	Histograms[static_cast<int32>(EFutureRacingLatencyStage::Physics)].Add(Sample.StageMs[static_cast<int32>(EFutureRacingLatencyStage::Physics)]);
+	Histograms[static_cast<int32>(EFutureRacingLatencyStage::Frame)].Add(Sample.StageMs[static_cast<int32>(EFutureRacingLatencyStage::Frame)]);
+
+	INC_DWORD_STAT(STAT_FutureRacingInputLatencySamples);
+
+	// this frame shows the result, time it once the render thread is done with it
+	PendingPresents.Emplace(SampleId, EventTime);
+}
+
+void UFutureRacingInputLatencySubsystem::DumpHistograms()
+{
+	const FString Date = FDateTime::Now().ToString();
+	const FString MapName = GetWorld()->GetMapName();
+
+	// one row per stage, with the bucket counts after the summary
+	FString Header = TEXT("Date,Map,Stage,Samples,AvgMs,P50Ms,P90Ms,P95Ms,P99Ms,MaxMs");
+
+	for (int32 Bucket = 0; Bucket < FFutureRacingLatencyHistogram::NumBuckets; ++Bucket)
+	{
+		Header += FString::Printf(TEXT(",%dms"), Bucket);
+	}
+
+	FString Csv;
+
+	const FString CsvFile = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("Benchmarks"), TEXT("InputLatency.csv"));
+
+	if (!IFileManager::Get().FileExists(*CsvFile))
+	{
+		Csv += Header + LINE_TERMINATOR;
+	}
+
+	for (int32 Stage = 0; Stage < static_cast<int32>(EFutureRacingLatencyStage::Num); ++Stage)
+	{
+		const FFutureRacingLatencyHistogram& Histogram = Histograms[Stage];
+
+		UE_LOG(LogFutureRacing, Display, TEXT("Input to %s: %lld samples, avg %.2fms, p50 %.0fms, p95 %.0fms, p99 %.0fms, max %.2fms"),
+			StageNames[Stage], Histogram.NumSamples, Histogram.GetAverage(),
+			Histogram.GetPercentile(0.5), Histogram.GetPercentile(0.95), Histogram.GetPercentile(0.99), Histogram.MaxMs);
+
+		FString Row = FString::Printf(TEXT("%s,%s,%s,%lld,%.3f,%.0f,%.0f,%.0f,%.0f,%.3f"),
+			*Date, *MapName, StageNames[Stage], Histogram.NumSamples, Histogram.GetAverage(),
+			Histogram.GetPercentile(0.5), Histogram.GetPercentile(0.9), Histogram.GetPercentile(0.95), Histogram.GetPercentile(0.99), Histogram.MaxMs);
+
+		for (int32 Bucket = 0; Bucket < FFutureRacingLatencyHistogram::NumBuckets; ++Bucket)
+		{
+			Row += FString::Printf(TEXT(",%lld"), Histogram.Counts[Bucket]);
+		}
+
+		Csv += Row + LINE_TERMINATOR;
+	}
+
+	if (!FFileHelper::SaveStringToFile(Csv, *CsvFile, FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM, &IFileManager::Get(), FILEWRITE_Append))
+	{
+		UE_LOG(LogFutureRacing, Error, TEXT("Could not write input latency histograms to '%s'."), *CsvFile);
+	}
+
+	// the samples since the last dump, oldest first
+	FString SamplesCsv = TEXT("EventTime,PhysicsStep,Frame,PhysicsMs,FrameMs,PresentMs") LINE_TERMINATOR;
+
+	const int64 FirstSampleId = FMath::Max<int64>(NextSampleId - Samples.Num(), 0);
+
+	for (int64 SampleId = FirstSampleId; SampleId < NextSampleId; ++SampleId)
+	{
+		const FFutureRacingLatencySample& Sample = Samples[SampleId % Samples.Num()];
+
+		if (Sample.EventTime <= 0.0)
+		{
+			continue;
+		}
+
+		SamplesCsv += FString::Printf(TEXT("%.6f,%lld,%llu,%.3f,%.3f,%.3f"),
+			Sample.EventTime, Sample.PhysicsStep, Sample.Frame, Sample.StageMs[0], Sample.StageMs[1], Sample.StageMs[2]) + LINE_TERMINATOR;
+	}
+
+	const FString SamplesFile = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("Benchmarks"), TEXT("InputLatencySamples.csv"));
+
+	if (FFileHelper::SaveStringToFile(SamplesCsv, *SamplesFile, FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM))
+	{
+		UE_LOG(LogFutureRacing, Display, TEXT("Wrote input latency results to '%s'."), *FPaths::ConvertRelativePathToFull(CsvFile));
+
+	} else {
+
+		UE_LOG(LogFutureRacing, Error, TEXT("Could not write input latency samples to '%s'."), *SamplesFile);
+	}
+
+	ResetHistograms();
+}
+
+void UFutureRacingInputLatencySubsystem::ResetHistograms()
+{
+	for (FFutureRacingLatencyHistogram& Histogram : Histograms)
+	{
+		Histogram.Reset();
+	}
+
+	for (FFutureRacingLatencySample& Sample : Samples)
+	{
+		Sample = FFutureRacingLatencySample();
+	}
+}
+
+bool UFutureRacingInputLatencySubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	// nobody drives on a dedicated server
+	return Super::ShouldCreateSubsystem(Outer) && !IsRunningDedicatedServer();
+}
+
+void UFutureRacingInputLatencySubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	Samples.SetNum(FMath::Max(MaxSamples, 1));
+
+	EndFrameHandle = FCoreDelegates::OnEndFrame.AddUObject(this, &UFutureRacingInputLatencySubsystem::OnEndFrame);
+}
+
+void UFutureRacingInputLatencySubsystem::Deinitialize()
+{
+	FCoreDelegates::OnEndFrame.Remove(EndFrameHandle);
+
+	Super::Deinitialize();
+}
+
+bool UFutureRacingInputLatencySubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	// only needed where vehicles actually race
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UFutureRacingInputLatencySubsystem::Tick(float DeltaTime)
+{
+	// collect what the render thread measured
+	TPair<int64, double> Present;
+
+	while (PresentQueue->Dequeue(Present))
+	{
+		Histograms[static_cast<int32>(EFutureRacingLatencyStage::Present)].Add(Present.Value);
+
+		if (FFutureRacingLatencySample* Sample = FindSample(Present.Key))
+		{
+			Sample->StageMs[static_cast<int32>(EFutureRacingLatencyStage::Present)] = Present.Value;
+		}
+	}
+
+	SET_FLOAT_STAT(STAT_FutureRacingInputToPhysicsP50, GetHistogram(EFutureRacingLatencyStage::Physics).GetPercentile(0.5));
+	SET_FLOAT_STAT(STAT_FutureRacingInputToPhysicsP95, GetHistogram(EFutureRacingLatencyStage::Physics).GetPercentile(0.95));
+	SET_FLOAT_STAT(STAT_FutureRacingInputToFrameP50, GetHistogram(EFutureRacingLatencyStage::Frame).GetPercentile(0.5));
+	SET_FLOAT_STAT(STAT_FutureRacingInputToFrameP95, GetHistogram(EFutureRacingLatencyStage::Frame).GetPercentile(0.95));
+	SET_FLOAT_STAT(STAT_FutureRacingInputToPresentP50, GetHistogram(EFutureRacingLatencyStage::Present).GetPercentile(0.5));
+	SET_FLOAT_STAT(STAT_FutureRacingInputToPresentP95, GetHistogram(EFutureRacingLatencyStage::Present).GetPercentile(0.95));
+}
+
+TStatId UFutureRacingInputLatencySubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UFutureRacingInputLatencySubsystem, STATGROUP_Tickables);
+}
+
+void UFutureRacingInputLatencySubsystem::OnEndFrame()
+{
+	if (PendingPresents.IsEmpty())
+	{
+		return;
+	}
+
+	// runs after everything the frame queued for rendering
+	ENQUEUE_RENDER_COMMAND(FutureRacingInputLatencyPresent)(
+		[Queue = PresentQueue, Pending = MoveTemp(PendingPresents)](FRHICommandListImmediate& RHICmdList)
+		{
+			const double Now = FPlatformTime::Seconds();
+
+			for (const TPair<int64, double>& Sample : Pending)
+			{
+				Queue->Enqueue(TPair<int64, double>(Sample.Key, (Now - Sample.Value) * 1000.0));
+			}
+		});
+
+	PendingPresents.Reset();
+}
+
+FFutureRacingLatencySample* UFutureRacingInputLatencySubsystem::FindSample(int64 SampleId)
+{
+	// overwritten by a newer sample
+	if (SampleId < NextSampleId - Samples.Num())
+	{
+		return nullptr;
+	}
+
+	return &Samples[SampleId % Samples.Num()];
+}
@@ -0,0 +1,159 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Containers/Queue.h"
+#include "FutureRacingInputLatencySubsystem.generated.h"
+
+struct FFutureRacingPhysicsStep;
+
+/**
+ *  Stages of the trip from an input event to the screen
+ */
+enum class EFutureRacingLatencyStage : uint8
+{
+	/** Until the first physics step simulating the input started */
+	Physics,
+
+	/** Until the game thread frame that first saw that step's result */
+	Frame,
+
+	/** Until the render thread finished submitting that frame for presenting */
+	Present,
+
+	Num
+};
+
+/**
+ *  Latency histogram with fixed 1ms buckets. Never allocates
+ */
+struct FFutureRacingLatencyHistogram
+{
+	/** Number of 1ms buckets. The last one also holds everything slower */
+	static constexpr int32 NumBuckets = 100;
+
+	int64 Counts[NumBuckets] = {};
+
+	int64 NumSamples = 0;
+	double TotalMs = 0.0;
+	double MaxMs = 0.0;
+
+	/** Adds a latency, in ms */
+	void Add(double Ms);
+
+	/** Returns the latency the given fraction of samples is at or below, in ms, to bucket resolution */
+	double GetPercentile(double Fraction) const;
+
+	/** Returns the average latency, in ms */
+	double GetAverage() const { return NumSamples > 0 ? TotalMs / NumSamples : 0.0; }
+
+	void Reset() { *this = FFutureRacingLatencyHistogram(); }
+};
+
+/**
+ *  One input change timed all the way through
+ */
+struct FFutureRacingLatencySample
+{
+	/** Platform time the input event was handled at, in seconds */
+	double EventTime = 0.0;
+
+	/** First physics step that simulated the input */
+	int64 PhysicsStep = 0;
+
+	/** Frame number of the game thread frame that first saw its result */
+	uint64 Frame = 0;
+
+	/** Latency of each stage, in ms. Negative until measured */
+	double StageMs[static_cast<int32>(EFutureRacingLatencyStage::Num)] = { -1.0, -1.0, -1.0 };
+};
+
+/**
+ *  Measures how long the local driver's input takes to reach the screen.
+ *
+ *  Input events are stamped as they reach the pawn's Enhanced Input handlers. The stamp travels with the
+ *  input through the physics thread queue, and comes back on the first physics step that simulates it.
+ *  The game thread frame that picks up that step is recorded, and a render command queued at the end of
+ *  that frame marks when the render thread has submitted it for presenting. Only input changes are
+ *  timed, since held inputs don't change what's on screen.
+ *
+ *  Histograms show up in stat FutureRacing, and FutureRacing.Input.DumpLatencyHistograms writes them to
+ *  Saved/Benchmarks/InputLatency.csv, with the individual samples in InputLatencySamples.csv.
+ *  Device and OS latency before Enhanced Input, and GPU and display latency after the render thread, aren't included.
+ */
+UCLASS(Config="Game")
+class UFutureRacingInputLatencySubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+protected:
+
+	/** Number of recent samples kept for the samples CSV */
+	UPROPERTY(Config)
+	int32 MaxSamples = 1024;
+
+	/** Latency histograms, one per stage */
+	FFutureRacingLatencyHistogram Histograms[static_cast<int32>(EFutureRacingLatencyStage::Num)];
+
+	/** Recent samples, as a ring indexed by sample id modulo MaxSamples */
+	TArray<FFutureRacingLatencySample> Samples;
+
+	/** Id of the next sample. Never reset, so late render thread results can't land on a newer sample */
+	int64 NextSampleId = 0;
+
+	/** Samples waiting for the end of the frame that saw them */
+	TArray<TPair<int64, double>> PendingPresents;
+
+	/** Present latencies measured on the render thread, as sample id and ms */
+	TSharedRef<TQueue<TPair<int64, double>, EQueueMode::Spsc>, ESPMode::ThreadSafe> PresentQueue = MakeShared<TQueue<TPair<int64, double>, EQueueMode::Spsc>, ESPMode::ThreadSafe>();
+
+	/** End of frame delegate handle */
+	FDelegateHandle EndFrameHandle;
+
+public:
+
+	/** Records the first physics step that simulated a changed input. Called by the movement component */
+	void RecordInputApplied(const FFutureRacingPhysicsStep& Step);
+
+	/** Returns the histogram for a stage */
+	const FFutureRacingLatencyHistogram& GetHistogram(EFutureRacingLatencyStage Stage) const { return Histograms[static_cast<int32>(Stage)]; }
+
+	/** Logs the histograms, writes them and the samples to CSV, then starts over */
+	void DumpHistograms();
+
+	/** Clears the histograms and samples */
+	void ResetHistograms();
+
+	// Begin USubsystem interface
+
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+
+	virtual void Deinitialize() override;
+
+	// End USubsystem interface
+
+	// Begin UWorldSubsystem interface
+
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+	// End UWorldSubsystem interface
+
+	// Begin FTickableGameObject interface
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	// End FTickableGameObject interface
+
+protected:
+
+	/** Queues a render command that times the frame's pending samples once the render thread gets through it */
+	void OnEndFrame();
+
+	/** Returns the sample with the given id, or null if it was overwritten */
+	FFutureRacingLatencySample* FindSample(int64 SampleId);
+};
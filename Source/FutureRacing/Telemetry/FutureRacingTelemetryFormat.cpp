@@ -0,0 +1,318 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "FutureRacingTelemetryFormat.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Serialization/Archive.h"
+#include "FutureRacing.h"
+
+namespace FutureRacingTelemetry
+{
+	using FutureRacingReplay::FByteWriter;
+	using FutureRacingReplay::FByteReader;
+
+	const TArray<FColumn>& GetSampleColumns()
+	{
+		static const TArray<FColumn> Columns = []()
+		{
+			TArray<FColumn> Result;
+
+			auto AddColumn = [&Result](const TCHAR* Name, EColumnType Type, int32 Offset)
+			{
+				FColumn& Column = Result.AddDefaulted_GetRef();
+				Column.Name = Name;
+				Column.Type = Type;
+				Column.Offset = Offset;
+			};
+
+			AddColumn(TEXT("Time"), EColumnType::Double, STRUCT_OFFSET(FFutureRacingTelemetrySample, Time));
+			AddColumn(TEXT("VehicleId"), EColumnType::UInt32, STRUCT_OFFSET(FFutureRacingTelemetrySample, VehicleId));
+			AddColumn(TEXT("ForwardSpeed"), EColumnType::Float, STRUCT_OFFSET(FFutureRacingTelemetrySample, ForwardSpeed));
+			AddColumn(TEXT("EngineRPM"), EColumnType::Float, STRUCT_OFFSET(FFutureRacingTelemetrySample, EngineRPM));
+			AddColumn(TEXT("Gear"), EColumnType::Int32, STRUCT_OFFSET(FFutureRacingTelemetrySample, Gear));
+			AddColumn(TEXT("Throttle"), EColumnType::Float, STRUCT_OFFSET(FFutureRacingTelemetrySample, Throttle));
+			AddColumn(TEXT("Brake"), EColumnType::Float, STRUCT_OFFSET(FFutureRacingTelemetrySample, Brake));
+			AddColumn(TEXT("Steering"), EColumnType::Float, STRUCT_OFFSET(FFutureRacingTelemetrySample, Steering));
+			AddColumn(TEXT("Handbrake"), EColumnType::Float, STRUCT_OFFSET(FFutureRacingTelemetrySample, Handbrake));
+
+			for (int32 WheelIndex = 0; WheelIndex < FFutureRacingTelemetrySample::MaxWheels; ++WheelIndex)
+			{
+				const int32 WheelOffset = WheelIndex * sizeof(float);
+
+				AddColumn(*FString::Printf(TEXT("Wheel%d_SlipAngle"), WheelIndex), EColumnType::Float, STRUCT_OFFSET(FFutureRacingTelemetrySample, WheelSlipAngle) + WheelOffset);
+				AddColumn(*FString::Printf(TEXT("Wheel%d_SlipMagnitude"), WheelIndex), EColumnType::Float, STRUCT_OFFSET(FFutureRacingTelemetrySample, WheelSlipMagnitude) + WheelOffset);
+				AddColumn(*FString::Printf(TEXT("Wheel%d_SuspensionOffset"), WheelIndex), EColumnType::Float, STRUCT_OFFSET(FFutureRacingTelemetrySample, WheelSuspensionOffset) + WheelOffset);
+				AddColumn(*FString::Printf(TEXT("Wheel%d_AngularVelocity"), WheelIndex), EColumnType::Float, STRUCT_OFFSET(FFutureRacingTelemetrySample, WheelAngularVelocity) + WheelOffset);
+			}
+
+			return Result;
+		}();
+
+		return Columns;
+	}
+
+	int32 GetColumnTypeSize(EColumnType Type)
+	{
+		return Type == EColumnType::Double ? 8 : 4;
+	}
+
+	void WriteFileHeader(TArray<uint8>& Out, const FString& MapName, const FDateTime& RecordedAt)
+	{
+		FByteWriter Writer(Out);
+		Writer.WriteUInt32(FileMagic);
+		Writer.WriteUInt32(FileVersion);
+		Writer.WriteString(MapName);
+		Writer.WriteVarInt(RecordedAt.GetTicks());
+
+		const TArray<FColumn>& Columns = GetSampleColumns();
+		Writer.WriteVarUInt(Columns.Num());
+
+		for (const FColumn& Column : Columns)
+		{
+			Writer.WriteString(Column.Name);
+			Writer.WriteUInt8(static_cast<uint8>(Column.Type));
+		}
+	}
+
+	bool ReadFileHeader(FByteReader& Reader, FFileHeader& OutHeader)
+	{
+		if (Reader.ReadUInt32() != FileMagic)
+		{
+			return false;
+		}
+
+		OutHeader.Version = Reader.ReadUInt32();
+
+		if (OutHeader.Version != FileVersion)
+		{
+			return false;
+		}
+
+		OutHeader.MapName = Reader.ReadString();
+		OutHeader.RecordedAt = FDateTime(Reader.ReadVarInt());
+
+		const uint64 NumColumns = Reader.ReadVarUInt();
+
+		for (uint64 Index = 0; Index < NumColumns && !Reader.bOverflow; ++Index)
+		{
+			FColumn& Column = OutHeader.Columns.AddDefaulted_GetRef();
+			Column.Name = Reader.ReadString();
+			Column.Type = static_cast<EColumnType>(Reader.ReadUInt8());
+
+			if (Column.Type < EColumnType::Float || Column.Type > EColumnType::UInt32)
+			{
+				return false;
+			}
+		}
+
+		return !Reader.bOverflow;
+	}
+
+	void WriteVehicleBlock(TArray<uint8>& Out, uint32 VehicleId, const FString& Name, const FString& ClassPath)
+	{
+		FByteWriter Writer(Out);
+		Writer.WriteUInt8(static_cast<uint8>(EBlockType::Vehicle));
+		Writer.WriteVarUInt(VehicleId);
+		Writer.WriteString(Name);
+		Writer.WriteString(ClassPath);
+	}
+
+	void WriteChunk(TArray<uint8>& Out, TConstArrayView<FFutureRacingTelemetrySample> Rows)
+	{
+		const TArray<FColumn>& Columns = GetSampleColumns();
+
+		int64 PayloadSize = 0;
+
+		for (const FColumn& Column : Columns)
+		{
+			PayloadSize += static_cast<int64>(GetColumnTypeSize(Column.Type)) * Rows.Num();
+		}
+
+		FByteWriter Writer(Out);
+		Writer.WriteUInt8(static_cast<uint8>(EBlockType::Chunk));
+		Writer.WriteVarUInt(Rows.Num());
+		Writer.WriteVarUInt(PayloadSize);
+
+		Out.Reserve(Out.Num() + PayloadSize);
+
+		// one column at a time
+		for (const FColumn& Column : Columns)
+		{
+			for (const FFutureRacingTelemetrySample& Row : Rows)
+			{
+				const uint8* Value = reinterpret_cast<const uint8*>(&Row) + Column.Offset;
+
+				if (Column.Type == EColumnType::Double)
+				{
+					double DoubleValue;
+					FMemory::Memcpy(&DoubleValue, Value, sizeof(DoubleValue));
+					Writer.WriteDouble(DoubleValue);
+
+				} else {
+
+					// floats and ints go out as their raw bits
+					uint32 Bits;
+					FMemory::Memcpy(&Bits, Value, sizeof(Bits));
+					Writer.WriteUInt32(Bits);
+				}
+			}
+		}
+	}
+
+	bool ExportCSV(const FString& TelemetryFile, const FString& CsvFile)
+	{
+		// the capture may still be open for writing
+		TArray<uint8> Bytes;
+
+		if (!FFileHelper::LoadFileToArray(Bytes, *TelemetryFile, FILEREAD_AllowWrite | FILEREAD_Silent))
+		{
+			UE_LOG(LogFutureRacing, Warning, TEXT("Could not open telemetry '%s'."), *TelemetryFile);
+			return false;
+		}
+
+		FByteReader Reader(Bytes.GetData(), Bytes.Num());
+		FFileHeader Header;
+
+		if (!ReadFileHeader(Reader, Header))
+		{
+			UE_LOG(LogFutureRacing, Warning, TEXT("'%s' is not a readable telemetry file."), *TelemetryFile);
+			return false;
+		}
+
+		TUniquePtr<FArchive> Archive(IFileManager::Get().CreateFileWriter(*CsvFile));
+
+		if (!Archive)
+		{
+			UE_LOG(LogFutureRacing, Warning, TEXT("Could not create '%s'."), *CsvFile);
+			return false;
+		}
+
+		// converting in batches keeps the number of writes down
+		FString Batch;
+
+		auto WriteBatch = [&Batch, &Archive]()
+		{
+			const FTCHARToUTF8 Converted(*Batch, Batch.Len());
+			Archive->Serialize(const_cast<ANSICHAR*>(Converted.Get()), Converted.Length());
+			Batch.Reset();
+		};
+
+		Batch = TEXT("Vehicle");
+
+		for (const FColumn& Column : Header.Columns)
+		{
+			Batch.Appendf(TEXT(",%s"), *Column.Name);
+		}
+
+		Batch += TEXT("\n");
+
+		TMap<uint32, FString> VehicleNames;
+		const int32 VehicleIdColumn = Header.Columns.IndexOfByPredicate([](const FColumn& Column) { return Column.Name == TEXT("VehicleId"); });
+
+		int64 NumRows = 0;
+
+		while (!Reader.IsAtEnd())
+		{
+			const EBlockType Type = static_cast<EBlockType>(Reader.ReadUInt8());
+
+			if (Type == EBlockType::Vehicle)
+			{
+				const uint32 VehicleId = static_cast<uint32>(Reader.ReadVarUInt());
+				const FString Name = Reader.ReadString();
+				Reader.ReadString();
+
+				VehicleNames.Add(VehicleId, Name);
+
+			} else if (Type == EBlockType::Chunk) {
+
+				const int64 ChunkRows = static_cast<int64>(Reader.ReadVarUInt());
+				const int64 PayloadSize = static_cast<int64>(Reader.ReadVarUInt());
+
+				// a chunk cut off by the end of the file is still being written
+				if (Reader.bOverflow || PayloadSize > Reader.GetRemaining())
+				{
+					break;
+				}
+
+				// find where each column starts in the payload
+				TArray<int64, TInlineAllocator<64>> ColumnStarts;
+				int64 ColumnStart = Reader.Offset;
+
+				for (const FColumn& Column : Header.Columns)
+				{
+					ColumnStarts.Add(ColumnStart);
+					ColumnStart += GetColumnTypeSize(Column.Type) * ChunkRows;
+				}
+
+				const int64 PayloadEnd = Reader.Offset + PayloadSize;
+
+				for (int64 Row = 0; Row < ChunkRows; ++Row)
+				{
+					uint32 VehicleId = 0;
+
+					if (VehicleIdColumn != INDEX_NONE)
+					{
+						Reader.Offset = ColumnStarts[VehicleIdColumn] + Row * sizeof(uint32);
+						VehicleId = Reader.ReadUInt32();
+					}
+
+					const FString* Name = VehicleNames.Find(VehicleId);
+					Batch += Name ? *Name : FString::FromInt(VehicleId);
+
+					for (int32 ColumnIndex = 0; ColumnIndex < Header.Columns.Num(); ++ColumnIndex)
+					{
+						const EColumnType ColumnType = Header.Columns[ColumnIndex].Type;
+						Reader.Offset = ColumnStarts[ColumnIndex] + Row * GetColumnTypeSize(ColumnType);
+
+						switch (ColumnType)
+						{
+						case EColumnType::Double:
+							Batch.Appendf(TEXT(",%.6f"), Reader.ReadDouble());
+							break;
+
+						case EColumnType::Int32:
+							Batch.Appendf(TEXT(",%d"), static_cast<int32>(Reader.ReadUInt32()));
+							break;
+
+						case EColumnType::UInt32:
+							Batch.Appendf(TEXT(",%u"), Reader.ReadUInt32());
+							break;
+
+						default:
+							Batch.Appendf(TEXT(",%g"), Reader.ReadFloat());
+							break;
+						}
+					}
+
+					Batch += TEXT("\n");
+
+					if (Batch.Len() > 64 * 1024)
+					{
+						WriteBatch();
+					}
+				}
+
+				Reader.Offset = PayloadEnd;
+				NumRows += ChunkRows;
+
+			} else {
+
+				UE_LOG(LogFutureRacing, Warning, TEXT("Telemetry '%s' has an unknown block at offset %lld, ignoring the rest."), *TelemetryFile, Reader.Offset - 1);
+				break;
+			}
+
+			if (Reader.bOverflow)
+			{
+				break;
+			}
+		}
+
+		WriteBatch();
+		Archive->Close();
+
+		UE_LOG(LogFutureRacing, Log, TEXT("Exported %lld telemetry rows from '%s' to '%s'."), NumRows, *TelemetryFile, *CsvFile);
+
+		return true;
+	}
+}
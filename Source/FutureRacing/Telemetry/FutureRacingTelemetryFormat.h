@@ -0,0 +1,125 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FutureRacingReplayFormat.h"
+
+/**
+ *  A single telemetry row, captured on the physics thread once per vehicle substep.
+ *  Plain data, so it can be copied through a byte ring buffer as is.
+ */
+struct FFutureRacingTelemetrySample
+{
+	/** Maximum number of wheels captured per vehicle */
+	static constexpr int32 MaxWheels = 4;
+
+	/** Physics solver time at the start of the substep, in seconds */
+	double Time = 0.0;
+
+	/** Id of the vehicle within the telemetry file. Filled in by the writer */
+	uint32 VehicleId = 0;
+
+	/** Speed along the vehicle's forward axis, in cm/s */
+	float ForwardSpeed = 0.0f;
+
+	float EngineRPM = 0.0f;
+	int32 Gear = 0;
+
+	/** Inputs applied this substep, after rate limiting */
+	float Throttle = 0.0f;
+	float Brake = 0.0f;
+	float Steering = 0.0f;
+	float Handbrake = 0.0f;
+
+	/** Per wheel state */
+	float WheelSlipAngle[MaxWheels] = {};
+	float WheelSlipMagnitude[MaxWheels] = {};
+	float WheelSuspensionOffset[MaxWheels] = {};
+	float WheelAngularVelocity[MaxWheels] = {};
+};
+
+/**
+ *  Telemetry file format. Uses the replay byte encoding for its headers.
+ *
+ *  A telemetry file is a header describing the columns, followed by a stream of blocks.
+ *  Vehicle blocks name a vehicle id, chunk blocks hold a run of rows stored column by column,
+ *  so tools can pull a single channel out without touching the others.
+ *  Rows are grouped by vehicle within a chunk; sort by time and vehicle when analyzing.
+ */
+namespace FutureRacingTelemetry
+{
+	/** "FRTL", little endian */
+	constexpr uint32 FileMagic = 0x4C545246;
+
+	/** Bump whenever the layout changes */
+	constexpr uint32 FileVersion = 1;
+
+	/** File extension for telemetry captures */
+	static const TCHAR* const FileExtension = TEXT(".frtelemetry");
+
+	/** Type byte at the start of every block */
+	enum class EBlockType : uint8
+	{
+		Vehicle = 1,
+		Chunk = 2
+	};
+
+	/** Storage type of a column */
+	enum class EColumnType : uint8
+	{
+		Float = 1,
+		Double = 2,
+		Int32 = 3,
+		UInt32 = 4
+	};
+
+	/** Describes a column of the telemetry file */
+	struct FColumn
+	{
+		FString Name;
+		EColumnType Type = EColumnType::Float;
+
+		/** Offset of the value in FFutureRacingTelemetrySample. Not saved */
+		int32 Offset = 0;
+	};
+
+	/** Returns the columns captured from FFutureRacingTelemetrySample, in file order */
+	const TArray<FColumn>& GetSampleColumns();
+
+	/** Returns the size in bytes of a single value of a column type */
+	int32 GetColumnTypeSize(EColumnType Type);
+
+	/** Contents of the file header */
+	struct FFileHeader
+	{
+		uint32 Version = FileVersion;
+
+		/** Map the telemetry was captured on */
+		FString MapName;
+
+		/** Wall clock time the capture started */
+		FDateTime RecordedAt;
+
+		/** Columns of every chunk */
+		TArray<FColumn> Columns;
+	};
+
+	/** Appends a file header for the sample columns */
+	void WriteFileHeader(TArray<uint8>& Out, const FString& MapName, const FDateTime& RecordedAt);
+
+	/** Returns false if the data isn't a telemetry file we can read */
+	bool ReadFileHeader(FutureRacingReplay::FByteReader& Reader, FFileHeader& OutHeader);
+
+	/** Appends a vehicle block */
+	void WriteVehicleBlock(TArray<uint8>& Out, uint32 VehicleId, const FString& Name, const FString& ClassPath);
+
+	/** Appends a chunk block holding the rows, column by column */
+	void WriteChunk(TArray<uint8>& Out, TConstArrayView<FFutureRacingTelemetrySample> Rows);
+
+	/**
+	 *  Converts a telemetry file to CSV, one line per row
+	 *  @return false if the telemetry file couldn't be read or the CSV couldn't be written
+	 */
+	bool ExportCSV(const FString& TelemetryFile, const FString& CsvFile);
+}
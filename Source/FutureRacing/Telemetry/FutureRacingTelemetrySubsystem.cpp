@@ -0,0 +1,218 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "FutureRacingTelemetrySubsystem.h"
+#include "FutureRacingPawn.h"
+#include "FutureRacingVehicleMovementComponent.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/Paths.h"
+#include "FutureRacing.h"
+
+static TAutoConsoleVariable<int32> CVarTelemetryCapture(
+	TEXT("FutureRacing.Telemetry.Capture"),
+	0,
+	TEXT("If 1, telemetry capture starts as soon as a vehicle enters a game world, saving to Saved/Telemetry.\n")
+	TEXT("Use FutureRacing.Telemetry.Start and Stop to capture a single stint instead."),
+	ECVF_Default);
+
+static FAutoConsoleCommandWithWorld StartTelemetryCommand(
+	TEXT("FutureRacing.Telemetry.Start"),
+	TEXT("Starts capturing physics rate telemetry for every vehicle in the current world."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (UFutureRacingTelemetrySubsystem* Telemetry = World ? World->GetSubsystem<UFutureRacingTelemetrySubsystem>() : nullptr)
+		{
+			Telemetry->StartCapture();
+		}
+	}));
+
+static FAutoConsoleCommandWithWorld StopTelemetryCommand(
+	TEXT("FutureRacing.Telemetry.Stop"),
+	TEXT("Stops the telemetry capture in the current world and closes its file."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (UFutureRacingTelemetrySubsystem* Telemetry = World ? World->GetSubsystem<UFutureRacingTelemetrySubsystem>() : nullptr)
+		{
+			Telemetry->StopCapture();
+		}
+	}));
+
+static FAutoConsoleCommandWithWorld DumpTelemetryCommand(
+	TEXT("FutureRacing.Telemetry.Dump"),
+	TEXT("Logs the telemetry capture size and cost for the current world."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (UFutureRacingTelemetrySubsystem* Telemetry = World ? World->GetSubsystem<UFutureRacingTelemetrySubsystem>() : nullptr)
+		{
+			const FFutureRacingTelemetryStats Stats = Telemetry->GetStats();
+
+			UE_LOG(LogFutureRacing, Display, TEXT("Telemetry '%s': %d vehicles, %lld rows, %.1f KB, %lld dropped samples, capture avg %.3fus/sample, drain avg %.3fms, max %.3fms"),
+				*Telemetry->GetFilename(), Stats.NumVehicles, Stats.NumRows, Stats.BytesWritten / 1024.0, Stats.NumDroppedSamples,
+				Stats.AverageCaptureMicroseconds, Stats.AverageDrainMs, Stats.MaxDrainMs);
+		}
+	}));
+
+static FAutoConsoleCommand ExportTelemetryCommand(
+	TEXT("FutureRacing.Telemetry.ExportCSV"),
+	TEXT("Converts a telemetry file to CSV. Usage: FutureRacing.Telemetry.ExportCSV <TelemetryFile> [CsvFile]"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		if (Args.Num() < 1)
+		{
+			UE_LOG(LogFutureRacing, Warning, TEXT("Usage: FutureRacing.Telemetry.ExportCSV <TelemetryFile> [CsvFile]"));
+			return;
+		}
+
+		const FString CsvFile = Args.Num() > 1 ? Args[1] : FPaths::ChangeExtension(Args[0], TEXT(".csv"));
+		FutureRacingTelemetry::ExportCSV(Args[0], CsvFile);
+	}));
+
+void UFutureRacingTelemetrySubsystem::RegisterVehicle(AFutureRacingPawn* Vehicle)
+{
+	if (!Vehicle || Vehicles.Contains(Vehicle))
+	{
+		return;
+	}
+
+	Vehicles.Add(Vehicle);
+
+	if (!Writer && CVarTelemetryCapture.GetValueOnGameThread() && GetWorld()->IsGameWorld())
+	{
+		// captures everything registered so far, including this vehicle
+		StartCapture();
+		return;
+	}
+
+	if (Writer)
+	{
+		CaptureVehicle(Vehicle);
+	}
+}
+
+void UFutureRacingTelemetrySubsystem::UnregisterVehicle(AFutureRacingPawn* Vehicle)
+{
+	if (Vehicles.Remove(Vehicle) == 0)
+	{
+		return;
+	}
+
+	if (Writer)
+	{
+		Vehicle->GetRacingVehicleMovement()->GetInputChannel()->DisableTelemetry();
+
+		if (const uint32* Id = VehicleIds.Find(Vehicle))
+		{
+			Writer->RemoveVehicle(*Id);
+		}
+	}
+}
+
+bool UFutureRacingTelemetrySubsystem::StartCapture()
+{
+	LLM_SCOPE_BYTAG(FutureRacing_Telemetry);
+
+	if (Writer)
+	{
+		return true;
+	}
+
+	const FString MapName = UWorld::RemovePIEPrefix(GetWorld()->GetMapName());
+
+	const FString Filename = FPaths::Combine(FPaths::ProjectSavedDir(), TelemetryFolder,
+		FString::Printf(TEXT("%s_%s%s"), *MapName, *FDateTime::Now().ToString(), FutureRacingTelemetry::FileExtension));
+
+	Writer = MakeUnique<FFutureRacingTelemetryWriter>(Filename, MapName, RowsPerChunk);
+
+	// draining on the game thread would defeat the purpose, so don't capture at all without a writer thread
+	if (!Writer->Start())
+	{
+		UE_LOG(LogFutureRacing, Warning, TEXT("Telemetry capture needs a writer thread, which this platform doesn't support."));
+		Writer.Reset();
+		return false;
+	}
+
+	VehicleIds.Empty();
+
+	for (const TWeakObjectPtr<AFutureRacingPawn>& Vehicle : Vehicles)
+	{
+		if (Vehicle.IsValid())
+		{
+			CaptureVehicle(Vehicle.Get());
+		}
+	}
+
+	UE_LOG(LogFutureRacing, Log, TEXT("Capturing telemetry to '%s'."), *Filename);
+
+	return true;
+}
+
+void UFutureRacingTelemetrySubsystem::StopCapture()
+{
+	if (!Writer)
+	{
+		return;
+	}
+
+	for (const TWeakObjectPtr<AFutureRacingPawn>& Vehicle : Vehicles)
+	{
+		if (Vehicle.IsValid())
+		{
+			Vehicle->GetRacingVehicleMovement()->GetInputChannel()->DisableTelemetry();
+		}
+	}
+
+	Writer->Finish();
+
+	const FFutureRacingTelemetryStats Stats = Writer->GetStats();
+
+	UE_LOG(LogFutureRacing, Log, TEXT("Finished telemetry '%s': %lld rows, %.1f KB, %lld dropped samples, capture avg %.3fus/sample."),
+		*Writer->GetFilename(), Stats.NumRows, Stats.BytesWritten / 1024.0, Stats.NumDroppedSamples, Stats.AverageCaptureMicroseconds);
+
+	if (bExportCSV)
+	{
+		FutureRacingTelemetry::ExportCSV(Writer->GetFilename(), FPaths::ChangeExtension(Writer->GetFilename(), TEXT(".csv")));
+	}
+
+	Writer.Reset();
+	VehicleIds.Empty();
+}
+
+FString UFutureRacingTelemetrySubsystem::GetFilename() const
+{
+	return Writer ? Writer->GetFilename() : FString();
+}
+
+FFutureRacingTelemetryStats UFutureRacingTelemetrySubsystem::GetStats() const
+{
+	return Writer ? Writer->GetStats() : FFutureRacingTelemetryStats();
+}
+
+void UFutureRacingTelemetrySubsystem::Deinitialize()
+{
+	StopCapture();
+
+	Vehicles.Empty();
+
+	Super::Deinitialize();
+}
+
+void UFutureRacingTelemetrySubsystem::CaptureVehicle(AFutureRacingPawn* Vehicle)
+{
+	uint32 Id;
+
+	if (const uint32* ExistingId = VehicleIds.Find(Vehicle))
+	{
+		Id = *ExistingId;
+
+	} else {
+
+		Id = VehicleIds.Num();
+		VehicleIds.Add(Vehicle, Id);
+	}
+
+	const TSharedRef<FFutureRacingInputChannel, ESPMode::ThreadSafe>& Channel = Vehicle->GetRacingVehicleMovement()->GetInputChannel();
+	Channel->EnableTelemetry(FMath::Max(RingSizeKB, 16) * 1024);
+
+	Writer->AddVehicle(Channel, Id, Vehicle->GetName(), Vehicle->GetClass()->GetPathName());
+}
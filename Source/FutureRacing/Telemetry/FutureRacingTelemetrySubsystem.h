@@ -0,0 +1,83 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "FutureRacingTelemetryWriter.h"
+#include "FutureRacingTelemetrySubsystem.generated.h"
+
+class AFutureRacingPawn;
+
+/**
+ *  Captures physics rate vehicle telemetry for tuning.
+ *  Every physics substep, each captured vehicle writes a fixed size sample with its engine, input and
+ *  per wheel state into its own lock free ring buffer. A writer thread drains them into a columnar file,
+ *  which can be converted to CSV. Full ring buffers drop samples instead of stalling physics.
+ */
+UCLASS(Config="Game")
+class UFutureRacingTelemetrySubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+protected:
+
+	/** Size of each vehicle's ring buffer between the physics thread and the writer thread */
+	UPROPERTY(Config)
+	int32 RingSizeKB = 256;
+
+	/** Number of rows per chunk in the telemetry file */
+	UPROPERTY(Config)
+	int32 RowsPerChunk = 1024;
+
+	/** Folder telemetry is saved to, relative to the project's Saved folder */
+	UPROPERTY(Config)
+	FString TelemetryFolder = TEXT("Telemetry");
+
+	/** If true, a CSV copy is exported next to the telemetry file when a capture stops */
+	UPROPERTY(Config)
+	bool bExportCSV = false;
+
+	/** Vehicles that could be captured */
+	TArray<TWeakObjectPtr<AFutureRacingPawn>> Vehicles;
+
+	/** Ids vehicles are captured under. Pooled vehicles keep theirs */
+	TMap<TWeakObjectPtr<AFutureRacingPawn>, uint32> VehicleIds;
+
+	/** Active capture, if any */
+	TUniquePtr<FFutureRacingTelemetryWriter> Writer;
+
+public:
+
+	/** Adds a vehicle, capturing it if a capture is running */
+	void RegisterVehicle(AFutureRacingPawn* Vehicle);
+
+	/** Removes a vehicle, keeping what was already captured */
+	void UnregisterVehicle(AFutureRacingPawn* Vehicle);
+
+	/** Starts capturing every registered vehicle to a new file */
+	bool StartCapture();
+
+	/** Finishes the current capture */
+	void StopCapture();
+
+	/** Returns true while capturing */
+	bool IsCapturing() const { return Writer.IsValid(); }
+
+	/** Returns the file being captured to */
+	FString GetFilename() const;
+
+	/** Returns the capture measurements so far */
+	FFutureRacingTelemetryStats GetStats() const;
+
+	// Begin UWorldSubsystem interface
+
+	virtual void Deinitialize() override;
+
+	// End UWorldSubsystem interface
+
+protected:
+
+	/** Enables capture on a vehicle and hands it to the writer */
+	void CaptureVehicle(AFutureRacingPawn* Vehicle);
+};
@@ -0,0 +1,295 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "FutureRacingTelemetryWriter.h"
+#include "FutureRacingVehicleMovementComponent.h"
+#include "FutureRacingReplayWriter.h"
+#include "HAL/FileManager.h"
+#include "HAL/Event.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/PlatformTime.h"
+#include "HAL/RunnableThread.h"
+#include "Misc/ScopeLock.h"
+#include "Serialization/Archive.h"
+#include "Serialization/MemoryWriter.h"
+#include "FutureRacing.h"
+
+DECLARE_CYCLE_STAT(TEXT("Telemetry Drain"), STAT_FutureRacingTelemetryDrain, STATGROUP_FutureRacing);
+
+FFutureRacingTelemetryWriter::FFutureRacingTelemetryWriter(const FString& InFilename, const FString& MapName, int32 InRowsPerChunk)
+	: Filename(InFilename)
+	, RowsPerChunk(FMath::Max(InRowsPerChunk, 1))
+{
+	FutureRacingTelemetry::WriteFileHeader(PendingBlocks, MapName, FDateTime::Now());
+
+	Rows.Reserve(RowsPerChunk * 2);
+}
+
+FFutureRacingTelemetryWriter::~FFutureRacingTelemetryWriter()
+{
+	Finish();
+}
+
+bool FFutureRacingTelemetryWriter::Start()
+{
+	if (Thread)
+	{
+		return true;
+	}
+
+	if (!FPlatformProcess::SupportsMultithreading())
+	{
+		return false;
+	}
+
+	WakeEvent = FPlatformProcess::GetSynchEventFromPool(false);
+	Thread = FRunnableThread::Create(this, TEXT("FutureRacingTelemetryWriter"), 0, TPri_BelowNormal);
+
+	return Thread != nullptr;
+}
+
+void FFutureRacingTelemetryWriter::AddVehicle(const TSharedRef<FFutureRacingInputChannel, ESPMode::ThreadSafe>& Channel, uint32 VehicleId, const FString& Name, const FString& ClassPath)
+{
+	FScopeLock Lock(&SourcesLock);
+
+	// a vehicle that comes back before its last drain just carries on
+	if (FSource* Existing = Sources.FindByPredicate([&Channel](const FSource& Source) { return Source.Channel == Channel; }))
+	{
+		Existing->bRemoved = false;
+		return;
+	}
+
+	// the vehicle block goes out before any of its rows
+	FutureRacingTelemetry::WriteVehicleBlock(PendingBlocks, VehicleId, Name, ClassPath);
+
+	FSource& Source = Sources.AddDefaulted_GetRef();
+	Source.Channel = Channel;
+	Source.VehicleId = VehicleId;
+}
+
+void FFutureRacingTelemetryWriter::RemoveVehicle(uint32 VehicleId)
+{
+	FScopeLock Lock(&SourcesLock);
+
+	for (FSource& Source : Sources)
+	{
+		if (Source.VehicleId == VehicleId)
+		{
+			Source.bRemoved = true;
+		}
+	}
+}
+
+void FFutureRacingTelemetryWriter::Finish()
+{
+	if (Thread)
+	{
+		Stop();
+		Thread->WaitForCompletion();
+
+		delete Thread;
+		Thread = nullptr;
+	}
+
+	if (WakeEvent)
+	{
+		FPlatformProcess::ReturnSynchEventToPool(WakeEvent);
+		WakeEvent = nullptr;
+	}
+
+	if (Archive)
+	{
+		Archive->Close();
+		Archive.Reset();
+	}
+}
+
+FFutureRacingTelemetryStats FFutureRacingTelemetryWriter::GetStats() const
+{
+	FFutureRacingTelemetryStats Stats;
+
+	int64 NumCaptured = 0;
+	int64 CaptureCycles = 0;
+
+	{
+		FScopeLock Lock(&SourcesLock);
+
+		Stats.NumDroppedSamples = RetiredDroppedSamples;
+		NumCaptured = RetiredCapturedSamples;
+		CaptureCycles = RetiredCaptureCycles;
+
+		for (const FSource& Source : Sources)
+		{
+			Stats.NumVehicles += Source.bRemoved ? 0 : 1;
+			Stats.NumDroppedSamples += Source.Channel->NumTelemetryDropped.load(std::memory_order_relaxed);
+			NumCaptured += Source.Channel->NumTelemetrySamples.load(std::memory_order_relaxed);
+			CaptureCycles += Source.Channel->TelemetryCaptureCycles.load(std::memory_order_relaxed);
+		}
+	}
+
+	Stats.NumRows = NumRowsWritten.load(std::memory_order_relaxed);
+	Stats.BytesWritten = BytesWritten.load(std::memory_order_relaxed);
+
+	if (NumCaptured > 0)
+	{
+		Stats.AverageCaptureMicroseconds = FPlatformTime::ToMilliseconds64(CaptureCycles) * 1000.0 / NumCaptured;
+	}
+
+	const int64 Drains = NumDrains.load(std::memory_order_relaxed);
+
+	if (Drains > 0)
+	{
+		Stats.AverageDrainMs = TotalDrainMicroseconds.load(std::memory_order_relaxed) / 1000.0 / Drains;
+	}
+
+	Stats.MaxDrainMs = MaxDrainMicroseconds.load(std::memory_order_relaxed) / 1000.0;
+
+	return Stats;
+}
+
+uint32 FFutureRacingTelemetryWriter::Run()
+{
+	Archive.Reset(IFileManager::Get().CreateFileWriter(*Filename, FILEWRITE_AllowRead));
+
+	if (!Archive)
+	{
+		UE_LOG(LogFutureRacing, Warning, TEXT("Could not create telemetry file '%s'."), *Filename);
+	}
+
+	while (!bStopRequested.load(std::memory_order_acquire))
+	{
+		WakeEvent->Wait(DrainIntervalMs);
+
+		Drain();
+	}
+
+	// pick up anything captured before the stop request, including a partial chunk
+	Drain();
+
+	if (Rows.Num() > 0)
+	{
+		WriteChunk();
+	}
+
+	if (Archive)
+	{
+		Archive->Flush();
+	}
+
+	return 0;
+}
+
+void FFutureRacingTelemetryWriter::Stop()
+{
+	bStopRequested.store(true, std::memory_order_release);
+
+	if (WakeEvent)
+	{
+		WakeEvent->Trigger();
+	}
+}
+
+void FFutureRacingTelemetryWriter::Drain()
+{
+	FUTURERACING_SCOPE_CYCLE_COUNTER(STAT_FutureRacingTelemetryDrain);
+	LLM_SCOPE_BYTAG(FutureRacing_Telemetry);
+
+	const uint64 StartCycles = FPlatformTime::Cycles64();
+
+	// take a copy of the sources, so the game thread is only ever blocked for this long
+	{
+		FScopeLock Lock(&SourcesLock);
+
+		DrainSources = Sources;
+
+		if (PendingBlocks.Num() > 0)
+		{
+			if (Archive)
+			{
+				Archive->Serialize(PendingBlocks.GetData(), PendingBlocks.Num());
+			}
+
+			BytesWritten.fetch_add(PendingBlocks.Num(), std::memory_order_relaxed);
+			PendingBlocks.Reset();
+		}
+	}
+
+	constexpr int32 SampleSize = sizeof(FFutureRacingTelemetrySample);
+
+	for (const FSource& Source : DrainSources)
+	{
+		DrainScratch.Reset();
+
+		FMemoryWriter ScratchWriter(DrainScratch);
+		Source.Channel->TelemetryRing->Drain(&ScratchWriter);
+
+		// samples are written whole, so the drained bytes always split evenly
+		const int32 NumSamples = DrainScratch.Num() / SampleSize;
+		const int32 FirstRow = Rows.Num();
+
+		Rows.AddUninitialized(NumSamples);
+		FMemory::Memcpy(Rows.GetData() + FirstRow, DrainScratch.GetData(), NumSamples * SampleSize);
+
+		for (int32 RowIndex = FirstRow; RowIndex < Rows.Num(); ++RowIndex)
+		{
+			Rows[RowIndex].VehicleId = Source.VehicleId;
+		}
+
+		if (Rows.Num() >= RowsPerChunk)
+		{
+			WriteChunk();
+		}
+	}
+
+	// drop vehicles that were removed, now that their last samples are in
+	{
+		FScopeLock Lock(&SourcesLock);
+
+		for (int32 Index = Sources.Num() - 1; Index >= 0; --Index)
+		{
+			const FSource& Source = Sources[Index];
+
+			if (Source.bRemoved && DrainSources.ContainsByPredicate([&Source](const FSource& Drained) { return Drained.VehicleId == Source.VehicleId && Drained.bRemoved; }))
+			{
+				RetiredDroppedSamples += Source.Channel->NumTelemetryDropped.load(std::memory_order_relaxed);
+				RetiredCapturedSamples += Source.Channel->NumTelemetrySamples.load(std::memory_order_relaxed);
+				RetiredCaptureCycles += Source.Channel->TelemetryCaptureCycles.load(std::memory_order_relaxed);
+
+				Sources.RemoveAt(Index);
+			}
+		}
+	}
+
+	DrainSources.Reset();
+
+	if (Archive)
+	{
+		Archive->Flush();
+	}
+
+	const int64 ElapsedMicroseconds = static_cast<int64>(FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - StartCycles) * 1000.0);
+
+	NumDrains.fetch_add(1, std::memory_order_relaxed);
+	TotalDrainMicroseconds.fetch_add(ElapsedMicroseconds, std::memory_order_relaxed);
+
+	if (ElapsedMicroseconds > MaxDrainMicroseconds.load(std::memory_order_relaxed))
+	{
+		MaxDrainMicroseconds.store(ElapsedMicroseconds, std::memory_order_relaxed);
+	}
+}
+
+void FFutureRacingTelemetryWriter::WriteChunk()
+{
+	ChunkScratch.Reset();
+	FutureRacingTelemetry::WriteChunk(ChunkScratch, Rows);
+
+	if (Archive)
+	{
+		Archive->Serialize(ChunkScratch.GetData(), ChunkScratch.Num());
+	}
+
+	NumRowsWritten.fetch_add(Rows.Num(), std::memory_order_relaxed);
+	BytesWritten.fetch_add(ChunkScratch.Num(), std::memory_order_relaxed);
+
+	Rows.Reset();
+}
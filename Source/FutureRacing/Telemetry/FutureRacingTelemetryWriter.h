@@ -0,0 +1,142 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+#include "HAL/CriticalSection.h"
+#include "FutureRacingTelemetryFormat.h"
+#include <atomic>
+
+class FArchive;
+class FEvent;
+class FRunnableThread;
+struct FFutureRacingInputChannel;
+
+/**
+ *  Telemetry capture measurements
+ */
+struct FFutureRacingTelemetryStats
+{
+	/** Number of vehicles being captured */
+	int32 NumVehicles = 0;
+
+	/** Number of rows written to the file */
+	int64 NumRows = 0;
+
+	/** Number of samples lost to full ring buffers */
+	int64 NumDroppedSamples = 0;
+
+	/** Number of bytes written to the file */
+	int64 BytesWritten = 0;
+
+	/** Average physics thread time spent capturing a sample */
+	double AverageCaptureMicroseconds = 0.0;
+
+	/** Average and worst writer thread time spent on a drain */
+	double AverageDrainMs = 0.0;
+	double MaxDrainMs = 0.0;
+};
+
+/**
+ *  Drains the telemetry ring buffers of every captured vehicle on a background thread,
+ *  and writes them out as columnar chunks.
+ *  The physics thread only ever touches its own vehicle's ring buffer.
+ */
+class FFutureRacingTelemetryWriter : public FRunnable
+{
+public:
+
+	FFutureRacingTelemetryWriter(const FString& InFilename, const FString& MapName, int32 InRowsPerChunk);
+	virtual ~FFutureRacingTelemetryWriter();
+
+	/**
+	 *  Starts the writer thread
+	 *  @return false if threads aren't available on this platform
+	 */
+	bool Start();
+
+	/** Starts draining a vehicle's telemetry. The channel must have telemetry enabled */
+	void AddVehicle(const TSharedRef<FFutureRacingInputChannel, ESPMode::ThreadSafe>& Channel, uint32 VehicleId, const FString& Name, const FString& ClassPath);
+
+	/** Stops draining a vehicle's telemetry, after picking up what it already captured */
+	void RemoveVehicle(uint32 VehicleId);
+
+	/** Writes out everything captured so far, closes the file and joins the thread */
+	void Finish();
+
+	/** Returns the file being written */
+	const FString& GetFilename() const { return Filename; }
+
+	/** Returns the capture measurements so far */
+	FFutureRacingTelemetryStats GetStats() const;
+
+	// Begin FRunnable interface
+
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+
+	// End FRunnable interface
+
+protected:
+
+	/** Moves every vehicle's captured samples into the pending rows, writing out full chunks */
+	void Drain();
+
+	/** Writes the pending rows as a chunk */
+	void WriteChunk();
+
+	/** A vehicle being drained */
+	struct FSource
+	{
+		TSharedPtr<FFutureRacingInputChannel, ESPMode::ThreadSafe> Channel;
+
+		uint32 VehicleId = 0;
+
+		/** Set when the vehicle should be dropped after its next drain */
+		bool bRemoved = false;
+	};
+
+	/** Output file */
+	FString Filename;
+
+	/** Rows per chunk block */
+	int32 RowsPerChunk = 1024;
+
+	/** Guards Sources and PendingBlocks, which the game thread edits */
+	mutable FCriticalSection SourcesLock;
+	TArray<FSource> Sources;
+
+	/** Vehicle blocks waiting to be written */
+	TArray<uint8> PendingBlocks;
+
+	/** Drop and capture counts of vehicles no longer drained */
+	int64 RetiredDroppedSamples = 0;
+	int64 RetiredCapturedSamples = 0;
+	int64 RetiredCaptureCycles = 0;
+
+	/** Writer thread state */
+	TUniquePtr<FArchive> Archive;
+	TArray<FSource> DrainSources;
+	TArray<uint8> DrainScratch;
+	TArray<FFutureRacingTelemetrySample> Rows;
+	TArray<uint8> ChunkScratch;
+
+	FRunnableThread* Thread = nullptr;
+
+	/** Wakes the writer thread up early */
+	FEvent* WakeEvent = nullptr;
+
+	/** Set when the writer thread should drain and exit */
+	std::atomic<bool> bStopRequested { false };
+
+	/** How long the writer thread sleeps between drains */
+	uint32 DrainIntervalMs = 50;
+
+	/** Writer thread measurements */
+	std::atomic<int64> NumRowsWritten { 0 };
+	std::atomic<int64> BytesWritten { 0 };
+	std::atomic<int64> NumDrains { 0 };
+	std::atomic<int64> TotalDrainMicroseconds { 0 };
+	std::atomic<int64> MaxDrainMicroseconds { 0 };
+};
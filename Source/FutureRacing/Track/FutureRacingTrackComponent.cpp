@@ -0,0 +1,49 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "FutureRacingTrackComponent.h"
+#include "FutureRacingTrackSubsystem.h"
+#include "Components/SplineComponent.h"
+#include "Engine/World.h"
+#include "FutureRacing.h"
+
+UFutureRacingTrackComponent::UFutureRacingTrackComponent()
+{
+	PrimaryComponentTick.bCanEverTick = false;
+}
+
+void UFutureRacingTrackComponent::Bake()
+{
+	if (USplineComponent* Spline = GetSpline())
+	{
+		Modify();
+		BuildTable(*Spline, Table);
+
+		UE_LOG(LogFutureRacing, Log, TEXT("Baked %d track samples over %.0fcm for '%s'."), Table.Num(), Table.TrackLength, *GetNameSafe(GetOwner()));
+
+	} else {
+
+		UE_LOG(LogFutureRacing, Error, TEXT("'%s' has no spline component to bake."), *GetNameSafe(GetOwner()));
+	}
+}
+
+void UFutureRacingTrackComponent::BuildTable(const USplineComponent& Spline, FFutureRacingTrackTable& OutTable) const
+{
+	OutTable.Build(Spline, SampleSpacing, MaxSpeed, MaxLateralAcceleration, MaxBrakingDeceleration);
+}
+
+USplineComponent* UFutureRacingTrackComponent::GetSpline() const
+{
+	return GetOwner() ? GetOwner()->FindComponentByClass<USplineComponent>() : nullptr;
+}
+
+void UFutureRacingTrackComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	// register with the track subsystem
+	if (UFutureRacingTrackSubsystem* TrackSubsystem = GetWorld()->GetSubsystem<UFutureRacingTrackSubsystem>())
+	{
+		TrackSubsystem->RegisterTrack(this);
+	}
+}
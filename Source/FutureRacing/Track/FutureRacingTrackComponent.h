@@ -0,0 +1,73 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "FutureRacingTrackTable.h"
+#include "FutureRacingTrackComponent.generated.h"
+
+class USplineComponent;
+
+/**
+ *  Bakes and stores the arc-length lookup table for a track spline.
+ *  Add to the actor that owns the track spline (e.g. the CPU path)
+ *  and press Bake so the table is saved and cooked with the level.
+ */
+UCLASS(ClassGroup="FutureRacing", meta = (BlueprintSpawnableComponent))
+class UFutureRacingTrackComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+protected:
+
+	/** Distance between baked samples */
+	UPROPERTY(EditAnywhere, Category="Track|Bake", meta = (Units = "cm", ClampMin = 10))
+	float SampleSpacing = 200.0f;
+
+	/** Top speed used for the suggested speed profile */
+	UPROPERTY(EditAnywhere, Category="Track|Bake", meta = (Units = "cm/s"))
+	float MaxSpeed = 4000.0f;
+
+	/** Lateral acceleration used for the suggested corner speeds */
+	UPROPERTY(EditAnywhere, Category="Track|Bake", meta = (Units = "cm/s2"))
+	float MaxLateralAcceleration = 1200.0f;
+
+	/** Deceleration used to place braking zones ahead of corners */
+	UPROPERTY(EditAnywhere, Category="Track|Bake", meta = (Units = "cm/s2"))
+	float MaxBrakingDeceleration = 900.0f;
+
+	/** If true, this is the track other systems use when they aren't given one explicitly */
+	UPROPERTY(EditAnywhere, Category="Track")
+	bool bIsPrimaryTrack = true;
+
+	/** Baked lookup table */
+	UPROPERTY(VisibleAnywhere, Category="Track")
+	FFutureRacingTrackTable Table;
+
+public:
+
+	/** Constructor */
+	UFutureRacingTrackComponent();
+
+	/** Rebakes the table from the owner's spline */
+	UFUNCTION(CallInEditor, Category="Track|Bake")
+	void Bake();
+
+	/** Builds the table from a spline using this component's settings */
+	void BuildTable(const USplineComponent& Spline, FFutureRacingTrackTable& OutTable) const;
+
+	/** Returns the baked table */
+	const FFutureRacingTrackTable& GetTable() const { return Table; };
+
+	/** Returns the owner's spline */
+	USplineComponent* GetSpline() const;
+
+	/** Returns true if this is the primary track */
+	bool IsPrimaryTrack() const { return bIsPrimaryTrack; };
+
+protected:
+
+	/** Registers the track with the world */
+	virtual void BeginPlay() override;
+};
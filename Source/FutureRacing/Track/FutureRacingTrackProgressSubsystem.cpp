@@ -0,0 +1,275 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "FutureRacingTrackProgressSubsystem.h"
+#include "FutureRacingTrackSubsystem.h"
+#include "FutureRacingTrackTable.h"
+#include "FutureRacingMarkerSubsystem.h"
+#include "FutureRacingPawn.h"
+#include "TimeTrialTrackGate.h"
+#include "Algo/BinarySearch.h"
+#include "Async/ParallelFor.h"
+#include "Engine/World.h"
+
+void UFutureRacingTrackProgressSubsystem::RegisterVehicle(AFutureRacingPawn* Vehicle)
+{
+	if (!Vehicle || VehicleIndices.Contains(Vehicle))
+	{
+		return;
+	}
+
+	VehicleIndices.Add(Vehicle, Vehicles.Num());
+
+	Vehicles.Add(Vehicle);
+	Locations.Add(Vehicle->GetActorLocation());
+	TrackDistances.Add(-1.0f);
+	LapDistances.Add(0.0f);
+	Laps.Add(0);
+	Sectors.Add(0);
+	LeaderboardIndices.Add(INDEX_NONE);
+}
+
+void UFutureRacingTrackProgressSubsystem::UnregisterVehicle(AFutureRacingPawn* Vehicle)
+{
+	if (const int32* Index = VehicleIndices.Find(Vehicle))
+	{
+		RemoveAtSwap(*Index);
+	}
+}
+
+const FFutureRacingRaceStanding* UFutureRacingTrackProgressSubsystem::GetStanding(const AFutureRacingPawn* Vehicle) const
+{
+	const int32* Index = VehicleIndices.Find(Vehicle);
+
+	if (!Index || !Leaderboard.IsValidIndex(LeaderboardIndices[*Index]))
+	{
+		return nullptr;
+	}
+
+	const FFutureRacingRaceStanding& Standing = Leaderboard[LeaderboardIndices[*Index]];
+
+	// the leaderboard may predate a vehicle joining or leaving this frame
+	return Standing.Vehicle.Get() == Vehicle ? &Standing : nullptr;
+}
+
+int32 UFutureRacingTrackProgressSubsystem::GetRacePosition(const AFutureRacingPawn* Vehicle) const
+{
+	const FFutureRacingRaceStanding* Standing = GetStanding(Vehicle);
+
+	return Standing ? Standing->Position : 0;
+}
+
+float UFutureRacingTrackProgressSubsystem::GetTrackGap(const AFutureRacingPawn* A, const AFutureRacingPawn* B) const
+{
+	const int32* IndexA = VehicleIndices.Find(A);
+	const int32* IndexB = VehicleIndices.Find(B);
+
+	if (!IndexA || !IndexB || !Track.IsValid() || TrackDistances[*IndexA] < 0.0f || TrackDistances[*IndexB] < 0.0f)
+	{
+		return -1.0f;
+	}
+
+	const float Gap = FMath::Abs(TrackDistances[*IndexA] - TrackDistances[*IndexB]);
+
+	// across the start line can be the shorter way
+	return Track->bClosedLoop ? FMath::Min(Gap, Track->TrackLength - Gap) : Gap;
+}
+
+void UFutureRacingTrackProgressSubsystem::Tick(float DeltaTime)
+{
+	// drop any vehicles destroyed without unregistering
+	for (int32 Index = Vehicles.Num() - 1; Index >= 0; --Index)
+	{
+		if (!Vehicles[Index].IsValid())
+		{
+			RemoveAtSwap(Index);
+		}
+	}
+
+	UpdateTrackLayout();
+
+	if (!Track.IsValid() || !Track->IsValid())
+	{
+		return;
+	}
+
+	UpdateProgress();
+	PublishLeaderboard();
+}
+
+TStatId UFutureRacingTrackProgressSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UFutureRacingTrackProgressSubsystem, STATGROUP_Tickables);
+}
+
+void UFutureRacingTrackProgressSubsystem::UpdateTrackLayout()
+{
+	UWorld* World = GetWorld();
+
+	if (!Track.IsValid())
+	{
+		if (UFutureRacingTrackSubsystem* TrackSubsystem = World->GetSubsystem<UFutureRacingTrackSubsystem>())
+		{
+			Track = TrackSubsystem->GetPrimaryTable();
+		}
+
+		if (!Track.IsValid() || !Track->IsValid())
+		{
+			return;
+		}
+	}
+
+	// gates register as they begin play, so rebuild the sectors whenever that changes
+	UFutureRacingMarkerSubsystem* Markers = World->GetSubsystem<UFutureRacingMarkerSubsystem>();
+	const int32 NumGates = Markers ? Markers->GetNumGates() : 0;
+
+	if (NumGates == NumSectorGates)
+	{
+		return;
+	}
+
+	NumSectorGates = NumGates;
+
+	// measure laps from the finish line if there is one, otherwise from the start of the track
+	ATimeTrialTrackGate* FinishLine = Markers ? Markers->GetFinishLine() : nullptr;
+	StartDistance = FinishLine ? Track->FindClosestDistance(FinishLine->GetActorLocation()) : 0.0f;
+
+	// every other gate starts a new sector
+	SectorStarts.Reset();
+	SectorStarts.Add(0.0f);
+
+	for (int32 GateIndex = 0; GateIndex < NumGates; ++GateIndex)
+	{
+		ATimeTrialTrackGate* Gate = Markers->GetGate(GateIndex);
+
+		if (Gate && Gate != FinishLine)
+		{
+			SectorStarts.Add(Track->WrapDistance(Track->FindClosestDistance(Gate->GetActorLocation()) - StartDistance));
+		}
+	}
+
+	SectorStarts.Sort();
+
+	// not enough gates to be interesting, split the lap evenly instead
+	if (SectorStarts.Num() < 2)
+	{
+		SectorStarts.Reset();
+
+		for (int32 SectorIndex = 0; SectorIndex < FMath::Max(DefaultNumSectors, 1); ++SectorIndex)
+		{
+			SectorStarts.Add(Track->TrackLength * SectorIndex / FMath::Max(DefaultNumSectors, 1));
+		}
+	}
+}
+
+void UFutureRacingTrackProgressSubsystem::UpdateProgress()
+{
+	const int32 NumVehicles = Vehicles.Num();
+
+	// gather the locations up front so the projection pass only touches our own arrays
+	for (int32 Index = 0; Index < NumVehicles; ++Index)
+	{
+		Locations[Index] = Vehicles[Index]->GetActorLocation();
+	}
+
+	const FFutureRacingTrackTable& Table = *Track;
+	const float TrackLength = Table.TrackLength;
+	const float HalfTrackLength = TrackLength * 0.5f;
+
+	// project onto the centreline and work out laps and sectors
+	ParallelFor(NumVehicles, [this, &Table, TrackLength, HalfTrackLength](int32 Index)
+	{
+		const bool bFirstSample = TrackDistances[Index] < 0.0f;
+
+		TrackDistances[Index] = Table.FindClosestDistance(Locations[Index], TrackDistances[Index]);
+
+		const float PreviousLapDistance = LapDistances[Index];
+		const float LapDistance = Table.bClosedLoop ? Table.WrapDistance(TrackDistances[Index] - StartDistance) : TrackDistances[Index] - StartDistance;
+		LapDistances[Index] = LapDistance;
+
+		if (bFirstSample)
+		{
+			// cars lined up behind the start line haven't started their first lap yet
+			Laps[Index] = (Table.bClosedLoop && LapDistance > HalfTrackLength) ? -1 : 0;
+
+		} else if (Table.bClosedLoop) {
+
+			// a jump of more than half the track means we wrapped around the start line
+			if (PreviousLapDistance - LapDistance > HalfTrackLength)
+			{
+				++Laps[Index];
+
+			} else if (LapDistance - PreviousLapDistance > HalfTrackLength) {
+
+				--Laps[Index];
+			}
+		}
+
+		Sectors[Index] = FMath::Max(0, static_cast<int32>(Algo::UpperBound(SectorStarts, LapDistance)) - 1);
+
+	}, NumVehicles < ParallelThreshold ? EParallelForFlags::ForceSingleThread : EParallelForFlags::None);
+}
+
+void UFutureRacingTrackProgressSubsystem::PublishLeaderboard()
+{
+	const int32 NumVehicles = Vehicles.Num();
+	const float TrackLength = Track->TrackLength;
+
+	// sort the vehicle indices by total progress
+	TArray<int32, TInlineAllocator<64>> Order;
+	Order.SetNumUninitialized(NumVehicles);
+
+	for (int32 Index = 0; Index < NumVehicles; ++Index)
+	{
+		Order[Index] = Index;
+	}
+
+	auto GetProgress = [this, TrackLength](int32 Index)
+	{
+		return Laps[Index] * TrackLength + LapDistances[Index];
+	};
+
+	Order.Sort([&GetProgress](int32 A, int32 B)
+	{
+		return GetProgress(A) > GetProgress(B);
+	});
+
+	// publish the standings in race order
+	Leaderboard.Reset();
+
+	for (int32 Position = 0; Position < NumVehicles; ++Position)
+	{
+		const int32 Index = Order[Position];
+
+		FFutureRacingRaceStanding& Standing = Leaderboard.AddDefaulted_GetRef();
+		Standing.Vehicle = Vehicles[Index];
+		Standing.LapDistance = LapDistances[Index];
+		Standing.Progress = GetProgress(Index);
+		Standing.Lap = FMath::Max(Laps[Index], 0);
+		Standing.Sector = Sectors[Index];
+		Standing.Position = Position + 1;
+
+		LeaderboardIndices[Index] = Position;
+	}
+
+	++LeaderboardVersion;
+}
+
+void UFutureRacingTrackProgressSubsystem::RemoveAtSwap(int32 Index)
+{
+	VehicleIndices.Remove(Vehicles[Index]);
+
+	Vehicles.RemoveAtSwap(Index);
+	Locations.RemoveAtSwap(Index);
+	TrackDistances.RemoveAtSwap(Index);
+	LapDistances.RemoveAtSwap(Index);
+	Laps.RemoveAtSwap(Index);
+	Sectors.RemoveAtSwap(Index);
+	LeaderboardIndices.RemoveAtSwap(Index);
+
+	// the last vehicle moved into the freed slot
+	if (Vehicles.IsValidIndex(Index))
+	{
+		VehicleIndices.Add(Vehicles[Index], Index);
+	}
+}
@@ -0,0 +1,140 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "FutureRacingTrackProgressSubsystem.generated.h"
+
+class AFutureRacingPawn;
+struct FFutureRacingTrackTable;
+
+/**
+ *  A vehicle's place in the race
+ */
+struct FFutureRacingRaceStanding
+{
+	/** Vehicle this standing belongs to */
+	TWeakObjectPtr<AFutureRacingPawn> Vehicle;
+
+	/** Distance past the start line on the current lap */
+	float LapDistance = 0.0f;
+
+	/** Total distance covered since the first start line crossing. Negative while still behind the start line */
+	float Progress = 0.0f;
+
+	/** Number of times the start line was crossed forwards. Zero until the first crossing */
+	int32 Lap = 0;
+
+	/** Index of the sector the vehicle is in */
+	int32 Sector = 0;
+
+	/** Race position, starting at 1 */
+	int32 Position = 0;
+};
+
+/**
+ *  Tracks every vehicle's progress along the primary track.
+ *  Once per frame, the vehicle locations are gathered and projected onto the baked centreline
+ *  in one batched pass, then sorted into a leaderboard. UI, AI and telemetry read the
+ *  published standings instead of working out progress themselves.
+ */
+UCLASS(Config="Game")
+class UFutureRacingTrackProgressSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+protected:
+
+	/** Number of equal sectors used when the track doesn't have enough gates to define them */
+	UPROPERTY(Config)
+	int32 DefaultNumSectors = 3;
+
+	/** Vehicle counts at or above this are projected onto the track in parallel */
+	UPROPERTY(Config)
+	int32 ParallelThreshold = 32;
+
+	/** Track everyone is measured along */
+	TSharedPtr<const FFutureRacingTrackTable> Track;
+
+	/** Track distance of the start line */
+	float StartDistance = 0.0f;
+
+	/** Lap distances each sector starts at, ascending. The first one is always zero */
+	TArray<float> SectorStarts;
+
+	/** Number of gates the sectors were built from */
+	int32 NumSectorGates = -1;
+
+	/** Registered vehicles */
+	TArray<TWeakObjectPtr<AFutureRacingPawn>> Vehicles;
+
+	/** Per vehicle state, parallel to Vehicles */
+	TArray<FVector> Locations;
+	TArray<float> TrackDistances;
+	TArray<float> LapDistances;
+	TArray<int32> Laps;
+	TArray<int32> Sectors;
+
+	/** Index of each vehicle in the per vehicle arrays. Weak keys so destroyed vehicles can still be removed */
+	TMap<TWeakObjectPtr<const AFutureRacingPawn>, int32> VehicleIndices;
+
+	/** Published standings, sorted by race position */
+	TArray<FFutureRacingRaceStanding> Leaderboard;
+
+	/** Index of each vehicle's standing in the leaderboard, parallel to Vehicles */
+	TArray<int32> LeaderboardIndices;
+
+	/** Incremented every time the leaderboard is published */
+	uint32 LeaderboardVersion = 0;
+
+public:
+
+	/** Adds a vehicle to the race */
+	void RegisterVehicle(AFutureRacingPawn* Vehicle);
+
+	/** Removes a vehicle from the race */
+	void UnregisterVehicle(AFutureRacingPawn* Vehicle);
+
+	/** Returns the standings sorted by race position */
+	const TArray<FFutureRacingRaceStanding>& GetLeaderboard() const { return Leaderboard; }
+
+	/** Returns a vehicle's standing, or null if it isn't racing */
+	const FFutureRacingRaceStanding* GetStanding(const AFutureRacingPawn* Vehicle) const;
+
+	/** Returns a vehicle's race position starting at 1, or 0 if it isn't racing */
+	int32 GetRacePosition(const AFutureRacingPawn* Vehicle) const;
+
+	/**
+	 *  Returns the distance between two vehicles along the track, the short way round on closed loops.
+	 *  Negative if either vehicle isn't racing or hasn't been placed on the track yet.
+	 */
+	float GetTrackGap(const AFutureRacingPawn* A, const AFutureRacingPawn* B) const;
+
+	/** Returns the number of sectors per lap */
+	int32 GetNumSectors() const { return SectorStarts.Num(); }
+
+	/** Returns a counter that changes every time the leaderboard is published */
+	uint32 GetLeaderboardVersion() const { return LeaderboardVersion; }
+
+	// Begin FTickableGameObject interface
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	// End FTickableGameObject interface
+
+protected:
+
+	/** Finds the track and works out the start line and sectors */
+	void UpdateTrackLayout();
+
+	/** Projects every vehicle onto the track and updates laps and sectors */
+	void UpdateProgress();
+
+	/** Sorts the vehicles into the leaderboard */
+	void PublishLeaderboard();
+
+	/** Removes the vehicle at an index, keeping the arrays parallel */
+	void RemoveAtSwap(int32 Index);
+};
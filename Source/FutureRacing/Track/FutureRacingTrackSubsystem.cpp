@@ -0,0 +1,108 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "FutureRacingTrackSubsystem.h"
+#include "FutureRacingTrackComponent.h"
+#include "Components/SplineComponent.h"
+#include "EngineUtils.h"
+#include "Engine/World.h"
+#include "FutureRacing.h"
+
+UFutureRacingTrackSubsystem::UFutureRacingTrackSubsystem()
+{
+	// default to the CPU path spline Blueprint
+	DefaultTrackActorClass = TSoftClassPtr<AActor>(FSoftObjectPath(TEXT("/Game/CPU/BP_CPU_Path_Spline.BP_CPU_Path_Spline_C")));
+}
+
+void UFutureRacingTrackSubsystem::RegisterTrack(UFutureRacingTrackComponent* Track)
+{
+	USplineComponent* Spline = Track ? Track->GetSpline() : nullptr;
+
+	if (!Spline)
+	{
+		return;
+	}
+
+	// use the baked table if we have one, otherwise build it now with the component's settings
+	if (Track->GetTable().IsValid())
+	{
+		Tables.Add(Spline, MakeShared<const FFutureRacingTrackTable>(Track->GetTable()));
+
+	} else {
+
+		TSharedRef<FFutureRacingTrackTable> Table = MakeShared<FFutureRacingTrackTable>();
+		Track->BuildTable(*Spline, *Table);
+		Tables.Add(Spline, Table);
+
+		UE_LOG(LogFutureRacing, Warning, TEXT("Track '%s' has no baked table. Built %d samples at runtime."), *GetNameSafe(Track->GetOwner()), Table->Num());
+	}
+
+	if (Track->IsPrimaryTrack() && !PrimarySpline.IsValid())
+	{
+		PrimarySpline = Spline;
+	}
+}
+
+TSharedPtr<const FFutureRacingTrackTable> UFutureRacingTrackSubsystem::GetTable(USplineComponent* Spline)
+{
+	if (!Spline)
+	{
+		return nullptr;
+	}
+
+	if (const TSharedPtr<const FFutureRacingTrackTable>* Existing = Tables.Find(Spline))
+	{
+		return *Existing;
+	}
+
+	// build the table once with the settings of the owner's track component, or the defaults
+	const UFutureRacingTrackComponent* Track = Spline->GetOwner() ? Spline->GetOwner()->FindComponentByClass<UFutureRacingTrackComponent>() : nullptr;
+
+	if (Track && Track->GetTable().IsValid())
+	{
+		return Tables.Add(Spline, MakeShared<const FFutureRacingTrackTable>(Track->GetTable()));
+	}
+
+	if (!Track)
+	{
+		Track = GetDefault<UFutureRacingTrackComponent>();
+	}
+
+	TSharedRef<FFutureRacingTrackTable> Table = MakeShared<FFutureRacingTrackTable>();
+	Track->BuildTable(*Spline, *Table);
+
+	return Tables.Add(Spline, Table);
+}
+
+USplineComponent* UFutureRacingTrackSubsystem::GetPrimarySpline()
+{
+	if (PrimarySpline.IsValid())
+	{
+		return PrimarySpline.Get();
+	}
+
+	// search the world once for the default track actor
+	if (!bSearchedForPrimarySpline)
+	{
+		bSearchedForPrimarySpline = true;
+
+		if (UClass* TrackClass = DefaultTrackActorClass.LoadSynchronous())
+		{
+			for (TActorIterator<AActor> It(GetWorld(), TrackClass); It; ++It)
+			{
+				if (USplineComponent* Spline = It->FindComponentByClass<USplineComponent>())
+				{
+					PrimarySpline = Spline;
+					break;
+				}
+			}
+		}
+	}
+
+	return PrimarySpline.Get();
+}
+
+TSharedPtr<const FFutureRacingTrackTable> UFutureRacingTrackSubsystem::GetPrimaryTable()
+{
+	return GetTable(GetPrimarySpline());
+}
@@ -0,0 +1,55 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "UObject/ObjectKey.h"
+#include "FutureRacingTrackTable.h"
+#include "FutureRacingTrackSubsystem.generated.h"
+
+class USplineComponent;
+class UFutureRacingTrackComponent;
+
+/**
+ *  Owns the track lookup tables for a world.
+ *  Tables baked by a track component are used as is. Splines without
+ *  one get a table built once on first use and shared by every caller.
+ */
+UCLASS(Config="Game")
+class UFutureRacingTrackSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+protected:
+
+	/** Actor class searched for the primary track spline if no track component claims it */
+	UPROPERTY(Config)
+	TSoftClassPtr<AActor> DefaultTrackActorClass;
+
+	/** Lookup tables, keyed by the spline they were built from */
+	TMap<TObjectKey<USplineComponent>, TSharedPtr<const FFutureRacingTrackTable>> Tables;
+
+	/** Spline used when callers don't provide their own */
+	TWeakObjectPtr<USplineComponent> PrimarySpline;
+
+	/** If true, we've already searched the world for a primary spline */
+	bool bSearchedForPrimarySpline = false;
+
+public:
+
+	/** Constructor */
+	UFutureRacingTrackSubsystem();
+
+	/** Registers a track component and its baked table */
+	void RegisterTrack(UFutureRacingTrackComponent* Track);
+
+	/** Returns the lookup table for a spline, building it on first use */
+	TSharedPtr<const FFutureRacingTrackTable> GetTable(USplineComponent* Spline);
+
+	/** Returns the primary track spline, if one can be found */
+	USplineComponent* GetPrimarySpline();
+
+	/** Returns the lookup table for the primary track */
+	TSharedPtr<const FFutureRacingTrackTable> GetPrimaryTable();
+};
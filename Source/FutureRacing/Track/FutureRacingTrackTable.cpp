@@ -0,0 +1,302 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "FutureRacingTrackTable.h"
+#include "Components/SplineComponent.h"
+
+void FFutureRacingTrackTable::Build(const USplineComponent& Spline, float InSampleSpacing, float MaxSpeed, float MaxLateralAcceleration, float MaxBrakingDeceleration)
+{
+	TrackLength = Spline.GetSplineLength();
+	bClosedLoop = Spline.IsClosedLoop();
+
+	// closed loops don't duplicate the first sample at the end
+	const int32 NumSamples = FMath::Max(2, FMath::CeilToInt(TrackLength / FMath::Max(InSampleSpacing, 1.0f)) + (bClosedLoop ? 0 : 1));
+	SampleSpacing = TrackLength / (bClosedLoop ? NumSamples : NumSamples - 1);
+
+	Positions.SetNumUninitialized(NumSamples);
+	Directions.SetNumUninitialized(NumSamples);
+	Curvatures.SetNumUninitialized(NumSamples);
+	SuggestedSpeeds.SetNumUninitialized(NumSamples);
+
+	// sample the spline at fixed spacing
+	for (int32 Index = 0; Index < NumSamples; ++Index)
+	{
+		const float Distance = Index * SampleSpacing;
+
+		Positions[Index] = Spline.GetLocationAtDistanceAlongSpline(Distance, ESplineCoordinateSpace::World);
+		Directions[Index] = Spline.GetDirectionAtDistanceAlongSpline(Distance, ESplineCoordinateSpace::World);
+	}
+
+	// estimate the curvature from the change in heading between the neighboring samples
+	for (int32 Index = 0; Index < NumSamples; ++Index)
+	{
+		const int32 Prev = bClosedLoop ? (Index + NumSamples - 1) % NumSamples : FMath::Max(Index - 1, 0);
+		const int32 Next = bClosedLoop ? (Index + 1) % NumSamples : FMath::Min(Index + 1, NumSamples - 1);
+
+		const FVector& PrevDirection = Directions[Prev];
+		const FVector& NextDirection = Directions[Next];
+
+		const float TurnAngle = FMath::Atan2(FVector::CrossProduct(PrevDirection, NextDirection).Z, FVector::DotProduct(PrevDirection, NextDirection));
+		const float ArcLength = (Next - Prev + (Next < Prev ? NumSamples : 0)) * SampleSpacing;
+
+		Curvatures[Index] = ArcLength > 0.0f ? TurnAngle / ArcLength : 0.0f;
+	}
+
+	// pick the cornering speed that keeps lateral acceleration in check
+	for (int32 Index = 0; Index < NumSamples; ++Index)
+	{
+		const float AbsCurvature = FMath::Abs(Curvatures[Index]);
+		SuggestedSpeeds[Index] = AbsCurvature > UE_KINDA_SMALL_NUMBER ? FMath::Min(MaxSpeed, FMath::Sqrt(MaxLateralAcceleration / AbsCurvature)) : MaxSpeed;
+	}
+
+	// propagate the corner speeds backwards so there's room to brake for them.
+	// Closed loops need a second lap so braking zones carry over the start line
+	const int32 Passes = bClosedLoop ? 2 : 1;
+	const float BrakingTerm = 2.0f * MaxBrakingDeceleration * SampleSpacing;
+
+	for (int32 Step = Passes * NumSamples - 2; Step >= 0; --Step)
+	{
+		const int32 Index = Step % NumSamples;
+		const int32 Next = (Index + 1) % NumSamples;
+
+		if (!bClosedLoop && Next == 0)
+		{
+			continue;
+		}
+
+		SuggestedSpeeds[Index] = FMath::Min(SuggestedSpeeds[Index], FMath::Sqrt(FMath::Square(SuggestedSpeeds[Next]) + BrakingTerm));
+	}
+
+	BuildGrid();
+}
+
+void FFutureRacingTrackTable::BuildGrid()
+{
+	// find the XY bounds of the track
+	FBox2D Bounds(ForceInit);
+
+	for (const FVector& Position : Positions)
+	{
+		Bounds += FVector2D(Position.X, Position.Y);
+	}
+
+	// cells need to be large enough that any point on the road has samples in the surrounding cells
+	GridCellSize = FMath::Max(2000.0f, SampleSpacing * 2.0f);
+	GridOrigin = Bounds.Min - FVector2D(GridCellSize);
+
+	const FVector2D Extent = Bounds.GetSize() + FVector2D(GridCellSize * 2.0f);
+	GridSizeX = FMath::Max(1, FMath::CeilToInt(Extent.X / GridCellSize));
+	GridSizeY = FMath::Max(1, FMath::CeilToInt(Extent.Y / GridCellSize));
+
+	const int32 NumCells = GridSizeX * GridSizeY;
+
+	// counting sort the samples into their cells
+	CellStarts.Reset();
+	CellStarts.SetNumZeroed(NumCells + 1);
+
+	TArray<int32> SampleCells;
+	SampleCells.SetNumUninitialized(Positions.Num());
+
+	for (int32 Index = 0; Index < Positions.Num(); ++Index)
+	{
+		const FIntPoint Cell = GetCell(Positions[Index]);
+		SampleCells[Index] = Cell.Y * GridSizeX + Cell.X;
+		++CellStarts[SampleCells[Index] + 1];
+	}
+
+	for (int32 CellIndex = 0; CellIndex < NumCells; ++CellIndex)
+	{
+		CellStarts[CellIndex + 1] += CellStarts[CellIndex];
+	}
+
+	TArray<int32> CellFill(CellStarts.GetData(), NumCells);
+	CellSamples.SetNumUninitialized(Positions.Num());
+
+	for (int32 Index = 0; Index < Positions.Num(); ++Index)
+	{
+		CellSamples[CellFill[SampleCells[Index]]++] = Index;
+	}
+}
+
+float FFutureRacingTrackTable::WrapDistance(float Distance) const
+{
+	if (bClosedLoop)
+	{
+		const float Wrapped = FMath::Fmod(Distance, TrackLength);
+		return Wrapped < 0.0f ? Wrapped + TrackLength : Wrapped;
+	}
+
+	return FMath::Clamp(Distance, 0.0f, TrackLength);
+}
+
+FIntPoint FFutureRacingTrackTable::GetCell(const FVector& Location) const
+{
+	const int32 CellX = FMath::FloorToInt((Location.X - GridOrigin.X) / GridCellSize);
+	const int32 CellY = FMath::FloorToInt((Location.Y - GridOrigin.Y) / GridCellSize);
+
+	return FIntPoint(FMath::Clamp(CellX, 0, GridSizeX - 1), FMath::Clamp(CellY, 0, GridSizeY - 1));
+}
+
+float FFutureRacingTrackTable::FindClosestDistance(const FVector& Location, float HintDistance) const
+{
+	if (!IsValid())
+	{
+		return 0.0f;
+	}
+
+	// samples far from the hint along the track are penalized, so crossovers don't make us jump
+	const bool bUseHint = HintDistance >= 0.0f;
+	const float HintWindow = GridCellSize * 2.0f;
+
+	auto ScoreSample = [&](int32 SampleIndex)
+	{
+		float Score = FVector::DistSquared(Positions[SampleIndex], Location);
+
+		if (bUseHint)
+		{
+			float TrackDelta = FMath::Abs(SampleIndex * SampleSpacing - HintDistance);
+
+			if (bClosedLoop)
+			{
+				TrackDelta = FMath::Min(TrackDelta, TrackLength - TrackDelta);
+			}
+
+			Score *= TrackDelta > HintWindow ? 4.0f : 1.0f;
+		}
+
+		return Score;
+	};
+
+	int32 BestSample = INDEX_NONE;
+	float BestScore = TNumericLimits<float>::Max();
+
+	// check the cell we're in and its neighbors
+	const FIntPoint Cell = GetCell(Location);
+
+	for (int32 CellY = FMath::Max(Cell.Y - 1, 0); CellY <= FMath::Min(Cell.Y + 1, GridSizeY - 1); ++CellY)
+	{
+		for (int32 CellX = FMath::Max(Cell.X - 1, 0); CellX <= FMath::Min(Cell.X + 1, GridSizeX - 1); ++CellX)
+		{
+			const int32 CellIndex = CellY * GridSizeX + CellX;
+
+			for (int32 Entry = CellStarts[CellIndex]; Entry < CellStarts[CellIndex + 1]; ++Entry)
+			{
+				const int32 SampleIndex = CellSamples[Entry];
+				const float Score = ScoreSample(SampleIndex);
+
+				if (Score < BestScore)
+				{
+					BestScore = Score;
+					BestSample = SampleIndex;
+				}
+			}
+		}
+	}
+
+	// we're well off the track: fall back to a linear scan
+	if (BestSample == INDEX_NONE)
+	{
+		for (int32 SampleIndex = 0; SampleIndex < Positions.Num(); ++SampleIndex)
+		{
+			const float Score = ScoreSample(SampleIndex);
+
+			if (Score < BestScore)
+			{
+				BestScore = Score;
+				BestSample = SampleIndex;
+			}
+		}
+	}
+
+	return RefineDistance(BestSample, Location);
+}
+
+float FFutureRacingTrackTable::RefineDistance(int32 SampleIndex, const FVector& Location) const
+{
+	const int32 NumSamples = Positions.Num();
+	const float SampleDistance = SampleIndex * SampleSpacing;
+
+	// project onto the segment towards each neighbor and keep the closest
+	float BestDistance = SampleDistance;
+	float BestDistSq = FVector::DistSquared(Positions[SampleIndex], Location);
+
+	for (const int32 Offset : { -1, 1 })
+	{
+		int32 Neighbor = SampleIndex + Offset;
+
+		if (bClosedLoop)
+		{
+			Neighbor = (Neighbor + NumSamples) % NumSamples;
+
+		} else if (Neighbor < 0 || Neighbor >= NumSamples) {
+
+			continue;
+		}
+
+		const FVector& Start = Positions[SampleIndex];
+		const FVector Segment = Positions[Neighbor] - Start;
+		const float SegmentLengthSq = Segment.SizeSquared();
+
+		if (SegmentLengthSq <= UE_SMALL_NUMBER)
+		{
+			continue;
+		}
+
+		const float Alpha = FMath::Clamp(FVector::DotProduct(Location - Start, Segment) / SegmentLengthSq, 0.0f, 1.0f);
+		const float DistSq = FVector::DistSquared(Start + Segment * Alpha, Location);
+
+		if (DistSq < BestDistSq)
+		{
+			BestDistSq = DistSq;
+			BestDistance = SampleDistance + Offset * Alpha * SampleSpacing;
+		}
+	}
+
+	return WrapDistance(BestDistance);
+}
+
+void FFutureRacingTrackTable::GetSampleAlpha(float Distance, int32& OutIndex, int32& OutNextIndex, float& OutAlpha) const
+{
+	const int32 NumSamples = Positions.Num();
+	const float SamplePosition = WrapDistance(Distance) / SampleSpacing;
+
+	OutIndex = FMath::Clamp(FMath::FloorToInt(SamplePosition), 0, NumSamples - 1);
+	OutAlpha = FMath::Clamp(SamplePosition - OutIndex, 0.0f, 1.0f);
+	OutNextIndex = bClosedLoop ? (OutIndex + 1) % NumSamples : FMath::Min(OutIndex + 1, NumSamples - 1);
+}
+
+FVector FFutureRacingTrackTable::GetPositionAtDistance(float Distance) const
+{
+	int32 Index, NextIndex;
+	float Alpha;
+	GetSampleAlpha(Distance, Index, NextIndex, Alpha);
+
+	return FMath::Lerp(Positions[Index], Positions[NextIndex], Alpha);
+}
+
+FVector FFutureRacingTrackTable::GetDirectionAtDistance(float Distance) const
+{
+	int32 Index, NextIndex;
+	float Alpha;
+	GetSampleAlpha(Distance, Index, NextIndex, Alpha);
+
+	return FMath::Lerp(Directions[Index], Directions[NextIndex], Alpha).GetSafeNormal();
+}
+
+float FFutureRacingTrackTable::GetCurvatureAtDistance(float Distance) const
+{
+	int32 Index, NextIndex;
+	float Alpha;
+	GetSampleAlpha(Distance, Index, NextIndex, Alpha);
+
+	return FMath::Lerp(Curvatures[Index], Curvatures[NextIndex], Alpha);
+}
+
+float FFutureRacingTrackTable::GetSuggestedSpeedAtDistance(float Distance) const
+{
+	int32 Index, NextIndex;
+	float Alpha;
+	GetSampleAlpha(Distance, Index, NextIndex, Alpha);
+
+	return FMath::Lerp(SuggestedSpeeds[Index], SuggestedSpeeds[NextIndex], Alpha);
+}
@@ -0,0 +1,118 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FutureRacingTrackTable.generated.h"
+
+class USplineComponent;
+
+/**
+ *  Arc-length lookup table baked from a track spline.
+ *  Stores positions, directions, curvature and a suggested speed at fixed spacing
+ *  in contiguous arrays, plus a uniform 2D grid index for constant time
+ *  "closest distance along the track" queries without solving the spline.
+ */
+USTRUCT()
+struct FFutureRacingTrackTable
+{
+	GENERATED_BODY()
+
+	/** Distance between samples */
+	UPROPERTY(VisibleAnywhere, Category="Track", meta = (Units = "cm"))
+	float SampleSpacing = 0.0f;
+
+	/** Total length of the track */
+	UPROPERTY(VisibleAnywhere, Category="Track", meta = (Units = "cm"))
+	float TrackLength = 0.0f;
+
+	/** If true, distances wrap around at the end of the track */
+	UPROPERTY(VisibleAnywhere, Category="Track")
+	bool bClosedLoop = false;
+
+	/** World space sample positions */
+	UPROPERTY()
+	TArray<FVector> Positions;
+
+	/** World space unit direction at each sample */
+	UPROPERTY()
+	TArray<FVector> Directions;
+
+	/** Signed curvature at each sample, in 1/cm. Positive turns right */
+	UPROPERTY()
+	TArray<float> Curvatures;
+
+	/** Suggested speed at each sample, accounting for braking into the corners ahead, in cm/s */
+	UPROPERTY()
+	TArray<float> SuggestedSpeeds;
+
+	/** World space XY origin of the grid index */
+	UPROPERTY()
+	FVector2D GridOrigin = FVector2D::ZeroVector;
+
+	/** Size of each grid cell */
+	UPROPERTY()
+	float GridCellSize = 0.0f;
+
+	/** Number of grid cells along X */
+	UPROPERTY()
+	int32 GridSizeX = 0;
+
+	/** Number of grid cells along Y */
+	UPROPERTY()
+	int32 GridSizeY = 0;
+
+	/** Start offset into CellSamples for each cell. Has one extra entry at the end */
+	UPROPERTY()
+	TArray<int32> CellStarts;
+
+	/** Sample indices, bucketed by cell */
+	UPROPERTY()
+	TArray<int32> CellSamples;
+
+public:
+
+	/** Bakes the table from a spline */
+	void Build(const USplineComponent& Spline, float InSampleSpacing, float MaxSpeed, float MaxLateralAcceleration, float MaxBrakingDeceleration);
+
+	/** Returns true if the table holds usable data */
+	bool IsValid() const { return Positions.Num() > 1 && SampleSpacing > 0.0f; };
+
+	/** Returns the number of samples */
+	int32 Num() const { return Positions.Num(); };
+
+	/** Wraps or clamps a distance to the track */
+	float WrapDistance(float Distance) const;
+
+	/**
+	 *  Returns the distance along the track closest to a world location.
+	 *  If a previous distance is given, samples near it win ties where the track crosses over itself.
+	 */
+	float FindClosestDistance(const FVector& Location, float HintDistance = -1.0f) const;
+
+	/** Returns the interpolated world position at a distance */
+	FVector GetPositionAtDistance(float Distance) const;
+
+	/** Returns the interpolated world direction at a distance */
+	FVector GetDirectionAtDistance(float Distance) const;
+
+	/** Returns the interpolated curvature at a distance */
+	float GetCurvatureAtDistance(float Distance) const;
+
+	/** Returns the interpolated suggested speed at a distance */
+	float GetSuggestedSpeedAtDistance(float Distance) const;
+
+protected:
+
+	/** Converts a distance into a sample index and blend alpha towards the next sample */
+	void GetSampleAlpha(float Distance, int32& OutIndex, int32& OutNextIndex, float& OutAlpha) const;
+
+	/** Returns the grid cell containing a world location, clamped to the grid */
+	FIntPoint GetCell(const FVector& Location) const;
+
+	/** Builds the grid index from the sample positions */
+	void BuildGrid();
+
+	/** Returns the distance of the closest point on the segments around a sample */
+	float RefineDistance(int32 SampleIndex, const FVector& Location) const;
+};
@@ -2,28 +2,24 @@
 
 
 #include "TimeTrialGameMode.h"
-#include "Kismet/GameplayStatics.h"
 #include "TimeTrialTrackGate.h"
+#include "FutureRacingMarkerSubsystem.h"
 #include "Engine/World.h"
 
-void ATimeTrialGameMode::BeginPlay()
+ATimeTrialTrackGate* ATimeTrialGameMode::GetFinishLine() const
 {
-	Super::BeginPlay();
-
-	// get the finish line marker
-	TArray<AActor*> ActorList;
+	// gates register as they begin play, so look the finish line up on demand
+	UFutureRacingMarkerSubsystem* Markers = GetWorld()->GetSubsystem<UFutureRacingMarkerSubsystem>();
 
-	UGameplayStatics::GetAllActorsOfClassWithTag(GetWorld(), ATimeTrialTrackGate::StaticClass(), FinishTag, ActorList);
-
-	if (ActorList.Num() > 0)
+	if (!Markers)
 	{
-		// get the first returned track marker that matches the tag
-		FinishLineMarker = Cast<ATimeTrialTrackGate>(ActorList[0]);
+		return nullptr;
 	}
 
-}
+	if (ATimeTrialTrackGate* TaggedGate = Markers->FindGate(FinishTag))
+	{
+		return TaggedGate;
+	}
 
-ATimeTrialTrackGate* ATimeTrialGameMode::GetFinishLine() const
-{
-	return FinishLineMarker;
+	return Markers->GetFinishLine();
 }
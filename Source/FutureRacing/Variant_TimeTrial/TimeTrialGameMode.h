@@ -18,7 +18,7 @@ class ATimeTrialGameMode : public AGameModeBase
 	
 protected:
 
-	/** Actor tag used to find the finish line marker on the level */
+	/** Actor tag used to find the finish line marker on the level. If unset, the gate flagged as the finish line is used */
 	UPROPERTY(EditAnywhere, Category="Time Trial")
 	FName FinishTag;
 
@@ -26,14 +26,6 @@ protected:
 	UPROPERTY(EditAnywhere, Category="Time Trial")
 	int32 Laps = 3;
 
-	/** Pointer to the finish line track marker */
-	TObjectPtr<ATimeTrialTrackGate> FinishLineMarker;
-
-protected:
-
-	/** Gameplay initialization */
-	virtual void BeginPlay() override;
-
 public: 
 
 	/** Returns the track marker for the finish line */
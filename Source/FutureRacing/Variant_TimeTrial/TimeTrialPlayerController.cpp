@@ -4,6 +4,7 @@
 #include "TimeTrialPlayerController.h"
 #include "TimeTrialUI.h"
 #include "Engine/World.h"
+#include "TimerManager.h"
 #include "TimeTrialGameMode.h"
 #include "TimeTrialTrackGate.h"
 #include "EnhancedInputSubsystems.h"
@@ -11,18 +12,40 @@
 #include "InputMappingContext.h"
 #include "FutureRacingUI.h"
 #include "FutureRacingPawn.h"
+#include "FutureRacingVehiclePoolSubsystem.h"
+#include "FutureRacingMarkerSubsystem.h"
+#include "FutureRacingGateCrossingSubsystem.h"
+#include "FutureRacingGhostSubsystem.h"
+#include "FutureRacingVehicleNetComponent.h"
 #include "ChaosWheeledVehicleMovementComponent.h"
 #include "Blueprint/UserWidget.h"
 #include "FutureRacing.h"
-#include "Kismet/GameplayStatics.h"
 #include "GameFramework/PlayerStart.h"
 #include "Widgets/Input/SVirtualJoystick.h"
 
+DECLARE_CYCLE_STAT(TEXT("Time Trial Controller Tick"), STAT_FutureRacingTimeTrialControllerTick, STATGROUP_FutureRacing);
+
 void ATimeTrialPlayerController::BeginPlay()
 {
 	Super::BeginPlay();
 
-	// only spawn UI on local player controllers
+	// get respawn vehicles ready while we're still loading
+	if (HasAuthority())
+	{
+		// the player's countdown starts now. Clients run it themselves, so the server keeps its own time
+		CountdownStartTime = GetWorld()->GetTimeSeconds();
+
+		if (UFutureRacingVehiclePoolSubsystem* VehiclePool = GetWorld()->GetSubsystem<UFutureRacingVehiclePoolSubsystem>())
+		{
+			VehiclePool->Prewarm(VehiclePawnClass, RespawnPoolSize);
+
+			// vehicles taken out of play go back to the pool instead of being destroyed
+			VehiclePool->OnVehicleReleased.AddUObject(this, &ATimeTrialPlayerController::OnPawnReleased);
+		}
+	}
+
+	// only spawn UI on local player controllers. Server builds never have one
+#if !UE_SERVER
 	if (IsLocalPlayerController())
 	{
 		if (ShouldUseTouchControls())
@@ -71,8 +94,14 @@ void ATimeTrialPlayerController::BeginPlay()
 			UE_LOG(LogFutureRacing, Error, TEXT("Could not spawn vehicle UI widget."));
 
 		}
-	}
 
+		// bring in the ghost laps saved for this track
+		if (UFutureRacingGhostSubsystem* Ghosts = GetWorld()->GetSubsystem<UFutureRacingGhostSubsystem>())
+		{
+			Ghosts->LoadGhosts();
+		}
+	}
+#endif
 }
 
 void ATimeTrialPlayerController::SetupInputComponent()
@@ -110,17 +139,32 @@ void ATimeTrialPlayerController::OnPossess(APawn* InPawn)
 	VehiclePawn = CastChecked<AFutureRacingPawn>(InPawn);
 
 	// subscribe to the pawn's OnDestroyed delegate
-	VehiclePawn->OnDestroyed.AddDynamic(this, &ATimeTrialPlayerController::OnPawnDestroyed);
+	VehiclePawn->OnDestroyed.AddUniqueDynamic(this, &ATimeTrialPlayerController::OnPawnDestroyed);
 
 	// disable input on the pawn if the race hasn't started yet
 	if (!bRaceStarted)
 	{
 		VehiclePawn->DisableInput(this);
-	}	
+	}
+}
+
+void ATimeTrialPlayerController::AcknowledgePossession(APawn* InPawn)
+{
+	Super::AcknowledgePossession(InPawn);
+
+	// respawning is up to the server, clients only need the pointer for the UI
+	VehiclePawn = Cast<AFutureRacingPawn>(InPawn);
+
+	if (VehiclePawn && !bRaceStarted)
+	{
+		VehiclePawn->DisableInput(this);
+	}
 }
 
 void ATimeTrialPlayerController::Tick(float Delta)
 {
+	FUTURERACING_SCOPE_CYCLE_COUNTER(STAT_FutureRacingTimeTrialControllerTick);
+
 	Super::Tick(Delta);
 
 	if (IsValid(VehiclePawn) && IsValid(VehicleUI))
@@ -132,30 +176,145 @@ void ATimeTrialPlayerController::Tick(float Delta)
 
 void ATimeTrialPlayerController::StartRace()
 {
+	// clients unlock their controls when their countdown ends, and leave the timing to the server
+	if (!HasAuthority())
+	{
+		bRaceStarted = true;
+
+		if (GetPawn())
+		{
+			GetPawn()->EnableInput(this);
+		}
+
+		ServerStartRace();
+		return;
+	}
+
 	// get the finish line from the game mode
 	if (ATimeTrialGameMode* GM = Cast<ATimeTrialGameMode>(GetWorld()->GetAuthGameMode()))
 	{
 		SetTargetGate(GM->GetFinishLine()->GetNextMarker());
 	}
 
-	// raise the race started flag so any respawned vehicles start with controls unlocked 
+	// raise the race started flag so any respawned vehicles start with controls unlocked
 	bRaceStarted = true;
 
-	// start the first lap
+	// the start line is a safe point to replace vehicles lost from the pool, before the racing gets going
+	if (UFutureRacingVehiclePoolSubsystem* VehiclePool = GetWorld()->GetSubsystem<UFutureRacingVehiclePoolSubsystem>())
+	{
+		VehiclePool->Refill();
+	}
+
+	// start the first lap on the physics clock the gates are timed on
+	UFutureRacingGateCrossingSubsystem* GateCrossing = GetWorld()->GetSubsystem<UFutureRacingGateCrossingSubsystem>();
+
 	CurrentLap = 0;
-	IncrementLapCount();
+	IncrementLapCount(GateCrossing ? GateCrossing->GetPhysicsResultsTime() : GetWorld()->GetTimeSeconds());
 
 	// enable input on the pawn
-	GetPawn()->EnableInput(this);
+	if (IsLocalController() && GetPawn())
+	{
+		GetPawn()->EnableInput(this);
+	}
+}
+
+void ATimeTrialPlayerController::ServerStartRace_Implementation()
+{
+	// the countdown only starts the race once
+	if (bRaceStarted || GetWorldTimerManager().IsTimerActive(StartRaceTimer))
+	{
+		return;
+	}
+
+	// don't take the client's word for when its countdown ended, start no earlier than ours ends
+	const double RemainingTime = CountdownStartTime + MinCountdownTime - GetWorld()->GetTimeSeconds();
+
+	if (RemainingTime > 0.0)
+	{
+		GetWorldTimerManager().SetTimer(StartRaceTimer, this, &ATimeTrialPlayerController::StartRace, RemainingTime, false);
+
+	} else {
+
+		StartRace();
+	}
 }
 
-void ATimeTrialPlayerController::IncrementLapCount()
+void ATimeTrialPlayerController::IncrementLapCount(double LapStartTime)
 {
 	// increment the lap counter
 	++CurrentLap;
 
+	// remote players get told, on their own clock
+	if (IsLocalController())
+	{
+		ShowLapStarted(LapStartTime);
+
+	} else {
+
+		ClientLapStarted(CurrentLap, LapStartTime);
+	}
+}
+
+void ATimeTrialPlayerController::ClientLapStarted_Implementation(int32 Lap, double ServerLapStartTime)
+{
+	CurrentLap = Lap;
+
+	ShowLapStarted(ServerToLocalTime(ServerLapStartTime));
+}
+
+void ATimeTrialPlayerController::ShowLapStarted(double LapStartTime)
+{
+	// update the UI
+	if (UIWidget)
+	{
+		const double PreviousLapStartTime = UIWidget->GetPhysicsLapStartTime();
+
+		const bool bNewBestLap = UIWidget->UpdateLapCount(CurrentLap, LapStartTime);
+
+		if (UFutureRacingGhostSubsystem* Ghosts = GetWorld()->GetSubsystem<UFutureRacingGhostSubsystem>())
+		{
+			// keep the lap we just finished as the ghost to beat
+			if (bNewBestLap)
+			{
+				Ghosts->SaveBestLap(VehiclePawn, PreviousLapStartTime, LapStartTime);
+			}
+
+			// race the ghosts on every lap
+			Ghosts->StartPlayback(LapStartTime);
+		}
+	}
+}
+
+void ATimeTrialPlayerController::CompleteSector(double CrossingTime)
+{
+	// remote players get told, on their own clock
+	if (!IsLocalController())
+	{
+		ClientSectorCompleted(CrossingTime);
+		return;
+	}
+
 	// update the UI
-	UIWidget->UpdateLapCount(CurrentLap, GetWorld()->GetTimeSeconds());
+	if (UIWidget)
+	{
+		UIWidget->UpdateSector(CrossingTime);
+	}
+}
+
+void ATimeTrialPlayerController::ClientSectorCompleted_Implementation(double ServerCrossingTime)
+{
+	if (UIWidget)
+	{
+		UIWidget->UpdateSector(ServerToLocalTime(ServerCrossingTime));
+	}
+}
+
+double ATimeTrialPlayerController::ServerToLocalTime(double ServerTime) const
+{
+	// the vehicle tracks how far our physics clock runs from the server's
+	const UFutureRacingVehicleNetComponent* NetComponent = IsValid(VehiclePawn) ? VehiclePawn->GetNetComponent() : nullptr;
+
+	return NetComponent ? NetComponent->ServerToLocalTime(ServerTime) : ServerTime;
 }
 
 ATimeTrialTrackGate* ATimeTrialPlayerController::GetTargetGate()
@@ -170,16 +329,36 @@ void ATimeTrialPlayerController::SetTargetGate(ATimeTrialTrackGate* Gate)
 
 void ATimeTrialPlayerController::OnPawnDestroyed(AActor* DestroyedPawn)
 {
-	// find the player start
-	TArray<AActor*> ActorList;
-	UGameplayStatics::GetAllActorsOfClass(GetWorld(), APlayerStart::StaticClass(), ActorList);
+	// pooled vehicles outlive us, so ignore vehicles we've since moved on from
+	if (DestroyedPawn == VehiclePawn)
+	{
+		RespawnVehicle();
+	}
+}
+
+void ATimeTrialPlayerController::OnPawnReleased(AFutureRacingPawn* ReleasedPawn, AController* FormerController)
+{
+	if (FormerController == this)
+	{
+		RespawnVehicle();
+	}
+}
+
+void ATimeTrialPlayerController::RespawnVehicle()
+{
+	FUTURERACING_SCOPE_CYCLE_COUNTER(STAT_FutureRacingRespawnTime);
+
+	// find a free player start
+	UFutureRacingMarkerSubsystem* Markers = GetWorld()->GetSubsystem<UFutureRacingMarkerSubsystem>();
 
-	if (ActorList.Num() > 0)
+	if (APlayerStart* PlayerStart = Markers->ReserveFreePlayerStart())
 	{
-		// spawn a vehicle at the player start
-		const FTransform SpawnTransform = ActorList[0]->GetActorTransform();
+		// take a vehicle from the pool and place it at the player start
+		const FTransform SpawnTransform = PlayerStart->GetActorTransform();
+
+		UFutureRacingVehiclePoolSubsystem* VehiclePool = GetWorld()->GetSubsystem<UFutureRacingVehiclePoolSubsystem>();
 
-		if (AFutureRacingPawn* RespawnedVehicle = GetWorld()->SpawnActor<AFutureRacingPawn>(VehiclePawnClass, SpawnTransform))
+		if (AFutureRacingPawn* RespawnedVehicle = VehiclePool->Acquire(VehiclePawnClass, SpawnTransform))
 		{
 			// possess the vehicle
 			Possess(RespawnedVehicle);
@@ -4,6 +4,7 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/PlayerController.h"
+#include "Engine/TimerHandle.h"
 #include "TimeTrialPlayerController.generated.h"
 
 class ATimeTrialTrackGate;
@@ -77,10 +78,24 @@ protected:
 	/** If true, the race has already started */
 	bool bRaceStarted = false;
 
+	/** Shortest time the server lets a client's start countdown take, in seconds. Should match the countdown animation */
+	UPROPERTY(EditAnywhere, Config, Category="Time Trial", meta = (ClampMin = 0))
+	float MinCountdownTime = 3.0f;
+
+	/** World time the server started this player's countdown at */
+	double CountdownStartTime = 0.0;
+
+	/** Starts the race on the server once the countdown is really over, when a client reports it early */
+	FTimerHandle StartRaceTimer;
+
 	/** Type of vehicle to automatically respawn when it's destroyed */
 	UPROPERTY(EditAnywhere, Category="Vehicle|Respawn")
 	TSubclassOf<AFutureRacingPawn> VehiclePawnClass;
 
+	/** Number of dormant vehicles to keep ready for respawning */
+	UPROPERTY(EditAnywhere, Category="Vehicle|Respawn", meta = (ClampMin = 0))
+	int32 RespawnPoolSize = 1;
+
 	/** Pointer to the controlled vehicle pawn */
 	TObjectPtr<AFutureRacingPawn> VehiclePawn;
 
@@ -97,17 +112,29 @@ protected:
 
 public:
 
+	/** Pawn initialization on clients, which never run OnPossess */
+	virtual void AcknowledgePossession(APawn* InPawn) override;
+
 	/** UI vehicle state update on tick */
 	virtual void Tick(float Delta) override;
 
 public:
 
-	/** Sets up the race start */
+	/** Sets up the race start. On clients, asks the server to start timing */
 	UFUNCTION()
 	void StartRace();
 
-	/** Moves on to the next lap */
-	void IncrementLapCount();
+	/**
+	 *  Moves on to the next lap. Server only
+	 *  @param LapStartTime Physics time the new lap started at
+	 */
+	void IncrementLapCount(double LapStartTime);
+
+	/**
+	 *  Completes the current sector. Server only
+	 *  @param CrossingTime Physics time the sector's end gate was crossed at
+	 */
+	void CompleteSector(double CrossingTime);
 
 	/** Returns the current target track gate */
 	ATimeTrialTrackGate* GetTargetGate();
@@ -117,10 +144,34 @@ public:
 
 protected:
 
+	/** Asks the server to start the race once the client's countdown is done. The server holds off until its own countdown is over */
+	UFUNCTION(Server, Reliable)
+	void ServerStartRace();
+
+	/** Tells the owning client a lap started, on the server's physics clock */
+	UFUNCTION(Client, Reliable)
+	void ClientLapStarted(int32 Lap, double ServerLapStartTime);
+
+	/** Tells the owning client a sector was completed, on the server's physics clock */
+	UFUNCTION(Client, Reliable)
+	void ClientSectorCompleted(double ServerCrossingTime);
+
+	/** Updates the lap counter UI and the ghosts for a new lap */
+	void ShowLapStarted(double LapStartTime);
+
+	/** Converts a server physics time to our physics clock */
+	double ServerToLocalTime(double ServerTime) const;
+
 	/** Handles pawn destruction and respawning */
 	UFUNCTION()
 	void OnPawnDestroyed(AActor* DestroyedPawn);
 
+	/** Respawns when our pawn is returned to the vehicle pool */
+	void OnPawnReleased(AFutureRacingPawn* ReleasedPawn, AController* FormerController);
+
+	/** Places a vehicle from the pool at a free player start and possesses it */
+	void RespawnVehicle();
+
 	/** Returns true if the player should use UMG touch controls */
 	bool ShouldUseTouchControls() const;
 };
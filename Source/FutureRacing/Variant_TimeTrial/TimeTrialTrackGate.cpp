@@ -5,10 +5,15 @@
 #include "Components/SceneComponent.h"
 #include "Components/BoxComponent.h"
 #include "TimeTrialPlayerController.h"
+#include "FutureRacingMarkerSubsystem.h"
+#include "Engine/World.h"
+#include "FutureRacing.h"
+
+DECLARE_CYCLE_STAT(TEXT("Gate Crossing Notify"), STAT_FutureRacingGateCrossingNotify, STATGROUP_FutureRacing);
 
 ATimeTrialTrackGate::ATimeTrialTrackGate()
 {
- 	PrimaryActorTick.bCanEverTick = true;
+ 	PrimaryActorTick.bCanEverTick = false;
 
 	// create the root component
 	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("Root"));
@@ -20,14 +25,48 @@ ATimeTrialTrackGate::ATimeTrialTrackGate()
 	CollisionBox->SetBoxExtent(FVector(1000.0f));
 	CollisionBox->SetLineThickness(32.0f);
 	CollisionBox->bHiddenInGame = false;
-	CollisionBox->SetCollisionProfileName(FName("OverlapAllDynamic"));
+	CollisionBox->SetCollisionProfileName(FName("NoCollision"));
+	CollisionBox->SetGenerateOverlapEvents(false);
+
+}
+
+void ATimeTrialTrackGate::BeginPlay()
+{
+	Super::BeginPlay();
 
+	// make ourselves available for lookups
+	if (UFutureRacingMarkerSubsystem* Markers = GetWorld()->GetSubsystem<UFutureRacingMarkerSubsystem>())
+	{
+		Markers->RegisterGate(this);
+	}
 }
 
-void ATimeTrialTrackGate::NotifyActorBeginOverlap(AActor* OtherActor)
+void ATimeTrialTrackGate::EndPlay(EEndPlayReason::Type EndPlayReason)
 {
-	// get the player controller of the overlapping actor
-	if (ATimeTrialPlayerController* PC = Cast<ATimeTrialPlayerController>(OtherActor->GetInstigatorController()))
+	if (UFutureRacingMarkerSubsystem* Markers = GetWorld()->GetSubsystem<UFutureRacingMarkerSubsystem>())
+	{
+		Markers->UnregisterGate(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void ATimeTrialTrackGate::NotifyCrossing(AActor* PassingActor, double CrossingTime)
+{
+	FUTURERACING_SCOPE_CYCLE_COUNTER(STAT_FutureRacingGateCrossingNotify);
+	INC_DWORD_STAT(STAT_FutureRacingGateCrossings);
+
+	// let any native listeners know something went through the gate
+	OnActorPassed.Broadcast(this, PassingActor, CrossingTime);
+
+	// lap and sector progress is up to the server, clients hear about it from their controller
+	if (IsNetMode(NM_Client))
+	{
+		return;
+	}
+
+	// get the player controller of the passing actor
+	if (ATimeTrialPlayerController* PC = Cast<ATimeTrialPlayerController>(PassingActor->GetInstigatorController()))
 	{
 		// is this the current target marker for the player?
 		if (PC->GetTargetGate() == this)
@@ -35,10 +74,13 @@ void ATimeTrialTrackGate::NotifyActorBeginOverlap(AActor* OtherActor)
 			// point the player to the next marker
 			PC->SetTargetGate(NextMarker);
 
+			// every gate closes a sector
+			PC->CompleteSector(CrossingTime);
+
 			// if this is the finish line, increment the lap
 			if (bIsFinishLine)
 			{
-				PC->IncrementLapCount();
+				PC->IncrementLapCount(CrossingTime);
 			}
 		}
 	}
@@ -7,17 +7,22 @@
 #include "TimeTrialTrackGate.generated.h"
 
 class UBoxComponent;
+class ATimeTrialTrackGate;
+
+DECLARE_MULTICAST_DELEGATE_ThreeParams(FTrackGatePassedDelegate, ATimeTrialTrackGate* /*Gate*/, AActor* /*PassingActor*/, double /*CrossingTime*/);
 
 /**
- *  A track gate volume for a Time Trial racing game.
+ *  A track gate for a Time Trial racing game.
  *  Players must pass through the track gates in order to complete a lap.
+ *  Crossings are detected by the gate crossing subsystem sweeping each vehicle's
+ *  physics steps against the gate, so the gate itself doesn't collide or tick.
  */
 UCLASS(abstract)
 class ATimeTrialTrackGate : public AActor
 {
 	GENERATED_BODY()
 	
-	/** Collision Box */
+	/** Box bounding the gate's crossing plane. Only used for its shape, it has no collision */
 	UPROPERTY(VisibleAnywhere, Category = "Components", meta = (AllowPrivateAccess = "true"))
 	UBoxComponent* CollisionBox;
 
@@ -38,11 +43,30 @@ public:
 
 protected:
 
-	/** Handle collision */
-	virtual void NotifyActorBeginOverlap(AActor* OtherActor) override;
+	/** Registers with the marker registry */
+	virtual void BeginPlay() override;
+
+	/** Unregisters from the marker registry */
+	virtual void EndPlay(EEndPlayReason::Type EndPlayReason) override;
 
 public:
 
+	/** Native delegate broadcast when any actor passes through this gate, regardless of who controls it */
+	FTrackGatePassedDelegate OnActorPassed;
+
+	/**
+	 *  Handles a vehicle passing through the gate.
+	 *  @param PassingActor Actor that crossed the gate
+	 *  @param CrossingTime Physics time of the crossing, interpolated between physics steps
+	 */
+	void NotifyCrossing(AActor* PassingActor, double CrossingTime);
+
+	/** Returns the box bounding the crossing plane */
+	const UBoxComponent* GetCrossingBox() const { return CollisionBox; }
+
 	/** Returns the next marker on the track */
 	ATimeTrialTrackGate* GetNextMarker() const;
+
+	/** Returns true if this gate is the finish line */
+	bool IsFinishLine() const { return bIsFinishLine; };
 };
@@ -3,6 +3,9 @@
 
 #include "TimeTrialUI.h"
 #include "TimeTrialStartUI.h"
+#include "FutureRacingGateCrossingSubsystem.h"
+#include "FutureRacingMarkerSubsystem.h"
+#include "Engine/World.h"
 
 void UTimeTrialUI::NativeConstruct()
 {
@@ -19,22 +22,35 @@ void UTimeTrialUI::NativeConstruct()
 	StartUI->StartCountdown();
 }
 
-void UTimeTrialUI::UpdateLapCount(int32 Lap, float NewLapStartTime)
+bool UTimeTrialUI::UpdateLapCount(int32 Lap, double NewLapStartTime)
 {
+	// the race starts, size the splits for the track
+	if (Lap <= 1)
+	{
+		InitSplits();
+	}
+
 	// save the new lap start time
 	LapStartTime = NewLapStartTime;
 
+	// the first sector of the new lap starts on the line
+	SectorStartTime = NewLapStartTime;
+	CurrentSector = 0;
+
 	// calculate the lap time
-	const float LapTime = NewLapStartTime - LastLapTime;
+	const double LapTime = NewLapStartTime - LastLapTime;
+
+	bool bNewBestLap = false;
 
 	// is this the first lap?
 	if (Lap > 1)
 	{
 		// do we have an invalid lap time?
-		if (BestLapTime < 0.0f)
+		if (BestLapTime < 0.0)
 		{
 			// save the current lap time
 			BestLapTime = LapTime;
+			bNewBestLap = true;
 
 		} else {
 
@@ -43,6 +59,7 @@ void UTimeTrialUI::UpdateLapCount(int32 Lap, float NewLapStartTime)
 			{
 				// save the best lap time
 				BestLapTime = LapTime;
+				bNewBestLap = true;
 			}
 
 		}
@@ -50,10 +67,42 @@ void UTimeTrialUI::UpdateLapCount(int32 Lap, float NewLapStartTime)
 	} else {
 
 		// first lap: save an invalid lap time
-		BestLapTime = -1.0f;
+		BestLapTime = -1.0;
+
+	}
+
+	// keep the splits of a fully timed best lap to compare against
+	if (bNewBestLap && NumSplits > 0 && CurrentSplits.Last() >= 0.0f)
+	{
+		for (int32 Split = 0; Split < NumSplits; ++Split)
+		{
+			BestSplits[Split] = CurrentSplits[Split];
+		}
 
+		bHasBestSplits = true;
+	}
+
+	// clear the splits for the new lap
+	for (float& Split : CurrentSplits)
+	{
+		Split = -1.0f;
 	}
 
+	if (NumSplits > 0)
+	{
+		const int32 Offset = GetRecordedLapOffset(Lap);
+
+		for (int32 Split = 0; Split < NumSplits; ++Split)
+		{
+			RecordedSplits[Offset + Split] = -1.0f;
+		}
+
+		RecordedLaps[(Lap - 1) % MaxRecordedLaps] = Lap;
+	}
+
+	LastSplitDelta = 0.0f;
+	bHasSplitDelta = false;
+
 	// save the current lap
 	CurrentLap = Lap;
 
@@ -62,6 +111,109 @@ void UTimeTrialUI::UpdateLapCount(int32 Lap, float NewLapStartTime)
 
 	// pass control to BP to update the widgets
 	BP_UpdateLaps();
+
+	return bNewBestLap;
+}
+
+void UTimeTrialUI::UpdateSector(double CrossingTime)
+{
+	// time the sector from crossing to crossing
+	LastSectorTime = CrossingTime - SectorStartTime;
+	SectorStartTime = CrossingTime;
+
+	// record the split, and compare it against the best lap
+	const int32 Split = CurrentSector;
+
+	if (Split < NumSplits && CurrentLap > 0)
+	{
+		const float SplitTime = CrossingTime - LapStartTime;
+
+		CurrentSplits[Split] = SplitTime;
+		RecordedSplits[GetRecordedLapOffset(CurrentLap) + Split] = SplitTime;
+
+		if (bHasBestSplits)
+		{
+			LastSplitDelta = SplitTime - BestSplits[Split];
+			bHasSplitDelta = true;
+		}
+	}
+
+	++CurrentSector;
+
+	// pass control to BP to update the widgets
+	BP_UpdateSplits();
+}
+
+float UTimeTrialUI::GetLiveDeltaToBest() const
+{
+	if (!bHasBestSplits)
+	{
+		return 0.0f;
+	}
+
+	const int32 Split = CurrentSector;
+
+	// past the last split, the lap delta stands until the next lap starts
+	if (Split >= NumSplits)
+	{
+		return GetLastSplitDelta();
+	}
+
+	// compare the time spent in this sector against the same sector on the best lap
+	const float BestSectorStart = Split > 0 ? BestSplits[Split - 1] : 0.0f;
+	const float CurrentSectorStart = Split > 0 ? CurrentSplits[Split - 1] : 0.0f;
+
+	const float BestSectorTime = BestSplits[Split] - BestSectorStart;
+	const float SectorElapsed = GetCurrentLapTime() - CurrentSectorStart;
+
+	// we don't know we're gaining until the next split, but we do know once we're losing
+	return GetLastSplitDelta() + FMath::Max(SectorElapsed - BestSectorTime, 0.0f);
+}
+
+float UTimeTrialUI::GetLapSplit(int32 Lap, int32 Split) const
+{
+	if (Lap < 1 || Split < 0 || Split >= NumSplits || RecordedLaps[(Lap - 1) % MaxRecordedLaps] != Lap)
+	{
+		return -1.0f;
+	}
+
+	return RecordedSplits[GetRecordedLapOffset(Lap) + Split];
+}
+
+void UTimeTrialUI::InitSplits()
+{
+	// every gate closes a split, the finish line last
+	UFutureRacingMarkerSubsystem* Markers = GetWorld() ? GetWorld()->GetSubsystem<UFutureRacingMarkerSubsystem>() : nullptr;
+
+	NumSplits = Markers ? Markers->GetNumGates() : 0;
+	MaxRecordedLaps = FMath::Max(MaxRecordedLaps, 1);
+
+	// size everything once, so timing a lap never allocates
+	CurrentSplits.Init(-1.0f, NumSplits);
+	BestSplits.Init(-1.0f, NumSplits);
+	RecordedSplits.Init(-1.0f, NumSplits * MaxRecordedLaps);
+	RecordedLaps.Init(0, MaxRecordedLaps);
+
+	bHasBestSplits = false;
+	LastSplitDelta = 0.0f;
+	bHasSplitDelta = false;
+}
+
+double UTimeTrialUI::GetCurrentLapTime() const
+{
+	// read the same physics clock the gate crossings are timed on
+	const UWorld* World = GetWorld();
+	const UFutureRacingGateCrossingSubsystem* GateCrossing = World ? World->GetSubsystem<UFutureRacingGateCrossingSubsystem>() : nullptr;
+
+	return GateCrossing ? GateCrossing->GetPhysicsResultsTime() - LapStartTime : 0.0;
+}
+
+double UTimeTrialUI::GetLapStartTime() const
+{
+	// the widget times the lap on world time, which runs ahead of the physics results and on clients isn't the server's
+	const UWorld* World = GetWorld();
+
+	return World ? World->GetTimeSeconds() - GetCurrentLapTime() : 0.0;
 }
 
 void UTimeTrialUI::StartRace()
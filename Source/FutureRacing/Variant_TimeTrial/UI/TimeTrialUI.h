@@ -14,6 +14,11 @@ DECLARE_DYNAMIC_MULTICAST_DELEGATE(FStartRaceDelegate);
  *  Simple UI for a Time Trial racing game
  *  Keeps track of lap number and best time
  *  Spawns a sub-widget to do the initial countdown
+ *
+ *  Every gate crossing is a split, timed from the start of the lap, and the finish line is the last one.
+ *  Splits are kept for the current lap, the best lap and a window of recent laps, in arrays sized once
+ *  when the race starts. The delta to the best lap is worked out from them on request, so the HUD can
+ *  poll it every frame without allocating or running Blueprint logic.
  */
 UCLASS(abstract)
 class UTimeTrialUI : public UUserWidget
@@ -27,17 +32,54 @@ protected:
 	TSubclassOf<UTimeTrialStartUI> StartUIClass;
 
 	/** Time when the previous lap started, in seconds */
-	float LastLapTime = 0.0f;
+	double LastLapTime = 0.0;
 
 	/** Best lap time, in seconds */
-	float BestLapTime = 0.0f;
+	double BestLapTime = 0.0;
 
-	/** Game time when this lap started */
-	float LapStartTime = 0.0f;
+	/** Physics time when this lap started */
+	double LapStartTime = 0.0;
+
+	/** Physics time when the current sector started */
+	double SectorStartTime = 0.0;
+
+	/** Time taken by the last completed sector, in seconds. Negative until a sector is completed */
+	double LastSectorTime = -1.0;
 
 	/** Current lap number */
 	int32 CurrentLap = 0;
 
+	/** Index of the current sector within the lap */
+	int32 CurrentSector = 0;
+
+	/** Number of laps whose splits are kept. Older laps are overwritten */
+	UPROPERTY(EditAnywhere, Category="Splits", meta=(ClampMin="1"))
+	int32 MaxRecordedLaps = 16;
+
+	/** Number of splits per lap, one per track gate */
+	int32 NumSplits = 0;
+
+	/** Split times of the current lap, in seconds from the lap start */
+	TArray<float> CurrentSplits;
+
+	/** Split times of the best lap. Only valid once bHasBestSplits is set */
+	TArray<float> BestSplits;
+
+	/** Split times of recent laps, NumSplits per lap, indexed by lap modulo MaxRecordedLaps. Negative if not reached */
+	TArray<float> RecordedSplits;
+
+	/** Lap held by each row of RecordedSplits */
+	TArray<int32> RecordedLaps;
+
+	/** If true, a full lap was timed and BestSplits holds its splits */
+	bool bHasBestSplits = false;
+
+	/** Difference to the best lap at the last split, in seconds. Negative is ahead */
+	float LastSplitDelta = 0.0f;
+
+	/** If true, LastSplitDelta compares against a best lap */
+	bool bHasSplitDelta = false;
+
 public:
 
 	/** Delegate to broadcast when the race starts */
@@ -50,8 +92,29 @@ protected:
 
 public:
 
-	/** Increments the lap and updates the lap counter */
-	void UpdateLapCount(int32 Lap, float NewLapStartTime);
+	/**
+	 *  Increments the lap and updates the lap counter
+	 *  @param Lap New lap number
+	 *  @param NewLapStartTime Physics time the lap started at, interpolated to the finish line crossing
+	 *  @return true if the lap just completed is the new best lap
+	 */
+	bool UpdateLapCount(int32 Lap, double NewLapStartTime);
+
+	/**
+	 *  Completes the current sector
+	 *  @param CrossingTime Physics time the sector's end gate was crossed at
+	 */
+	void UpdateSector(double CrossingTime);
+
+	/**
+	 *  Gets the world time the current lap started at, for Blueprint timers that subtract it from the game time.
+	 *  Worked back from the physics clock, so game time minus this is always the current lap time
+	 */
+	UFUNCTION(BlueprintPure, Category="Time Trial")
+	double GetLapStartTime() const;
+
+	/** Gets the physics time the current lap started at, the clock lap and split times are taken on */
+	double GetPhysicsLapStartTime() const { return LapStartTime; };
 
 	/** Allows Blueprint control to update the lap tracker widgets */
 	UFUNCTION(BlueprintImplementableEvent, Category="Time Trial", meta = (DisplayName = "Update Laps"))
@@ -69,9 +132,60 @@ protected:
 
 	/** Gets the best lap time saved */
 	UFUNCTION(BlueprintPure, Category="Time Trial")
-	float GetBestLapTime() const { return BestLapTime; };
+	double GetBestLapTime() const { return BestLapTime; };
 
-	/** Gets the best lap time saved */
+	/** Gets the time spent on the current lap so far, on the same clock as the lap times */
 	UFUNCTION(BlueprintPure, Category="Time Trial")
-	float GetLapStartTime() const { return LapStartTime; };
+	double GetCurrentLapTime() const;
+
+	/** Gets the current sector index */
+	UFUNCTION(BlueprintPure, Category="Time Trial")
+	int32 GetCurrentSector() const { return CurrentSector; };
+
+	/** Gets the time taken by the last completed sector */
+	UFUNCTION(BlueprintPure, Category="Time Trial")
+	double GetLastSectorTime() const { return LastSectorTime; };
+
+	/** Allows Blueprint control to update the split widgets. Called once per split, not every frame */
+	UFUNCTION(BlueprintImplementableEvent, Category="Time Trial", meta = (DisplayName = "Update Splits"))
+	void BP_UpdateSplits();
+
+	/** Gets the number of splits per lap */
+	UFUNCTION(BlueprintPure, Category="Splits")
+	int32 GetNumSplits() const { return NumSplits; };
+
+	/** Returns true once a full lap was timed, so there is a best lap to compare against */
+	UFUNCTION(BlueprintPure, Category="Splits")
+	bool HasBestSplits() const { return bHasBestSplits; };
+
+	/** Gets the difference to the best lap at the last split, in seconds. Negative is ahead */
+	UFUNCTION(BlueprintPure, Category="Splits")
+	float GetLastSplitDelta() const { return bHasSplitDelta ? LastSplitDelta : 0.0f; };
+
+	/**
+	 *  Gets the live difference to the best lap, in seconds. Negative is ahead.
+	 *  Holds the last split's delta, and starts growing once the current sector takes longer than it did on the best lap.
+	 */
+	UFUNCTION(BlueprintPure, Category="Splits")
+	float GetLiveDeltaToBest() const;
+
+	/** Gets a split of the current lap, or a negative time if it wasn't reached yet */
+	UFUNCTION(BlueprintPure, Category="Splits")
+	float GetCurrentSplit(int32 Split) const { return CurrentSplits.IsValidIndex(Split) ? CurrentSplits[Split] : -1.0f; };
+
+	/** Gets a split of the best lap, or a negative time if there is no best lap */
+	UFUNCTION(BlueprintPure, Category="Splits")
+	float GetBestSplit(int32 Split) const { return bHasBestSplits && BestSplits.IsValidIndex(Split) ? BestSplits[Split] : -1.0f; };
+
+	/** Gets a split of a recent lap, or a negative time if it wasn't reached or is no longer kept */
+	UFUNCTION(BlueprintPure, Category="Splits")
+	float GetLapSplit(int32 Lap, int32 Split) const;
+
+protected:
+
+	/** Sizes the split arrays for the track's gates */
+	void InitSplits();
+
+	/** Returns the first entry of a lap's splits in RecordedSplits */
+	int32 GetRecordedLapOffset(int32 Lap) const { return ((Lap - 1) % MaxRecordedLaps) * NumSplits; };
 };